@@ -0,0 +1,59 @@
+#include "audio_prompt.h"
+#include <string.h>
+
+static const int16_t ima_step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t ima_index_table[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+const audio_prompt_header_t *audio_prompt_header(const uint8_t *data, size_t len) {
+    const audio_prompt_header_t *header = (const audio_prompt_header_t *) data;
+    if (len < sizeof(audio_prompt_header_t) || memcmp(header->magic, AUDIO_PROMPT_MAGIC, 4) ||
+        header->block_samples == 0 || (header->block_samples & 1)) {
+        return NULL;
+    }
+    size_t full = header->samples / header->block_samples;
+    size_t rest = header->samples % header->block_samples;
+    size_t need = sizeof(audio_prompt_header_t) + full * AUDIO_PROMPT_BLOCK_BYTES(header->block_samples) +
+                  (rest ? AUDIO_PROMPT_BLOCK_HEADER + (rest + 1) / 2 : 0);
+    if (len < need) {
+        return NULL;
+    }
+    return header;
+}
+
+int audio_prompt_decode_block(const uint8_t *block, int samples, int16_t *out, int channels) {
+    int predictor = (int16_t) (block[0] | (block[1] << 8));
+    int index     = block[2] > 88 ? 88 : block[2];
+    const uint8_t *nibbles = block + AUDIO_PROMPT_BLOCK_HEADER;
+    for (int i = 0; i < samples; i++) {
+        int code = (i & 1) ? (nibbles[i >> 1] >> 4) : (nibbles[i >> 1] & 0x0f);
+        int step = ima_step_table[index];
+        int diff = step >> 3;
+        if (code & 4)
+            diff += step;
+        if (code & 2)
+            diff += step >> 1;
+        if (code & 1)
+            diff += step >> 2;
+        predictor += (code & 8) ? -diff : diff;
+        if (predictor > 32767)
+            predictor = 32767;
+        else if (predictor < -32768)
+            predictor = -32768;
+        index += ima_index_table[code];
+        if (index < 0)
+            index = 0;
+        else if (index > 88)
+            index = 88;
+        for (int c = 0; c < channels; c++) {
+            *out++ = (int16_t) predictor;
+        }
+    }
+    return samples;
+}
@@ -0,0 +1,50 @@
+#ifndef AUDIO_PROMPT_H
+#define AUDIO_PROMPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Prompt clips are stored as mono IMA-ADPCM (4 bits per sample) instead of
+raw PCM, written by scripts/pcm_to_adpcm.py:
+
+  header  audio_prompt_header_t, little endian
+  blocks  block_samples samples each (the last one may be shorter):
+          int16 predictor, uint8 step index, uint8 reserved,
+          then two samples per byte, low nibble first
+
+Each block restarts the decoder state, so a damaged block only spoils
+itself and playback can stop at any block boundary.
+*/
+
+#define AUDIO_PROMPT_MAGIC        "IMAA"
+#define AUDIO_PROMPT_BLOCK_HEADER 4
+
+typedef struct __attribute__((packed)) {
+    char     magic[4];      // AUDIO_PROMPT_MAGIC
+    uint32_t sample_rate;
+    uint32_t samples;       // Mono samples in the clip
+    uint16_t block_samples; // Even
+    uint16_t reserved;
+} audio_prompt_header_t;
+
+#define AUDIO_PROMPT_BLOCK_BYTES(block_samples) (AUDIO_PROMPT_BLOCK_HEADER + (block_samples) / 2)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Header of an embedded clip, NULL if data is not a valid clip*/
+const audio_prompt_header_t *audio_prompt_header(const uint8_t *data, size_t len);
+
+/*
+Decode one block of samples samples into out, each sample written
+channels times (interleaved). Returns the number of samples decoded.
+*/
+int audio_prompt_decode_block(const uint8_t *block, int samples, int16_t *out, int channels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,7 +1,11 @@
 #include "user_audio_bsp.h"
+#include "audio_prompt.h"
+#include "esp_heap_caps.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 #include "i2c_bsp.h"
 #include <stdio.h>
 #include <string.h>
@@ -12,17 +16,81 @@
 esp_codec_dev_handle_t playback = NULL;
 esp_codec_dev_handle_t record   = NULL;
 
-extern const uint8_t mode_pcm_start[] asm("_binary_mode_pcm_start");
-extern const uint8_t mode_pcm_end[] asm("_binary_mode_pcm_end");
+extern const uint8_t mode_adp_start[] asm("_binary_mode_adp_start");
+extern const uint8_t mode_adp_end[] asm("_binary_mode_adp_end");
 
-extern const uint8_t one_pcm_start[] asm("_binary_mode_1_pcm_start");
-extern const uint8_t one_pcm_end[] asm("_binary_mode_1_pcm_end");
+extern const uint8_t one_adp_start[] asm("_binary_mode_1_adp_start");
+extern const uint8_t one_adp_end[] asm("_binary_mode_1_adp_end");
 
-extern const uint8_t two_pcm_start[] asm("_binary_mode_2_pcm_start");
-extern const uint8_t two_pcm_end[] asm("_binary_mode_2_pcm_end");
+extern const uint8_t two_adp_start[] asm("_binary_mode_2_adp_start");
+extern const uint8_t two_adp_end[] asm("_binary_mode_2_adp_end");
 
-extern const uint8_t three_pcm_start[] asm("_binary_mode_3_pcm_start");
-extern const uint8_t three_pcm_end[] asm("_binary_mode_3_pcm_end");
+extern const uint8_t three_adp_start[] asm("_binary_mode_3_adp_start");
+extern const uint8_t three_adp_end[] asm("_binary_mode_3_adp_end");
+
+/*
+Prompt playback: prompt_decode_Task decodes the ADPCM clip one block at a
+time into one of two PCM buffers while Play_Prompt() writes the other to
+the codec, the buffers going back and forth through two queues.
+*/
+#define PROMPT_CHANNELS    2    // Play_InfoAudio() opens the codec in stereo
+#define PROMPT_BUF_SAMPLES 1024 // Mono samples per buffer, the largest block accepted
+#define PROMPT_SAMPLE_RATE 16000
+
+typedef struct {
+    int8_t   buf;   // -1 marks the end of the clip
+    uint16_t bytes;
+} prompt_chunk_t;
+
+static int16_t      *prompt_pcm[2]     = {};
+static QueueHandle_t prompt_req_queue  = NULL; // Clip to decode
+static QueueHandle_t prompt_full_queue = NULL; // Decoded buffers, in order
+static QueueHandle_t prompt_free_queue = NULL; // Buffers written to the codec
+static volatile bool prompt_abort      = false;
+
+static const uint8_t *prompt_clip(uint8_t value, size_t *len) {
+    const uint8_t *start[] = {mode_adp_start, one_adp_start, two_adp_start, three_adp_start};
+    const uint8_t *end[]   = {mode_adp_end, one_adp_end, two_adp_end, three_adp_end};
+    if (value > 3) {
+        return NULL;
+    }
+    *len = end[value] - start[value];
+    return start[value];
+}
+
+static void prompt_decode_Task(void *arg) {
+    uint8_t        value;
+    prompt_chunk_t chunk;
+    for (;;) {
+        if (pdTRUE != xQueueReceive(prompt_req_queue, &value, portMAX_DELAY)) {
+            continue;
+        }
+        size_t                       len    = 0;
+        const uint8_t               *data   = prompt_clip(value, &len);
+        const audio_prompt_header_t *header = data ? audio_prompt_header(data, len) : NULL;
+        if (header && header->sample_rate != PROMPT_SAMPLE_RATE) {
+            ESP_LOGW("audio", "Prompt %d is %lu Hz, played at %d Hz", value, (unsigned long) header->sample_rate, PROMPT_SAMPLE_RATE);
+        }
+        if (header && header->block_samples <= PROMPT_BUF_SAMPLES) {
+            const uint8_t *block = data + sizeof(audio_prompt_header_t);
+            uint32_t       left  = header->samples;
+            while (left && !prompt_abort) {
+                int samples = left < header->block_samples ? left : header->block_samples;
+                xQueueReceive(prompt_free_queue, &chunk.buf, portMAX_DELAY);
+                audio_prompt_decode_block(block, samples, prompt_pcm[chunk.buf], PROMPT_CHANNELS);
+                chunk.bytes = samples * PROMPT_CHANNELS * sizeof(int16_t);
+                xQueueSend(prompt_full_queue, &chunk, portMAX_DELAY);
+                block += AUDIO_PROMPT_BLOCK_HEADER + (samples + 1) / 2;
+                left -= samples;
+            }
+        } else {
+            ESP_LOGE("audio", "Prompt %d is not a valid clip", value);
+        }
+        chunk.buf   = -1;
+        chunk.bytes = 0;
+        xQueueSend(prompt_full_queue, &chunk, portMAX_DELAY);
+    }
+}
 
 user_audio_bsp::user_audio_bsp() {
     set_codec_board_type("USER_CODEC_BOARD");
@@ -34,6 +102,18 @@ user_audio_bsp::user_audio_bsp() {
     ESP_ERROR_CHECK(init_codec(&codec_cfg));
     playback = get_playback_handle();
     record   = get_record_handle();
+
+    for (int i = 0; i < 2; i++) {
+        prompt_pcm[i] = (int16_t *) heap_caps_malloc(PROMPT_BUF_SAMPLES * PROMPT_CHANNELS * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+        assert(prompt_pcm[i]);
+    }
+    prompt_req_queue  = xQueueCreate(1, sizeof(uint8_t));
+    prompt_full_queue = xQueueCreate(2, sizeof(prompt_chunk_t));
+    prompt_free_queue = xQueueCreate(2, sizeof(int8_t));
+    for (int8_t i = 0; i < 2; i++) {
+        xQueueSend(prompt_free_queue, &i, 0);
+    }
+    xTaskCreate(prompt_decode_Task, "prompt_decode_Task", 3 * 1024, NULL, 4, NULL);
 }
 
 user_audio_bsp::~user_audio_bsp() {
@@ -42,7 +122,7 @@ user_audio_bsp::~user_audio_bsp() {
 uint8_t user_audio_bsp::Play_InfoAudio() {
     esp_codec_dev_set_out_vol(playback, 100.0); //Set the volume to 100.
     esp_codec_dev_sample_info_t fs = {};
-    fs.sample_rate                 = 16000;
+    fs.sample_rate                 = PROMPT_SAMPLE_RATE;
     fs.channel                     = 2;
     fs.bits_per_sample             = 16;
     int     err                    = esp_codec_dev_open(playback, &fs); //Start playback
@@ -60,29 +140,25 @@ uint8_t user_audio_bsp::Close_Play() {
     return errx;
 }
 
-int user_audio_bsp::Get_MusicSizt(uint8_t value) {
-    if (value == 0)
-        return (mode_pcm_end - mode_pcm_start);
-    if (value == 1)
-        return (one_pcm_end - one_pcm_start);
-    if (value == 2)
-        return (two_pcm_end - two_pcm_start);
-    if (value == 3)
-        return (three_pcm_end - three_pcm_start);
-    return 0;
-}
-
-uint8_t *user_audio_bsp::Get_MusicData(uint8_t value) {
-    uint8_t *ptr = NULL;
-    if (value == 0)
-        ptr = (uint8_t *) mode_pcm_start;
-    if (value == 1)
-        ptr = (uint8_t *) one_pcm_start;
-    if (value == 2)
-        ptr = (uint8_t *) two_pcm_start;
-    if (value == 3)
-        ptr = (uint8_t *) three_pcm_start;
-    return ptr;
+/*Plays clip value (0-3) to the end or until keep_playing() returns false, returns 0 if it was cut short*/
+uint8_t user_audio_bsp::Play_Prompt(uint8_t value, bool (*keep_playing)(void)) {
+    prompt_chunk_t chunk;
+    prompt_abort = false;
+    xQueueSend(prompt_req_queue, &value, portMAX_DELAY);
+    for (;;) {
+        xQueueReceive(prompt_full_queue, &chunk, portMAX_DELAY);
+        if (chunk.buf < 0) {
+            break;
+        }
+        if (!prompt_abort) {
+            esp_codec_dev_write(playback, prompt_pcm[chunk.buf], chunk.bytes);
+        }
+        xQueueSend(prompt_free_queue, &chunk.buf, 0);
+        if (keep_playing && !keep_playing()) {
+            prompt_abort = true; // The decoder stops at its next block, drain until its end mark
+        }
+    }
+    return prompt_abort ? 0 : 1;
 }
 
 void user_audio_bsp::Set_CodecReg(const char *str, uint8_t reg, uint8_t data) {
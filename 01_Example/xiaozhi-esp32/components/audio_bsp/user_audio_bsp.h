@@ -16,8 +16,7 @@ public:
     uint8_t Play_InfoAudio();
     void Play_BackWrite(void *data_ptr,uint32_t len);
     uint8_t Close_Play();
-    int Get_MusicSizt(uint8_t value);
-    uint8_t* Get_MusicData(uint8_t value);
+    uint8_t Play_Prompt(uint8_t value, bool (*keep_playing)(void));
     void Set_CodecReg(const char * str,uint8_t reg,uint8_t data);
     uint8_t Get_CodecReg(const char *str, uint8_t reg);
 };
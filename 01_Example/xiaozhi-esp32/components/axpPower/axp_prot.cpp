@@ -187,6 +187,14 @@ void state_axp2101_task(void *arg) {
     }
 }
 
+int axp_get_batt_voltage(void) {
+    return axp2101.isBatteryConnect() ? axp2101.getBattVoltage() : -1;
+}
+
+int axp_get_batt_percent(void) {
+    return axp2101.isBatteryConnect() ? axp2101.getBatteryPercent() : -1;
+}
+
 void axp2101_isCharging_task(void *arg) {
     for (;;) {
         vTaskDelay(pdMS_TO_TICKS(20000));
@@ -1,11 +1,21 @@
 #ifndef AXP_PROT_H
 #define AXP_PROT_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void axp_i2c_prot_init(void);
 void axp_cmd_init(void);
 //void axp_basic_sleep_start(void);
 //void state_axp2101_task(void *arg);
 void axp2101_isCharging_task(void *arg);
+int  axp_get_batt_voltage(void);   // mV, -1 without a battery
+int  axp_get_batt_percent(void);   // -1 without a battery
+
+#ifdef __cplusplus
+}
+#endif
 
 
 #endif 
\ No newline at end of file
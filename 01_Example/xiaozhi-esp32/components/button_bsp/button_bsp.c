@@ -2,6 +2,7 @@
 #include "driver/gpio.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_sleep.h"
 #include "esp_timer.h"
 #include "multi_button.h"
 
@@ -43,8 +44,42 @@ static void on_button3_single_click(Button *btn_handle);
 
 /*********************************************/
 
+/*
+The multi_button state machine only needs ticks while a button is pressed
+or a click sequence is open. Each key has a level interrupt at its active
+level (also its light sleep wake-up source); the ISR masks the key and
+starts the tick timer, and once every button is idle again the timer stops
+and the keys are armed again. A key still held at that point fires right
+away, so no press is lost.
+*/
+static esp_timer_handle_t clock_tick_timer = NULL;
+
+static const struct {
+    gpio_num_t pin;
+    uint8_t    active;
+} button_keys[] = {
+    {(gpio_num_t) USER_KEY_1, button1_active},
+    {(gpio_num_t) USER_KEY_2, button2_active},
+    {(gpio_num_t) USER_KEY_3, button3_active},
+};
+
+static void button_keys_arm(void) {
+    for (size_t i = 0; i < sizeof(button_keys) / sizeof(button_keys[0]); i++) {
+        gpio_intr_enable(button_keys[i].pin);
+    }
+}
+
+static void button_key_isr(void *arg) {
+    gpio_intr_disable((gpio_num_t) (uintptr_t) arg);
+    esp_timer_start_periodic(clock_tick_timer, 1000 * TICKS_INTERVAL); // Already running is fine
+}
+
 static void clock_task_callback(void *arg) {
     button_ticks(); //Status callback
+    if (button_all_idle()) {
+        esp_timer_stop(clock_tick_timer);
+        button_keys_arm();
+    }
 }
 
 static uint8_t read_button_GPIO(uint8_t button_id) //Return the GPIO level
@@ -79,6 +114,23 @@ static void gpio_init(void) {
     ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_config(&gpio_conf));
 }
 
+/*Level interrupts at the active level, left masked until button_keys_arm()*/
+static void button_isr_init(void) {
+    esp_err_t isr_ret = gpio_install_isr_service(0);
+    if (isr_ret != ESP_OK && isr_ret != ESP_ERR_INVALID_STATE) { // Already installed is fine
+        ESP_ERROR_CHECK_WITHOUT_ABORT(isr_ret);
+    }
+    for (size_t i = 0; i < sizeof(button_keys) / sizeof(button_keys[0]); i++) {
+        gpio_num_t      pin   = button_keys[i].pin;
+        gpio_int_type_t level = button_keys[i].active ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL;
+        gpio_intr_disable(pin);
+        ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_set_intr_type(pin, level));
+        ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_isr_handler_add(pin, button_key_isr, (void *) (uintptr_t) pin));
+        ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_wakeup_enable(pin, level));
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_sleep_enable_gpio_wakeup()); // Light sleep only, deep sleep keeps its ext1 setup
+}
+
 void button_Init(void) {
     key_groups  = xEventGroupCreate();
     boot_groups = xEventGroupCreate();
@@ -108,12 +160,12 @@ void button_Init(void) {
         .name     = "clock_task",
         .arg      = NULL,
     };
-    esp_timer_handle_t clock_tick_timer = NULL;
     ESP_ERROR_CHECK(esp_timer_create(&clock_tick_timer_args, &clock_tick_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(clock_tick_timer, 1000 * 5)); //5ms
     button_start(&button2);                                                // Start button
     button_start(&button1);                                                // Start button
     button_start(&button3);                                                // Start button
+    button_isr_init();
+    button_keys_arm();                                                     // 5ms ticks only while a key is in use
 }
 
 /*Event function*/
@@ -109,6 +109,24 @@ int button_is_pressed(Button* handle)
 	return (handle->button_level == handle->active_level) ? 1 : 0;
 }
 
+/**
+  * @brief  Check if every started button is released and has no sequence in progress,
+  *         i.e. button_ticks() has nothing left to do until the next press
+  * @param  None
+  * @retval 1: all idle, 0: ticks still needed
+  */
+int button_all_idle(void)
+{
+	Button* target;
+	for (target = head_handle; target; target = target->next) {
+		if (target->state != BTN_STATE_IDLE || target->debounce_cnt != 0 ||
+		    target->button_level == target->active_level) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
 /**
   * @brief  Read button level with inline optimization
   * @param  handle: the button handle struct
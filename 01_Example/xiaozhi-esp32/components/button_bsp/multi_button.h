@@ -76,6 +76,7 @@ void button_ticks(void);
 uint8_t button_get_repeat_count(Button* handle);
 void button_reset(Button* handle);
 int button_is_pressed(Button* handle);
+int button_all_idle(void);
 
 #ifdef __cplusplus
 }
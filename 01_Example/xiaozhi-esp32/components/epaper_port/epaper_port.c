@@ -4,7 +4,10 @@
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #define EPD_DC_PIN 8
 #define EPD_CS_PIN 9
@@ -21,9 +24,40 @@
 #define epaper_dc_0 gpio_set_level(EPD_DC_PIN, 0)
 #define ReadBusy gpio_get_level(EPD_BUSY_PIN)
 
+/*
+SPI clock for the panel. The controller accepts 20 MHz on writes;
+build with -DEPD_SPI_CLOCK_HZ=10000000 to go back to the old 10 MHz
+*/
+#ifndef EPD_SPI_CLOCK_HZ
+#define EPD_SPI_CLOCK_HZ (20 * 1000 * 1000)
+#endif
+
+/*Frame upload stripes (EPD_PORT_STRIPE_SIZE bytes) ping-pong in internal DMA RAM*/
+#define EPD_STRIPE_COUNT 2
+
+static const char *TAG = "epaper_port";
+
 static spi_device_handle_t spi;
 static void                spi_send_byte(uint8_t cmd);
 
+typedef struct {
+    uint8_t          *buf[EPD_STRIPE_COUNT];   // DMA-capable stripe buffers, NULL = polling fallback
+    spi_transaction_t trans[EPD_STRIPE_COUNT];
+    int               next;                    // Buffer handed out next
+    int               in_flight;               // Queued transactions not collected yet
+} epaper_upload_t;
+
+static epaper_upload_t   upload;
+static SemaphoreHandle_t busy_sem; // Given by the BUSY rising edge
+
+static void IRAM_ATTR epaper_busy_isr(void *arg) {
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(busy_sem, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
 static void epaper_gpio_init(void) {
     gpio_config_t gpio_conf = {};
     gpio_conf.intr_type     = GPIO_INTR_DISABLE;
@@ -33,13 +67,21 @@ static void epaper_gpio_init(void) {
     gpio_conf.pull_up_en    = GPIO_PULLUP_ENABLE;
     ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_config(&gpio_conf));
 
-    gpio_conf.intr_type    = GPIO_INTR_DISABLE;
+    gpio_conf.intr_type    = GPIO_INTR_POSEDGE;
     gpio_conf.mode         = GPIO_MODE_INPUT;
     gpio_conf.pin_bit_mask = ((uint64_t) 0x01 << EPD_BUSY_PIN);
     gpio_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
     gpio_conf.pull_up_en   = GPIO_PULLDOWN_ENABLE;
     ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_config(&gpio_conf));
 
+    /*BUSY going high (idle) wakes the waiting task instead of polling*/
+    busy_sem          = xSemaphoreCreateBinary();
+    esp_err_t isr_ret = gpio_install_isr_service(0);
+    if (isr_ret != ESP_OK && isr_ret != ESP_ERR_INVALID_STATE) { // Already installed is fine
+        ESP_ERROR_CHECK_WITHOUT_ABORT(isr_ret);
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_isr_handler_add(EPD_BUSY_PIN, epaper_busy_isr, NULL));
+
     epaper_rst_1;
 }
 
@@ -68,7 +110,7 @@ static void epaper_spi_init(void) {
     buscfg.max_transfer_sz               = EXAMPLE_LCD_WIDTH * EXAMPLE_LCD_HEIGHT;
     spi_device_interface_config_t devcfg = {};
     devcfg.spics_io_num                  = -1;
-    devcfg.clock_speed_hz                = 10 * 1000 * 1000; //Clock out at 10 MHz
+    devcfg.clock_speed_hz                = EPD_SPI_CLOCK_HZ;
     devcfg.mode                          = 0;                //SPI mode 0
     devcfg.queue_size                    = 7;                //We want to be able to queue 7 transactions at a time
     devcfg.flags                         = SPI_DEVICE_HALFDUPLEX;
@@ -76,17 +118,30 @@ static void epaper_spi_init(void) {
     ESP_ERROR_CHECK(ret);
     ret = spi_bus_add_device(SPI3_HOST, &devcfg, &spi);
     ESP_ERROR_CHECK(ret);
+
+    for (int i = 0; i < EPD_STRIPE_COUNT; i++) {
+        upload.buf[i] = (uint8_t *) heap_caps_malloc(EPD_PORT_STRIPE_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (upload.buf[i] == NULL) {
+            ESP_LOGW(TAG, "No DMA memory for upload stripes, falling back to polling transfers");
+            for (int j = 0; j < i; j++) {
+                heap_caps_free(upload.buf[j]);
+                upload.buf[j] = NULL;
+            }
+            break;
+        }
+    }
+    ESP_LOGI(TAG, "SPI clock %d Hz, %s frame upload", EPD_SPI_CLOCK_HZ, upload.buf[0] ? "DMA ping-pong" : "polling");
 }
 
 /*
   Waiting for the idle signal
 */
 static void epaper_readbusyh(void) {
-    while (1) {
-        if (ReadBusy) {
-            return;
-        }
-        vTaskDelay(pdMS_TO_TICKS(10));
+    /*Drop an edge left over from an earlier wait, then sleep until the next one.
+      The timeout only re-checks the level in case an edge was missed*/
+    xSemaphoreTake(busy_sem, 0);
+    while (!ReadBusy) {
+        xSemaphoreTake(busy_sem, pdMS_TO_TICKS(100));
     }
 }
 
@@ -110,10 +165,31 @@ void epaper_SendData(uint8_t Data) {
     epaper_cs_1;
 }
 
+/*
+Collect the oldest queued stripe, blocking until the DMA transfer finished
+*/
+static void epaper_upload_collect(void) {
+    spi_transaction_t *done;
+    esp_err_t          ret = spi_device_get_trans_result(spi, &done, portMAX_DELAY);
+    assert(ret == ESP_OK);
+    upload.in_flight--;
+}
+
 /*send bytes data*/
 void epaper_Sendbuffera(uint8_t *Data, int len) {
-    epaper_dc_1;
-    epaper_cs_0;
+    if (upload.buf[0] != NULL) {
+        /*Copy the next stripe while the previous one is on the wire*/
+        while (len > 0) {
+            int      n   = len < EPD_PORT_STRIPE_SIZE ? len : EPD_PORT_STRIPE_SIZE;
+            uint8_t *buf = epaper_port_upload_buffer();
+            memcpy(buf, Data, n);
+            epaper_port_upload_queue(n);
+            Data += n;
+            len -= n;
+        }
+        return;
+    }
+
     esp_err_t         ret;
     spi_transaction_t t;
     memset(&t, 0, sizeof(t));
@@ -132,13 +208,12 @@ void epaper_Sendbuffera(uint8_t *Data, int len) {
     t.tx_buffer = ptr;
     ret         = spi_device_polling_transmit(spi, &t); //Transmit!
     assert(ret == ESP_OK);                              //Should have had no issues.
-    epaper_cs_1;
 }
 
 /*
   The data has been uploaded to Buff
 */
-static void epaper_TurnOnDisplay(void) {
+void epaper_port_refresh(void) {
 
     epaper_SendCommand(0x04); // POWER_ON
     epaper_readbusyh();
@@ -250,6 +325,56 @@ static void spi_send_byte(uint8_t cmd) {
 
 /*Shared function API*/
 
+/*
+start a frame upload: DATA_START_TRANSMISSION, then stripes until epaper_port_upload_end()
+*/
+void epaper_port_upload_begin(void) {
+    epaper_SendCommand(0x10);
+    epaper_dc_1;
+    epaper_cs_0;
+    upload.next      = 0;
+    upload.in_flight = 0;
+}
+
+/*
+free stripe buffer (EPD_PORT_STRIPE_SIZE bytes), waits for its previous transfer if needed
+*/
+uint8_t *epaper_port_upload_buffer(void) {
+    /*Transfers complete in order, so the oldest one frees exactly this buffer*/
+    if (upload.in_flight == EPD_STRIPE_COUNT) {
+        epaper_upload_collect();
+    }
+    return upload.buf[upload.next];
+}
+
+/*
+queue the buffer from epaper_port_upload_buffer() with len bytes, returns at once
+*/
+void epaper_port_upload_queue(int len) {
+    spi_transaction_t *t = &upload.trans[upload.next];
+    memset(t, 0, sizeof(*t));
+    t->length        = 8 * len;
+    t->tx_buffer     = upload.buf[upload.next];
+    esp_err_t ret    = spi_device_queue_trans(spi, t, portMAX_DELAY);
+    assert(ret == ESP_OK);
+    upload.in_flight++;
+    upload.next = (upload.next + 1) % EPD_STRIPE_COUNT;
+}
+
+/*
+wait for the queued stripes and release CS
+*/
+void epaper_port_upload_end(void) {
+    while (upload.in_flight > 0) {
+        epaper_upload_collect();
+    }
+    epaper_cs_1;
+}
+
+bool epaper_port_upload_async(void) {
+    return upload.buf[0] != NULL;
+}
+
 /*
 clear screen
 */
@@ -258,23 +383,32 @@ void epaper_port_clear(uint8_t *Image, uint8_t color) {
     Width  = (EXAMPLE_LCD_WIDTH % 2 == 0) ? (EXAMPLE_LCD_WIDTH / 2) : (EXAMPLE_LCD_WIDTH / 2 + 1);
     Height = EXAMPLE_LCD_HEIGHT;
 
-    epaper_SendCommand(0x10);
     for (int j = 0; j < Height * Width; j++) {
         Image[j] = (color << 4) | color;
     }
+    epaper_port_upload_begin();
     epaper_Sendbuffera(Image, Height * Width);
-    epaper_TurnOnDisplay();
+    epaper_port_upload_end();
+    epaper_port_refresh();
 }
 
 /*
-display
+Upload a frame to the panel RAM without refreshing
 */
-void epaper_port_display(uint8_t *Image) {
+void epaper_port_upload_frame(uint8_t *Image) {
     uint16_t Width, Height;
     Width  = (EXAMPLE_LCD_WIDTH % 2 == 0) ? (EXAMPLE_LCD_WIDTH / 2) : (EXAMPLE_LCD_WIDTH / 2 + 1);
     Height = EXAMPLE_LCD_HEIGHT;
 
-    epaper_SendCommand(0x10);
+    epaper_port_upload_begin();
     epaper_Sendbuffera(Image, Height * Width);
-    epaper_TurnOnDisplay();
-}
\ No newline at end of file
+    epaper_port_upload_end();
+}
+
+/*
+display
+*/
+void epaper_port_display(uint8_t *Image) {
+    epaper_port_upload_frame(Image);
+    epaper_port_refresh();
+}
@@ -1,6 +1,9 @@
 #ifndef EPAPER_PORT_H
 #define EPAPER_PORT_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 
 /**********************************
 Color Index
@@ -17,6 +20,9 @@ Color Index
 #define EXAMPLE_LCD_WIDTH  800
 #define EXAMPLE_LCD_HEIGHT 480
 
+/*Frame upload stripe: 12 rows of the packed 4bpp frame*/
+#define EPD_PORT_STRIPE_SIZE (12 * EXAMPLE_LCD_WIDTH / 2)
+
 
 /**********************************
 Color Index
@@ -38,6 +44,39 @@ void epaper_port_init(void);
 void epaper_port_clear(uint8_t *Image,uint8_t color);
 void epaper_port_display(uint8_t *Image);
 
+/*
+Stripe-wise frame upload over queued DMA transactions. Two stripe buffers
+ping-pong, so the next stripe can be rendered into one while the other is
+on the wire; waits block on the SPI driver instead of polling.
+
+    epaper_port_upload_begin();
+    for each stripe:
+        uint8_t *buf = epaper_port_upload_buffer();  // fill up to EPD_PORT_STRIPE_SIZE bytes
+        epaper_port_upload_queue(len);
+    epaper_port_upload_end();
+    epaper_port_refresh();
+
+epf_upload() is the producer that fills stripes as it reads the card;
+epaper_port_upload_frame() copies stripes from a finished framebuffer.
+epaper_port_upload_buffer() returns NULL when no DMA memory was available
+at init (see epaper_port_upload_async()); epaper_port_display() handles
+both cases.
+*/
+void     epaper_port_upload_begin(void);
+uint8_t *epaper_port_upload_buffer(void);
+void     epaper_port_upload_queue(int len);
+void     epaper_port_upload_end(void);
+bool     epaper_port_upload_async(void);
+
+/*
+Whole-frame upload without the refresh; Image may be reused as soon as
+this returns, e.g. to render the next frame during epaper_port_refresh()
+*/
+void epaper_port_upload_frame(uint8_t *Image);
+
+/*Power on, refresh the panel from its RAM and power off again*/
+void epaper_port_refresh(void);
+
 
 #ifdef __cplusplus
 }
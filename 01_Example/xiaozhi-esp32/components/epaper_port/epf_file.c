@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "epf_file.h"
+#include "epaper_port.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+/*RLE data goes through a small internal RAM buffer in both directions*/
+#define EPF_IO_CHUNK 4096
+
+static const char *TAG = "epf_file";
+
+bool epf_is_epf_path(const char *path) {
+    size_t len = strlen(path);
+    return len >= 4 && strcasecmp(path + len - 4, ".epf") == 0;
+}
+
+/*
+One PackBits token for in[*pos..], written to out (at most 129 bytes).
+Runs of three or more become a repeat, anything shorter stays literal.
+*/
+static size_t epf_rle_token(const uint8_t *in, size_t n, size_t *pos, uint8_t *out) {
+    size_t p = *pos;
+    size_t run = 1;
+    while (p + run < n && run < 128 && in[p + run] == in[p]) {
+        run++;
+    }
+    if (run >= 3) {
+        out[0] = (uint8_t)(257 - run);
+        out[1] = in[p];
+        *pos = p + run;
+        return 2;
+    }
+
+    size_t len = 0;
+    while (p + len < n && len < 128) {
+        if (p + len + 2 < n && in[p + len] == in[p + len + 1] && in[p + len] == in[p + len + 2]) {
+            break;
+        }
+        len++;
+    }
+    out[0] = (uint8_t)(len - 1);
+    memcpy(out + 1, in + p, len);
+    *pos = p + len;
+    return len + 1;
+}
+
+static size_t epf_rle_size(const uint8_t *in, size_t n) {
+    uint8_t token[129];
+    size_t size = 0;
+    size_t pos = 0;
+    while (pos < n) {
+        size += epf_rle_token(in, n, &pos, token);
+    }
+    return size;
+}
+
+esp_err_t epf_write(const char *path, const uint8_t *frame, int width, int height,
+                    uint8_t layout, uint8_t compression) {
+    if (frame == NULL || width <= 0 || height <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t frame_size = (size_t)(width + 1) / 2 * height;
+    size_t data_size = frame_size;
+    if (compression == EPF_COMPRESSION_RLE) {
+        data_size = epf_rle_size(frame, frame_size);
+        if (data_size >= frame_size) {
+            compression = EPF_COMPRESSION_NONE;
+            data_size = frame_size;
+        }
+    } else {
+        compression = EPF_COMPRESSION_NONE;
+    }
+
+    epf_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EPF_MAGIC, 4);
+    header.width = width;
+    header.height = height;
+    header.bpp = 4;
+    header.compression = compression;
+    header.layout = layout;
+    header.data_size = data_size;
+    header.frame_size = frame_size;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    if (ok && compression == EPF_COMPRESSION_NONE) {
+        ok = fwrite(frame, 1, frame_size, f) == frame_size;
+    } else if (ok) {
+        uint8_t *chunk = (uint8_t *)heap_caps_malloc(EPF_IO_CHUNK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (chunk == NULL) {
+            fclose(f);
+            remove(path);
+            return ESP_ERR_NO_MEM;
+        }
+        size_t pos = 0;
+        size_t fill = 0;
+        while (ok && pos < frame_size) {
+            fill += epf_rle_token(frame, frame_size, &pos, chunk + fill);
+            if (EPF_IO_CHUNK - fill < 129 || pos == frame_size) {
+                ok = fwrite(chunk, 1, fill, f) == fill;
+                fill = 0;
+            }
+        }
+        heap_caps_free(chunk);
+    }
+
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write %s", path);
+        remove(path);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Saved %s: %dx%d, %s, %u bytes", path, width, height,
+             compression == EPF_COMPRESSION_RLE ? "RLE" : "raw", (unsigned)(sizeof(header) + data_size));
+    return ESP_OK;
+}
+
+/*
+Where decoded frame bytes go: straight into frame, or (frame == NULL) into
+upload stripes that are queued to the panel as soon as they are full
+*/
+typedef struct {
+    uint8_t *frame;
+    uint8_t *stripe;
+    size_t   fill;      // Bytes in stripe
+    size_t   out;       // Frame bytes produced so far
+} epf_sink_t;
+
+/*n bytes from src, or n copies of value when src is NULL*/
+static void epf_sink_put(epf_sink_t *sink, const uint8_t *src, uint8_t value, size_t n) {
+    if (sink->frame != NULL) {
+        if (src != NULL) {
+            memcpy(sink->frame + sink->out, src, n);
+        } else {
+            memset(sink->frame + sink->out, value, n);
+        }
+        sink->out += n;
+        return;
+    }
+    while (n > 0) {
+        if (sink->stripe == NULL) {
+            sink->stripe = epaper_port_upload_buffer();
+            sink->fill = 0;
+        }
+        size_t copy = EPD_PORT_STRIPE_SIZE - sink->fill;
+        copy = copy < n ? copy : n;
+        if (src != NULL) {
+            memcpy(sink->stripe + sink->fill, src, copy);
+            src += copy;
+        } else {
+            memset(sink->stripe + sink->fill, value, copy);
+        }
+        sink->fill += copy;
+        sink->out += copy;
+        n -= copy;
+        if (sink->fill == EPD_PORT_STRIPE_SIZE) {
+            epaper_port_upload_queue(sink->fill);
+            sink->stripe = NULL;
+        }
+    }
+}
+
+static void epf_sink_flush(epf_sink_t *sink) {
+    if (sink->frame == NULL && sink->stripe != NULL && sink->fill > 0) {
+        epaper_port_upload_queue(sink->fill);
+    }
+    sink->stripe = NULL;
+}
+
+/*Expand RLE data of len bytes from f into sink, tokens may span chunks*/
+static esp_err_t epf_read_rle(FILE *f, size_t len, epf_sink_t *sink, size_t frame_size) {
+    uint8_t *chunk = (uint8_t *)heap_caps_malloc(EPF_IO_CHUNK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (chunk == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+    size_t literal = 0;     // Literal bytes still to copy
+    size_t repeat = 0;      // Pending repeat count, waiting for its byte
+    while (err == ESP_OK && len > 0) {
+        size_t n = len < EPF_IO_CHUNK ? len : EPF_IO_CHUNK;
+        if (fread(chunk, 1, n, f) != n) {
+            err = ESP_FAIL;
+            break;
+        }
+        len -= n;
+
+        size_t i = 0;
+        while (i < n) {
+            if (literal > 0) {
+                size_t copy = literal < n - i ? literal : n - i;
+                if (copy > frame_size - sink->out) {
+                    err = ESP_FAIL;
+                    break;
+                }
+                epf_sink_put(sink, chunk + i, 0, copy);
+                i += copy;
+                literal -= copy;
+            } else if (repeat > 0) {
+                if (repeat > frame_size - sink->out) {
+                    err = ESP_FAIL;
+                    break;
+                }
+                epf_sink_put(sink, NULL, chunk[i++], repeat);
+                repeat = 0;
+            } else {
+                uint8_t control = chunk[i++];
+                if (control < 128) {
+                    literal = control + 1;
+                } else if (control > 128) {
+                    repeat = 257 - control;
+                }
+            }
+        }
+    }
+    heap_caps_free(chunk);
+
+    if (err == ESP_OK && (sink->out != frame_size || literal > 0 || repeat > 0)) {
+        err = ESP_FAIL;
+    }
+    return err;
+}
+
+/*Raw frame data read stripe by stripe, each fread overlapping the transfer of the previous stripe*/
+static esp_err_t epf_read_raw_stripes(FILE *f, size_t frame_size) {
+    while (frame_size > 0) {
+        size_t n = frame_size < EPD_PORT_STRIPE_SIZE ? frame_size : EPD_PORT_STRIPE_SIZE;
+        uint8_t *stripe = epaper_port_upload_buffer();
+        if (fread(stripe, 1, n, f) != n) {
+            return ESP_FAIL;
+        }
+        epaper_port_upload_queue(n);
+        frame_size -= n;
+    }
+    return ESP_OK;
+}
+
+/*Open path and check its header against the panel; f is left at the frame data*/
+static esp_err_t epf_open(const char *path, int width, int height, uint8_t layout, FILE **out, epf_header_t *header) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    size_t frame_size = (size_t)(width + 1) / 2 * height;
+    esp_err_t err = ESP_OK;
+    if (fread(header, sizeof(*header), 1, f) != 1 || memcmp(header->magic, EPF_MAGIC, 4) != 0 || header->bpp != 4) {
+        ESP_LOGE(TAG, "%s is not an EPF file", path);
+        err = ESP_ERR_INVALID_ARG;
+    } else if (header->width != width || header->height != height || header->frame_size != frame_size) {
+        ESP_LOGE(TAG, "%s is %ux%u, panel is %dx%d", path, header->width, header->height, width, height);
+        err = ESP_ERR_INVALID_SIZE;
+    } else if (header->layout != layout) {
+        ESP_LOGE(TAG, "%s layout 0x%02x, expected 0x%02x", path, header->layout, layout);
+        err = ESP_ERR_INVALID_STATE;
+    } else if (header->compression == EPF_COMPRESSION_NONE) {
+        if (header->data_size != frame_size) {
+            ESP_LOGE(TAG, "%s: raw frame data of %u bytes", path, (unsigned)header->data_size);
+            err = ESP_FAIL;
+        }
+    } else if (header->compression != EPF_COMPRESSION_RLE) {
+        ESP_LOGE(TAG, "%s: unknown compression %u", path, header->compression);
+        err = ESP_ERR_NOT_SUPPORTED;
+    }
+    if (err != ESP_OK) {
+        fclose(f);
+        return err;
+    }
+    *out = f;
+    return ESP_OK;
+}
+
+esp_err_t epf_read(const char *path, uint8_t *frame, int width, int height, uint8_t layout) {
+    FILE *f;
+    epf_header_t header;
+    esp_err_t err = epf_open(path, width, height, layout, &f, &header);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (header.compression == EPF_COMPRESSION_NONE) {
+        if (fread(frame, 1, header.frame_size, f) != header.frame_size) {
+            err = ESP_FAIL;
+        }
+    } else {
+        epf_sink_t sink = {frame, NULL, 0, 0};
+        err = epf_read_rle(f, header.data_size, &sink, header.frame_size);
+    }
+    fclose(f);
+
+    if (err == ESP_FAIL) {
+        ESP_LOGE(TAG, "%s: truncated or corrupt frame data", path);
+    }
+    return err;
+}
+
+esp_err_t epf_upload(const char *path, int width, int height, uint8_t layout) {
+    if (!epaper_port_upload_async()) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    FILE *f;
+    epf_header_t header;
+    esp_err_t err = epf_open(path, width, height, layout, &f, &header);
+    if (err != ESP_OK) {
+        return err;
+    }
+    epaper_port_upload_begin();
+    if (header.compression == EPF_COMPRESSION_NONE) {
+        err = epf_read_raw_stripes(f, header.frame_size);
+    } else {
+        epf_sink_t sink = {NULL, NULL, 0, 0};
+        err = epf_read_rle(f, header.data_size, &sink, header.frame_size);
+        epf_sink_flush(&sink);
+    }
+    epaper_port_upload_end();
+    fclose(f);
+
+    if (err == ESP_FAIL) {
+        ESP_LOGE(TAG, "%s: truncated or corrupt frame data, panel RAM is incomplete", path);
+    }
+    return err;
+}
@@ -0,0 +1,78 @@
+#ifndef EPF_FILE_H
+#define EPF_FILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*
+EPF ("e-paper frame") files hold the panel framebuffer exactly as it is
+sent to the panel: 4bpp EPD_7IN3E_* codes, two pixels per byte, even X in
+the high nibble, rows of (width + 1) / 2 bytes. A 20-byte header comes
+first, then the frame, raw or PackBits RLE-compressed:
+
+    control n = 0..127     n + 1 literal bytes follow
+    control n = 129..255   the next byte repeats 257 - n times
+    control n = 128        no-op
+
+A raw file is loaded with one fread straight into the framebuffer.
+scripts/bmp_to_epf.py converts existing 6-colour BMPs on the host.
+*/
+
+#define EPF_MAGIC "EPF1"
+
+#define EPF_COMPRESSION_NONE 0
+#define EPF_COMPRESSION_RLE  1
+
+/*Paint rotation (0/90/180/270) and mirror bits the frame was rendered with*/
+#define EPF_LAYOUT(rotate, mirror) ((uint8_t)((((rotate) / 90) & 0x03) | (((mirror) & 0x03) << 2)))
+
+/*Little-endian on disk*/
+typedef struct __attribute__((packed)) {
+    char     magic[4];      // EPF_MAGIC
+    uint16_t width;         // Panel memory width in pixels
+    uint16_t height;        // Panel memory height in pixels
+    uint8_t  bpp;           // Always 4
+    uint8_t  compression;   // EPF_COMPRESSION_*
+    uint8_t  layout;        // EPF_LAYOUT()
+    uint8_t  reserved;
+    uint32_t data_size;     // Bytes following the header
+    uint32_t frame_size;    // Bytes of the unpacked frame
+} epf_header_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*True if path ends in ".epf" (any case)*/
+bool epf_is_epf_path(const char *path);
+
+/*
+Save a frame. With EPF_COMPRESSION_RLE the frame is only compressed when
+that makes the file smaller (dithered photos usually stay raw).
+*/
+esp_err_t epf_write(const char *path, const uint8_t *frame, int width, int height,
+                    uint8_t layout, uint8_t compression);
+
+/*
+Load a frame into frame ((width + 1) / 2 * height bytes). Fails with
+ESP_ERR_INVALID_SIZE if the file was made for another panel size and
+ESP_ERR_INVALID_STATE if it was made for another layout.
+*/
+esp_err_t epf_read(const char *path, uint8_t *frame, int width, int height, uint8_t layout);
+
+/*
+Stream a frame from the card straight into the panel RAM through the
+upload stripes, reading (and unpacking) the next stripe while the previous
+one is on the wire; no framebuffer is involved. ESP_ERR_NOT_SUPPORTED
+without DMA stripes. Other errors before the upload leave the panel RAM
+untouched, a failure part way through (ESP_FAIL) leaves it incomplete, so
+upload a full frame before the next refresh.
+*/
+esp_err_t epf_upload(const char *path, int width, int height, uint8_t layout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !EPF_FILE_H
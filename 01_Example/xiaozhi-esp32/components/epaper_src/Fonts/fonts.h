@@ -79,6 +79,17 @@ typedef struct
   
 }cFONT;
 
+//Sorted codepoint index of a cFONT table, generated at build time by scripts/gen_font_index.py
+typedef struct
+{
+  const uint32_t *codepoint;                          // Unicode codepoints, ascending
+  const uint16_t *slot;                               // Table entry of each codepoint
+  uint16_t size;
+}cFONT_INDEX;
+
+//NULL if the table was not indexed
+const cFONT_INDEX *Font_CN_GetIndex(const cFONT *font);
+
 extern sFONT Font24;
 
 extern cFONT Font22CN;
@@ -45,6 +45,8 @@
 
 #include "GUI_BMPfile.h"
 #include "GUI_Paint.h"
+#include "epaper_port.h"
+#include "epf_file.h"
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -59,6 +61,7 @@
 
 
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
 
 static const char *TAG = "GUI_BMPfile";
 
@@ -365,13 +368,10 @@ UBYTE GUI_ReadBmp_RGB_7Color(const char *path, UWORD Xstart, UWORD Ystart)
     fclose(fp);
    
     // Refresh the image to the display buffer based on the displayed orientation
+    // BMP rows are stored bottom-up, each one is drawn as a span
     for(y = 0; y < bmpInfoHeader.biHeight; y++) {
-        for(x = 0; x < bmpInfoHeader.biWidth; x++) {
-            if(x > Paint.Width || y > Paint.Height) {
-                break;
-            }
-            Paint_SetPixel(Xstart + x, Ystart + y, Image[bmpInfoHeader.biHeight *  bmpInfoHeader.biWidth - 1 -(bmpInfoHeader.biWidth-x-1+(y* bmpInfoHeader.biWidth))]);
-		}
+        Paint_DrawSpan(Xstart, Ystart + y, Image + (bmpInfoHeader.biHeight - 1 - y) * bmpInfoHeader.biWidth,
+                       bmpInfoHeader.biWidth, SPAN_HORIZONTAL);
     }
     return 0;
 }
@@ -447,263 +447,284 @@ UBYTE GUI_ReadBmp_RGB_4Color(const char *path, UWORD Xstart, UWORD Ystart)
     fclose(fp);
    
     // Refresh the image to the display buffer based on the displayed orientation
+    // BMP rows are stored bottom-up, each one is drawn as a span
     for(y = 0; y < bmpInfoHeader.biHeight; y++) {
-        for(x = 0; x < bmpInfoHeader.biWidth; x++) {
-            if(x > Paint.Width || y > Paint.Height) {
-                break;
-            }
-            Paint_SetPixel(Xstart + x, Ystart + y, Image[bmpInfoHeader.biHeight *  bmpInfoHeader.biWidth - 1 -(bmpInfoHeader.biWidth-x-1+(y* bmpInfoHeader.biWidth))]);
-		}
+        Paint_DrawSpan(Xstart, Ystart + y, Image + (bmpInfoHeader.biHeight - 1 - y) * bmpInfoHeader.biWidth,
+                       bmpInfoHeader.biWidth, SPAN_HORIZONTAL);
     }
     return 0;
 }
-#if 1
-UBYTE GUI_ReadBmp_RGB_6Color(const char *path, UWORD Xstart, UWORD Ystart)
+/*
+6-color BMP reader state, kept between images so loading allocates nothing:
+pixel rows are read in whole-row chunks through Bmp_Chunk (DMA-capable
+internal RAM when available, so FATFS can transfer sectors straight into
+it), classified into Bmp_Colors and drawn as one span per row.
+*/
+#define BMP_READ_CHUNK  (16 * 1024)
+#define BMP_COLOR_SLOTS 16
+#define BMP_COLOR_EMPTY 0xFFFFFFFF
+/*Multiplicative hash of a packed B | G << 8 | R << 16 pixel, collision-free for the six palette colors*/
+#define BMP_COLOR_HASH(Bgr) ((UDOUBLE)((Bgr) * 0x9E3779B1u) >> 28)
+
+typedef struct {
+    UDOUBLE Bgr;
+    UBYTE Color;
+} BMP_COLOR_SLOT;
+
+static UBYTE *Bmp_Chunk = NULL;
+static UBYTE *Bmp_Colors = NULL;
+static UWORD Bmp_ColorsLen = 0;
+static BMP_COLOR_SLOT Bmp_ColorSlots[BMP_COLOR_SLOTS];
+
+static UBYTE GUI_BmpReaderInit(UWORD RowPixels)
 {
-#if 0
-    FILE *fp;                     //Define a file pointer
-    BMPFILEHEADER bmpFileHeader;  //Define a bmp file header structure
-    BMPINFOHEADER bmpInfoHeader;  //Define a bmp info header structure
-    
-    // Binary file open
-    if((fp = fopen(path, "rb")) == NULL) {
-        ESP_LOGE(TAG,"Cann't open the file!");
-        return 0;
-    }
-
-    // Set the file pointer from the beginning
-    fseek(fp, 0, SEEK_SET);
-    fread(&bmpFileHeader, sizeof(BMPFILEHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 14
-    fread(&bmpInfoHeader, sizeof(BMPINFOHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 50
-    printf("pixel = %ld * %ld\r\n", bmpInfoHeader.biWidth, bmpInfoHeader.biHeight);
-	
-    UDOUBLE Image_Byte = bmpInfoHeader.biWidth * bmpInfoHeader.biHeight * 3;
+    if(Bmp_Chunk == NULL) {
+        Bmp_Chunk = (UBYTE *)heap_caps_aligned_alloc(32, BMP_READ_CHUNK, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if(Bmp_Chunk == NULL) {
+            Bmp_Chunk = (UBYTE *)heap_caps_aligned_alloc(32, BMP_READ_CHUNK, MALLOC_CAP_SPIRAM);
+        }
+        if(Bmp_Chunk == NULL) {
+            ESP_LOGE(TAG, "BMP read buffer allocation failed!");
+            return 0;
+        }
 
-    UBYTE *Image = (UBYTE *)heap_caps_malloc(1000 * sizeof(uint8_t), MALLOC_CAP_8BIT);    
-    //for(int i = 0; i<Image_Byte; i++)
-    memset(Image, 0xFF, Image_Byte);
-    return 0;
-#else
-    FILE *fp;                     //Define a file pointer
-    BMPFILEHEADER bmpFileHeader;  //Define a bmp file header structure
-    BMPINFOHEADER bmpInfoHeader;  //Define a bmp info header structure
-    
-    // Binary file open
-    if((fp = fopen(path, "rb")) == NULL) {
-        ESP_LOGE(TAG,"Cann't open the file!");
-        return 0;
+        // The panel palette as stored in 24-bit BMPs (bytes B, G, R)
+        static const struct { UDOUBLE Bgr; UBYTE Color; } Palette[] = {
+            {0x000000, 0}, // Black
+            {0xFFFFFF, 1}, // White
+            {0xFFFF00, 2}, // Yellow
+            {0xFF0000, 3}, // Red
+            {0x0000FF, 5}, // Blue
+            {0x00FF00, 6}, // Green
+        };
+        for(UWORD i = 0; i < BMP_COLOR_SLOTS; i++) {
+            Bmp_ColorSlots[i].Bgr = BMP_COLOR_EMPTY;
+        }
+        for(UWORD i = 0; i < sizeof(Palette) / sizeof(Palette[0]); i++) {
+            BMP_COLOR_SLOT *Slot = &Bmp_ColorSlots[BMP_COLOR_HASH(Palette[i].Bgr)];
+            Slot->Bgr = Palette[i].Bgr;
+            Slot->Color = Palette[i].Color;
+        }
     }
 
-    // Set the file pointer from the beginning
-    fseek(fp, 0, SEEK_SET);
-    fread(&bmpFileHeader, sizeof(BMPFILEHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 14
-    fread(&bmpInfoHeader, sizeof(BMPINFOHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 50
-    printf("pixel = %ld * %ld\r\n", bmpInfoHeader.biWidth, bmpInfoHeader.biHeight);
-	
-    UDOUBLE Image_Byte = bmpInfoHeader.biWidth * bmpInfoHeader.biHeight * 3;
-
-    UBYTE *Image = (UBYTE *)heap_caps_malloc(Image_Byte * sizeof(uint8_t), MALLOC_CAP_SPIRAM);    
-    //for(int i = 0; i<Image_Byte; i++)
-    //memset(Image, 0xFF, Image_Byte);
-    //ESP_LOGE("FILE","%ld",Image_Byte);
-    // Determine if it is a monochrome bitmap
-    int readbyte = bmpInfoHeader.biBitCount;
-    if(readbyte != 24){
-        ESP_LOGE(TAG,"Bmp image is not 24 bitmap!");
-        exit(0);
+    if(RowPixels > Bmp_ColorsLen) {
+        heap_caps_free(Bmp_Colors);
+        Bmp_Colors = (UBYTE *)heap_caps_malloc(RowPixels, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        Bmp_ColorsLen = Bmp_Colors ? RowPixels : 0;
+        if(Bmp_Colors == NULL) {
+            ESP_LOGE(TAG, "BMP row buffer allocation failed!");
+            return 0;
+        }
     }
-    // Read image data into the cache
-    UWORD x, y;
-    UBYTE Rdata[3];
-    fseek(fp, bmpFileHeader.bOffset, SEEK_SET);
-    
-    for(y = 0; y < bmpInfoHeader.biHeight; y++) {//Total display column
-        for(x = 0; x < bmpInfoHeader.biWidth ; x++) {//Show a line in the line
-            if(fread((char *)Rdata, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
-			if(fread((char *)Rdata+1, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
-			if(fread((char *)Rdata+2, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
+    return 1;
+}
 
-			if(Rdata[0] == 0 && Rdata[1] == 0 && Rdata[2] == 0){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  0;//Black
-			}else if(Rdata[0] == 255 && Rdata[1] == 255 && Rdata[2] == 255){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  1;//White
-			}else if(Rdata[0] == 0 && Rdata[1] == 255 && Rdata[2] == 255){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  2;//Yellow
-			}else if(Rdata[0] == 0 && Rdata[1] == 0 && Rdata[2] == 255){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  3;//Red
-			// }else if(Rdata[0] == 0 && Rdata[1] == 128 && Rdata[2] == 255){
-			// 	Image[x+(y* bmpInfoHeader.biWidth )] =  4;//Orange
-			}else if(Rdata[0] == 255 && Rdata[1] == 0 && Rdata[2] == 0){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  5;//Blue
-			}else if(Rdata[0] == 0 && Rdata[1] == 255 && Rdata[2] == 0){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  6;//Green
-			}
+/*Panel colors of Len BGR pixels, anything off the palette becomes white*/
+static void GUI_BmpClassifyRow(const UBYTE *Bgr, UBYTE *Colors, UWORD Len)
+{
+    UDOUBLE Last = BMP_COLOR_EMPTY;
+    UBYTE LastColor = 1;
+    for(UWORD i = 0; i < Len; i++, Bgr += 3) {
+        UDOUBLE Pixel = Bgr[0] | (Bgr[1] << 8) | ((UDOUBLE)Bgr[2] << 16);
+        if(Pixel != Last) {
+            const BMP_COLOR_SLOT *Slot = &Bmp_ColorSlots[BMP_COLOR_HASH(Pixel)];
+            LastColor = (Slot->Bgr == Pixel) ? Slot->Color : 1;
+            Last = Pixel;
         }
+        Colors[i] = LastColor;
     }
-    fclose(fp);
-
-    // Detect portrait mode (height > width) and rotate 90° CW when drawing
-    int is_portrait = (bmpInfoHeader.biHeight > bmpInfoHeader.biWidth);
+}
 
-    if (is_portrait) {
-        ESP_LOGI(TAG, "Portrait image detected (%ldx%ld), rotating 90° CW for display",
-                 bmpInfoHeader.biWidth, bmpInfoHeader.biHeight);
-        // Rotate 90° CW: src(x, y) -> dst(src_h - 1 - y, x)
-        // After rotation: display width = biHeight, display height = biWidth
-        for(y = 0; y < bmpInfoHeader.biHeight; y++) {
-            for(x = 0; x < bmpInfoHeader.biWidth; x++) {
-                // Calculate rotated position
-                UWORD dst_x = bmpInfoHeader.biHeight - 1 - y;
-                UWORD dst_y = x;
-                if(Xstart + dst_x > Paint.Width || Ystart + dst_y > Paint.Height) {
-                    continue;
-                }
-                Paint_SetPixel(Xstart + dst_x, Ystart + dst_y,
-                    Image[bmpInfoHeader.biHeight * bmpInfoHeader.biWidth - 1 - (bmpInfoHeader.biWidth - x - 1 + (y * bmpInfoHeader.biWidth))]);
-            }
-        }
+/*
+Visible part of a Width x Height BMP drawn at (Xstart, Ystart): top-down
+source rows [Y0, Y1), Len pixels of each. 0 if nothing is on the picture.
+*/
+static UBYTE GUI_BmpPlace(int Width, int Height, UWORD Xstart, UWORD Ystart,
+                          int *Y0, int *Y1, int *Len, UBYTE *Portrait)
+{
+    if(Xstart >= Paint.Width || Ystart >= Paint.Height)
+        return 0;
+    *Portrait = Height > Width;
+    *Y0 = 0;
+    *Y1 = Height;
+    if(*Portrait) {
+        // Source row y becomes the column Xstart + Height - 1 - y
+        if(Xstart + Height > Paint.Width)
+            *Y0 = Xstart + Height - Paint.Width;
+        *Len = (Width < Paint.Height - Ystart) ? Width : Paint.Height - Ystart;
     } else {
-        // Landscape mode: draw normally
-        for(y = 0; y < bmpInfoHeader.biHeight; y++) {
-            for(x = 0; x < bmpInfoHeader.biWidth; x++) {
-                if(x > Paint.Width || y > Paint.Height) {
-                    break;
-                }
-                Paint_SetPixel(Xstart + x, Ystart + y,
-                    Image[bmpInfoHeader.biHeight * bmpInfoHeader.biWidth - 1 - (bmpInfoHeader.biWidth - x - 1 + (y * bmpInfoHeader.biWidth))]);
-            }
-        }
+        if(Ystart + Height > Paint.Height)
+            *Y1 = Paint.Height - Ystart;
+        *Len = (Width < Paint.Width - Xstart) ? Width : Paint.Width - Xstart;
     }
-    heap_caps_free(Image);
-    Image = NULL;
-    return 0;
-#endif
+    return 1;
+}
+
+static void GUI_BmpDrawRow(const UBYTE *Bgr, int Height, int Y, int Len, UBYTE Portrait, UWORD Xstart, UWORD Ystart)
+{
+    GUI_BmpClassifyRow(Bgr, Bmp_Colors, Len);
+    if(Portrait)
+        Paint_DrawSpan(Xstart + Height - 1 - Y, Ystart, Bmp_Colors, Len, SPAN_VERTICAL);
+    else
+        Paint_DrawSpan(Xstart, Ystart + Y, Bmp_Colors, Len, SPAN_HORIZONTAL);
 }
-#else
 
+/*
+Draw a 24-bit 6-color BMP with its top-left corner at (Xstart, Ystart).
+Portrait images (height > width) are rotated 90 degrees CW. Only the rows
+and pixels that land on the picture are read and classified. Returns 0 on
+success, 1 if the file could not be opened, parsed or read to the end.
+*/
 UBYTE GUI_ReadBmp_RGB_6Color(const char *path, UWORD Xstart, UWORD Ystart)
 {
+    int64_t StartTime = esp_timer_get_time();
     FILE *fp;
     BMPFILEHEADER bmpFileHeader;
     BMPINFOHEADER bmpInfoHeader;
 
-    fp = fopen(path, "rb");
-    if (!fp) {
+    if((fp = fopen(path, "rb")) == NULL) {
         ESP_LOGE(TAG, "Can't open file: %s", path);
-        return 0;
+        return 1;
     }
+    // Chunks are read straight into Bmp_Chunk, stdio buffering would only add a copy
+    setvbuf(fp, NULL, _IONBF, 0);
 
-    // 读取头
-    if (fread(&bmpFileHeader, sizeof(BMPFILEHEADER), 1, fp) != 1 ||
-        fread(&bmpInfoHeader, sizeof(BMPINFOHEADER), 1, fp) != 1) {
+    if(fread(&bmpFileHeader, sizeof(BMPFILEHEADER), 1, fp) != 1 ||
+       fread(&bmpInfoHeader, sizeof(BMPINFOHEADER), 1, fp) != 1) {
         ESP_LOGE(TAG, "Failed to read BMP header");
         fclose(fp);
-        return 0;
+        return 1;
     }
-    printf("pixel = %ld * %ld\r\n", bmpInfoHeader.biWidth, bmpInfoHeader.biHeight);
-
-    if (bmpInfoHeader.biBitCount != 24) {
-        ESP_LOGE(TAG, "Bmp image is not 24-bit!");
+    if(bmpInfoHeader.biBitCount != 24 || bmpInfoHeader.biCompression != 0) {
+        ESP_LOGE(TAG, "Bmp image is not an uncompressed 24-bit bitmap!");
         fclose(fp);
-        return 0;
+        return 1;
     }
 
-    UWORD width = (UWORD)bmpInfoHeader.biWidth;
-    UWORD height = (UWORD)bmpInfoHeader.biHeight;
-    int rowSize = ((width * 3 + 3) & ~3); // 每行4字节对齐
-
-    // 行缓冲与颜色索引缓冲（每像素1字节）
-    UBYTE *rowBuf = (UBYTE *)heap_caps_malloc(rowSize, MALLOC_CAP_SPIRAM);
-    UBYTE *Image = (UBYTE *)heap_caps_malloc(width * height, MALLOC_CAP_SPIRAM);
+    // A negative height marks a top-down bitmap
+    int Width = (int32_t)bmpInfoHeader.biWidth;
+    int Height = (int32_t)bmpInfoHeader.biHeight;
+    UBYTE BottomUp = Height > 0;
+    if(Height < 0)
+        Height = -Height;
+    UDOUBLE RowSize = ((UDOUBLE)Width * 3 + 3) & ~3u;
+    if(Width <= 0 || Height == 0 || RowSize > BMP_READ_CHUNK) {
+        ESP_LOGE(TAG, "Unsupported BMP size %d x %d", Width, Height);
+        fclose(fp);
+        return 1;
+    }
 
-    if (!rowBuf || !Image) {
-        ESP_LOGE(TAG, "Memory allocation failed!");
-        if (rowBuf) heap_caps_free(rowBuf);
-        if (Image) heap_caps_free(Image);
+    int Y0, Y1, Len;
+    UBYTE Portrait;
+    if(!GUI_BmpPlace(Width, Height, Xstart, Ystart, &Y0, &Y1, &Len, &Portrait)) {
+        ESP_LOGE(TAG, "%s at (%d, %d) is outside the picture", path, Xstart, Ystart);
         fclose(fp);
-        return 0;
+        return 1;
+    }
+    if(!GUI_BmpReaderInit(Len)) {
+        fclose(fp);
+        return 1;
     }
 
-    // 移动到像素数据区
-    if (fseek(fp, bmpFileHeader.bOffset, SEEK_SET) != 0) {
+    // The same rows in file order
+    int R0 = BottomUp ? Height - Y1 : Y0;
+    int R1 = BottomUp ? Height - Y0 : Y1;
+    if(fseek(fp, bmpFileHeader.bOffset + (long)R0 * RowSize, SEEK_SET) != 0) {
         ESP_LOGE(TAG, "fseek failed");
-        heap_caps_free(rowBuf);
-        heap_caps_free(Image);
         fclose(fp);
-        return 0;
+        return 1;
     }
 
-    // 逐行读取（BMP 底行优先）
-    for (UWORD y = 0; y < height; y++) {
-        size_t got = fread(rowBuf, 1, rowSize, fp);
-        if (got != rowSize) {
-            // 如果是最后一行因文件短缺导致读取不足，也可以选择 break 或继续处理已读字节
-            ESP_LOGE(TAG, "BMP read error at line %u (got %zu, want %u)", (unsigned)y, got, (unsigned)rowSize);
-            break;
+    int RowsPerChunk = BMP_READ_CHUNK / RowSize;
+    int64_t ReadUs = 0, DrawUs = 0;
+    UDOUBLE ReadBytes = 0;
+    UBYTE Truncated = 0;
+    for(int R = R0; R < R1; ) {
+        int Rows = (R1 - R < RowsPerChunk) ? R1 - R : RowsPerChunk;
+        int64_t T0 = esp_timer_get_time();
+        size_t Got = fread(Bmp_Chunk, 1, Rows * RowSize, fp);
+        int64_t T1 = esp_timer_get_time();
+        ReadUs += T1 - T0;
+        ReadBytes += Got;
+        if(Got != Rows * RowSize) {
+            ESP_LOGE(TAG, "BMP read error at row %d (got %u, want %u)", R, (unsigned)Got, (unsigned)(Rows * RowSize));
+            Rows = Got / RowSize;
+            R1 = R + Rows;
+            Truncated = 1;
         }
 
-        UBYTE *p = rowBuf;
-        for (UWORD x = 0; x < width; x++) {
-            /* 
-             * 重要：保持和你原始代码等效的字节序与比较方式
-             * 原代码读三次 fread 到 Rdata[0],Rdata[1],Rdata[2]
-             * 这里 p[0] 对应原来的 Rdata[0]，p[1] -> Rdata[1]，p[2] -> Rdata[2]
-             */
-            UBYTE d0 = *p++; // 原 Rdata[0]
-            UBYTE d1 = *p++; // 原 Rdata[1]
-            UBYTE d2 = *p++; // 原 Rdata[2]
-
-            UBYTE color;
-            if (d0 == 0 && d1 == 0 && d2 == 0) {
-                color = 0; // Black
-            } else if (d0 == 255 && d1 == 255 && d2 == 255) {
-                color = 1; // White
-            } else if (d0 == 0 && d1 == 255 && d2 == 255) {
-                color = 2; // Yellow  (按你原始判断)
-            } else if (d0 == 0 && d1 == 0 && d2 == 255) {
-                color = 3; // Red
-            // } else if (d0 == 0 && d1 == 128 && d2 == 255) {
-            //     color = 4; // Orange (保留注释)
-            } else if (d0 == 255 && d1 == 0 && d2 == 0) {
-                color = 5; // Blue
-            } else if (d0 == 0 && d1 == 255 && d2 == 0) {
-                color = 6; // Green
-            } else {
-                color = 1; // 默认白
-            }
-
-            // 存储时保持原来“反转”的索引逻辑：BMP 从底到顶，所以把读取的第 y 行放到 Image 的 (height-1-y)
-            Image[(int)(height - 1 - y) * width + x] = color;
+        for(int i = 0; i < Rows; i++, R++) {
+            int Y = BottomUp ? Height - 1 - R : R;
+            GUI_BmpDrawRow(Bmp_Chunk + i * RowSize, Height, Y, Len, Portrait, Xstart, Ystart);
         }
+        DrawUs += esp_timer_get_time() - T1;
     }
-
     fclose(fp);
 
-    // 刷新显示（保留你原来的绘制边界限制）
-    for (UWORD y = 0; y < height; y++) {
-        if (Ystart + y >= Paint.Height) break;
-        for (UWORD x = 0; x < width; x++) {
-            if (Xstart + x >= Paint.Width) break;
-            Paint_SetPixel(Xstart + x, Ystart + y, Image[(int)y * width + x]);
-        }
-    }
-
-    heap_caps_free(rowBuf);
-    heap_caps_free(Image);
-    return 0;
+    int64_t TotalUs = esp_timer_get_time() - StartTime;
+    ESP_LOGI(TAG, "[TIMING] BMP %dx%d%s: read %lld ms (%.2f MB/s), classify + draw %lld ms, total %lld ms",
+             Width, Height, Portrait ? " (portrait)" : "", ReadUs / 1000,
+             ReadUs > 0 ? (float)ReadBytes / ReadUs : 0.0f, DrawUs / 1000, TotalUs / 1000);
+    return Truncated;
 }
 
+/*
+Draw one pixel row of a 24-bit 6-color BMP held in memory (e.g. arriving
+over the network), placed exactly as GUI_ReadBmp_RGB_6Color would. Y is
+the top-down row, so rows may come in file order, bottom-up or not.
+*/
+UBYTE GUI_DrawBmpRow_6Color(const UBYTE *Bgr, int Width, int Height, int Y, UWORD Xstart, UWORD Ystart)
+{
+    int Y0, Y1, Len;
+    UBYTE Portrait;
+    if(Width <= 0 || Y < 0 || Y >= Height || !GUI_BmpPlace(Width, Height, Xstart, Ystart, &Y0, &Y1, &Len, &Portrait))
+        return 0;
+    if(Y < Y0 || Y >= Y1 || !GUI_BmpReaderInit(Len))
+        return 0;
+    GUI_BmpDrawRow(Bgr, Height, Y, Len, Portrait, Xstart, Ystart);
+    return 1;
+}
 
-#endif
+/*
+EPF frames are stored in the framebuffer layout and are read straight into
+Paint.Image; anything else goes through GUI_ReadBmp_RGB_6Color. An EPF that
+fails to load is replaced by decoding the .bmp of the same name, which also
+rebuilds the EPF. Returns 0 on success, 1 if nothing valid was drawn.
+*/
+UBYTE GUI_ReadImage_6Color(const char *path, UWORD Xstart, UWORD Ystart)
+{
+    if (!epf_is_epf_path(path)) {
+        return GUI_ReadBmp_RGB_6Color(path, Xstart, Ystart);
+    }
+    if (Xstart != 0 || Ystart != 0 || Paint.Scale != 6) {
+        ESP_LOGE(TAG, "%s: EPF frames only load full-screen into a 6-color image", path);
+        return 1;
+    }
+    uint8_t layout = EPF_LAYOUT(Paint.Rotate, Paint.Mirror);
+    esp_err_t err  = epf_read(path, Paint.Image, Paint.WidthMemory, Paint.HeightMemory, layout);
+    if (err == ESP_OK) {
+        return 0;
+    }
+    // Paint.Image may hold part of the frame now, never show it
+    char bmp_path[256];
+    const char *dot = strrchr(path, '.');
+    int base = dot ? (int)(dot - path) : (int)strlen(path);
+    if (snprintf(bmp_path, sizeof(bmp_path), "%.*s.bmp", base, path) >= (int)sizeof(bmp_path) ||
+        access(bmp_path, F_OK) != 0) {
+        ESP_LOGE(TAG, "%s: %s and no BMP to fall back to", path, esp_err_to_name(err));
+        return 1;
+    }
+    ESP_LOGW(TAG, "%s: %s, decoding %s instead", path, esp_err_to_name(err), bmp_path);
+    Paint_Clear(EPD_7IN3E_WHITE);
+    if (GUI_ReadBmp_RGB_6Color(bmp_path, 0, 0) != 0) {
+        ESP_LOGE(TAG, "%s: fallback %s failed too, keeping the EPF", path, bmp_path);
+        return 1;
+    }
+    if (epf_write(path, Paint.Image, Paint.WidthMemory, Paint.HeightMemory, layout, EPF_COMPRESSION_RLE) != ESP_OK) {
+        ESP_LOGW(TAG, "%s: could not be rebuilt", path);
+    }
+    return 0;
+}
 
 
 uint8_t GUI_RGB888_6Color(uint8_t *buffer,int Height,int Width)
@@ -739,10 +760,17 @@ UBYTE GUI_DirectDisplay_RGB888_6Color(const uint8_t *rgb888_buffer,
         ESP_LOGI(TAG, "Portrait image detected, rotating 90 degrees CW for display");
     }
 
+    // One row of palette indices, drawn as a span (a column when rotated)
+    UBYTE *row = (UBYTE *)heap_caps_malloc(width, MALLOC_CAP_8BIT);
+    if (row == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate row buffer");
+        return 1;
+    }
+
     for (UWORD y = 0; y < height; y++) {
-        for (UWORD x = 0; x < width; x++) {
+        const uint8_t *pixel = rgb888_buffer + (UDOUBLE)y * width * 3;
+        for (UWORD x = 0; x < width; x++, pixel += 3) {
             // Get RGB values from dithered buffer (RGB888 format)
-            const uint8_t *pixel = rgb888_buffer + ((UDOUBLE)y * width + x) * 3;
             uint8_t r = pixel[0];
             uint8_t g = pixel[1];
             uint8_t b = pixel[2];
@@ -765,22 +793,18 @@ UBYTE GUI_DirectDisplay_RGB888_6Color(const uint8_t *rgb888_buffer,
             } else {
                 color = 1; // Default to white for unexpected colors
             }
+            row[x] = color;
+        }
 
-            if (is_portrait) {
-                // Rotate 90° CW: src(x, y) -> dst(src_h - 1 - y, x)
-                UWORD dst_x = height - 1 - y;
-                UWORD dst_y = x;
-                if (Xstart + dst_x < Paint.Width && Ystart + dst_y < Paint.Height) {
-                    Paint_SetPixel(Xstart + dst_x, Ystart + dst_y, color);
-                }
-            } else {
-                // Landscape mode: draw normally
-                if (Xstart + x < Paint.Width && Ystart + y < Paint.Height) {
-                    Paint_SetPixel(Xstart + x, Ystart + y, color);
-                }
-            }
+        if (is_portrait) {
+            // Rotate 90° CW: src(x, y) -> dst(src_h - 1 - y, x)
+            Paint_DrawSpan(Xstart + height - 1 - y, Ystart, row, width, SPAN_VERTICAL);
+        } else {
+            // Landscape mode: draw normally
+            Paint_DrawSpan(Xstart, Ystart + y, row, width, SPAN_HORIZONTAL);
         }
     }
+    heap_caps_free(row);
 
     ESP_LOGI(TAG, "Direct display completed");
     return 0;
@@ -96,8 +96,12 @@ UBYTE GUI_ReadBmp_4Gray(const char *path, UWORD Xstart, UWORD Ystart);
 UBYTE GUI_ReadBmp_16Gray(const char *path, UWORD Xstart, UWORD Ystart);
 UBYTE GUI_ReadBmp_RGB_4Color(const char *path, UWORD Xstart, UWORD Ystart);
 UBYTE GUI_ReadBmp_RGB_6Color(const char *path, UWORD Xstart, UWORD Ystart);
+UBYTE GUI_DrawBmpRow_6Color(const UBYTE *Bgr, int Width, int Height, int Y, UWORD Xstart, UWORD Ystart);
 UBYTE GUI_ReadBmp_RGB_7Color(const char *path, UWORD Xstart, UWORD Ystart);
 
+// .epf frame (full screen only) or 24-bit 6-color BMP, picked by extension; 0 on success, 1 if nothing valid was drawn
+UBYTE GUI_ReadImage_6Color(const char *path, UWORD Xstart, UWORD Ystart);
+
 // Direct display from RGB888 buffer (skip SD card I/O)
 UBYTE GUI_DirectDisplay_RGB888_6Color(const uint8_t *rgb888_buffer,
                                        UWORD width, UWORD height,
@@ -83,6 +83,7 @@
 #include <string.h> //memset()
 #include <math.h>
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 
 static const char *TAG = "GUI_Paint";
 
@@ -183,62 +184,65 @@ void Paint_SetScale(UBYTE scale)
     }
 }
 /******************************************************************************
-function: Draw Pixels
+function: Map a point of the picture to its position in the image cache
 parameter:
-    Xpoint : At point X
-    Ypoint : At point Y
-    Color  : Painted colors
+    Xpoint : At point X, not range checked
+    Ypoint : At point Y, not range checked
+    X      : Receives the memory X
+    Y      : Receives the memory Y
+return: 0 if Rotate or Mirror is invalid
 ******************************************************************************/
-void Paint_SetPixel(UWORD Xpoint, UWORD Ypoint, UWORD Color)
+static UBYTE Paint_MapPoint(int Xpoint, int Ypoint, int *X, int *Y)
 {
-    if(Xpoint > Paint.Width || Ypoint > Paint.Height){
-        ESP_LOGI(TAG,"Exceeding display boundaries");
-        return;
-    }      
-    UWORD X, Y;
     switch(Paint.Rotate) {
     case 0:
-        X = Xpoint;
-        Y = Ypoint;  
+        *X = Xpoint;
+        *Y = Ypoint;
         break;
     case 90:
-        X = Paint.WidthMemory - Ypoint - 1;
-        Y = Xpoint;
+        *X = Paint.WidthMemory - Ypoint - 1;
+        *Y = Xpoint;
         break;
     case 180:
-        X = Paint.WidthMemory - Xpoint - 1;
-        Y = Paint.HeightMemory - Ypoint - 1;
+        *X = Paint.WidthMemory - Xpoint - 1;
+        *Y = Paint.HeightMemory - Ypoint - 1;
         break;
     case 270:
-        X = Ypoint;
-        Y = Paint.HeightMemory - Xpoint - 1;
+        *X = Ypoint;
+        *Y = Paint.HeightMemory - Xpoint - 1;
         break;
     default:
-        return;
+        return 0;
     }
-    
+
     switch(Paint.Mirror) {
     case MIRROR_NONE:
         break;
     case MIRROR_HORIZONTAL:
-        X = Paint.WidthMemory - X - 1;
+        *X = Paint.WidthMemory - *X - 1;
         break;
     case MIRROR_VERTICAL:
-        Y = Paint.HeightMemory - Y - 1;
+        *Y = Paint.HeightMemory - *Y - 1;
         break;
     case MIRROR_ORIGIN:
-        X = Paint.WidthMemory - X - 1;
-        Y = Paint.HeightMemory - Y - 1;
+        *X = Paint.WidthMemory - *X - 1;
+        *Y = Paint.HeightMemory - *Y - 1;
         break;
     default:
-        return;
+        return 0;
     }
+    return 1;
+}
 
-    if(X > Paint.WidthMemory || Y > Paint.HeightMemory){
-        ESP_LOGI(TAG,"Exceeding display boundaries");
-        return;
-    }
-    
+/******************************************************************************
+function: Write one pixel of the image cache, no rotation or range check
+parameter:
+    X     : Memory X
+    Y     : Memory Y
+    Color : Painted colors
+******************************************************************************/
+static inline void Paint_PutPixel(UWORD X, UWORD Y, UWORD Color)
+{
     if(Paint.Scale == 2){
         UDOUBLE Addr = X / 8 + Y * Paint.WidthByte;
         UBYTE Rdata = Paint.Image[Addr];
@@ -257,39 +261,226 @@ void Paint_SetPixel(UWORD Xpoint, UWORD Ypoint, UWORD Color)
 		UBYTE Rdata = Paint.Image[Addr];
 		Rdata = Rdata & (~(0xF0 >> ((X % 2)*4)));//Clear first, then set value
 		Paint.Image[Addr] = Rdata | ((Color << 4) >> ((X % 2)*4));
-		// printf("Add =  %d ,data = %d\r\n",Addr,Rdata);
 	}
 }
 
+/******************************************************************************
+function: Draw Pixels
+parameter:
+    Xpoint : At point X
+    Ypoint : At point Y
+    Color  : Painted colors
+******************************************************************************/
+void Paint_SetPixel(UWORD Xpoint, UWORD Ypoint, UWORD Color)
+{
+    if(Xpoint >= Paint.Width || Ypoint >= Paint.Height){
+        ESP_LOGI(TAG,"Exceeding display boundaries");
+        return;
+    }
+    int X, Y;
+    if(!Paint_MapPoint(Xpoint, Ypoint, &X, &Y)) {
+        return;
+    }
+    Paint_PutPixel(X, Y, Color);
+}
+
+/******************************************************************************
+ * Span raster core
+ *
+ * Rotation and mirroring are resolved once per span: a rectangle of the
+ * picture is a rectangle of the image cache, and a row or column of the
+ * picture walks the cache in a fixed memory step. Memory rows are written
+ * whole bytes at a time, only the edge pixels need a read-modify-write.
+******************************************************************************/
+
+// Bits per pixel of the current scale, 0 if not set
+static UBYTE Paint_Bpp(void)
+{
+    if(Paint.Scale == 2)
+        return 1;
+    if(Paint.Scale == 4)
+        return 2;
+    if(Paint.Scale == 6 || Paint.Scale == 7 || Paint.Scale == 16)
+        return 4;
+    return 0;
+}
+
+// A whole byte of Color, the same bits Paint_PutPixel would write pixel by pixel
+static UBYTE Paint_FillByte(UWORD Color, UBYTE Bpp)
+{
+    if(Bpp == 1)
+        return (Color == BLACK)? 0x00 : 0xFF;
+    if(Bpp == 2)
+        return (Color % 4) * 0x55;
+    return (Color & 0x0F) * 0x11;
+}
+
+/******************************************************************************
+function: Fill a rectangle of the image cache
+parameter:
+    X0, Y0 : Memory start point, inclusive
+    X1, Y1 : Memory end point, inclusive, X0 <= X1 and Y0 <= Y1
+    Color  : Painted colors
+******************************************************************************/
+static void Paint_FillMemRect(UWORD X0, UWORD Y0, UWORD X1, UWORD Y1, UWORD Color)
+{
+    UBYTE Bpp = Paint_Bpp();
+    if(Bpp == 0)
+        return;
+    UBYTE PixelsPerByte = 8 / Bpp;
+    UBYTE Fill = Paint_FillByte(Color, Bpp);
+
+    // Pixels are MSB first: mask of X0..end of its byte, and of start of its byte..X1
+    UDOUBLE Byte0 = X0 / PixelsPerByte, Byte1 = X1 / PixelsPerByte;
+    UBYTE Mask0 = 0xFF >> ((X0 % PixelsPerByte) * Bpp);
+    UBYTE Mask1 = (UBYTE)(0xFF << ((PixelsPerByte - 1 - X1 % PixelsPerByte) * Bpp));
+    if(Byte0 == Byte1) {
+        Mask0 &= Mask1;
+    }
+
+    UBYTE *Row = Paint.Image + (UDOUBLE)Y0 * Paint.WidthByte;
+    for(UWORD Y = Y0; Y <= Y1; Y++, Row += Paint.WidthByte) {
+        Row[Byte0] = (Row[Byte0] & ~Mask0) | (Fill & Mask0);
+        if(Byte1 > Byte0) {
+            memset(Row + Byte0 + 1, Fill, Byte1 - Byte0 - 1);
+            Row[Byte1] = (Row[Byte1] & ~Mask1) | (Fill & Mask1);
+        }
+    }
+}
+
+/******************************************************************************
+function: Fill a rectangle of the picture, clipped to it
+parameter:
+    Xstart, Ystart : Start point, inclusive, may be negative
+    Xend, Yend     : End point, inclusive
+    Color          : Painted colors
+******************************************************************************/
+static void Paint_FillRect(int Xstart, int Ystart, int Xend, int Yend, UWORD Color)
+{
+    if(Xstart < 0)
+        Xstart = 0;
+    if(Ystart < 0)
+        Ystart = 0;
+    if(Xend > Paint.Width - 1)
+        Xend = Paint.Width - 1;
+    if(Yend > Paint.Height - 1)
+        Yend = Paint.Height - 1;
+    if(Xstart > Xend || Ystart > Yend)
+        return;
+
+    int X0, Y0, X1, Y1;
+    if(!Paint_MapPoint(Xstart, Ystart, &X0, &Y0) || !Paint_MapPoint(Xend, Yend, &X1, &Y1))
+        return;
+    Paint_FillMemRect((X0 < X1)? X0 : X1, (Y0 < Y1)? Y0 : Y1,
+                      (X0 < X1)? X1 : X0, (Y0 < Y1)? Y1 : Y0, Color);
+}
+
+/******************************************************************************
+function: Fill the dots Paint_DrawPoint (DOT_FILL_AROUND) draws for every
+          point of a rectangle, as one rectangle
+parameter:
+    Xstart, Ystart : Start point, inclusive, any order
+    Xend, Yend     : End point, inclusive
+    Color          : Painted colors
+    Dot_Pixel      : Dot size
+******************************************************************************/
+static void Paint_FillDots(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend,
+                           UWORD Color, DOT_PIXEL Dot_Pixel)
+{
+    // A dot at (x, y) covers x - Dot_Pixel .. x + Dot_Pixel - 2, the same in y
+    int X0 = (Xstart < Xend)? Xstart : Xend;
+    int X1 = (Xstart < Xend)? Xend : Xstart;
+    int Y0 = (Ystart < Yend)? Ystart : Yend;
+    int Y1 = (Ystart < Yend)? Yend : Ystart;
+    int Dot = Dot_Pixel;
+    // Dots reaching past the top or left edge are clipped. Paint_DrawPoint does
+    // the same: its "< 0" check is unsigned (DOT_PIXEL is an unsigned enum), so
+    // it never skips, and Paint_SetPixel drops the pixels outside the picture
+    Paint_FillRect(X0 - Dot, Y0 - Dot, X1 + Dot - 2, Y1 + Dot - 2, Color);
+}
+
+/******************************************************************************
+function: Draw a row or column of colors
+parameter:
+    Xstart : x starting point
+    Ystart : Y starting point
+    Colors : One color per pixel
+    Len    : Number of pixels
+    Dir    : SPAN_HORIZONTAL runs along X, SPAN_VERTICAL along Y
+info:
+    Pixels outside the picture are skipped. Whole bytes are written where
+    the span lies along a memory row, which is the case for 4bpp rows at
+    rotate 0/180 and columns at rotate 90/270.
+******************************************************************************/
+void Paint_DrawSpan(UWORD Xstart, UWORD Ystart, const UBYTE *Colors, UWORD Len, SPAN_DIR Dir)
+{
+    // Clip to the picture
+    UWORD Limit = (Dir == SPAN_HORIZONTAL)? Paint.Width : Paint.Height;
+    UWORD Start = (Dir == SPAN_HORIZONTAL)? Xstart : Ystart;
+    if(Xstart >= Paint.Width || Ystart >= Paint.Height || Len == 0)
+        return;
+    if(Len > Limit - Start)
+        Len = Limit - Start;
+
+    // Memory position of the first pixel and the step to the next one
+    int X, Y, Xnext, Ynext;
+    if(!Paint_MapPoint(Xstart, Ystart, &X, &Y))
+        return;
+    if(Dir == SPAN_HORIZONTAL)
+        Paint_MapPoint(Xstart + 1, Ystart, &Xnext, &Ynext);
+    else
+        Paint_MapPoint(Xstart, Ystart + 1, &Xnext, &Ynext);
+    int XStep = Xnext - X, YStep = Ynext - Y;
+
+    if(Paint_Bpp() != 4 || XStep == 0) {
+        // Memory column, or a 1/2bpp scale: one pixel at a time, no per-pixel transform
+        for(UWORD i = 0; i < Len; i++, X += XStep, Y += YStep) {
+            Paint_PutPixel(X, Y, Colors[i]);
+        }
+        return;
+    }
+
+    // Memory row: walk it left to right, reading Colors backwards when mirrored
+    UBYTE *Row = Paint.Image + (UDOUBLE)Y * Paint.WidthByte;
+    int Cs = XStep;
+    const UBYTE *C = Colors;
+    if(XStep < 0) {
+        X -= Len - 1;
+        C += Len - 1;
+    }
+    UWORD i = 0;
+    if(X & 1) {
+        Row[X >> 1] = (Row[X >> 1] & 0xF0) | (*C & 0x0F);
+        C += Cs;
+        X++;
+        i++;
+    }
+    for(; i + 1 < Len; i += 2, X += 2, C += 2 * Cs) {
+        Row[X >> 1] = (C[0] << 4) | (C[Cs] & 0x0F);
+    }
+    if(i < Len) {
+        Row[X >> 1] = (Row[X >> 1] & 0x0F) | (*C << 4);
+    }
+}
+
 /******************************************************************************
 function: Clear the color of the picture
 parameter:
     Color : Painted colors
 ******************************************************************************/
 void Paint_Clear(UWORD Color)
-{	
+{
+    UBYTE Fill;
 	if(Paint.Scale == 2) {
-		for (UWORD Y = 0; Y < Paint.HeightByte; Y++) {
-			for (UWORD X = 0; X < Paint.WidthByte; X++ ) {//8 pixel =  1 byte
-				UDOUBLE Addr = X + Y*Paint.WidthByte;
-				Paint.Image[Addr] = Color;
-			}
-		}		
+		Fill = Color;//8 pixel =  1 byte
     }else if(Paint.Scale == 4) {
-        for (UWORD Y = 0; Y < Paint.HeightByte; Y++) {
-			for (UWORD X = 0; X < Paint.WidthByte; X++ ) {
-				UDOUBLE Addr = X + Y*Paint.WidthByte;
-				Paint.Image[Addr] = (Color<<6)|(Color<<4)|(Color<<2)|Color;
-			}
-		}		
+		Fill = (Color<<6)|(Color<<4)|(Color<<2)|Color;
 	}else if(Paint.Scale == 6 || Paint.Scale == 7 || Paint.Scale == 16) {
-		for (UWORD Y = 0; Y < Paint.HeightByte; Y++) {
-			for (UWORD X = 0; X < Paint.WidthByte; X++ ) {
-				UDOUBLE Addr = X + Y*Paint.WidthByte;
-				Paint.Image[Addr] = (Color<<4)|Color;
-			}
-		}		
-	}
+		Fill = (Color<<4)|Color;
+	}else {
+        return;
+    }
+    memset(Paint.Image, Fill, (UDOUBLE)Paint.WidthByte * Paint.HeightByte);
 }
 
 /******************************************************************************
@@ -303,12 +494,9 @@ parameter:
 ******************************************************************************/
 void Paint_ClearWindows(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend, UWORD Color)
 {
-    UWORD X, Y;
-    for (Y = Ystart; Y < Yend; Y++) {
-        for (X = Xstart; X < Xend; X++) {//8 pixel =  1 byte
-            Paint_SetPixel(X, Y, Color);
-        }
-    }
+    if (Xstart >= Xend || Ystart >= Yend)
+        return;
+    Paint_FillRect(Xstart, Ystart, Xend - 1, Yend - 1, Color);
 }
 
 /******************************************************************************
@@ -367,6 +555,12 @@ void Paint_DrawLine(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend,
         return;
     }
 
+    // Solid horizontal or vertical line: its dots make up one rectangle
+    if (Line_Style == LINE_STYLE_SOLID && (Xstart == Xend || Ystart == Yend)) {
+        Paint_FillDots(Xstart, Ystart, Xend, Yend, Color, Line_width);
+        return;
+    }
+
     UWORD Xpoint = Xstart;
     UWORD Ypoint = Ystart;
     int dx = (int)Xend - (int)Xstart >= 0 ? Xend - Xstart : Xstart - Xend;
@@ -425,9 +619,9 @@ void Paint_DrawRectangle(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend,
     }
 
     if (Draw_Fill) {
-        UWORD Ypoint;
-        for(Ypoint = Ystart; Ypoint < Yend; Ypoint++) {
-            Paint_DrawLine(Xstart, Ypoint, Xend, Ypoint, Color , Line_width, LINE_STYLE_SOLID);
+        // The solid lines of rows Ystart..Yend-1, filled at once
+        if (Ystart < Yend) {
+            Paint_FillDots(Xstart, Ystart, Xend, Yend - 1, Color, Line_width);
         }
     } else {
         Paint_DrawLine(Xstart, Ystart, Xend, Ystart, Color, Line_width, LINE_STYLE_SOLID);
@@ -600,6 +794,238 @@ void Paint_DrawString_EN(UWORD Xstart, UWORD Ystart, const char * pString,
 }
 
 
+/******************************************************************************
+ * Chinese (UTF-8) strings
+ *
+ * Glyphs are found by binary search in the codepoint index generated at
+ * build time (scripts/gen_font_index.py). In the 4bpp scales a glyph is
+ * rendered once into packed memory rows for the current rotation and kept
+ * in a small LRU cache; drawing it again is a masked byte copy.
+******************************************************************************/
+#ifndef PAINT_GLYPH_CACHE_SIZE
+#define PAINT_GLYPH_CACHE_SIZE  32
+#endif
+
+typedef struct {
+    const CH_CN *Glyph;             // NULL = free entry
+    UWORD Width, Height;            // Font cell
+    UWORD Foreground, Background;
+    UBYTE Transparent;              // Background pixels are left untouched
+    UWORD Rotate;
+    UBYTE Mirror;
+    UBYTE Odd;                      // Left memory column of the cell is odd
+    UWORD Columns, Rows;            // Memory size of the cell
+    UWORD RowBytes;                 // Bytes per memory row, pad nibbles included
+    UDOUBLE Capacity;               // Bytes allocated for Data
+    UDOUBLE Used;                   // LRU stamp
+    UBYTE *Data;                    // Rows * RowBytes color bytes, then as many mask bytes
+} PAINT_GLYPH;
+
+static PAINT_GLYPH Paint_GlyphCache[PAINT_GLYPH_CACHE_SIZE];
+static UDOUBLE Paint_GlyphClock;
+
+/******************************************************************************
+function: Decode the next UTF-8 character
+parameter:
+    pText : String position, advanced past the character
+return: Unicode codepoint, 0xFFFD for a malformed byte (skipped alone)
+******************************************************************************/
+static UDOUBLE Paint_NextUTF8(const char **pText)
+{
+    static const UDOUBLE Min[5] = {0, 0, 0x80, 0x800, 0x10000};
+    const UBYTE *p = (const UBYTE *)*pText;
+    UDOUBLE Codepoint;
+    UBYTE Len;
+
+    if (p[0] < 0x80) {
+        *pText += 1;
+        return p[0];
+    } else if ((p[0] & 0xE0) == 0xC0) {
+        Codepoint = p[0] & 0x1F;
+        Len = 2;
+    } else if ((p[0] & 0xF0) == 0xE0) {
+        Codepoint = p[0] & 0x0F;
+        Len = 3;
+    } else if ((p[0] & 0xF8) == 0xF0) {
+        Codepoint = p[0] & 0x07;
+        Len = 4;
+    } else {
+        *pText += 1;
+        return 0xFFFD;
+    }
+
+    // A missing continuation byte (the terminating 0 included) ends the sequence early
+    for (UBYTE i = 1; i < Len; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *pText += 1;
+            return 0xFFFD;
+        }
+        Codepoint = (Codepoint << 6) | (p[i] & 0x3F);
+    }
+    *pText += Len;
+    if (Codepoint < Min[Len] || Codepoint > 0x10FFFF || (Codepoint >= 0xD800 && Codepoint <= 0xDFFF)) {
+        return 0xFFFD;
+    }
+    return Codepoint;
+}
+
+/******************************************************************************
+function: Find the glyph of a codepoint
+parameter:
+    font      : Font
+    Index     : Its generated index, NULL to scan the table
+    Codepoint : Unicode codepoint
+return: Table entry, NULL if the font has none
+******************************************************************************/
+static const CH_CN *Paint_FindGlyph(const cFONT *font, const cFONT_INDEX *Index, UDOUBLE Codepoint)
+{
+    if (Index != NULL) {
+        int Low = 0, High = Index->size - 1;
+        while (Low <= High) {
+            int Mid = (Low + High) / 2;
+            if (Index->codepoint[Mid] < Codepoint) {
+                Low = Mid + 1;
+            } else if (Index->codepoint[Mid] > Codepoint) {
+                High = Mid - 1;
+            } else {
+                return &font->table[Index->slot[Mid]];
+            }
+        }
+        return NULL;
+    }
+
+    for (UWORD Num = 0; Num < font->size; Num++) {
+        const char *p = font->table[Num].index;
+        if (Paint_NextUTF8(&p) == Codepoint) {
+            return &font->table[Num];
+        }
+    }
+    return NULL;
+}
+
+/******************************************************************************
+function: Draw a glyph bitmap pixel by pixel
+parameter:
+    Xpoint, Ypoint   : Top left corner of the cell
+    ptr              : Glyph bitmap, font->Width bits per row padded to bytes
+    font             : Font
+    Color_Foreground : Color of the set bits
+    Color_Background : Color of the clear bits, FONT_BACKGROUND leaves them
+******************************************************************************/
+static void Paint_DrawGlyphBits(UWORD Xpoint, UWORD Ypoint, const char *ptr, const cFONT *font,
+                                UWORD Color_Foreground, UWORD Color_Background)
+{
+    UWORD i, j;
+    for (j = 0; j < font->Height; j++) {
+        for (i = 0; i < font->Width; i++) {
+            if (*ptr & (0x80 >> (i % 8))) {
+                Paint_SetPixel(Xpoint + i, Ypoint + j, Color_Foreground);
+            } else if (FONT_BACKGROUND != Color_Background) {
+                Paint_SetPixel(Xpoint + i, Ypoint + j, Color_Background);
+            }
+            if (i % 8 == 7) {
+                ptr++;
+            }
+        }
+        if (font->Width % 8 != 0) {
+            ptr++;
+        }
+    }
+}
+
+/******************************************************************************
+function: Get a glyph pre-rendered for the current rotation, rendering it on a miss
+parameter:
+    Glyph            : Table entry
+    font             : Font
+    Xpoint, Ypoint   : Top left corner of the cell, inside the picture
+    Color_Foreground : Color of the set bits
+    Color_Background : Color of the clear bits, FONT_BACKGROUND leaves them
+    X0, Y0           : Receive the top left memory corner of the cell
+return: Cache entry, NULL if it could not be allocated
+******************************************************************************/
+static PAINT_GLYPH *Paint_GetGlyph(const CH_CN *Glyph, const cFONT *font, UWORD Xpoint, UWORD Ypoint,
+                                   UWORD Color_Foreground, UWORD Color_Background, int *X0, int *Y0)
+{
+    int Xa, Ya, Xb, Yb;
+    Paint_MapPoint(Xpoint, Ypoint, &Xa, &Ya);
+    Paint_MapPoint(Xpoint + font->Width - 1, Ypoint + font->Height - 1, &Xb, &Yb);
+    *X0 = (Xa < Xb)? Xa : Xb;
+    *Y0 = (Ya < Yb)? Ya : Yb;
+    UBYTE Odd = *X0 & 1;
+    UBYTE Transparent = (FONT_BACKGROUND == Color_Background);
+
+    // Hit, or the free / least recently used entry
+    PAINT_GLYPH *Entry = &Paint_GlyphCache[0];
+    for (UWORD n = 0; n < PAINT_GLYPH_CACHE_SIZE; n++) {
+        PAINT_GLYPH *g = &Paint_GlyphCache[n];
+        if (g->Glyph == Glyph && g->Width == font->Width && g->Height == font->Height &&
+            g->Foreground == Color_Foreground && g->Transparent == Transparent &&
+            (Transparent || g->Background == Color_Background) &&
+            g->Rotate == Paint.Rotate && g->Mirror == Paint.Mirror && g->Odd == Odd) {
+            g->Used = ++Paint_GlyphClock;
+            return g;
+        }
+        if (Entry->Glyph != NULL && (g->Glyph == NULL || g->Used < Entry->Used)) {
+            Entry = g;
+        }
+    }
+
+    UWORD Columns = ((Xa < Xb)? Xb - Xa : Xa - Xb) + 1;
+    UWORD Rows = ((Ya < Yb)? Yb - Ya : Ya - Yb) + 1;
+    UWORD RowBytes = (Odd + Columns + 1) / 2;
+    UDOUBLE Size = (UDOUBLE)Rows * RowBytes;
+    if (Entry->Capacity < 2 * Size) {
+        heap_caps_free(Entry->Data);
+        Entry->Data = (UBYTE *)heap_caps_malloc(2 * Size, MALLOC_CAP_SPIRAM);
+        Entry->Capacity = (Entry->Data != NULL)? 2 * Size : 0;
+        if (Entry->Data == NULL) {
+            Entry->Glyph = NULL;
+            return NULL;
+        }
+    }
+
+    Entry->Glyph = Glyph;
+    Entry->Width = font->Width;
+    Entry->Height = font->Height;
+    Entry->Foreground = Color_Foreground;
+    Entry->Background = Color_Background;
+    Entry->Transparent = Transparent;
+    Entry->Rotate = Paint.Rotate;
+    Entry->Mirror = Paint.Mirror;
+    Entry->Odd = Odd;
+    Entry->Columns = Columns;
+    Entry->Rows = Rows;
+    Entry->RowBytes = RowBytes;
+    Entry->Used = ++Paint_GlyphClock;
+
+    // Same bits and transform as Paint_DrawGlyphBits, into a byte-aligned copy of the cell
+    UBYTE *Data = Entry->Data, *Mask = Entry->Data + Size;
+    memset(Data, 0, 2 * Size);
+    const char *ptr = Glyph->matrix;
+    for (UWORD j = 0; j < font->Height; j++) {
+        for (UWORD i = 0; i < font->Width; i++) {
+            UBYTE Set = (*ptr & (0x80 >> (i % 8))) != 0;
+            if (Set || !Transparent) {
+                int X, Y;
+                Paint_MapPoint(Xpoint + i, Ypoint + j, &X, &Y);
+                UWORD Col = X - *X0 + Odd;
+                UDOUBLE Addr = (UDOUBLE)(Y - *Y0) * RowBytes + Col / 2;
+                UBYTE Shift = (Col % 2)? 0 : 4;
+                Data[Addr] |= ((Set? Color_Foreground : Color_Background) & 0x0F) << Shift;
+                Mask[Addr] |= 0x0F << Shift;
+            }
+            if (i % 8 == 7) {
+                ptr++;
+            }
+        }
+        if (font->Width % 8 != 0) {
+            ptr++;
+        }
+    }
+    return Entry;
+}
+
 /******************************************************************************
 function: Display the string
 parameter:
@@ -616,81 +1042,37 @@ void Paint_DrawString_CN(UWORD Xstart, UWORD Ystart, const char * pString, cFONT
 {
     const char* p_text = pString;
     int x = Xstart, y = Ystart;
-    int i, j,Num;
+    const cFONT_INDEX *Index = Font_CN_GetIndex(font);
+    UBYTE Packed = (Paint.Scale == 6 || Paint.Scale == 7 || Paint.Scale == 16);
+
     /* Send the string character by character on EPD */
     while (*p_text != 0) {
-        if(*p_text <= 0xE0) {  //ASCII < 126
-            for(Num = 0; Num < font->size; Num++) {
-                if(*p_text== font->table[Num].index[0]) {
-                    const char* ptr = &font->table[Num].matrix[0];
-                    for (j = 0; j < font->Height; j++) {
-                        for (i = 0; i < font->Width; i++) {
-                            if (FONT_BACKGROUND == Color_Background) { //this process is to speed up the scan
-                                if (*ptr & (0x80 >> (i % 8))) {
-                                    Paint_SetPixel(x + i, y + j, Color_Foreground);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                }
-                            } else {
-                                if (*ptr & (0x80 >> (i % 8))) {
-                                    Paint_SetPixel(x + i, y + j, Color_Foreground);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                } else {
-                                    Paint_SetPixel(x + i, y + j, Color_Background);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Background, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                }
-                            }
-                            if (i % 8 == 7) {
-                                ptr++;
-                            }
-                        }
-                        if (font->Width % 8 != 0) {
-                            ptr++;
-                        }
-                    }
-                    break;
-                }
+        UDOUBLE Codepoint = Paint_NextUTF8(&p_text);
+        const CH_CN *Glyph = Paint_FindGlyph(font, Index, Codepoint);
+
+        if (Glyph != NULL) {
+            PAINT_GLYPH *Cached = NULL;
+            int X0, Y0;
+            // Cells partly outside the picture go pixel by pixel and get clipped
+            if (Packed && x + font->Width <= Paint.Width && y + font->Height <= Paint.Height) {
+                Cached = Paint_GetGlyph(Glyph, font, x, y, Color_Foreground, Color_Background, &X0, &Y0);
             }
-            /* Point on the next character */
-            p_text += 1;
-            /* Decrement the column position by 16 */
-            x += font->ASCII_Width;
-        } else {        //Chinese
-            for(Num = 0; Num < font->size; Num++) {
-                if((*p_text== font->table[Num].index[0]) && (*(p_text+1) == font->table[Num].index[1])  && (*(p_text+2) == font->table[Num].index[2])) {
-                    const char* ptr = &font->table[Num].matrix[0];
-
-                    for (j = 0; j < font->Height; j++) {
-                        for (i = 0; i < font->Width; i++) {
-                            if (FONT_BACKGROUND == Color_Background) { //this process is to speed up the scan
-                                if (*ptr & (0x80 >> (i % 8))) {
-                                    Paint_SetPixel(x + i, y + j, Color_Foreground);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                }
-                            } else {
-                                if (*ptr & (0x80 >> (i % 8))) {
-                                    Paint_SetPixel(x + i, y + j, Color_Foreground);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                } else {
-                                    Paint_SetPixel(x + i, y + j, Color_Background);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Background, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                }
-                            }
-                            if (i % 8 == 7) {
-                                ptr++;
-                            }
-                        }
-                        if (font->Width % 8 != 0) {
-                            ptr++;
-                        }
+            if (Cached != NULL) {
+                const UBYTE *Data = Cached->Data;
+                const UBYTE *Mask = Cached->Data + (UDOUBLE)Cached->Rows * Cached->RowBytes;
+                UBYTE *Row = Paint.Image + (UDOUBLE)Y0 * Paint.WidthByte + X0 / 2;
+                for (UWORD j = 0; j < Cached->Rows; j++, Row += Paint.WidthByte) {
+                    for (UWORD b = 0; b < Cached->RowBytes; b++) {
+                        Row[b] = (Row[b] & ~*Mask++) | *Data++;
                     }
-                    break;
                 }
+            } else {
+                Paint_DrawGlyphBits(x, y, Glyph->matrix, font, Color_Foreground, Color_Background);
             }
-            /* Point on the next character */
-            p_text += 3;
-            /* Decrement the column position by 16 */
-            x += font->Width;
         }
+
+        /* Point on the next character */
+        x += (Codepoint < 0x80)? font->ASCII_Width : font->Width;
     }
 }
 
@@ -835,13 +1217,5 @@ info:
 ******************************************************************************/
 void Paint_DrawBitMap(const unsigned char* image_buffer)
 {
-    UWORD x, y;
-    UDOUBLE Addr = 0;
-
-    for (y = 0; y < Paint.HeightByte; y++) {
-        for (x = 0; x < Paint.WidthByte; x++) {//8 pixel =  1 byte
-            Addr = x + y * Paint.WidthByte;
-            Paint.Image[Addr] = (unsigned char)image_buffer[Addr];
-        }
-    }
+    memcpy(Paint.Image, image_buffer, (UDOUBLE)Paint.WidthByte * Paint.HeightByte);
 }
@@ -167,6 +167,14 @@ typedef enum {
     DRAW_FILL_FULL,
 } DRAW_FILL;
 
+/**
+ * Direction of a span of colors
+**/
+typedef enum {
+    SPAN_HORIZONTAL = 0,    // Along X
+    SPAN_VERTICAL,          // Along Y
+} SPAN_DIR;
+
 /**
  * Custom structure of a time attribute
 **/
@@ -196,6 +204,7 @@ void Paint_SetScale(UBYTE scale);
 
 void Paint_Clear(UWORD Color);
 void Paint_ClearWindows(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend, UWORD Color);
+void Paint_DrawSpan(UWORD Xstart, UWORD Ystart, const UBYTE *Colors, UWORD Len, SPAN_DIR Dir);
 
 //Drawing
 void Paint_DrawPoint(UWORD Xpoint, UWORD Ypoint, UWORD Color, DOT_PIXEL Dot_Pixel, DOT_STYLE Dot_FillWay);
@@ -0,0 +1,172 @@
+/**
+ * @file base64_stream.c
+ * @brief Resumable, table-free base64 decoder
+ */
+
+#include "base64_stream.h"
+#include <string.h>
+
+// Sextet of a single base64 character, -1 for anything else.
+// Each range test yields an all-ones mask only inside its range, no branches or table.
+static inline int32_t b64_value(int32_t c) {
+    int32_t v = -1;
+    v += (((0x40 - c) & (c - 0x5b)) >> 8) & (c - 64);   // 'A'..'Z' -> 0..25
+    v += (((0x60 - c) & (c - 0x7b)) >> 8) & (c - 70);   // 'a'..'z' -> 26..51
+    v += (((0x2f - c) & (c - 0x3a)) >> 8) & (c + 5);    // '0'..'9' -> 52..61
+    v += (((0x2a - c) & (c - 0x2c)) >> 8) & 63;         // '+' -> 62
+    v += (((0x2e - c) & (c - 0x30)) >> 8) & 64;         // '/' -> 63
+    return v;
+}
+
+#define B64_ONES 0x01010101u
+#define B64_HIGH 0x80808080u
+
+// Bit 7 set in every lane of h (characters | 0x80) whose character is >= k
+#define B64_GE(h, k) (((h) - (k) * B64_ONES) & B64_HIGH)
+
+// Four characters at once (SWAR), first character in the low byte of w.
+// Returns their 24-bit value, or -1 if any of them is not base64.
+static inline int32_t b64_word(uint32_t w) {
+    if (w & B64_HIGH) {
+        return -1;
+    }
+    uint32_t h = w | B64_HIGH;
+    uint32_t ge43 = B64_GE(h, 43), ge44 = B64_GE(h, 44);
+    uint32_t ge47 = B64_GE(h, 47), ge48 = B64_GE(h, 48), ge58 = B64_GE(h, 58);
+    uint32_t ge65 = B64_GE(h, 65), ge91 = B64_GE(h, 91);
+    uint32_t ge97 = B64_GE(h, 97), ge123 = B64_GE(h, 123);
+
+    // '+', '/' and '0'..'9', 'A'..'Z', 'a'..'z'
+    uint32_t valid = (ge43 ^ ge44) | (ge47 ^ ge58) | (ge65 ^ ge91) | (ge97 ^ ge123);
+    if (valid != B64_HIGH) {
+        return -1;
+    }
+
+    // c + 19 lands '+' on 62; each threshold passed pulls the next range down to its base.
+    // No lane goes negative or past 255, so the word arithmetic never carries between lanes.
+    uint32_t sub = (ge47 >> 7) * 3 + (ge48 >> 7) * 12 + (ge65 >> 7) * 69 + (ge97 >> 7) * 6;
+    uint32_t s = w + 19 * B64_ONES - sub;
+
+    // Pack the four sextets: pairs into 12 bits, then the pairs into 24
+    uint32_t t = ((s & 0x003F003F) << 6) | ((s >> 8) & 0x003F003F);
+    return (int32_t)(((t & 0xFFF) << 12) | (t >> 16));
+}
+
+static inline uint32_t load_le32(const char *p) {
+    const uint8_t *b = (const uint8_t *)p;
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static inline void store_triple(uint8_t *out, int32_t v) {
+    out[0] = v >> 16;
+    out[1] = v >> 8;
+    out[2] = v;
+}
+
+void base64_stream_init(base64_stream_t *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+size_t base64_stream_decode(base64_stream_t *s, const char *in, size_t len,
+                            uint8_t *out, size_t out_cap, size_t *out_len) {
+    size_t i = 0;
+    size_t o = 0;
+
+    while (s->error == BASE64_STREAM_OK && out_cap - o >= 3) {
+#if BASE64_STREAM_FAST_PATH
+        if (s->quad == 0 && !s->padded) {
+            size_t start = i;
+            // 16 characters -> 12 bytes while the run is clean
+            while (len - i >= 16 && out_cap - o >= 12) {
+                int32_t v0 = b64_word(load_le32(in + i));
+                int32_t v1 = b64_word(load_le32(in + i + 4));
+                int32_t v2 = b64_word(load_le32(in + i + 8));
+                int32_t v3 = b64_word(load_le32(in + i + 12));
+                if ((v0 | v1 | v2 | v3) < 0) break;
+                store_triple(out + o, v0);
+                store_triple(out + o + 3, v1);
+                store_triple(out + o + 6, v2);
+                store_triple(out + o + 9, v3);
+                i += 16;
+                o += 12;
+            }
+            // 4 characters -> 3 bytes up to the first quad that needs the slow path
+            while (len - i >= 4 && out_cap - o >= 3) {
+                int32_t v = b64_word(load_le32(in + i));
+                if (v < 0) break;
+                store_triple(out + o, v);
+                i += 4;
+                o += 3;
+            }
+            s->chars += i - start;
+            s->fast_chars += i - start;
+            if (out_cap - o < 3) break;
+        }
+#endif
+        if (i >= len) break;
+
+        // One character at a time: whitespace, padding, a split quad or the end of the run
+        int32_t c = (uint8_t)in[i];
+        int32_t v = b64_value(c);
+        if (v >= 0) {
+            if (s->padded) {
+                s->error = BASE64_STREAM_ERR_PADDING;
+                break;
+            }
+            s->accum = (s->accum << 6) | v;
+            s->chars++;
+            if (++s->quad == 4) {
+                store_triple(out + o, s->accum);
+                o += 3;
+                s->quad = 0;
+                s->accum = 0;
+            }
+        } else if (c == '=') {
+            if (!s->padded) {
+                // "xx==" carries one byte, "xxx=" two
+                if (s->quad < 2) {
+                    s->error = BASE64_STREAM_ERR_PADDING;
+                    break;
+                }
+                if (s->quad == 2) {
+                    out[o++] = s->accum >> 4;
+                } else {
+                    out[o++] = s->accum >> 10;
+                    out[o++] = s->accum >> 2;
+                }
+                s->quad = 0;
+                s->accum = 0;
+                s->padded = true;
+            }
+            s->padding++;
+        } else if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            s->whitespace++;
+        } else {
+            break;  // Not ours, leave it to the caller
+        }
+        i++;
+    }
+
+    *out_len = o;
+    return i;
+}
+
+int base64_stream_finish(base64_stream_t *s, uint8_t *out, size_t *out_len) {
+    *out_len = 0;
+    if (s->error != BASE64_STREAM_OK) {
+        return s->error;
+    }
+    if (s->quad == 1) {
+        s->error = BASE64_STREAM_ERR_LENGTH;
+    } else if (s->quad == 2) {
+        out[0] = s->accum >> 4;
+        *out_len = 1;
+    } else if (s->quad == 3) {
+        out[0] = s->accum >> 10;
+        out[1] = s->accum >> 2;
+        *out_len = 2;
+    }
+    s->quad = 0;
+    s->accum = 0;
+    return s->error;
+}
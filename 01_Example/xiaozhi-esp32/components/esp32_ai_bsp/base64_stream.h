@@ -0,0 +1,73 @@
+/**
+ * @file base64_stream.h
+ * @brief Resumable, table-free base64 decoder
+ *
+ * Characters are mapped to sextets with branch-free arithmetic instead of a
+ * 256-entry table. Clean runs are decoded 16 characters to 12 bytes per
+ * iteration (4 to 3 near the end of a run); whitespace and padding drop to a
+ * per-character path only for the quad that contains them. Input may be split
+ * anywhere between calls.
+ */
+
+#ifndef BASE64_STREAM_H
+#define BASE64_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 1 = 16/4-character fast path, 0 = per-character decoding only (for A/B timing)
+#ifndef BASE64_STREAM_FAST_PATH
+#define BASE64_STREAM_FAST_PATH 1
+#endif
+
+// Error codes
+#define BASE64_STREAM_OK            0
+#define BASE64_STREAM_ERR_PADDING  -1  // '=' too early, or data after padding
+#define BASE64_STREAM_ERR_LENGTH   -2  // Input ended with a single dangling character
+
+typedef struct {
+    uint32_t accum;         // Sextets of the current quad
+    uint8_t quad;           // Sextets in accum (0..3)
+    bool padded;            // Padding seen, only '=' and whitespace may follow
+    int error;              // First error, sticky
+
+    // Validation stats
+    size_t chars;           // Alphabet characters decoded
+    size_t fast_chars;      // ... of which on the fast path
+    size_t whitespace;      // Whitespace characters skipped
+    size_t padding;         // '=' characters
+} base64_stream_t;
+
+void base64_stream_init(base64_stream_t *s);
+
+/**
+ * @brief Decode the next piece of input
+ *
+ * Stops at the end of the input, when fewer than 3 bytes of output space are
+ * left, on an error, or at the first character that is neither base64,
+ * whitespace nor '=' (left for the caller, e.g. a closing JSON quote).
+ *
+ * @param out_len Receives the number of bytes written to out
+ * @return Number of input characters consumed
+ */
+size_t base64_stream_decode(base64_stream_t *s, const char *in, size_t len,
+                            uint8_t *out, size_t out_cap, size_t *out_len);
+
+/**
+ * @brief End of input: emit the bytes of an unpadded final quad
+ * @param out At least 2 bytes of space
+ * @param out_len Receives the number of bytes written (0..2)
+ * @return BASE64_STREAM_OK or the (sticky) error code
+ */
+int base64_stream_finish(base64_stream_t *s, uint8_t *out, size_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BASE64_STREAM_H
@@ -1,10 +1,16 @@
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
+#include <atomic>
 #include "dither_engine.h"
+#include "pixel_kernels.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_memory_utils.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
 #include "sdcard_bsp.h"
+#include "epaper_port.h"
 
 #include "jpeg_decoder.h"
 #include "test_decoder.h"
@@ -23,6 +29,16 @@ static const uint8_t DEFAULT_PALETTE[6][3] = {
     {255, 255, 0}    // Yellow
 };
 
+// Panel color codes for each palette entry (same order as DEFAULT_PALETTE)
+static const uint8_t EPD_COLOR_CODES[6] = {
+    EPD_7IN3E_BLACK,
+    EPD_7IN3E_WHITE,
+    EPD_7IN3E_RED,
+    EPD_7IN3E_GREEN,
+    EPD_7IN3E_BLUE,
+    EPD_7IN3E_YELLOW
+};
+
 // ============================================================================
 // Error Diffusion Kernels
 // ============================================================================
@@ -65,19 +81,81 @@ static const int FS_OFFSETS_Y[4] = {0, 1, 1, 1};
 #define FS_COUNT 4
 
 // ============================================================================
-// Perceptual Color Distance (Redmean formula)
+// Ordered Dithering Threshold Matrices
 // ============================================================================
-// This formula accounts for human perception where we're more sensitive to green
-// and the perception of red changes based on the amount of red present.
-static inline int perceptual_distance(uint8_t r1, uint8_t g1, uint8_t b1,
-                                       uint8_t r2, uint8_t g2, uint8_t b2) {
-    int dr = (int)r1 - r2;
-    int dg = (int)g1 - g2;
-    int db = (int)b1 - b2;
-    int rmean = ((int)r1 + r2) / 2;
-    // Weighted color distance based on human perception
-    return ((512 + rmean) * dr * dr >> 8) + 4 * dg * dg + ((767 - rmean) * db * db >> 8);
-}
+// Ordered kernels add a per-pixel threshold offset from a tiled matrix instead of
+// diffusing error, so every pixel is independent and bands run on both cores.
+
+// Bayer 8x8 index matrix, 64 levels
+static const uint8_t BAYER_8X8[64] = {
+     0, 32,  8, 40,  2, 34, 10, 42,
+    48, 16, 56, 24, 50, 18, 58, 26,
+    12, 44,  4, 36, 14, 46,  6, 38,
+    60, 28, 52, 20, 62, 30, 54, 22,
+     3, 35, 11, 43,  1, 33,  9, 41,
+    51, 19, 59, 27, 49, 17, 57, 25,
+    15, 47,  7, 39, 13, 45,  5, 37,
+    63, 31, 55, 23, 61, 29, 53, 21
+};
+
+// Blue-noise 32x32 threshold matrix, 256 levels (each used 4 times)
+// Generated with void-and-cluster, Gaussian sigma 1.5 on a toroidal grid
+static const uint8_t BLUE_NOISE_32X32[1024] = {
+     27, 184, 243, 116,  28, 224, 181, 238,  49, 206, 103,  62, 203, 150,  45, 182, 131,  71, 177, 114,  88, 234,  24, 212,  76, 161,  96, 175, 210, 158, 112, 198,
+    125, 157,  90,  50, 136,  78,  11, 111, 162,  74, 229, 179,  10,  95, 230,  22, 209,   8, 154,  30, 207, 139,  49, 175, 241,  36, 231,   3, 134,  32, 224,  58,
+    212,  40, 233, 176, 199, 252, 148, 218,  34, 135,  19, 122, 252,  68, 166, 120,  82, 250,  97, 224,  63, 186,  83, 126,  14, 150, 115,  84, 247,  75, 178, 100,
+     22, 141,  73,   9, 102,  39,  60,  93, 176, 244,  89, 160,  38, 141, 205,  56, 187, 142,  46, 166, 120,   1, 254, 100, 200,  67, 217, 187,  53, 145,  12, 242,
+    189, 110, 168, 226, 128, 164, 192, 123,   4, 201,  57, 217, 183, 104,   2, 241,  28, 113, 232,  23, 193, 151,  37, 226, 166,  47, 136,  24, 108, 206, 161,  85,
+    230,  47, 202,  30,  83, 239,  20, 216,  73, 143, 115,  25,  75, 225, 134,  94, 170,  67, 201,  81, 102, 214,  73, 138,  17,  91, 246, 173, 227,  38, 124,  60,
+      6, 136,  69, 154, 209,  55, 106, 156, 236,  44, 190, 246, 155,  52, 192,  37, 215, 152,   7, 137, 241,  52, 178, 110, 212, 193, 120,   4,  68,  95, 253, 174,
+    217, 100, 245, 119,   1, 185, 133,  34,  91, 172,   8,  88, 126,  17, 233,  77, 121, 249,  55, 172,  31, 126,   9, 248,  59,  33,  78, 160, 138, 202,  19, 148,
+     43, 191,  28, 171,  90, 255,  70, 222, 195, 122,  63, 221, 167, 101, 177, 146,  21,  98, 209,  87, 225, 197, 159,  94, 149, 181, 237, 217,  49, 183, 114,  79,
+    164, 131,  64, 228,  46, 146,  13, 163,  25, 246, 148, 201,  40, 253,  61, 204,  45, 188, 158,  13, 113,  72,  41, 232,  21, 131, 103,  16,  90, 229,  30, 238,
+     95,  10, 210, 108, 196, 124, 214,  83, 111,  50,  99,  15,  79, 137,   5, 108, 237, 129,  65, 247, 142, 185, 211, 122,  65, 204,  42, 171, 152, 124,  66, 205,
+     52, 248, 156,  78,  22, 167,  40, 235, 138, 188, 215, 165, 116, 183, 213, 155,  81,  17, 175,  32,  94,  54,   2, 167,  86, 254, 188,  58, 243,   0, 178, 140,
+    189, 118,  35, 184, 242,  99,  63, 178,  10,  72,  33, 227,  51, 240,  70,  34, 229, 193, 118, 221, 155, 240, 107, 220, 140,  13, 112, 137,  80, 219, 106,  26,
+     87, 230,  61, 132,   3, 223, 119, 208, 153, 251, 128,  88, 152,  20, 130, 169,  96, 140,  49,  75, 198,  26, 179,  61,  38, 160, 213,  28, 192,  45, 156, 208,
+      8, 172, 150,  90, 199, 147,  29,  86,  50, 107, 203,   0, 186, 105, 203,  47,   4, 255, 210,  15, 114, 135,  82, 236, 195, 101,  74, 240,  94, 127, 249,  66,
+    104, 214,  25, 253,  44,  71, 172, 238, 191,  27, 169, 231,  56, 248,  80, 223, 180, 110,  84, 162, 245,  42, 153,   6, 123, 230,  53, 167,   6, 180,  36, 141,
+    236,  52, 123, 163, 108, 211, 134,   6,  97, 149,  66, 117, 139,  24, 150, 125,  62, 154,  32, 184,  68, 218, 191,  93, 173,  18, 144, 206, 110, 228,  79, 198,
+     13, 182,  76, 194,  12, 235,  55, 121, 218, 245,  42,  84, 216, 176,  40, 196,  12, 231, 205, 100,   9, 127,  54, 252,  70, 220,  35, 130,  62,  18, 164, 120,
+     96, 145, 244,  35,  89, 151, 184,  78,  20, 180, 130, 197,   7, 101, 242,  71,  96, 132,  50, 143, 235, 170, 109,  27, 158, 105, 187,  87, 251, 147, 220,  42,
+    174, 213,  59, 133, 223, 105,  39, 207, 159,  93,  29, 228, 163,  54, 117, 208, 170, 247,  19, 190,  74,  37, 209, 140, 202,  48, 237, 164,  26, 102, 194,  68,
+     29, 112,   1, 198, 170,  18, 239, 138,  60, 250, 113,  69, 142, 235,  15, 151,  33,  82, 113, 221, 160,  92, 240,  14,  85, 125,   3,  75, 205,  51, 131, 246,
+    159, 234,  77, 119,  48,  72, 193, 117,  15, 174, 213,  43, 192,  81, 129, 185,  61, 216, 136,  57,   0, 119, 187,  65, 175, 215, 153, 226, 111, 177,   8,  89,
+     39, 188, 143, 210, 255, 162,  91, 225,  51,  84, 151,   2, 102, 218,  29, 253,  93, 195,  27, 177, 251, 145,  46, 229, 103,  24,  56, 137,  31, 234, 149, 215,
+     99,  62,  16,  97,  31, 145,   4, 181, 134, 200, 232, 121, 169,  51, 155, 111,   5, 147, 234,  98,  71, 211,  18, 133, 166, 241, 199,  92, 189,  76,  56, 124,
+    247, 165, 225, 183, 125,  63, 233,  43, 107,  23,  69,  35, 245, 197,  73, 227, 171,  55, 122,  36, 161, 109, 190,  88,  32,  69, 118,  11, 254, 163,  22, 195,
+      5, 116,  45,  79, 244, 196,  98, 207, 162, 252, 179, 146,  95,  10, 126,  41, 207,  80, 182, 203,   7, 226,  59, 249, 157, 219, 176,  47, 130, 103, 224, 139,
+     67, 200, 148,  25, 168,  16, 154,  67,  11,  86, 127, 222,  59, 186, 236, 144, 104,  16, 248, 132,  85, 144,  43, 128, 106,  21, 142, 211,  66, 181,  34,  86,
+    168, 242,  92, 222, 114,  48, 135, 239, 115, 216,  46,  17, 112, 161,  83,  23, 221, 156,  64,  44, 237, 173, 208,  12, 196,  82, 233,  97,   1, 243, 152, 214,
+     14,  39, 128,  60, 182, 212,  81, 174,  31, 190, 157, 200, 243,  36, 206,  57, 179, 116, 199,  98,  19, 115,  72, 159, 239,  58,  37, 168, 204, 117,  53, 101,
+    232, 189, 158,  21, 250, 104,   7, 228,  58, 133,  77,  99,  65, 141, 123, 255,  89,   3, 231, 153, 186, 219,  33,  91, 132, 180, 107, 149,  74,  26, 194, 135,
+     48, 109, 219,  85, 143,  41, 202, 157, 109, 250,   0, 222, 173,  14, 194,  30, 165, 139,  38,  76, 129,  57, 251, 191,   5, 223,  20, 249, 129, 227, 171,  80,
+    147,  70,   2, 204, 169,  64, 127,  87,  23, 185, 146,  41, 118, 238,  77, 106, 220,  54, 244, 201,  11, 165, 105, 144,  53, 121, 197,  64,  44,  92,   9, 254,
+};
+
+typedef struct {
+    const uint8_t *thresholds;
+    int size_log2;      // Matrix is (1 << size_log2) pixels square
+    int levels;         // Threshold values run from 0 to levels - 1
+} dither_matrix_desc_t;
+
+static const dither_matrix_desc_t MATRIX_BAYER      = {BAYER_8X8, 3, 64};
+static const dither_matrix_desc_t MATRIX_BLUE_NOISE = {BLUE_NOISE_32X32, 5, 256};
+
+// Peak-to-peak threshold offset added to each channel before the palette lookup
+#ifndef DITHER_ORDERED_SPREAD
+#define DITHER_ORDERED_SPREAD 128
+#endif
+
+// Pixels a wavefront row trails the row above it by. Row y + 1 at x reads errors that row y
+// writes up to pixel x + 1 and writes the x + 1 slot row y touches up to pixel x + 2, so >= 3.
+#define WAVEFRONT_LAG 8
+#define WAVEFRONT_ERR_ROWS 3
+
+// Task stack for each dither worker, rows are heap allocated
+#define DITHER_WORKER_STACK (4 * 1024)
 
 // ============================================================================
 // Constructor / Destructor
@@ -92,12 +170,24 @@ dither_engine::dither_engine() {
 }
 
 dither_engine::~dither_engine() {
+    if (_push) {
+        dither_push_end();
+    }
+    if (_palette_lut) {
+        heap_caps_free(_palette_lut);
+        _palette_lut = NULL;
+    }
 }
 
 void dither_engine::set_config(const dither_config_t *config) {
     if (config) {
+        // Only the calibrated palette feeds the lookup table, kernel changes keep it valid
+        if (memcmp(_config.palette, config->palette, sizeof(_config.palette)) != 0) {
+            _palette_lut_dirty = true;
+        }
         _config = *config;
-        const char *kernel_names[] = {"Floyd-Steinberg", "Jarvis", "Stucki", "Sierra-2-4A"};
+        const char *kernel_names[] = {"Floyd-Steinberg", "Jarvis", "Stucki", "Sierra-2-4A",
+                                      "Floyd-Steinberg (wavefront)", "Bayer 8x8", "Blue noise 32x32"};
         ESP_LOGI(TAG, "Dither config: kernel=%s, serpentine=%s",
                  kernel_names[_config.kernel], _config.serpentine ? "true" : "false");
         ESP_LOGI(TAG, "Palette: [%d,%d,%d] [%d,%d,%d] [%d,%d,%d] [%d,%d,%d] [%d,%d,%d] [%d,%d,%d]",
@@ -119,10 +209,11 @@ int dither_engine::nearest_color_perceptual(uint8_t r, uint8_t g, uint8_t b) {
     int best_dist = INT_MAX;
 
     for (int i = 0; i < 6; i++) {
-        int dist = perceptual_distance(r, g, b,
-                                        _config.palette[i][0],
-                                        _config.palette[i][1],
-                                        _config.palette[i][2]);
+        // Redmean distance: weighs green highest, red/blue weights follow the mean red level
+        int dist = pixel_redmean_distance(r, g, b,
+                                          _config.palette[i][0],
+                                          _config.palette[i][1],
+                                          _config.palette[i][2]);
         if (dist < best_dist) {
             best_dist = dist;
             best = i;
@@ -131,6 +222,64 @@ int dither_engine::nearest_color_perceptual(uint8_t r, uint8_t g, uint8_t b) {
     return best;
 }
 
+// ============================================================================
+// Palette Lookup Table
+// ============================================================================
+// Each bin stores the nearest palette entry for the centre of its RGB cube, so the
+// per-pixel cost drops from 6 redmean distances to a single table read. Only pixels
+// within half a bin of a decision boundary can map differently from the exact search,
+// and the quantisation error is still computed from the real pixel value.
+
+void dither_engine::build_palette_lut() {
+#if DITHER_PALETTE_LUT_BITS > 0
+    if (!_palette_lut_dirty && _palette_lut) {
+        return;
+    }
+
+    if (_palette_lut == NULL) {
+        // Prefer internal RAM when there is room, the table is read once per pixel
+        size_t internal_free = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (internal_free > DITHER_PALETTE_LUT_SIZE + 64 * 1024) {
+            _palette_lut = (uint8_t *)heap_caps_malloc(DITHER_PALETTE_LUT_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (_palette_lut == NULL) {
+            _palette_lut = (uint8_t *)heap_caps_malloc(DITHER_PALETTE_LUT_SIZE, MALLOC_CAP_SPIRAM);
+        }
+        if (_palette_lut == NULL) {
+            ESP_LOGW(TAG, "Failed to allocate palette LUT (%d bytes), using exact search", DITHER_PALETTE_LUT_SIZE);
+            return;
+        }
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    const int bins = 1 << DITHER_PALETTE_LUT_BITS;
+    const int shift = 8 - DITHER_PALETTE_LUT_BITS;
+    const int half = (1 << shift) >> 1;
+    uint8_t *p = _palette_lut;
+    uint8_t block[PIXEL_BLOCK * 3];
+    for (int r = 0; r < bins; r++) {
+        for (int g = 0; g < bins; g++) {
+            // Bin centres along b, searched PIXEL_BLOCK at a time
+            for (int b = 0; b < bins; b += PIXEL_BLOCK) {
+                int n = bins - b < PIXEL_BLOCK ? bins - b : PIXEL_BLOCK;
+                for (int i = 0; i < n; i++) {
+                    block[i * 3 + 0] = (r << shift) | half;
+                    block[i * 3 + 1] = (g << shift) | half;
+                    block[i * 3 + 2] = ((b + i) << shift) | half;
+                }
+                pixel_nearest_palette16(block, n, _config.palette, 6, p);
+                p += n;
+            }
+        }
+    }
+    _palette_lut_dirty = false;
+
+    ESP_LOGI(TAG, "[TIMING] Palette LUT build (%dx%dx%d, %s): %lld ms", bins, bins, bins,
+             esp_ptr_external_ram(_palette_lut) ? "PSRAM" : "internal",
+             (esp_timer_get_time() - start_time) / 1000);
+#endif
+}
+
 // ============================================================================
 // JPEG Decode
 // ============================================================================
@@ -153,108 +302,720 @@ void dither_engine::Jpeg_dec_buffer_free(uint8_t *outbuffer) {
 }
 
 // ============================================================================
-// Main Dithering Function
+// Kernel Selection
 // ============================================================================
 
-void dither_engine::dither_rgb888(uint8_t *in_img, uint8_t *out_img, int w, int h) {
-    // Allocate work buffer in PSRAM for large images
-    uint8_t *work = (uint8_t *)heap_caps_malloc(w * h * 3, MALLOC_CAP_SPIRAM);
-    if (!work) {
-        // Fallback to internal RAM
-        work = (uint8_t *)malloc(w * h * 3);
-    }
-    if (!work) {
-        ESP_LOGE(TAG, "Failed to allocate work buffer for dithering");
-        return;
-    }
-
-    // Copy input to work buffer
-    memcpy(work, in_img, w * h * 3);
-
-    // Select kernel based on config
+typedef struct {
     const int *weights;
     const int *offsets_x;
     const int *offsets_y;
     int divisor;
     int count;
+    int rows;       // Rows touched by the kernel, including the current one
+} dither_kernel_desc_t;
 
-    switch (_config.kernel) {
-        case DITHER_JARVIS:
-            weights = JARVIS_WEIGHTS;
-            offsets_x = JARVIS_OFFSETS_X;
-            offsets_y = JARVIS_OFFSETS_Y;
-            divisor = JARVIS_DIVISOR;
-            count = JARVIS_COUNT;
-            break;
-        case DITHER_STUCKI:
-            weights = STUCKI_WEIGHTS;
-            offsets_x = JARVIS_OFFSETS_X;  // Same offsets as Jarvis
-            offsets_y = JARVIS_OFFSETS_Y;
-            divisor = STUCKI_DIVISOR;
-            count = STUCKI_COUNT;
-            break;
-        case DITHER_SIERRA_2_4A:
-            weights = SIERRA_WEIGHTS;
-            offsets_x = SIERRA_OFFSETS_X;
-            offsets_y = SIERRA_OFFSETS_Y;
-            divisor = SIERRA_DIVISOR;
-            count = SIERRA_COUNT;
-            break;
-        default:  // DITHER_FLOYD_STEINBERG
-            weights = FS_WEIGHTS;
-            offsets_x = FS_OFFSETS_X;
-            offsets_y = FS_OFFSETS_Y;
-            divisor = FS_DIVISOR;
-            count = FS_COUNT;
+static const dither_kernel_desc_t KERNEL_FS      = {FS_WEIGHTS, FS_OFFSETS_X, FS_OFFSETS_Y, FS_DIVISOR, FS_COUNT, 2};
+static const dither_kernel_desc_t KERNEL_JARVIS  = {JARVIS_WEIGHTS, JARVIS_OFFSETS_X, JARVIS_OFFSETS_Y, JARVIS_DIVISOR, JARVIS_COUNT, 3};
+static const dither_kernel_desc_t KERNEL_STUCKI  = {STUCKI_WEIGHTS, JARVIS_OFFSETS_X, JARVIS_OFFSETS_Y, STUCKI_DIVISOR, STUCKI_COUNT, 3};  // Same offsets as Jarvis
+static const dither_kernel_desc_t KERNEL_SIERRA  = {SIERRA_WEIGHTS, SIERRA_OFFSETS_X, SIERRA_OFFSETS_Y, SIERRA_DIVISOR, SIERRA_COUNT, 2};
+
+static const dither_kernel_desc_t *get_kernel(dither_kernel_t kernel) {
+    switch (kernel) {
+        case DITHER_JARVIS:      return &KERNEL_JARVIS;
+        case DITHER_STUCKI:      return &KERNEL_STUCKI;
+        case DITHER_SIERRA_2_4A: return &KERNEL_SIERRA;
+        default:                 return &KERNEL_FS;  // DITHER_FLOYD_STEINBERG(_WAVEFRONT)
+    }
+}
+
+// Threshold matrix for ordered kernels, NULL for error diffusion
+static const dither_matrix_desc_t *get_matrix(dither_kernel_t kernel) {
+    switch (kernel) {
+        case DITHER_ORDERED_BAYER: return &MATRIX_BAYER;
+        case DITHER_BLUE_NOISE:    return &MATRIX_BLUE_NOISE;
+        default:                   return NULL;
+    }
+}
+
+// Largest horizontal reach of any kernel, used as padding so the inner loop needs no x bounds check
+#define ERR_PAD 2
+
+// ============================================================================
+// Streaming Dithering
+// ============================================================================
+
+// Per-frame row window shared by the pull (dither_stream) and push (dither_push_*) paths
+struct dither_engine::row_state_t {
+    int w;
+    int y;                              // Next row to dither
+    const dither_kernel_desc_t *kernel; // Error diffusion kernel, NULL for ordered kernels
+    const dither_matrix_desc_t *matrix; // Threshold matrix, NULL for error diffusion
+    bool serpentine;
+    int err_stride;
+    uint8_t *in_row;                    // Input row for source callbacks
+    uint8_t *idx_row;                   // Palette indices of the last dithered row
+    int16_t *err;                       // Error diffusion: kernel->rows rows of int16 accumulators
+    int16_t *offsets;                   // Ordered: threshold offsets of the whole matrix
+};
+
+bool dither_engine::row_state_init(row_state_t *s, int w, int y_begin) {
+    memset(s, 0, sizeof(*s));
+    s->w = w;
+    s->y = y_begin;
+    s->matrix = get_matrix(_config.kernel);
+    s->kernel = s->matrix ? NULL : get_kernel(_config.kernel);
+    // The wavefront kernel cannot alternate direction, keep its single-core output identical
+    s->serpentine = _config.serpentine && _config.kernel != DITHER_FLOYD_STEINBERG_WAVEFRONT;
+    s->err_stride = (w + 2 * ERR_PAD) * 3;
+
+    // Row window: one input row, one index row and either the kernel's rows of int16 error
+    // accumulators or the ordered threshold offsets, never a full-frame buffer
+    s->in_row = (uint8_t *)heap_caps_malloc(w * 3, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s->idx_row = (uint8_t *)heap_caps_malloc(w, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    int extra;
+    if (s->matrix) {
+        const dither_matrix_desc_t *m = s->matrix;
+        const int cells = 1 << (2 * m->size_log2);
+        extra = cells * (int)sizeof(int16_t);
+        s->offsets = (int16_t *)heap_caps_malloc(extra, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (s->offsets) {
+            // Threshold t maps to an offset centred on zero: (t + 0.5) / levels - 0.5 of the spread
+            for (int i = 0; i < cells; i++) {
+                s->offsets[i] = (int16_t)(((2 * m->thresholds[i] + 1 - m->levels) * DITHER_ORDERED_SPREAD) / (2 * m->levels));
+            }
+        }
+    } else {
+        extra = s->kernel->rows * s->err_stride * (int)sizeof(int16_t);
+        s->err = (int16_t *)heap_caps_calloc(s->kernel->rows * s->err_stride, sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (!s->in_row || !s->idx_row || (!s->offsets && !s->err)) {
+        ESP_LOGE(TAG, "Failed to allocate dither row window (%d bytes)", w * 4 + extra);
+        row_state_free(s);
+        return false;
+    }
+    return true;
+}
+
+void dither_engine::row_state_free(row_state_t *s) {
+    heap_caps_free(s->in_row);
+    heap_caps_free(s->idx_row);
+    heap_caps_free(s->err);
+    heap_caps_free(s->offsets);
+    s->in_row = s->idx_row = NULL;
+    s->err = s->offsets = NULL;
+}
+
+void dither_engine::dither_row(row_state_t *s, const uint8_t *in_row) {
+    const int w = s->w;
+    const int y = s->y++;
+    uint8_t *idx_row = s->idx_row;
+
+    if (s->matrix) {
+        // Ordered: a per-pixel threshold offset from the tiled matrix, no error carried between pixels
+        const dither_matrix_desc_t *m = s->matrix;
+        const int mask = (1 << m->size_log2) - 1;
+        const int16_t *o = s->offsets + ((y & mask) << m->size_log2);
+        const uint8_t *px = in_row;
+        for (int x = 0; x < w; x++, px += 3) {
+            int t = o[x & mask];
+            int vr = px[0] + t;
+            int vg = px[1] + t;
+            int vb = px[2] + t;
+            vr = CLAMP(vr, 0, 255);
+            vg = CLAMP(vg, 0, 255);
+            vb = CLAMP(vb, 0, 255);
+            idx_row[x] = palette_index(vr, vg, vb);
+        }
+        return;
+    }
+
+    const dither_kernel_desc_t *k = s->kernel;
+
+    // Error rows are a ring indexed by image row, the padding absorbs out-of-bounds taps
+    int16_t *err_rows[3];
+    for (int r = 0; r < k->rows; r++) {
+        err_rows[r] = s->err + ((y + r) % k->rows) * s->err_stride + ERR_PAD * 3;
+    }
+    int16_t *cur = err_rows[0];
+
+    // Serpentine scanning: alternate direction each row to reduce artifacts
+    bool reverse = s->serpentine && (y % 2 == 1);
+    int x_start = reverse ? (w - 1) : 0;
+    int x_end = reverse ? -1 : w;
+    int x_step = reverse ? -1 : 1;
+
+    for (int x = x_start; x != x_end; x += x_step) {
+        const uint8_t *px = in_row + x * 3;
+        int16_t *e = cur + x * 3;
+
+        // Input plus the full accumulated error, clamped only for the palette search
+        int vr = px[0] + e[0];
+        int vg = px[1] + e[1];
+        int vb = px[2] + e[2];
+        vr = CLAMP(vr, 0, 255);
+        vg = CLAMP(vg, 0, 255);
+        vb = CLAMP(vb, 0, 255);
+
+        // Find nearest color using perceptual distance (uses calibrated palette)
+        int ci = palette_index(vr, vg, vb);
+        idx_row[x] = ci;
+
+        // Calculate quantization error using calibrated palette (for better dithering)
+        int err_r = vr - _config.palette[ci][0];
+        int err_g = vg - _config.palette[ci][1];
+        int err_b = vb - _config.palette[ci][2];
+
+        // Diffuse error to neighboring pixels
+        // For serpentine scanning, flip the x offsets when going right-to-left
+        for (int i = 0; i < k->count; i++) {
+            int dx = reverse ? -k->offsets_x[i] : k->offsets_x[i];
+            int16_t *n = err_rows[k->offsets_y[i]] + (x + dx) * 3;
+            n[0] += err_r * k->weights[i] / k->divisor;
+            n[1] += err_g * k->weights[i] / k->divisor;
+            n[2] += err_b * k->weights[i] / k->divisor;
+        }
+    }
+
+    // The current row's accumulators are consumed, recycle them for row y + rows
+    memset(cur - ERR_PAD * 3, 0, s->err_stride * sizeof(int16_t));
+}
+
+// Rows [y_begin, y_end) from source to sink. Ordered kernels can start anywhere (two-core bands),
+// error diffusion only gives the right result for a whole frame.
+bool dither_engine::stream_rows(int w, int y_begin, int y_end, dither_row_source_t source,
+                                dither_row_sink_t sink, void *user_ctx) {
+    row_state_t s;
+    if (!row_state_init(&s, w, y_begin)) {
+        return false;
+    }
+
+    bool ok = true;
+    for (int y = y_begin; y < y_end && ok; y++) {
+        if (!source(user_ctx, y, s.in_row)) {
+            ok = false;
             break;
+        }
+        dither_row(&s, s.in_row);
+        ok = sink(user_ctx, y, s.idx_row);
+    }
+
+    row_state_free(&s);
+    return ok;
+}
+
+bool dither_engine::dither_stream(int w, int h, dither_row_source_t source, dither_row_sink_t sink, void *user_ctx) {
+    if (w <= 0 || h <= 0 || source == NULL || sink == NULL) {
+        ESP_LOGE(TAG, "dither_stream: invalid parameters");
+        return false;
     }
 
-    // Process each row
-    for (int y = 0; y < h; y++) {
-        // Serpentine scanning: alternate direction each row to reduce artifacts
-        bool reverse = _config.serpentine && (y % 2 == 1);
-        int x_start = reverse ? (w - 1) : 0;
-        int x_end = reverse ? -1 : w;
-        int x_step = reverse ? -1 : 1;
-
-        for (int x = x_start; x != x_end; x += x_step) {
-            int idx = (y * w + x) * 3;
-            uint8_t r = work[idx];
-            uint8_t g = work[idx + 1];
-            uint8_t b = work[idx + 2];
-
-            // Find nearest color using perceptual distance (uses calibrated palette)
-            int ci = nearest_color_perceptual(r, g, b);
-
-            // Output standard RGB values (for display compatibility)
-            out_img[idx] = DEFAULT_PALETTE[ci][0];
-            out_img[idx + 1] = DEFAULT_PALETTE[ci][1];
-            out_img[idx + 2] = DEFAULT_PALETTE[ci][2];
-
-            // Calculate quantization error using calibrated palette (for better dithering)
-            int err_r = (int)r - _config.palette[ci][0];
-            int err_g = (int)g - _config.palette[ci][1];
-            int err_b = (int)b - _config.palette[ci][2];
-
-            // Diffuse error to neighboring pixels
-            // For serpentine scanning, flip the x offsets when going right-to-left
-            for (int k = 0; k < count; k++) {
-                int nx = x + (reverse ? -offsets_x[k] : offsets_x[k]);
-                int ny = y + offsets_y[k];
-
-                // Bounds check
-                if (nx >= 0 && nx < w && ny < h) {
-                    int n = (ny * w + nx) * 3;
-                    work[n]     = CLAMP(work[n]     + err_r * weights[k] / divisor, 0, 255);
-                    work[n + 1] = CLAMP(work[n + 1] + err_g * weights[k] / divisor, 0, 255);
-                    work[n + 2] = CLAMP(work[n + 2] + err_b * weights[k] / divisor, 0, 255);
+    // Refresh the palette lookup table if the calibration changed since the last frame
+    build_palette_lut();
+
+    return stream_rows(w, 0, h, source, sink, user_ctx);
+}
+
+// ============================================================================
+// Two-Core Dithering
+// ============================================================================
+
+struct dither_engine::parallel_job_t {
+    dither_engine *engine;
+    int w;
+    int h;
+    dither_row_source_t source;
+    dither_row_sink_t sink;
+    void *user_ctx;
+    bool wavefront;                 // Interleaved Floyd-Steinberg rows instead of ordered bands
+    int split_y;                    // Ordered: worker 0 takes [0, split_y), worker 1 the rest
+    int16_t *err;                   // Wavefront: WAVEFRONT_ERR_ROWS shared error rows
+    std::atomic<int> progress[2];   // Wavefront: y * w + x + 1 of each worker's last finished pixel
+    std::atomic<bool> abort;
+    bool ok[2];
+    SemaphoreHandle_t done;         // Given once by each helper task
+};
+
+bool dither_engine::wavefront_rows(parallel_job_t *job, int worker) {
+    const int w = job->w;
+    const int err_stride = (w + 2 * ERR_PAD) * 3;
+    std::atomic<int> *mine = &job->progress[worker];
+    std::atomic<int> *above = &job->progress[worker ^ 1];
+
+    uint8_t *in_row = (uint8_t *)heap_caps_malloc(w * 3, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint8_t *idx_row = (uint8_t *)heap_caps_malloc(w, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    bool ok = (in_row != NULL && idx_row != NULL);
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to allocate wavefront dither rows (%d bytes)", w * 4);
+    }
+
+    // Each worker takes every other row, row y waits on the worker running row y - 1
+    for (int y = worker; y < job->h && ok && !job->abort.load(std::memory_order_relaxed); y += 2) {
+        if (!job->source(job->user_ctx, y, in_row)) {
+            ok = false;
+            break;
+        }
+
+        int16_t *cur = job->err + (y % WAVEFRONT_ERR_ROWS) * err_stride + ERR_PAD * 3;
+        int16_t *next = job->err + ((y + 1) % WAVEFRONT_ERR_ROWS) * err_stride + ERR_PAD * 3;
+        const int above_base = (y - 1) * w;
+        int ready = (y == 0) ? w : 0;   // Pixels of row y - 1 known to be finished
+
+        const uint8_t *px = in_row;
+        int16_t *e = cur;
+        for (int x = 0; x < w; x++, px += 3, e += 3) {
+            int need = x + WAVEFRONT_LAG < w ? x + WAVEFRONT_LAG : w;
+            for (int spins = 0; ready < need; spins++) {
+                ready = above->load(std::memory_order_acquire) - above_base;
+                // Both workers can end up on one core (fallback path), let the other one run
+                if ((spins & 0xFF) == 0xFF) {
+                    taskYIELD();
                 }
             }
+
+            int vr = px[0] + e[0];
+            int vg = px[1] + e[1];
+            int vb = px[2] + e[2];
+            vr = CLAMP(vr, 0, 255);
+            vg = CLAMP(vg, 0, 255);
+            vb = CLAMP(vb, 0, 255);
+
+            int ci = palette_index(vr, vg, vb);
+            idx_row[x] = ci;
+
+            int err_r = vr - _config.palette[ci][0];
+            int err_g = vg - _config.palette[ci][1];
+            int err_b = vb - _config.palette[ci][2];
+
+            // Same taps and rounding as KERNEL_FS, so the output matches the single-core pass
+            int16_t *n = next + x * 3;
+            e[3] += err_r * 7 / FS_DIVISOR;
+            e[4] += err_g * 7 / FS_DIVISOR;
+            e[5] += err_b * 7 / FS_DIVISOR;
+            n[-3] += err_r * 3 / FS_DIVISOR;
+            n[-2] += err_g * 3 / FS_DIVISOR;
+            n[-1] += err_b * 3 / FS_DIVISOR;
+            n[0] += err_r * 5 / FS_DIVISOR;
+            n[1] += err_g * 5 / FS_DIVISOR;
+            n[2] += err_b * 5 / FS_DIVISOR;
+            n[3] += err_r * 1 / FS_DIVISOR;
+            n[4] += err_g * 1 / FS_DIVISOR;
+            n[5] += err_b * 1 / FS_DIVISOR;
+
+            mine->store(y * w + x + 1, std::memory_order_release);
+        }
+
+        // Row y's slot is next written by row y + 2 on this worker, clear it before moving on
+        memset(cur - ERR_PAD * 3, 0, err_stride * sizeof(int16_t));
+
+        ok = job->sink(job->user_ctx, y, idx_row);
+    }
+
+    // Never leave the other worker spinning on this one
+    mine->store(INT_MAX, std::memory_order_release);
+
+    heap_caps_free(in_row);
+    heap_caps_free(idx_row);
+    return ok;
+}
+
+bool dither_engine::run_worker(parallel_job_t *job, int worker) {
+    bool ok;
+    if (job->wavefront) {
+        ok = wavefront_rows(job, worker);
+    } else if (worker == 0) {
+        ok = stream_rows(job->w, 0, job->split_y, job->source, job->sink, job->user_ctx);
+    } else {
+        ok = stream_rows(job->w, job->split_y, job->h, job->source, job->sink, job->user_ctx);
+    }
+    if (!ok) {
+        job->abort.store(true, std::memory_order_relaxed);
+    }
+    return ok;
+}
+
+void dither_engine::parallel_helper_task(void *arg) {
+    parallel_job_t *job = (parallel_job_t *)arg;
+    int worker = (xPortGetCoreID() == 0) ? 0 : 1;
+    job->ok[worker] = job->engine->run_worker(job, worker);
+    xSemaphoreGive(job->done);
+    vTaskDelete(NULL);
+}
+
+bool dither_engine::dither_stream_parallel(int w, int h, dither_row_source_t source, dither_row_sink_t sink,
+                                           void *user_ctx, int split_y, bool interleave) {
+    bool ordered = (get_matrix(_config.kernel) != NULL);
+    bool wavefront = (_config.kernel == DITHER_FLOYD_STEINBERG_WAVEFRONT) && interleave;
+#if CONFIG_FREERTOS_UNICORE
+    ordered = false;
+    wavefront = false;
+#endif
+    if ((!ordered && !wavefront) || w <= 0 || h < 2 || source == NULL || sink == NULL) {
+        return dither_stream(w, h, source, sink, user_ctx);
+    }
+
+    // Built once up front, both workers only read it
+    build_palette_lut();
+
+    parallel_job_t job;
+    job.engine = this;
+    job.w = w;
+    job.h = h;
+    job.source = source;
+    job.sink = sink;
+    job.user_ctx = user_ctx;
+    job.wavefront = wavefront;
+    job.split_y = CLAMP(split_y, 0, h);
+    job.err = NULL;
+    job.progress[0].store(0);
+    job.progress[1].store(0);
+    job.abort.store(false);
+    job.ok[0] = false;
+    job.ok[1] = false;
+    job.done = NULL;
+
+    if (wavefront) {
+        job.err = (int16_t *)heap_caps_calloc(WAVEFRONT_ERR_ROWS * (w + 2 * ERR_PAD) * 3, sizeof(int16_t),
+                                              MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (!wavefront || job.err != NULL) {
+        job.done = xSemaphoreCreateCounting(2, 0);
+    }
+    if (job.done == NULL) {
+        ESP_LOGW(TAG, "Two-core dither setup failed, using a single core");
+        heap_caps_free(job.err);
+        return dither_stream(w, h, source, sink, user_ctx);
+    }
+
+    // One worker pinned to each core: an unpinned caller could share a core with its helper.
+    // Core 1's worker starts first, so worker 0 can always run on the caller as a fallback.
+    UBaseType_t prio = uxTaskPriorityGet(NULL);
+    int helpers = 0;
+    if (xTaskCreatePinnedToCore(parallel_helper_task, "dither_w1", DITHER_WORKER_STACK, &job, prio, NULL, 1) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to start dither worker on core 1, using a single core");
+        vSemaphoreDelete(job.done);
+        heap_caps_free(job.err);
+        return dither_stream(w, h, source, sink, user_ctx);
+    }
+    helpers++;
+    if (xTaskCreatePinnedToCore(parallel_helper_task, "dither_w0", DITHER_WORKER_STACK, &job, prio, NULL, 0) == pdPASS) {
+        helpers++;
+    } else {
+        job.ok[0] = run_worker(&job, 0);
+    }
+
+    for (int i = 0; i < helpers; i++) {
+        xSemaphoreTake(job.done, portMAX_DELAY);
+    }
+    vSemaphoreDelete(job.done);
+    heap_caps_free(job.err);
+    return job.ok[0] && job.ok[1];
+}
+
+// ============================================================================
+// Main Dithering Function
+// ============================================================================
+
+typedef struct {
+    const uint8_t *in_img;
+    uint8_t *out_img;
+    int w;
+} dither_buffer_ctx_t;
+
+static bool buffer_row_source(void *user_ctx, int y, uint8_t *rgb_row) {
+    dither_buffer_ctx_t *ctx = (dither_buffer_ctx_t *)user_ctx;
+    memcpy(rgb_row, ctx->in_img + (size_t)y * ctx->w * 3, ctx->w * 3);
+    return true;
+}
+
+static bool buffer_row_sink(void *user_ctx, int y, const uint8_t *index_row) {
+    dither_buffer_ctx_t *ctx = (dither_buffer_ctx_t *)user_ctx;
+    // Output standard RGB values (for display compatibility)
+    pixel_expand_indices(index_row, DEFAULT_PALETTE, 6, ctx->out_img + (size_t)y * ctx->w * 3, ctx->w);
+    return true;
+}
+
+void dither_engine::dither_rgb888(uint8_t *in_img, uint8_t *out_img, int w, int h) {
+    // Row y is read before it is written, so dithering in place is safe
+    dither_buffer_ctx_t ctx = {in_img, out_img, w};
+    if (!dither_stream_parallel(w, h, buffer_row_source, buffer_row_sink, &ctx, h / 2, true)) {
+        ESP_LOGE(TAG, "Dithering failed");
+    }
+}
+
+// ============================================================================
+// Packed E-Paper Output
+// ============================================================================
+
+typedef struct {
+    dither_row_source_t source;
+    void *source_ctx;
+    uint8_t *image;
+    int width_byte;
+    int x_count;            // Source columns that land on the panel
+    int y_first;            // First source row that lands on the panel
+    int y_last;             // One past the last source row that lands on the panel
+    // Affine source (x, y) -> memory (X, Y) transform
+    int x0, dxx, dxy;
+    int y0, dyx, dyy;
+} dither_epd_ctx_t;
+
+// Source pixel -> panel memory position, the same chain as GUI_DirectDisplay_RGB888_6Color + Paint_SetPixel
+static void epd_map_point(const dither_epd_target_t *t, bool portrait, int h,
+                          int x, int y, int *out_x, int *out_y) {
+    // Portrait images are rotated 90 degrees CW into the landscape canvas
+    int lx = portrait ? (h - 1 - y) : x;
+    int ly = portrait ? x : y;
+    int X, Y;
+    switch (t->rotate) {
+        case 90:  X = t->width_memory - ly - 1; Y = lx; break;
+        case 180: X = t->width_memory - lx - 1; Y = t->height_memory - ly - 1; break;
+        case 270: X = ly; Y = t->height_memory - lx - 1; break;
+        default:  X = lx; Y = ly; break;
+    }
+    if (t->mirror & 0x01) X = t->width_memory - X - 1;
+    if (t->mirror & 0x02) Y = t->height_memory - Y - 1;
+    *out_x = X;
+    *out_y = Y;
+}
+
+static bool epd_row_source(void *user_ctx, int y, uint8_t *rgb_row) {
+    dither_epd_ctx_t *ctx = (dither_epd_ctx_t *)user_ctx;
+    return ctx->source(ctx->source_ctx, y, rgb_row);
+}
+
+static bool epd_row_sink(void *user_ctx, int y, const uint8_t *index_row) {
+    dither_epd_ctx_t *ctx = (dither_epd_ctx_t *)user_ctx;
+    if (y < ctx->y_first || y >= ctx->y_last) {
+        return true;
+    }
+
+    int X = ctx->x0 + ctx->dxy * y;
+    int Y = ctx->y0 + ctx->dyy * y;
+
+    if (ctx->dyx == 0) {
+        // Source row maps onto one memory row: emit whole bytes, nibble writes only at the edges
+        uint8_t *row = ctx->image + Y * ctx->width_byte;
+        // Nibble the pixel at X lands in: even X is the high nibble, odd X the low one
+        int x = 0;
+        if (ctx->dxx > 0) {
+            if (X & 1) {
+                row[X >> 1] = (row[X >> 1] & 0xF0) | EPD_COLOR_CODES[index_row[x]];
+                X++;
+                x++;
+            }
+            for (; x + 1 < ctx->x_count; x += 2, X += 2) {
+                row[X >> 1] = (EPD_COLOR_CODES[index_row[x]] << 4) | EPD_COLOR_CODES[index_row[x + 1]];
+            }
+        } else {
+            // Mirrored row (rotate 180): source x + 1 sits left of x in memory
+            if (!(X & 1)) {
+                row[X >> 1] = (row[X >> 1] & 0x0F) | (EPD_COLOR_CODES[index_row[x]] << 4);
+                X--;
+                x++;
+            }
+            for (; x + 1 < ctx->x_count; x += 2, X -= 2) {
+                row[X >> 1] = (EPD_COLOR_CODES[index_row[x + 1]] << 4) | EPD_COLOR_CODES[index_row[x]];
+            }
+        }
+        if (x < ctx->x_count) {
+            uint8_t *b = row + (X >> 1);
+            if (X & 1) {
+                *b = (*b & 0xF0) | EPD_COLOR_CODES[index_row[x]];
+            } else {
+                *b = (*b & 0x0F) | (EPD_COLOR_CODES[index_row[x]] << 4);
+            }
+        }
+    } else {
+        // Source row maps onto a memory column (portrait or 90/270 rotation): one nibble per pixel
+        int addr = Y * ctx->width_byte + (X >> 1);
+        int step = ctx->dyx * ctx->width_byte;
+        int shift = (X & 1) ? 0 : 4;
+        uint8_t mask = (X & 1) ? 0xF0 : 0x0F;
+        for (int x = 0; x < ctx->x_count; x++, addr += step) {
+            ctx->image[addr] = (ctx->image[addr] & mask) | (EPD_COLOR_CODES[index_row[x]] << shift);
         }
     }
+    return true;
+}
+
+// Ordered band boundary for the two-core pass. Column-mapped rows share bytes in pairs
+// (two nibbles), so the split must not separate a pair or both cores would write one byte.
+static int epd_band_split(const dither_epd_ctx_t *ctx, int h) {
+    int split = h / 2;
+    if (ctx->dyx != 0 && split > 0 &&
+        ((ctx->x0 + ctx->dxy * (split - 1)) >> 1) == ((ctx->x0 + ctx->dxy * split) >> 1)) {
+        split++;
+    }
+    return split;
+}
+
+// Clipping and the source -> framebuffer transform of a w x h image on target
+static void epd_setup(dither_epd_ctx_t *ctx, int w, int h, const dither_epd_target_t *target) {
+    // Logical (Paint) canvas size and the size the image occupies on it
+    bool portrait = (h > w);
+    bool swapped = (target->rotate == 90 || target->rotate == 270);
+    int paint_w = swapped ? target->height_memory : target->width_memory;
+    int paint_h = swapped ? target->width_memory : target->height_memory;
+
+    ctx->image = target->image;
+    ctx->width_byte = (target->width_memory + 1) / 2;
+    if (portrait) {
+        // lx = h - 1 - y must stay below paint_w, ly = x below paint_h
+        ctx->x_count = w < paint_h ? w : paint_h;
+        ctx->y_first = h > paint_w ? h - paint_w : 0;
+        ctx->y_last = h;
+    } else {
+        ctx->x_count = w < paint_w ? w : paint_w;
+        ctx->y_first = 0;
+        ctx->y_last = h < paint_h ? h : paint_h;
+    }
+
+    // Resolve rotation and mirroring once per frame into an affine transform
+    int ox, oy, ax, ay, bx, by;
+    epd_map_point(target, portrait, h, 0, 0, &ox, &oy);
+    epd_map_point(target, portrait, h, 1, 0, &ax, &ay);
+    epd_map_point(target, portrait, h, 0, 1, &bx, &by);
+    ctx->x0 = ox;
+    ctx->y0 = oy;
+    ctx->dxx = ax - ox;
+    ctx->dyx = ay - oy;
+    ctx->dxy = bx - ox;
+    ctx->dyy = by - oy;
+}
+
+bool dither_engine::dither_stream_to_epd(int w, int h, dither_row_source_t source, void *user_ctx,
+                                         const dither_epd_target_t *target) {
+    if (target == NULL || target->image == NULL || w <= 0 || h <= 0) {
+        ESP_LOGE(TAG, "dither_stream_to_epd: invalid parameters");
+        return false;
+    }
+
+    dither_epd_ctx_t ctx;
+    ctx.source = source;
+    ctx.source_ctx = user_ctx;
+    epd_setup(&ctx, w, h, target);
+
+    if (target->lock) {
+        xSemaphoreTake(target->lock, portMAX_DELAY);
+    }
+    // Adjacent rows may only be in flight together when each lands in its own memory row
+    bool ok = dither_stream_parallel(w, h, epd_row_source, epd_row_sink, &ctx, epd_band_split(&ctx, h), ctx.dyx == 0);
+    if (target->lock) {
+        xSemaphoreGive(target->lock);
+    }
+    return ok;
+}
+
+bool dither_engine::dither_rgb888_to_epd(const uint8_t *in_img, int w, int h, const dither_epd_target_t *target) {
+    dither_buffer_ctx_t ctx = {in_img, NULL, w};
+    return dither_stream_to_epd(w, h, buffer_row_source, &ctx, target);
+}
+
+// ============================================================================
+// Push Dithering
+// ============================================================================
+// The producer (e.g. the PNG decoder) drives the row loop, so decode, scale and
+// dither run as one pass with only the row window in memory.
+
+struct dither_engine::push_session_t {
+    row_state_t rows;
+    int h;
+    dither_row_sink_t sink;
+    void *user_ctx;
+    dither_buffer_ctx_t buffer;     // dither_push_begin_rgb888 sink state
+    dither_epd_ctx_t epd;           // dither_push_begin_epd sink state
+    SemaphoreHandle_t lock;         // Framebuffer lock held until dither_push_end
+    bool ok;
+};
+
+bool dither_engine::dither_push_begin(int w, int h, dither_row_sink_t sink, void *user_ctx) {
+    if (w <= 0 || h <= 0 || sink == NULL) {
+        ESP_LOGE(TAG, "dither_push_begin: invalid parameters");
+        return false;
+    }
+    if (_push != NULL) {
+        ESP_LOGW(TAG, "dither_push_begin: previous session not ended, dropping it");
+        dither_push_end();
+    }
+
+    build_palette_lut();
+
+    push_session_t *p = (push_session_t *)heap_caps_calloc(1, sizeof(push_session_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (p == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate push session");
+        return false;
+    }
+    if (!row_state_init(&p->rows, w, 0)) {
+        heap_caps_free(p);
+        return false;
+    }
+    p->h = h;
+    p->sink = sink;
+    p->user_ctx = user_ctx;
+    p->ok = true;
+    _push = p;
+    return true;
+}
 
-    // Free work buffer
-    heap_caps_free(work);
+bool dither_engine::dither_push_begin_rgb888(int w, int h, uint8_t *out_img) {
+    if (out_img == NULL) {
+        ESP_LOGE(TAG, "dither_push_begin_rgb888: invalid parameters");
+        return false;
+    }
+    if (!dither_push_begin(w, h, buffer_row_sink, NULL)) {
+        return false;
+    }
+    _push->buffer.in_img = NULL;
+    _push->buffer.out_img = out_img;
+    _push->buffer.w = w;
+    _push->user_ctx = &_push->buffer;
+    return true;
+}
+
+bool dither_engine::dither_push_begin_epd(int w, int h, const dither_epd_target_t *target) {
+    if (target == NULL || target->image == NULL) {
+        ESP_LOGE(TAG, "dither_push_begin_epd: invalid parameters");
+        return false;
+    }
+    if (!dither_push_begin(w, h, epd_row_sink, NULL)) {
+        return false;
+    }
+    epd_setup(&_push->epd, w, h, target);
+    _push->user_ctx = &_push->epd;
+    _push->lock = target->lock;
+    if (_push->lock) {
+        xSemaphoreTake(_push->lock, portMAX_DELAY);
+    }
+    return true;
+}
+
+bool dither_engine::dither_push_row(const uint8_t *rgb_row) {
+    push_session_t *p = _push;
+    if (p == NULL || !p->ok || p->rows.y >= p->h) {
+        return false;
+    }
+    int y = p->rows.y;
+    dither_row(&p->rows, rgb_row);
+    p->ok = p->sink(p->user_ctx, y, p->rows.idx_row);
+    return p->ok;
+}
+
+bool dither_engine::dither_push_end() {
+    push_session_t *p = _push;
+    if (p == NULL) {
+        return false;
+    }
+    _push = NULL;
+    if (p->lock) {
+        xSemaphoreGive(p->lock);
+    }
+    bool ok = p->ok && p->rows.y == p->h;
+    if (p->ok && !ok) {
+        ESP_LOGW(TAG, "Push dither ended after %d of %d rows", p->rows.y, p->h);
+    }
+    row_state_free(&p->rows);
+    heap_caps_free(p);
+    return ok;
 }
 
 // ============================================================================
@@ -307,11 +1068,7 @@ int dither_engine::rgb888_to_sdcard_bmp(const char *filename, const uint8_t *rgb
         const uint8_t *src = rgb888 + src_row * width * 3;
 
         // Convert RGB888 -> BGR888
-        for (int x = 0; x < width; x++) {
-            row_buf[x * 3 + 0] = src[x * 3 + 2];  // B
-            row_buf[x * 3 + 1] = src[x * 3 + 1];  // G
-            row_buf[x * 3 + 2] = src[x * 3 + 0];  // R
-        }
+        pixel_swap_rb_row(src, row_buf, width);
         // Fill aligned bytes
         for (int p = width * 3; p < row_stride; p++) {
             row_buf[p] = 0;
@@ -2,7 +2,10 @@
 #define DITHER_ENGINE_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "dither_types.h"
 
 #pragma pack(push, 1)
@@ -29,11 +32,76 @@ typedef struct {
 } BITMAPINFOHEADER;
 #pragma pack(pop)
 
+// Quantised RGB -> palette index lookup table (5 bits per channel = 32x32x32 bins, 32 KB)
+// Set DITHER_PALETTE_LUT_BITS to 0 to fall back to the exact 6-color search for every pixel
+#ifndef DITHER_PALETTE_LUT_BITS
+#define DITHER_PALETTE_LUT_BITS 5
+#endif
+#define DITHER_PALETTE_LUT_SIZE (1 << (DITHER_PALETTE_LUT_BITS * 3))
+
+// Streaming dither callbacks
+// Source: fill rgb_row (width * 3 bytes, RGB888) with input row y, return false to abort
+// Sink:   consume index_row (width bytes, palette index 0-5 in config order) for row y
+typedef bool (*dither_row_source_t)(void *user_ctx, int y, uint8_t *rgb_row);
+typedef bool (*dither_row_sink_t)(void *user_ctx, int y, const uint8_t *index_row);
+
+// Packed 4bpp e-paper framebuffer target (the epd_blackImage used with Paint scale 6)
+// Pixels are stored as EPD_7IN3E_* codes, two per byte, even X in the high nibble.
+typedef struct {
+    uint8_t *image;             // Framebuffer, width_memory / 2 * height_memory bytes
+    int width_memory;           // Panel memory width in pixels (Paint.WidthMemory)
+    int height_memory;          // Panel memory height in pixels (Paint.HeightMemory)
+    int rotate;                 // Paint.Rotate: 0, 90, 180 or 270
+    int mirror;                 // Paint.Mirror: bit 0 horizontal, bit 1 vertical
+    SemaphoreHandle_t lock;     // Optional, held while the framebuffer is written
+} dither_epd_target_t;
+
 class dither_engine {
 private:
     dither_config_t _config;
+    uint8_t *_palette_lut = NULL;   // RGB -> palette index, built from the calibrated palette
+    bool _palette_lut_dirty = true; // Set when the calibrated palette changes
     int nearest_color_perceptual(uint8_t r, uint8_t g, uint8_t b);
 
+    // (Re)build the palette lookup table, only does work when the palette changed
+    void build_palette_lut();
+
+    // Palette index of a pixel, through the lookup table when available
+    inline int palette_index(uint8_t r, uint8_t g, uint8_t b) {
+#if DITHER_PALETTE_LUT_BITS > 0
+        if (_palette_lut) {
+            const int shift = 8 - DITHER_PALETTE_LUT_BITS;
+            return _palette_lut[((r >> shift) << (DITHER_PALETTE_LUT_BITS * 2)) |
+                                ((g >> shift) << DITHER_PALETTE_LUT_BITS) | (b >> shift)];
+        }
+#endif
+        return nearest_color_perceptual(r, g, b);
+    }
+
+    // Row window of one streaming pass (error ring or ordered offsets), see dither_engine.cpp
+    struct row_state_t;
+    bool row_state_init(row_state_t *s, int w, int y_begin);
+    void row_state_free(row_state_t *s);
+    void dither_row(row_state_t *s, const uint8_t *in_row);
+    bool stream_rows(int w, int y_begin, int y_end, dither_row_source_t source, dither_row_sink_t sink, void *user_ctx);
+
+    // Active dither_push_* session, NULL when none
+    struct push_session_t;
+    push_session_t *_push = NULL;
+
+    // Two-core dithering: ordered kernels split the frame into bands, the wavefront
+    // Floyd-Steinberg kernel interleaves rows with the odd rows trailing the even ones
+    struct parallel_job_t;      // Defined in dither_engine.cpp
+    static void parallel_helper_task(void *arg);
+    bool run_worker(parallel_job_t *job, int worker);
+    bool wavefront_rows(parallel_job_t *job, int worker);
+
+    // Same as dither_stream, but source/sink may be called for different rows from both cores at once.
+    // split_y is the band boundary for ordered kernels, interleave allows adjacent rows in flight together.
+    // Kernels without a parallel form (and single-core builds) run through dither_stream.
+    bool dither_stream_parallel(int w, int h, dither_row_source_t source, dither_row_sink_t sink, void *user_ctx,
+                                int split_y, bool interleave);
+
 public:
     dither_engine();
     ~dither_engine();
@@ -47,9 +115,32 @@ public:
     // Remember to release the outbuffer when the usage is completed
     void Jpeg_dec_buffer_free(uint8_t *outbuffer);
 
-    // Main dithering method (uses internal config)
+    // Main dithering method (uses internal config), in_img and out_img may be the same buffer
     void dither_rgb888(uint8_t *in_img, uint8_t *out_img, int w, int h);
 
+    // Streaming dither: pulls input rows from source and pushes palette index rows to sink.
+    // Only the kernel's 2-3 rows of int16 error accumulators are kept, no full-frame buffer.
+    // Rows are visited in order on the calling task, so callbacks need not be thread-safe.
+    // Returns false if allocation failed or a callback aborted.
+    bool dither_stream(int w, int h, dither_row_source_t source, dither_row_sink_t sink, void *user_ctx);
+
+    // Dither straight into a packed 4bpp e-paper framebuffer. Portrait images (h > w) are
+    // rotated 90 degrees CW like GUI_DirectDisplay_RGB888_6Color, and the target's Paint
+    // rotation/mirroring is applied in the same pass. Pixels outside the panel are clipped.
+    bool dither_stream_to_epd(int w, int h, dither_row_source_t source, void *user_ctx, const dither_epd_target_t *target);
+    bool dither_rgb888_to_epd(const uint8_t *in_img, int w, int h, const dither_epd_target_t *target);
+
+    // Push dithering: the caller hands over input rows in order (0..h-1) instead of a source
+    // callback pulling them, e.g. straight from a row decoder. Same output as dither_stream.
+    // Single-core only, one session per engine; the EPD variant holds target->lock until end.
+    bool dither_push_begin(int w, int h, dither_row_sink_t sink, void *user_ctx);
+    bool dither_push_begin_rgb888(int w, int h, uint8_t *out_img);
+    bool dither_push_begin_epd(int w, int h, const dither_epd_target_t *target);
+    // Dither one RGB888 row (w * 3 bytes), returns false once the sink aborted or h rows were pushed
+    bool dither_push_row(const uint8_t *rgb_row);
+    // Release the session, true if all h rows went through
+    bool dither_push_end();
+
     // Convert RGB888 to BMP and save to SD card
     int rgb888_to_sdcard_bmp(const char *filename, const uint8_t *rgb888, int width, int height);
 };
@@ -9,7 +9,10 @@ typedef enum {
     DITHER_FLOYD_STEINBERG = 0,
     DITHER_JARVIS,
     DITHER_STUCKI,
-    DITHER_SIERRA_2_4A
+    DITHER_SIERRA_2_4A,
+    DITHER_FLOYD_STEINBERG_WAVEFRONT,   // Floyd-Steinberg on both cores, left-to-right rows
+    DITHER_ORDERED_BAYER,               // 8x8 Bayer threshold matrix, bands on both cores
+    DITHER_BLUE_NOISE                   // 32x32 blue-noise threshold matrix, bands on both cores
 } dither_kernel_t;
 
 // Dithering configuration
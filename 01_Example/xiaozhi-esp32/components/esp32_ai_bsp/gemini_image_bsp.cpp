@@ -6,6 +6,9 @@
 #include "esp_timer.h"
 #include "sdcard_bsp.h"
 #include "pngle_scale.h"
+#include "pixel_kernels.h"
+#include "epaper_port.h"
+#include "epf_file.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -14,10 +17,10 @@
 typedef struct {
     int64_t api_request_us;
     int64_t base64_decode_us;
-    int64_t buffer_shrink_us;
     int64_t image_decode_us;
     int64_t resize_us;
     int64_t dither_us;
+    int64_t fused_us;           // PNG: decode, scale and dither as one streaming pass
     int64_t save_bmp_us;
     int64_t total_us;
     // File info
@@ -29,6 +32,7 @@ typedef struct {
     int target_width;
     int target_height;
     const char *image_format;
+    bool fused;                 // fused_us replaces the decode/resize/dither stages
 } image_gen_stats_t;
 
 
@@ -70,26 +74,6 @@ static bool model_supports_image_size(const char* model) {
 // Gemini API endpoint
 #define GEMINI_API_URL "https://generativelanguage.googleapis.com/v1beta/models/%s:generateContent?key=%s"
 
-// Base64 decode table
-const int8_t gemini_image_bsp::base64_decode_table[256] = {
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
-    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
-    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
-    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
-    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
-    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
-};
-
 gemini_image_bsp::gemini_image_bsp(const char *ai_model, const char *gemini_api_key, const int width, const int height) {
     _width        = width;
     _height       = height;
@@ -97,19 +81,15 @@ gemini_image_bsp::gemini_image_bsp(const char *ai_model, const char *gemini_api_
     _scale_mode   = SCALE_MODE_FILL;    // Default to fill (crop excess)
     model         = ai_model;
     api_key       = gemini_api_key;
-    // Allocate buffers in SPIRAM
+    // Allocate buffers in SPIRAM, floyd_buffer only once a result needs it (alloc_floyd_buffer())
     request_body  = (char *) heap_caps_malloc(4 * 1024, MALLOC_CAP_SPIRAM);
-    png_buffer    = (uint8_t *) heap_caps_malloc(width * height * 4, MALLOC_CAP_SPIRAM);  // RGBA
-    floyd_buffer  = (uint8_t *) heap_caps_malloc(width * height * 3, MALLOC_CAP_SPIRAM);  // RGB888
     assert(request_body);
-    assert(png_buffer);
-    assert(floyd_buffer);
 }
 
 gemini_image_bsp::~gemini_image_bsp() {
     if (request_body) heap_caps_free(request_body);
-    if (png_buffer) heap_caps_free(png_buffer);
     if (floyd_buffer) heap_caps_free(floyd_buffer);
+    if (epf_frame) heap_caps_free(epf_frame);
 }
 
 void gemini_image_bsp::set_AspectRatio(gemini_aspect_ratio_t ratio) {
@@ -126,17 +106,26 @@ void gemini_image_bsp::set_ScaleMode(scale_mode_t mode) {
     ESP_LOGI(TAG, "Scale mode set to: %s", mode == SCALE_MODE_FILL ? "fill (crop excess)" : "fit (pad with white)");
 }
 
+void gemini_image_bsp::set_EpdTarget(const dither_epd_target_t *target) {
+    if (target == NULL || target->image == NULL) {
+        _has_epd_target = false;
+        ESP_LOGI(TAG, "E-paper framebuffer target cleared");
+        return;
+    }
+    _epd_target = *target;
+    _has_epd_target = true;
+    ESP_LOGI(TAG, "E-paper framebuffer target set: %dx%d, rotate=%d, mirror=%d",
+             target->width_memory, target->height_memory, target->rotate, target->mirror);
+}
+
 scale_mode_t gemini_image_bsp::get_ScaleMode() const {
     return _scale_mode;
 }
 
-// Dynamic response buffer allocation
-// Will allocate based on available SPIRAM, leaving 512KB for other operations
-#define MIN_RESPONSE_BUFFER_SIZE (2 * 1024 * 1024)  // 2MB minimum
-#define SPIRAM_RESERVE_SIZE (512 * 1024)  // Keep 512KB free for other ops
-
-// Store actual allocated buffer size for overflow checking
-static size_t g_response_buffer_size = 0;
+// Decoded image bytes are handed to the PNG decoder in blocks of this size
+#define IMAGE_DECODE_BLOCK_SIZE 4096
+// First JPEG collection buffer, doubled whenever it fills up
+#define JPEG_INITIAL_CAPACITY (256 * 1024)
 
 int gemini_image_bsp::_http_event_handler(esp_http_client_event_t *evt) {
     gemini_http_response_t *resp = (gemini_http_response_t *) evt->user_data;
@@ -170,45 +159,21 @@ int gemini_image_bsp::_http_event_handler(esp_http_client_event_t *evt) {
                          chunk_count, evt->data_len, total_received);
             }
 
-            // Pre-allocate buffer on first data chunk based on available memory
-            if (resp->buffer == NULL) {
-                ESP_LOGD(TAG, "[HTTP] First chunk - allocating buffer...");
-                size_t free_spiram = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
-                size_t alloc_size = free_spiram > SPIRAM_RESERVE_SIZE ?
-                                    free_spiram - SPIRAM_RESERVE_SIZE : 0;
-
-                ESP_LOGD(TAG, "[HTTP] Free SPIRAM block: %zu, alloc_size: %zu", free_spiram, alloc_size);
-
-                if (alloc_size < MIN_RESPONSE_BUFFER_SIZE) {
-                    ESP_LOGE(TAG, "Not enough SPIRAM: %zu available, need %d",
-                             free_spiram, MIN_RESPONSE_BUFFER_SIZE);
-                    return ESP_FAIL;
-                }
-
-                resp->buffer = (char *) heap_caps_malloc(alloc_size, MALLOC_CAP_SPIRAM);
-                if (resp->buffer == NULL) {
-                    ESP_LOGE(TAG, "Failed to allocate response buffer (%zu bytes)", alloc_size);
-                    return ESP_FAIL;
-                }
-                resp->buffer_len = 0;
-                g_response_buffer_size = alloc_size;
-                ESP_LOGD(TAG, "Allocated %zu bytes for response buffer (free: %zu)",
-                         alloc_size, free_spiram);
+            // Only the start of the body is kept, for the preview and error responses
+            int room = (int)sizeof(resp->preview) - 1 - resp->preview_len;
+            if (room > 0) {
+                int copy_len = evt->data_len < room ? evt->data_len : room;
+                memcpy(resp->preview + resp->preview_len, evt->data, copy_len);
+                resp->preview_len += copy_len;
+                resp->preview[resp->preview_len] = '\0';
             }
+            resp->body_len += evt->data_len;
+            total_received = resp->body_len;
 
-            int copy_len = evt->data_len;
-            // Check if we have enough space
-            if (resp->buffer_len + copy_len >= g_response_buffer_size) {
-                ESP_LOGE(TAG, "Response buffer overflow (%d + %d >= %zu), truncating",
-                         resp->buffer_len, copy_len, g_response_buffer_size);
-                copy_len = g_response_buffer_size - resp->buffer_len - 1;
-                if (copy_len <= 0) return ESP_OK;
-            }
-
-            memcpy(resp->buffer + resp->buffer_len, evt->data, copy_len);
-            resp->buffer_len += copy_len;
-            resp->buffer[resp->buffer_len] = '\0';
-            total_received = resp->buffer_len;
+            // Decode inlineData.data while it downloads; after an error the parser ignores the rest
+            int64_t start_time = esp_timer_get_time();
+            inline_data_parser_feed(&resp->parser, (const char *) evt->data, evt->data_len);
+            resp->handler_us += esp_timer_get_time() - start_time;
         }
         break;
     case HTTP_EVENT_ON_FINISH:
@@ -224,32 +189,123 @@ int gemini_image_bsp::_http_event_handler(esp_http_client_event_t *evt) {
     return ESP_OK;
 }
 
-int gemini_image_bsp::base64_decode(const char *input, size_t input_len, uint8_t *output, size_t *output_len) {
-    size_t out_idx = 0;
-    uint32_t accum = 0;
-    int bits = 0;
+// pngle_scale row consumer: every scaled row goes straight into the push ditherer
+static int fused_dither_row(void *user_ctx, int y, const uint8_t *rgb_row) {
+    (void)y;
+    dither_engine *engine = (dither_engine *)user_ctx;
+    return engine->dither_push_row(rgb_row) ? 0 : 1;
+}
+
+int gemini_image_bsp::_image_sink(void *user_ctx, const uint8_t *data, size_t len) {
+    gemini_http_response_t *resp = (gemini_http_response_t *) user_ctx;
+    int64_t start_time = esp_timer_get_time();
+    int ret = resp->owner->stream_image_bytes(resp, data, len);
+    resp->image_us += esp_timer_get_time() - start_time;
+    return ret;
+}
 
-    for (size_t i = 0; i < input_len; i++) {
-        char c = input[i];
-        if (c == '=' || c == '\n' || c == '\r' || c == ' ') continue;
+int gemini_image_bsp::stream_image_bytes(gemini_http_response_t *resp, const uint8_t *data, size_t len) {
+    if (resp->format == GEMINI_IMAGE_PENDING) {
+        // Debug: Show first 16 bytes of decoded data (magic bytes)
+        if (len >= 16) {
+            ESP_LOGI(TAG, "First 16 bytes: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X",
+                     data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7],
+                     data[8], data[9], data[10], data[11], data[12], data[13], data[14], data[15]);
+        }
 
-        int8_t val = base64_decode_table[(uint8_t)c];
-        if (val < 0) {
-            ESP_LOGE(TAG, "Invalid base64 character: %c", c);
+        // Check if it's PNG or JPEG based on magic bytes
+        bool is_png = (len > 8 && data[0] == 0x89 && data[1] == 0x50);
+        bool is_jpeg = (len > 2 && data[0] == 0xFF && data[1] == 0xD8);
+        ESP_LOGI(TAG, "Image format detection: %s (is_png=%d, is_jpeg=%d)",
+                 is_jpeg ? "JPEG" : (is_png ? "PNG" : "Unknown"), is_png, is_jpeg);
+
+        if (is_png) {
+            // Decoded rows go through the scaler straight into the ditherer, so neither the
+            // PNG file, the full-size RGB frame nor a resized copy is ever allocated
+            if (resp->epd == NULL && !alloc_floyd_buffer()) {
+                return -1;
+            }
+            bool started = resp->epd ? dither_push_begin_epd(resp->target_w, resp->target_h, resp->epd)
+                                     : dither_push_begin_rgb888(resp->target_w, resp->target_h, floyd_buffer);
+            if (!started) {
+                return -1;
+            }
+            resp->push_started = true;
+
+            // FIT pads with white, the same as resize_nearest_rgb888 for JPEG
+            pngle_scale_mode_t pngle_mode = (_scale_mode == SCALE_MODE_FILL) ? PNGLE_SCALE_FILL : PNGLE_SCALE_FIT;
+            resp->png = pngle_scale_stream_new(resp->target_w, resp->target_h, pngle_mode, 255,
+                                               fused_dither_row, static_cast<dither_engine *>(this));
+            if (resp->png == NULL) {
+                ESP_LOGE(TAG, "Failed to create PNG decode stream");
+                return -1;
+            }
+            resp->format = GEMINI_IMAGE_PNG;
+            ESP_LOGI(TAG, "Decoding PNG during download, fused with scale + dither (target: %dx%d%s)...",
+                     resp->target_w, resp->target_h, resp->epd ? ", e-paper framebuffer" : "");
+        } else if (is_jpeg) {
+            // JPEG still decodes in one piece, so collect the file
+            resp->jpeg_data = (uint8_t *) heap_caps_malloc(JPEG_INITIAL_CAPACITY, MALLOC_CAP_SPIRAM);
+            if (resp->jpeg_data == NULL) {
+                ESP_LOGE(TAG, "Failed to allocate JPEG buffer (%d bytes)", JPEG_INITIAL_CAPACITY);
+                return -1;
+            }
+            resp->jpeg_cap = JPEG_INITIAL_CAPACITY;
+            resp->format = GEMINI_IMAGE_JPEG;
+        } else {
+            ESP_LOGE(TAG, "Unknown image format (not PNG 0x89 0x50 or JPEG 0xFF 0xD8)");
+            resp->format = GEMINI_IMAGE_UNKNOWN;
             return -1;
         }
+    }
 
-        accum = (accum << 6) | val;
-        bits += 6;
+    if (resp->format == GEMINI_IMAGE_PNG) {
+        int err = pngle_scale_stream_feed(resp->png, data, len);
+        if (err != PNGLE_SCALE_OK) {
+            ESP_LOGE(TAG, "pngle decode failed: %s", pngle_scale_error_text(err));
+            return -1;
+        }
+        return 0;
+    }
 
-        if (bits >= 8) {
-            bits -= 8;
-            output[out_idx++] = (accum >> bits) & 0xFF;
+    if (resp->format == GEMINI_IMAGE_JPEG) {
+        if (resp->jpeg_len + len > resp->jpeg_cap) {
+            size_t new_cap = resp->jpeg_cap * 2;
+            while (resp->jpeg_len + len > new_cap) {
+                new_cap *= 2;
+            }
+            uint8_t *grown = (uint8_t *) heap_caps_realloc(resp->jpeg_data, new_cap, MALLOC_CAP_SPIRAM);
+            if (grown == NULL) {
+                ESP_LOGE(TAG, "Failed to grow JPEG buffer to %zu bytes", new_cap);
+                return -1;
+            }
+            resp->jpeg_data = grown;
+            resp->jpeg_cap = new_cap;
         }
+        memcpy(resp->jpeg_data + resp->jpeg_len, data, len);
+        resp->jpeg_len += len;
+        return 0;
     }
+    return -1;
+}
 
-    *output_len = out_idx;
-    return 0;
+void gemini_image_bsp::release_response(gemini_http_response_t *resp) {
+    if (resp->png) {
+        pngle_scale_stream_free(resp->png);
+        resp->png = NULL;
+    }
+    if (resp->push_started) {
+        dither_push_end();
+        resp->push_started = false;
+    }
+    if (resp->jpeg_data) {
+        heap_caps_free(resp->jpeg_data);
+        resp->jpeg_data = NULL;
+    }
+    if (resp->decode_block) {
+        heap_caps_free(resp->decode_block);
+        resp->decode_block = NULL;
+    }
 }
 
 // Helper for resizing image with aspect ratio preservation
@@ -284,23 +340,33 @@ static void resize_nearest_rgb888(const uint8_t* src, int src_w, int src_h,
                  src_w, src_h, scaled_w, scaled_h, crop_x, crop_y, dst_w, dst_h);
 
         // Sample from source with cropping
+        uint16_t *x_index = (uint16_t *) heap_caps_malloc(dst_w * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (x_index == NULL) {
+            ESP_LOGE("resize", "Failed to allocate column table (%d bytes)", dst_w * (int)sizeof(uint16_t));
+            return;
+        }
+        // Source column of each destination column, shared by every row
+        for (int x = 0; x < dst_w; x++) {
+            int src_x = (x + crop_x) * src_w / scaled_w;
+            x_index[x] = src_x >= src_w ? src_w - 1 : src_x;
+        }
+
+        int prev_src_y = -1;
         for (int y = 0; y < dst_h; y++) {
             int scaled_y = y + crop_y;
             int src_y = scaled_y * src_h / scaled_h;
             if (src_y >= src_h) src_y = src_h - 1;
 
-            for (int x = 0; x < dst_w; x++) {
-                int scaled_x = x + crop_x;
-                int src_x = scaled_x * src_w / scaled_w;
-                if (src_x >= src_w) src_x = src_w - 1;
-
-                int src_idx = (src_y * src_w + src_x) * 3;
-                int dst_idx = (y * dst_w + x) * 3;
-                dst[dst_idx + 0] = src[src_idx + 0];
-                dst[dst_idx + 1] = src[src_idx + 1];
-                dst[dst_idx + 2] = src[src_idx + 2];
+            uint8_t *dst_row = dst + y * dst_w * 3;
+            if (src_y == prev_src_y) {
+                // Upscaled rows repeat the previous output row
+                memcpy(dst_row, dst_row - dst_w * 3, dst_w * 3);
+            } else {
+                pixel_resample_row(src + src_y * src_w * 3, x_index, dst_row, dst_w);
             }
+            prev_src_y = src_y;
         }
+        heap_caps_free(x_index);
     } else {
         // Fit mode: scale to fit within target, pad with white
         if (src_aspect > dst_aspect) {
@@ -322,32 +388,41 @@ static void resize_nearest_rgb888(const uint8_t* src, int src_w, int src_h,
         memset(dst, 255, dst_w * dst_h * 3);
 
         // Sample from source and place at offset
+        uint16_t *x_index = (uint16_t *) heap_caps_malloc(scaled_w * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (x_index == NULL) {
+            ESP_LOGE("resize", "Failed to allocate column table (%d bytes)", scaled_w * (int)sizeof(uint16_t));
+            return;
+        }
+        for (int x = 0; x < scaled_w; x++) {
+            int src_x = x * src_w / scaled_w;
+            x_index[x] = src_x >= src_w ? src_w - 1 : src_x;
+        }
+
+        int prev_src_y = -1;
         for (int y = 0; y < scaled_h; y++) {
             int src_y = y * src_h / scaled_h;
             if (src_y >= src_h) src_y = src_h - 1;
             int dst_y = y + offset_y;
 
-            for (int x = 0; x < scaled_w; x++) {
-                int src_x = x * src_w / scaled_w;
-                if (src_x >= src_w) src_x = src_w - 1;
-                int dst_x = x + offset_x;
-
-                int src_idx = (src_y * src_w + src_x) * 3;
-                int dst_idx = (dst_y * dst_w + dst_x) * 3;
-                dst[dst_idx + 0] = src[src_idx + 0];
-                dst[dst_idx + 1] = src[src_idx + 1];
-                dst[dst_idx + 2] = src[src_idx + 2];
+            uint8_t *dst_row = dst + (dst_y * dst_w + offset_x) * 3;
+            if (src_y == prev_src_y) {
+                memcpy(dst_row, dst_row - dst_w * 3, scaled_w * 3);
+            } else {
+                pixel_resample_row(src + src_y * src_w * 3, x_index, dst_row, scaled_w);
             }
+            prev_src_y = src_y;
         }
+        heap_caps_free(x_index);
     }
 }
 
 const char* gemini_image_bsp::gemini_generate_image(bool skip_sd_save) {
-    gemini_http_response_t response = {0};
+    gemini_http_response_t response = {};
     image_gen_stats_t stats = {0};
     int64_t start_time, end_time, total_start_time;
 
     total_start_time = esp_timer_get_time();
+    _epd_written = false;
 
     // Debug: Show available memory before starting
     ESP_LOGI(TAG, "=== Starting Gemini Image Generation ===");
@@ -355,21 +430,61 @@ const char* gemini_image_bsp::gemini_generate_image(bool skip_sd_save) {
     ESP_LOGI(TAG, "Free internal: %d bytes", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
     ESP_LOGI(TAG, "Largest SPIRAM block: %d bytes", heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
 
-    // Temporarily free pre-allocated buffers to maximize memory for API response
-    // This gives us an extra ~2.6MB of SPIRAM for the response buffer
-    if (png_buffer) {
-        heap_caps_free(png_buffer);
-        png_buffer = NULL;
-        ESP_LOGI(TAG, "Freed png_buffer to increase response buffer capacity");
+    // Target size - swap dimensions for portrait mode
+    int target_w, target_h;
+    if (_aspect_ratio == ASPECT_RATIO_9_16) {
+        // Portrait mode: swap width and height
+        target_w = _height;  // 480
+        target_h = _width;   // 800
+    } else {
+        // Landscape mode: use original dimensions
+        target_w = _width;   // 800
+        target_h = _height;  // 480
     }
+    stats.target_width = target_w;
+    stats.target_height = target_h;
+
+    // With a framebuffer target the result is dithered straight into packed 4bpp in epf_frame,
+    // then saved as an EPF file or, for direct display, copied into the panel framebuffer once
+    // decoding has succeeded, so the framebuffer lock is not held through the download and a
+    // failed download leaves the displayed frame intact.
+    // Otherwise the 6-color RGB888 result lands in floyd_buffer and is saved as BMP
+    dither_epd_target_t save_target;
+    const dither_epd_target_t *epd = NULL;
+    if (_has_epd_target && alloc_epf_frame()) {
+        save_target = _epd_target;
+        save_target.image = epf_frame;
+        save_target.lock = NULL;
+        memset(epf_frame, (EPD_7IN3E_WHITE << 4) | EPD_7IN3E_WHITE,
+               (_epd_target.width_memory + 1) / 2 * _epd_target.height_memory);
+        epd = &save_target;
+    }
+    bool to_epd = (epd != NULL);
+
+    // Release the previous result while the response streams in
+    // floyd_buffer comes back once the image format is known (PNG) or before resizing (JPEG)
     if (floyd_buffer) {
         heap_caps_free(floyd_buffer);
         floyd_buffer = NULL;
-        ESP_LOGI(TAG, "Freed floyd_buffer to increase response buffer capacity");
+        ESP_LOGI(TAG, "Freed floyd_buffer until the image format is known");
     }
     ESP_LOGI(TAG, "After freeing buffers - Largest SPIRAM block: %d bytes",
              heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
 
+    // The response body is parsed as it arrives: inlineData.data is base64-decoded into a
+    // small block and handed to the PNG decoder, so the JSON itself is never buffered
+    response.owner = this;
+    response.target_w = target_w;
+    response.target_h = target_h;
+    response.epd = epd;
+    response.decode_block = (uint8_t *) heap_caps_malloc(IMAGE_DECODE_BLOCK_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (response.decode_block == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate decode block (%d bytes)", IMAGE_DECODE_BLOCK_SIZE);
+        return NULL;
+    }
+    inline_data_parser_init(&response.parser, response.decode_block, IMAGE_DECODE_BLOCK_SIZE,
+                            _image_sink, &response);
+
     // Build full URL with model and API key
     char url[512];
     snprintf(url, sizeof(url), GEMINI_API_URL, model, api_key);
@@ -393,7 +508,7 @@ const char* gemini_image_bsp::gemini_generate_image(bool skip_sd_save) {
     ESP_LOGI(TAG, "Request body (%d bytes):", strlen(request_body));
     printf("%s\n", request_body);
 
-    // === TIMING: API Request ===
+    // === TIMING: API Request (includes the overlapped base64 and PNG decode) ===
     ESP_LOGI(TAG, "[DEBUG] >>> Starting HTTP perform...");
     ESP_LOGI(TAG, "[DEBUG] Free heap: internal=%d, SPIRAM=%d",
              heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
@@ -411,172 +526,106 @@ const char* gemini_image_bsp::gemini_generate_image(bool skip_sd_save) {
     stats.api_request_us = end_time - start_time;
     ESP_LOGI(TAG, "[TIMING] API request: %lld ms", stats.api_request_us / 1000);
 
-    ESP_LOGI(TAG, "[DEBUG] Response buffer: %p, len: %d",
-             response.buffer, response.buffer_len);
+    ESP_LOGI(TAG, "[DEBUG] Response body: %zu bytes, decoded image: %zu bytes",
+             response.body_len, response.parser.decoded_len);
 
     esp_http_client_cleanup(client);
     ESP_LOGI(TAG, "[DEBUG] HTTP client cleaned up");
 
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Gemini request failed: %s", esp_err_to_name(err));
-        heap_caps_free(response.buffer);
+        release_response(&response);
         return NULL;
     }
 
     if (status_code != 200) {
         ESP_LOGE(TAG, "Gemini API error, status: %d", status_code);
-        ESP_LOGE(TAG, "Response: %s", response.buffer ? response.buffer : "NULL");
-        heap_caps_free(response.buffer);
+        ESP_LOGE(TAG, "Response: %s", response.preview_len > 0 ? response.preview : "NULL");
+        release_response(&response);
         return NULL;
     }
 
-    ESP_LOGI(TAG, "Gemini response received, parsing manually (buffer size: %d)...", response.buffer_len);
-    ESP_LOGI(TAG, "Free SPIRAM after response: %d bytes", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    ESP_LOGI(TAG, "Gemini response received (%zu bytes), image decoded while streaming", response.body_len);
 
     // Debug: Print first 200 chars of response to see structure
-    if (response.buffer_len > 0) {
-        char debug_buf[201];
-        size_t copy_len = response.buffer_len < 200 ? response.buffer_len : 200;
-        memcpy(debug_buf, response.buffer, copy_len);
-        debug_buf[copy_len] = '\0';
-        ESP_LOGI(TAG, "Response preview: %s", debug_buf);
+    if (response.preview_len > 0) {
+        ESP_LOGI(TAG, "Response preview: %.200s", response.preview);
     }
 
-    // Manual JSON parsing to avoid ArduinoJson memory issues
     // Response format: { "candidates": [{ "content": { "parts": [{ "inlineData": { "mimeType": "image/png", "data": "base64..." }}]}}]}
-
-    // Find "inlineData" section
-    const char *inline_data = strstr(response.buffer, "\"inlineData\"");
-    if (inline_data == NULL) {
-        ESP_LOGE(TAG, "No inlineData in response");
-        heap_caps_free(response.buffer);
+    int parse_err = inline_data_parser_finish(&response.parser);
+    stats.base64_len = response.parser.b64.chars;
+    stats.decoded_file_size = response.parser.decoded_len;
+    stats.image_format = response.format == GEMINI_IMAGE_JPEG ? "JPEG" :
+                         (response.format == GEMINI_IMAGE_PNG ? "PNG" : "Unknown");
+    ESP_LOGI(TAG, "Image received, MIME type: %s", response.parser.mime_type);
+    if (parse_err != INLINE_DATA_OK) {
+        ESP_LOGE(TAG, "Image extraction failed: %s", inline_data_error_text(parse_err));
+        release_response(&response);
         return NULL;
     }
+    heap_caps_free(response.decode_block);
+    response.decode_block = NULL;
 
-    // Find mimeType within inlineData
-    const char *mime_start = strstr(inline_data, "\"mimeType\"");
-    char mime_type_str[32] = "unknown";
-    if (mime_start != NULL) {
-        mime_start = strchr(mime_start + 10, '"');  // Skip to value
-        if (mime_start != NULL) {
-            mime_start++;  // Skip opening quote
-            const char *mime_end = strchr(mime_start, '"');
-            if (mime_end != NULL) {
-                size_t mime_len = mime_end - mime_start;
-                if (mime_len < sizeof(mime_type_str)) {
-                    memcpy(mime_type_str, mime_start, mime_len);
-                    mime_type_str[mime_len] = '\0';
-                }
-            }
-        }
-    }
-    ESP_LOGI(TAG, "Image received, MIME type: %s", mime_type_str);
-
-    // Find "data" field - search for "data":" pattern
-    const char *data_key = strstr(inline_data, "\"data\"");
-    if (data_key == NULL) {
-        ESP_LOGE(TAG, "No data field in inlineData");
-        heap_caps_free(response.buffer);
-        return NULL;
-    }
-
-    // Find the colon and opening quote
-    const char *data_start = strchr(data_key + 6, '"');
-    if (data_start == NULL) {
-        ESP_LOGE(TAG, "Malformed data field");
-        heap_caps_free(response.buffer);
-        return NULL;
-    }
-    data_start++;  // Skip opening quote
-
-    // Find the closing quote for base64 data
-    const char *data_end = strchr(data_start, '"');
-    if (data_end == NULL) {
-        ESP_LOGE(TAG, "No closing quote for data");
-        heap_caps_free(response.buffer);
+    if (response.format != GEMINI_IMAGE_PNG && response.format != GEMINI_IMAGE_JPEG) {
+        ESP_LOGE(TAG, "Unknown image format (not PNG 0x89 0x50 or JPEG 0xFF 0xD8)");
+        release_response(&response);
         return NULL;
     }
 
-    size_t base64_len = data_end - data_start;
-    stats.base64_len = base64_len;
-    ESP_LOGI(TAG, "Found base64 data, length: %zu", base64_len);
-
-    // === TIMING: Base64 Decode ===
-    start_time = esp_timer_get_time();
-
-    // Decode base64 in-place into the response buffer to save memory
-    // This is safe because base64 decodes to 3/4 the size, so the write position
-    // (starting at buffer[0]) will never catch up with the read position (data_start)
-    size_t decoded_len = 0;
-    uint8_t *decoded_buffer = (uint8_t *) response.buffer;  // Reuse response buffer
+    // Base64 decoding ran inside the HTTP handler, minus the time the image consumer took
+    stats.base64_decode_us = response.handler_us - response.image_us;
+    ESP_LOGI(TAG, "[TIMING] Base64 decode (during download): %lld ms", stats.base64_decode_us / 1000);
+    const base64_stream_t *b64 = &response.parser.b64;
+    ESP_LOGI(TAG, "Base64 stats: %zu chars (%zu on fast path), %zu whitespace, %zu padding",
+             b64->chars, b64->fast_chars, b64->whitespace, b64->padding);
+    ESP_LOGI(TAG, "Decoded image size: %zu bytes (streamed), base64 length: %zu",
+             stats.decoded_file_size, stats.base64_len);
 
-    if (base64_decode(data_start, base64_len, decoded_buffer, &decoded_len) != 0) {
-        ESP_LOGE(TAG, "Base64 decode failed");
-        heap_caps_free(response.buffer);
-        return NULL;
-    }
-
-    end_time = esp_timer_get_time();
-    stats.base64_decode_us = end_time - start_time;
-    stats.decoded_file_size = decoded_len;
-    ESP_LOGI(TAG, "[TIMING] Base64 decode: %lld ms", stats.base64_decode_us / 1000);
-    ESP_LOGI(TAG, "Decoded image size: %zu bytes (in-place)", decoded_len);
-
-    // Debug: Show first 16 bytes of decoded data (magic bytes)
-    if (decoded_len >= 16) {
-        ESP_LOGI(TAG, "First 16 bytes: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X",
-                 decoded_buffer[0], decoded_buffer[1], decoded_buffer[2], decoded_buffer[3],
-                 decoded_buffer[4], decoded_buffer[5], decoded_buffer[6], decoded_buffer[7],
-                 decoded_buffer[8], decoded_buffer[9], decoded_buffer[10], decoded_buffer[11],
-                 decoded_buffer[12], decoded_buffer[13], decoded_buffer[14], decoded_buffer[15]);
-    }
-
-    // Check if it's PNG or JPEG based on magic bytes
-    bool is_png = (decoded_len > 8 && decoded_buffer[0] == 0x89 && decoded_buffer[1] == 0x50);
-    bool is_jpeg = (decoded_len > 2 && decoded_buffer[0] == 0xFF && decoded_buffer[1] == 0xD8);
-    stats.image_format = is_jpeg ? "JPEG" : (is_png ? "PNG" : "Unknown");
-    ESP_LOGI(TAG, "Image format detection: %s (is_png=%d, is_jpeg=%d)", stats.image_format, is_png, is_jpeg);
-
-    // === TIMING: Buffer Relocation ===
-    start_time = esp_timer_get_time();
+    if (response.format == GEMINI_IMAGE_PNG) {
+        // === TIMING: Fused PNG Decode + Scale + Dither ===
+        // Most of it already ran during the download, only the trailing rows are left
+        start_time = esp_timer_get_time();
+        pngle_scale_result_t result;
+        int png_err = pngle_scale_stream_finish(response.png, &result);
+        response.png = NULL;
+        bool dithered = dither_push_end();
+        response.push_started = false;
+        end_time = esp_timer_get_time();
 
-    // IMPORTANT: Don't use realloc to shrink - it causes memory fragmentation!
-    // Instead: allocate new smaller buffer, copy data, then free the large buffer.
-    // This ensures the original 4MB block is freed as one contiguous piece.
-    uint8_t *new_buffer = (uint8_t *) heap_caps_malloc(decoded_len, MALLOC_CAP_SPIRAM);
-    if (new_buffer != NULL) {
-        memcpy(new_buffer, decoded_buffer, decoded_len);
-        heap_caps_free(response.buffer);  // Free the large 4MB buffer completely
-        decoded_buffer = new_buffer;
-        ESP_LOGI(TAG, "Relocated PNG data: freed %zu bytes, allocated %zu bytes (defragmented)",
-                 g_response_buffer_size, decoded_len);
-    } else {
-        // Fallback: try realloc if new allocation fails
-        ESP_LOGW(TAG, "New buffer allocation failed, trying realloc (may fragment)");
-        uint8_t *shrunk_buffer = (uint8_t *) heap_caps_realloc(response.buffer, decoded_len, MALLOC_CAP_SPIRAM);
-        if (shrunk_buffer != NULL) {
-            decoded_buffer = shrunk_buffer;
-        } else {
-            decoded_buffer = (uint8_t *) response.buffer;
+        if (png_err != PNGLE_SCALE_OK) {
+            ESP_LOGE(TAG, "pngle decode failed: %s", pngle_scale_error_text(png_err));
+            return NULL;
         }
-    }
-    response.buffer = NULL;  // Ownership transferred to decoded_buffer
-
-    end_time = esp_timer_get_time();
-    stats.buffer_shrink_us = end_time - start_time;
-    ESP_LOGI(TAG, "[TIMING] Buffer relocation: %lld ms", stats.buffer_shrink_us / 1000);
-
-    uint8_t *rgb_buffer = NULL;
-    int rgb_len = 0;
-    int img_w = 0;
-    int img_h = 0;
+        if (!dithered) {
+            ESP_LOGE(TAG, "Dithering of decoded PNG rows failed");
+            return NULL;
+        }
+        stats.original_width = result.original_width;
+        stats.original_height = result.original_height;
+        ESP_LOGI(TAG, "PNG decoded: %dx%d -> %dx%d (fused)",
+                 result.original_width, result.original_height, result.width, result.height);
+
+        stats.fused = true;
+        stats.fused_us = response.image_us + (end_time - start_time);
+        ESP_LOGI(TAG, "[TIMING] PNG decode + scale + dither (fused, during download): %lld ms", stats.fused_us / 1000);
+        ESP_LOGI(TAG, "Free SPIRAM after fused decode: %d bytes (largest block: %d)",
+                 heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+                 heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+    } else {
+        // JPEG was only collected during the download
+        uint8_t *decoded_buffer = response.jpeg_data;
+        size_t decoded_len = response.jpeg_len;
+        response.jpeg_data = NULL;
 
-    ESP_LOGI(TAG, "Free SPIRAM before image decode: %d bytes", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+        uint8_t *rgb_buffer = NULL;
+        int rgb_len = 0;
+        int img_w = 0;
+        int img_h = 0;
 
-    // === TIMING: Image Decode ===
-    start_time = esp_timer_get_time();
+        // === TIMING: Image Decode ===
+        start_time = esp_timer_get_time();
 
-    if (is_jpeg) {
         ESP_LOGI(TAG, "Decoding JPEG image (size: %zu bytes)...", decoded_len);
         // Jpeg_decode returns 1 on success, 0 on failure
         int jpeg_result = Jpeg_decode(decoded_buffer, decoded_len, &rgb_buffer, &rgb_len, &img_w, &img_h);
@@ -586,111 +635,119 @@ const char* gemini_image_bsp::gemini_generate_image(bool skip_sd_save) {
             heap_caps_free(decoded_buffer);
             return NULL;
         }
-    } else if (is_png) {
-        ESP_LOGI(TAG, "Decoding PNG image (size: %zu bytes)...", decoded_len);
-        int png_result = png_to_rgb888(decoded_buffer, decoded_len, &rgb_buffer, &rgb_len, &img_w, &img_h);
-        ESP_LOGI(TAG, "PNG decode result: %d, rgb_len: %d, size: %dx%d", png_result, rgb_len, img_w, img_h);
-        if (png_result == 0) {
-            ESP_LOGE(TAG, "PNG decode failed");
-            heap_caps_free(decoded_buffer);
+
+        end_time = esp_timer_get_time();
+        stats.image_decode_us = end_time - start_time;
+        stats.original_width = img_w;
+        stats.original_height = img_h;
+        stats.rgb_buffer_size = rgb_len;
+        ESP_LOGI(TAG, "[TIMING] Image decode (%s): %lld ms", stats.image_format, stats.image_decode_us / 1000);
+
+        ESP_LOGI(TAG, "Image decoded to RGB, size: %d bytes", rgb_len);
+        ESP_LOGI(TAG, "Free SPIRAM after image decode: %d bytes", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+        heap_caps_free(decoded_buffer);
+
+        // Resize logic
+        uint8_t *dither_input = rgb_buffer;
+        bool used_internal_resize = false;
+
+        bool need_resize = (img_w != target_w || img_h != target_h);
+
+        // Re-allocate floyd_buffer now that the JPEG has been decoded
+        // In e-paper mode it is only needed as the resize destination
+        if ((!to_epd || need_resize) && !alloc_floyd_buffer()) {
+            Jpeg_dec_buffer_free(rgb_buffer);
             return NULL;
         }
-    } else {
-        ESP_LOGE(TAG, "Unknown image format (not PNG 0x89 0x50 or JPEG 0xFF 0xD8)");
-        heap_caps_free(decoded_buffer);
-        return NULL;
-    }
 
-    end_time = esp_timer_get_time();
-    stats.image_decode_us = end_time - start_time;
-    stats.original_width = img_w;
-    stats.original_height = img_h;
-    stats.rgb_buffer_size = rgb_len;
-    ESP_LOGI(TAG, "[TIMING] Image decode (%s): %lld ms", stats.image_format, stats.image_decode_us / 1000);
-
-    ESP_LOGI(TAG, "Image decoded to RGB, size: %d bytes", rgb_len);
-    ESP_LOGI(TAG, "Free SPIRAM after image decode: %d bytes", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
-    heap_caps_free(decoded_buffer);
-
-    // Re-allocate floyd_buffer now that response buffer is freed
-    // This buffer is needed for resize and dithering operations
-    floyd_buffer = (uint8_t *) heap_caps_malloc(_width * _height * 3, MALLOC_CAP_SPIRAM);
-    if (floyd_buffer == NULL) {
-        ESP_LOGE(TAG, "Failed to re-allocate floyd_buffer (%d bytes)", _width * _height * 3);
-        if (is_jpeg) Jpeg_dec_buffer_free(rgb_buffer);
-        else heap_caps_free(rgb_buffer);
-        return NULL;
-    }
-    ESP_LOGI(TAG, "Re-allocated floyd_buffer: %d bytes", _width * _height * 3);
+        // === TIMING: Resize ===
+        start_time = esp_timer_get_time();
 
-    // Resize logic - swap dimensions for portrait mode
-    uint8_t *dither_input = rgb_buffer;
-    bool used_internal_resize = false;
-    int target_w, target_h;
-    if (_aspect_ratio == ASPECT_RATIO_9_16) {
-        // Portrait mode: swap width and height
-        target_w = _height;  // 480
-        target_h = _width;   // 800
-    } else {
-        // Landscape mode: use original dimensions
-        target_w = _width;   // 800
-        target_h = _height;  // 480
-    }
-    stats.target_width = target_w;
-    stats.target_height = target_h;
+        if (need_resize) {
+            ESP_LOGI(TAG, "Resizing image from %dx%d to %dx%d (scale_mode=%s)",
+                     img_w, img_h, target_w, target_h,
+                     _scale_mode == SCALE_MODE_FIT ? "fit" : "fill");
+            resize_nearest_rgb888(rgb_buffer, img_w, img_h, floyd_buffer, target_w, target_h, _scale_mode);
 
-    // === TIMING: Resize ===
-    start_time = esp_timer_get_time();
+            // Free original buffer
+            Jpeg_dec_buffer_free(rgb_buffer);
+
+            dither_input = floyd_buffer;
+            used_internal_resize = true;
 
-    if (img_w != target_w || img_h != target_h) {
-        ESP_LOGI(TAG, "Resizing image from %dx%d to %dx%d (scale_mode=%s)",
-                 img_w, img_h, target_w, target_h,
-                 _scale_mode == SCALE_MODE_FIT ? "fit" : "fill");
-        resize_nearest_rgb888(rgb_buffer, img_w, img_h, floyd_buffer, target_w, target_h, _scale_mode);
+            end_time = esp_timer_get_time();
+            stats.resize_us = end_time - start_time;
+            ESP_LOGI(TAG, "[TIMING] Resize (%dx%d -> %dx%d): %lld ms", img_w, img_h, target_w, target_h, stats.resize_us / 1000);
+        } else {
+            stats.resize_us = 0;
+            ESP_LOGI(TAG, "[TIMING] Resize: skipped (same size)");
+        }
 
-        // Free original buffer
-        if (is_jpeg) Jpeg_dec_buffer_free(rgb_buffer);
-        else heap_caps_free(rgb_buffer);
+        // === TIMING: Dithering ===
+        start_time = esp_timer_get_time();
 
-        dither_input = floyd_buffer;
-        used_internal_resize = true;
+        // Apply dithering (uses configured kernel: Jarvis, Stucki, Sierra, or Floyd-Steinberg)
+        ESP_LOGI(TAG, "Applying dithering (target: %dx%d%s)...", target_w, target_h, to_epd ? ", e-paper framebuffer" : "");
+        if (to_epd) {
+            bool dithered = dither_rgb888_to_epd(dither_input, target_w, target_h, epd);
+            if (!dithered) {
+                ESP_LOGE(TAG, "Dithering into e-paper framebuffer failed");
+                if (!used_internal_resize) {
+                    Jpeg_dec_buffer_free(dither_input);
+                }
+                return NULL;
+            }
+        } else {
+            dither_rgb888(dither_input, floyd_buffer, target_w, target_h);
+        }
 
         end_time = esp_timer_get_time();
-        stats.resize_us = end_time - start_time;
-        ESP_LOGI(TAG, "[TIMING] Resize (%dx%d -> %dx%d): %lld ms", img_w, img_h, target_w, target_h, stats.resize_us / 1000);
-    } else {
-        stats.resize_us = 0;
-        ESP_LOGI(TAG, "[TIMING] Resize: skipped (same size)");
-    }
-
-    // === TIMING: Dithering ===
-    start_time = esp_timer_get_time();
+        stats.dither_us = end_time - start_time;
+        ESP_LOGI(TAG, "[TIMING] Dithering: %lld ms", stats.dither_us / 1000);
+        ESP_LOGI(TAG, "Dithering complete");
 
-    // Apply dithering (uses configured kernel: Jarvis, Stucki, Sierra, or Floyd-Steinberg)
-    ESP_LOGI(TAG, "Applying dithering (target: %dx%d)...", target_w, target_h);
-    dither_rgb888(dither_input, floyd_buffer, target_w, target_h);
+        // Free the RGB buffer if not reused
+        if (!used_internal_resize) {
+            Jpeg_dec_buffer_free(dither_input);
+        }
+        ESP_LOGI(TAG, "Free SPIRAM after dithering: %d bytes", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    }
 
-    end_time = esp_timer_get_time();
-    stats.dither_us = end_time - start_time;
-    ESP_LOGI(TAG, "[TIMING] Dithering: %lld ms", stats.dither_us / 1000);
-    ESP_LOGI(TAG, "Dithering complete");
+    // Direct display: the frame decoded, swap it in for the displayed one
+    if (skip_sd_save && to_epd) {
+        if (_epd_target.lock) {
+            xSemaphoreTake(_epd_target.lock, portMAX_DELAY);
+        }
+        memcpy(_epd_target.image, epf_frame, (_epd_target.width_memory + 1) / 2 * _epd_target.height_memory);
+        if (_epd_target.lock) {
+            xSemaphoreGive(_epd_target.lock);
+        }
+        _epd_written = true;
+    }
 
     // Store dimensions for direct display accessor
     _last_target_w = target_w;
     _last_target_h = target_h;
 
-    // Free the RGB buffer if not reused
-    if (!used_internal_resize) {
-        if (is_jpeg) {
-            Jpeg_dec_buffer_free(dither_input);
-        } else {
-            heap_caps_free(dither_input);
+    // === TIMING: Save image (skip if direct display mode) ===
+    if (!skip_sd_save && to_epd) {
+        start_time = esp_timer_get_time();
+
+        // Save the packed frame as EPF, it loads back with a single read
+        snprintf(sdcard_path, 98, "/sdcard/05_user_ai_img/ai_%d.epf", path_value);
+        ESP_LOGI(TAG, "Saving to: %s", sdcard_path);
+
+        esp_err_t save_err = epf_write(sdcard_path, epf_frame, epd->width_memory, epd->height_memory,
+                                       EPF_LAYOUT(epd->rotate, epd->mirror), EPF_COMPRESSION_RLE);
+        if (save_err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to save EPF to SD card: %s", esp_err_to_name(save_err));
+            return NULL;
         }
-    }
-    ESP_LOGI(TAG, "Free SPIRAM after dithering: %d bytes", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
 
-    // === TIMING: Save BMP (skip if direct display mode) ===
-    if (!skip_sd_save) {
+        end_time = esp_timer_get_time();
+        stats.save_bmp_us = end_time - start_time;
+        ESP_LOGI(TAG, "[TIMING] Save EPF to SD card: %lld ms", stats.save_bmp_us / 1000);
+    } else if (!skip_sd_save) {
         start_time = esp_timer_get_time();
 
         // Save to SD card as BMP
@@ -727,20 +784,25 @@ const char* gemini_image_bsp::gemini_generate_image(bool skip_sd_save) {
              stats.api_request_us / 1000, (float)stats.api_request_us / stats.total_us * 100);
     ESP_LOGI(TAG, "║ Base64 Decode            │ %10lld │ %5.1f%%               ║",
              stats.base64_decode_us / 1000, (float)stats.base64_decode_us / stats.total_us * 100);
-    ESP_LOGI(TAG, "║ Buffer Shrink            │ %10lld │ %5.1f%%               ║",
-             stats.buffer_shrink_us / 1000, (float)stats.buffer_shrink_us / stats.total_us * 100);
-    ESP_LOGI(TAG, "║ Image Decode (%s)      │ %10lld │ %5.1f%%               ║",
-             stats.image_format, stats.image_decode_us / 1000, (float)stats.image_decode_us / stats.total_us * 100);
-    ESP_LOGI(TAG, "║ Resize                   │ %10lld │ %5.1f%%               ║",
-             stats.resize_us / 1000, (float)stats.resize_us / stats.total_us * 100);
-    ESP_LOGI(TAG, "║ Dithering                │ %10lld │ %5.1f%%               ║",
-             stats.dither_us / 1000, (float)stats.dither_us / stats.total_us * 100);
+    if (stats.fused) {
+        ESP_LOGI(TAG, "║ Decode+Scale+Dither(%s) │ %10lld │ %5.1f%%               ║",
+                 stats.image_format, stats.fused_us / 1000, (float)stats.fused_us / stats.total_us * 100);
+    } else {
+        ESP_LOGI(TAG, "║ Image Decode (%s)      │ %10lld │ %5.1f%%               ║",
+                 stats.image_format, stats.image_decode_us / 1000, (float)stats.image_decode_us / stats.total_us * 100);
+        ESP_LOGI(TAG, "║ Resize                   │ %10lld │ %5.1f%%               ║",
+                 stats.resize_us / 1000, (float)stats.resize_us / stats.total_us * 100);
+        ESP_LOGI(TAG, "║ Dithering                │ %10lld │ %5.1f%%               ║",
+                 stats.dither_us / 1000, (float)stats.dither_us / stats.total_us * 100);
+    }
     if (!skip_sd_save) {
-        ESP_LOGI(TAG, "║ Save BMP to SD           │ %10lld │ %5.1f%%               ║",
-                 stats.save_bmp_us / 1000, (float)stats.save_bmp_us / stats.total_us * 100);
+        ESP_LOGI(TAG, "║ Save %s to SD           │ %10lld │ %5.1f%%               ║",
+                 to_epd ? "EPF" : "BMP", stats.save_bmp_us / 1000, (float)stats.save_bmp_us / stats.total_us * 100);
     }
     ESP_LOGI(TAG, "╠══════════════════════════════════════════════════════════════╣");
     ESP_LOGI(TAG, "║ TOTAL                    │ %10lld │ 100.0%%               ║", stats.total_us / 1000);
+    ESP_LOGI(TAG, "║ (Base64%s overlap the API request)                ║",
+             stats.fused ? " and PNG decode" : "");
     ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════════╝");
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "╔══════════════════════════════════════════════════════════════╗");
@@ -750,8 +812,12 @@ const char* gemini_image_bsp::gemini_generate_image(bool skip_sd_save) {
     ESP_LOGI(TAG, "║ Base64 Length:       %zu bytes                              ║", stats.base64_len);
     ESP_LOGI(TAG, "║ Decoded File Size:   %zu bytes (%.2f KB)                    ║",
              stats.decoded_file_size, (float)stats.decoded_file_size / 1024);
-    ESP_LOGI(TAG, "║ RGB Buffer Size:     %zu bytes (%.2f MB)                    ║",
-             stats.rgb_buffer_size, (float)stats.rgb_buffer_size / (1024 * 1024));
+    if (stats.fused) {
+        ESP_LOGI(TAG, "║ RGB Buffer Size:     none (rows streamed)                   ║");
+    } else {
+        ESP_LOGI(TAG, "║ RGB Buffer Size:     %zu bytes (%.2f MB)                    ║",
+                 stats.rgb_buffer_size, (float)stats.rgb_buffer_size / (1024 * 1024));
+    }
     ESP_LOGI(TAG, "║ Original Resolution: %d x %d                                ║",
              stats.original_width, stats.original_height);
     ESP_LOGI(TAG, "║ Target Resolution:   %d x %d                                ║",
@@ -768,63 +834,29 @@ const char* gemini_image_bsp::gemini_generate_image(bool skip_sd_save) {
     return sdcard_path;
 }
 
-uint8_t gemini_image_bsp::png_to_rgb888(uint8_t *png_data, int png_len, uint8_t **rgb_buffer, int *rgb_len, int *width, int *height) {
-    // Calculate target dimensions based on aspect ratio
-    int target_w, target_h;
-    if (_aspect_ratio == ASPECT_RATIO_9_16) {
-        target_w = _height;  // 480
-        target_h = _width;   // 800
-    } else {
-        target_w = _width;   // 800
-        target_h = _height;  // 480
-    }
-
-    // First, read PNG dimensions from IHDR chunk
-    unsigned preview_w = 0, preview_h = 0;
-    if (png_len >= 24 && png_data[0] == 0x89 && png_data[1] == 0x50 &&
-        png_data[2] == 0x4E && png_data[3] == 0x47) {
-        preview_w = (png_data[16] << 24) | (png_data[17] << 16) |
-                    (png_data[18] << 8) | png_data[19];
-        preview_h = (png_data[20] << 24) | (png_data[21] << 16) |
-                    (png_data[22] << 8) | png_data[23];
-        ESP_LOGI(TAG, "PNG dimensions: %ux%u, target: %dx%d", preview_w, preview_h, target_w, target_h);
-    }
-
-    // Check if PNG needs scaling (larger than target)
-    bool needs_scaling = (preview_w > (unsigned)target_w || preview_h > (unsigned)target_h);
-
-    // Map scale mode
-    pngle_scale_mode_t pngle_mode = (_scale_mode == SCALE_MODE_FILL) ?
-                                     PNGLE_SCALE_FILL : PNGLE_SCALE_FIT;
-
-    pngle_scale_result_t result;
-    int err;
-
-    if (needs_scaling) {
-        // Use pngle streaming decoder with built-in scaling
-        // This avoids allocating a huge buffer for the full-size image
-        ESP_LOGI(TAG, "Using pngle with scaling (%ux%u -> %dx%d)",
-                 preview_w, preview_h, target_w, target_h);
-        err = pngle_scale_decode(png_data, png_len, target_w, target_h, pngle_mode, &result);
-    } else {
-        // For images that don't need scaling, decode at original size
-        ESP_LOGI(TAG, "Using pngle for same-size decode (%ux%u)", preview_w, preview_h);
-        err = pngle_scale_decode(png_data, png_len, 0, 0, PNGLE_SCALE_STRETCH, &result);
+bool gemini_image_bsp::alloc_epf_frame() {
+    if (epf_frame == NULL) {
+        int frame_size = (_epd_target.width_memory + 1) / 2 * _epd_target.height_memory;
+        epf_frame = (uint8_t *) heap_caps_malloc(frame_size, MALLOC_CAP_SPIRAM);
+        if (epf_frame == NULL) {
+            ESP_LOGW(TAG, "Failed to allocate EPF frame (%d bytes), dithering to RGB888 instead", frame_size);
+            return false;
+        }
+        ESP_LOGI(TAG, "Allocated EPF frame: %d bytes", frame_size);
     }
+    return true;
+}
 
-    if (err != PNGLE_SCALE_OK) {
-        ESP_LOGE(TAG, "pngle decode failed: %s", pngle_scale_error_text(err));
-        return 0;
+bool gemini_image_bsp::alloc_floyd_buffer() {
+    if (floyd_buffer == NULL) {
+        floyd_buffer = (uint8_t *) heap_caps_malloc(_width * _height * 3, MALLOC_CAP_SPIRAM);
+        if (floyd_buffer == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate floyd_buffer (%d bytes)", _width * _height * 3);
+            return false;
+        }
+        ESP_LOGI(TAG, "Allocated floyd_buffer: %d bytes", _width * _height * 3);
     }
-
-    *rgb_buffer = result.rgb_buffer;
-    *rgb_len = result.buffer_size;
-    if (width) *width = result.width;
-    if (height) *height = result.height;
-
-    ESP_LOGI(TAG, "PNG decoded: %dx%d (original: %dx%d)",
-             result.width, result.height, result.original_width, result.original_height);
-    return 1;
+    return true;
 }
 
 void gemini_image_bsp::set_Chat(const char *str) {
@@ -4,11 +4,39 @@
 #include "ArduinoJson-v7.4.1.h"
 #include "esp_http_client.h"
 #include "dither_engine.h"
+#include "inline_data_parser.h"
+#include "pngle_scale.h"
+
+class gemini_image_bsp;
+
+// Image format detected from the first decoded bytes of inlineData
+typedef enum {
+    GEMINI_IMAGE_PENDING,   // No image bytes yet
+    GEMINI_IMAGE_PNG,       // Streamed through pngle_scale into the ditherer
+    GEMINI_IMAGE_JPEG,      // Collected for the staged JPEG path
+    GEMINI_IMAGE_UNKNOWN    // Neither, rest of the data is dropped
+} gemini_image_format_t;
 
 // HTTP response callback structure
+// The body is never stored: inlineData.data is decoded while it downloads
 typedef struct {
-    char *buffer;
-    int buffer_len;
+    gemini_image_bsp *owner;
+    char preview[512];              // Start of the body, for logs and error responses
+    int preview_len;
+    size_t body_len;                // Body bytes received
+    inline_data_parser_t parser;    // Finds and base64-decodes inlineData.data
+    uint8_t *decode_block;          // Parser output block (internal RAM)
+    gemini_image_format_t format;
+    pngle_scale_stream_t *png;      // PNG: incremental decode + scale
+    bool push_started;              // PNG: dither push session open
+    uint8_t *jpeg_data;             // JPEG: decoded bytes (SPIRAM, grown as needed)
+    size_t jpeg_len;
+    size_t jpeg_cap;
+    int target_w;
+    int target_h;
+    const dither_epd_target_t *epd; // Packed 4bpp target, NULL for RGB888 into floyd_buffer
+    int64_t handler_us;             // Time spent in HTTP_EVENT_ON_DATA
+    int64_t image_us;               // Part of it spent decoding the image
 } gemini_http_response_t;
 
 // Aspect ratio options for image generation
@@ -38,7 +66,6 @@ private:
     char sdcard_path[100] = {""};       // SD card file path for saved image
     int path_value = 0;                 // File index counter
     bool is_success = false;            // Flag for successful request setup
-    uint8_t *png_buffer = NULL;         // Store decoded PNG data
     uint8_t *floyd_buffer = NULL;       // Store Floyd-Steinberg dithered data
     int _width;
     int _height;
@@ -46,20 +73,28 @@ private:
     scale_mode_t _scale_mode;             // Current scale mode setting
     int _last_target_w = 0;               // Last generated image width (for direct display)
     int _last_target_h = 0;               // Last generated image height (for direct display)
-
-    // Base64 decoding table
-    static const int8_t base64_decode_table[256];
+    dither_epd_target_t _epd_target = {}; // E-paper framebuffer for direct display (optional)
+    bool _has_epd_target = false;         // Set once set_EpdTarget() was called
+    bool _epd_written = false;            // Last direct display result already sits in the framebuffer
+    uint8_t *epf_frame = NULL;            // Off-screen packed frame, saved as EPF or copied to the panel
 
     static int _http_event_handler(esp_http_client_event_t *evt);
 
-    // Decode base64 string to binary data
-    int base64_decode(const char *input, size_t input_len, uint8_t *output, size_t *output_len);
+    // inline_data_parser sink: routes decoded image bytes to the PNG stream or JPEG buffer
+    static int _image_sink(void *user_ctx, const uint8_t *data, size_t len);
+    int stream_image_bytes(gemini_http_response_t *resp, const uint8_t *data, size_t len);
+
+    // Release whatever the response still owns (PNG stream, push session, JPEG buffer)
+    void release_response(gemini_http_response_t *resp);
 
     // Call Gemini API and get base64-encoded image
     const char* gemini_generate_image(bool skip_sd_save = false);
 
-    // Decode PNG to RGB888 format
-    uint8_t png_to_rgb888(uint8_t *png_data, int png_len, uint8_t **rgb_buffer, int *rgb_len, int *width, int *height);
+    // Allocate floyd_buffer on first use or after it was released for the API response
+    bool alloc_floyd_buffer();
+
+    // Allocate epf_frame once, sized like the e-paper target
+    bool alloc_epf_frame();
 
 public:
     /**
@@ -133,6 +168,21 @@ public:
      * @return Height in pixels
      */
     int get_TargetHeight() const { return _last_target_h; }
+
+    /**
+     * Set the e-paper framebuffer used in direct display mode
+     * When set, get_ImgName_Direct(true) dithers into an off-screen packed
+     * frame and copies it into the framebuffer under target->lock once the
+     * image decoded, instead of producing an RGB888 buffer
+     * @param target Framebuffer description, copied; NULL disables the path
+     */
+    void set_EpdTarget(const dither_epd_target_t *target);
+
+    /**
+     * Check whether the last direct display result was written to the framebuffer
+     * @return true if only a panel refresh is left to do
+     */
+    bool is_EpdWritten() const { return _epd_written; }
 };
 
 #endif
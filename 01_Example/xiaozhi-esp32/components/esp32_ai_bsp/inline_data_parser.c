@@ -0,0 +1,229 @@
+/**
+ * @file inline_data_parser.c
+ * @brief Incremental extractor for the base64 image of a Gemini JSON response
+ */
+
+#include "inline_data_parser.h"
+#include <string.h>
+
+// Scanner states
+enum {
+    STATE_FIND_INLINE,      // Looking for "inlineData"
+    STATE_IN_INLINE,        // Inside inlineData, looking for "mimeType" or "data"
+    STATE_EXPECT_COLON,     // Key matched, skipping to ':'
+    STATE_EXPECT_QUOTE,     // Skipping to the opening quote of the value
+    STATE_MIME_VALUE,       // Copying the mimeType string
+    STATE_DATA_VALUE,       // Decoding the data string
+    STATE_DONE              // Closing quote of data seen, rest of the body is ignored
+};
+
+static const char KEY_INLINE[] = "\"inlineData\"";
+static const char KEY_MIME[]   = "\"mimeType\"";
+static const char KEY_DATA[]   = "\"data\"";
+
+// Advance a key matcher by one character, true once the whole key matched.
+// Keys start with their only other quote, so a mismatch restarts at 0 or 1.
+static bool match_key(uint8_t *pos, const char *key, size_t key_len, char c) {
+    if (c == key[*pos]) {
+        if (++*pos == key_len) {
+            *pos = 0;
+            return true;
+        }
+    } else {
+        *pos = (c == '"') ? 1 : 0;
+    }
+    return false;
+}
+
+static int flush_output(inline_data_parser_t *p) {
+    if (p->out_len == 0) {
+        return INLINE_DATA_OK;
+    }
+    if (p->sink(p->user_ctx, p->out, p->out_len) != 0) {
+        return INLINE_DATA_ERR_ABORTED;
+    }
+    p->decoded_len += p->out_len;
+    p->out_len = 0;
+    return INLINE_DATA_OK;
+}
+
+// Decode the data string until its closing quote or the end of the piece.
+// The decoder takes whole runs; only the quote and JSON escapes come back here.
+static int decode_data(inline_data_parser_t *p, const char *data, size_t len, size_t *consumed) {
+    int err = INLINE_DATA_OK;
+    size_t i = 0;
+
+    while (i < len) {
+        // Keep room for the decoder's smallest step and for the final partial quad
+        if (p->out_cap - p->out_len < 3 && (err = flush_output(p)) != INLINE_DATA_OK) {
+            break;
+        }
+
+        if (p->escape) {
+            // Only "\/" can occur in base64, line breaks are dropped like plain whitespace
+            char c = data[i++];
+            p->escape = false;
+            if (c == 'n' || c == 'r' || c == 't') {
+                p->b64.whitespace++;
+                continue;
+            }
+            if (c != '/') {
+                err = INLINE_DATA_ERR_BASE64;
+                break;
+            }
+            size_t produced;
+            base64_stream_decode(&p->b64, "/", 1, p->out + p->out_len, p->out_cap - p->out_len, &produced);
+            p->out_len += produced;
+        } else {
+            size_t produced;
+            i += base64_stream_decode(&p->b64, data + i, len - i,
+                                      p->out + p->out_len, p->out_cap - p->out_len, &produced);
+            p->out_len += produced;
+            if (p->b64.error != BASE64_STREAM_OK) {
+                err = INLINE_DATA_ERR_BASE64;
+                break;
+            }
+            if (i == len || p->out_cap - p->out_len < 3) {
+                continue;   // Piece used up, or the block needs a flush
+            }
+            char c = data[i++];
+            if (c == '"') {
+                if (base64_stream_finish(&p->b64, p->out + p->out_len, &produced) != BASE64_STREAM_OK) {
+                    err = INLINE_DATA_ERR_BASE64;
+                    break;
+                }
+                p->out_len += produced;
+                p->state = STATE_DONE;
+                err = flush_output(p);
+                break;
+            }
+            if (c == '\\') {
+                p->escape = true;
+                continue;
+            }
+            err = INLINE_DATA_ERR_BASE64;   // Character outside the alphabet
+        }
+        if (p->b64.error != BASE64_STREAM_OK) {
+            err = INLINE_DATA_ERR_BASE64;
+        }
+        if (err != INLINE_DATA_OK) {
+            break;
+        }
+    }
+
+    *consumed = i;
+    return err;
+}
+
+void inline_data_parser_init(inline_data_parser_t *p, uint8_t *out, size_t out_cap,
+                             inline_data_sink_t sink, void *user_ctx) {
+    memset(p, 0, sizeof(*p));
+    base64_stream_init(&p->b64);
+    p->state = STATE_FIND_INLINE;
+    p->out = out;
+    p->out_cap = out_cap;
+    p->sink = sink;
+    p->user_ctx = user_ctx;
+    strcpy(p->mime_type, "unknown");
+    if (out == NULL || out_cap < 16 || sink == NULL) {
+        p->error = INLINE_DATA_ERR_PARAM;
+    }
+}
+
+int inline_data_parser_feed(inline_data_parser_t *p, const char *data, size_t len) {
+    size_t i = 0;
+
+    while (p->error == INLINE_DATA_OK && i < len && p->state != STATE_DONE) {
+        if (p->state == STATE_DATA_VALUE) {
+            size_t consumed;
+            p->error = decode_data(p, data + i, len - i, &consumed);
+            i += consumed;
+            continue;
+        }
+
+        char c = data[i++];
+        switch (p->state) {
+        case STATE_FIND_INLINE:
+            if (match_key(&p->match_inline, KEY_INLINE, sizeof(KEY_INLINE) - 1, c)) {
+                p->state = STATE_IN_INLINE;
+            }
+            break;
+        case STATE_IN_INLINE:
+            if (match_key(&p->match_mime, KEY_MIME, sizeof(KEY_MIME) - 1, c)) {
+                p->value_is_data = false;
+                p->state = STATE_EXPECT_COLON;
+            } else if (match_key(&p->match_data, KEY_DATA, sizeof(KEY_DATA) - 1, c)) {
+                p->value_is_data = true;
+                p->state = STATE_EXPECT_COLON;
+            }
+            if (p->state != STATE_IN_INLINE) {
+                p->match_mime = 0;
+                p->match_data = 0;
+            }
+            break;
+        case STATE_EXPECT_COLON:
+            if (c == ':') {
+                p->state = STATE_EXPECT_QUOTE;
+            } else if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                p->state = STATE_IN_INLINE;   // Not a key after all
+            }
+            break;
+        case STATE_EXPECT_QUOTE:
+            if (c == '"') {
+                if (p->value_is_data) {
+                    p->state = STATE_DATA_VALUE;
+                } else {
+                    p->mime_len = 0;
+                    p->mime_type[0] = '\0';
+                    p->state = STATE_MIME_VALUE;
+                }
+            } else if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                p->state = STATE_IN_INLINE;
+            }
+            break;
+        case STATE_MIME_VALUE:
+            if (c == '"' && !p->escape) {
+                p->state = STATE_IN_INLINE;
+            } else if (c == '\\' && !p->escape) {
+                p->escape = true;
+            } else {
+                p->escape = false;
+                if (p->mime_len < sizeof(p->mime_type) - 1) {
+                    p->mime_type[p->mime_len++] = c;
+                    p->mime_type[p->mime_len] = '\0';
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return p->error;
+}
+
+int inline_data_parser_finish(inline_data_parser_t *p) {
+    if (p->error != INLINE_DATA_OK) {
+        return p->error;
+    }
+    if (p->state == STATE_DONE) {
+        return INLINE_DATA_OK;
+    }
+    p->error = (p->state == STATE_DATA_VALUE) ? INLINE_DATA_ERR_TRUNCATED : INLINE_DATA_ERR_NOT_FOUND;
+    return p->error;
+}
+
+bool inline_data_parser_done(const inline_data_parser_t *p) {
+    return p->state == STATE_DONE;
+}
+
+const char *inline_data_error_text(int error) {
+    switch (error) {
+    case INLINE_DATA_OK:             return "OK";
+    case INLINE_DATA_ERR_PARAM:      return "Invalid parameter";
+    case INLINE_DATA_ERR_NOT_FOUND:  return "No inlineData data in response";
+    case INLINE_DATA_ERR_TRUNCATED:  return "Response ended inside the data string";
+    case INLINE_DATA_ERR_BASE64:     return "Invalid base64 character";
+    case INLINE_DATA_ERR_ABORTED:    return "Aborted by image consumer";
+    default:                         return "Unknown error";
+    }
+}
@@ -0,0 +1,92 @@
+/**
+ * @file inline_data_parser.h
+ * @brief Incremental extractor for the base64 image of a Gemini JSON response
+ *
+ * Fed with the raw response body as it arrives, piece by piece. It looks for
+ * the "inlineData" object, captures its "mimeType" and decodes the "data"
+ * string on the fly, handing the binary image to a sink in small blocks.
+ * Nothing else of the JSON is kept, so the whole response never has to sit
+ * in memory.
+ */
+
+#ifndef INLINE_DATA_PARSER_H
+#define INLINE_DATA_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "base64_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decoded image bytes, called in order; return 0 to continue, non-zero to abort
+typedef int (*inline_data_sink_t)(void *user_ctx, const uint8_t *data, size_t len);
+
+// Error codes
+#define INLINE_DATA_OK              0
+#define INLINE_DATA_ERR_PARAM      -1
+#define INLINE_DATA_ERR_NOT_FOUND  -2  // Body ended before an inlineData "data" string
+#define INLINE_DATA_ERR_TRUNCATED  -3  // Body ended inside the "data" string
+#define INLINE_DATA_ERR_BASE64     -4  // Invalid character or padding in the base64 data
+#define INLINE_DATA_ERR_ABORTED    -5  // Sink returned non-zero
+
+typedef struct {
+    // Scanner state, private
+    uint8_t state;
+    uint8_t match_inline;       // Characters of "inlineData" matched so far
+    uint8_t match_mime;         // Characters of "mimeType" matched so far
+    uint8_t match_data;         // Characters of "data" matched so far
+    bool value_is_data;         // Key just matched is "data" (else "mimeType")
+    bool escape;                // Previous string character was a backslash
+    base64_stream_t b64;        // Decoder state and validation stats of the data string
+
+    // Output block, flushed to the sink when full and at the end of the string
+    uint8_t *out;
+    size_t out_cap;
+    size_t out_len;
+    inline_data_sink_t sink;
+    void *user_ctx;
+
+    // Results
+    char mime_type[32];         // "unknown" until seen
+    size_t mime_len;
+    size_t decoded_len;         // Bytes handed to the sink
+    int error;                  // First error, sticky
+} inline_data_parser_t;
+
+/**
+ * @brief Reset the parser
+ * @param out Scratch block for decoded bytes, out_cap bytes (e.g. 4 KB, at least 16)
+ */
+void inline_data_parser_init(inline_data_parser_t *p, uint8_t *out, size_t out_cap,
+                             inline_data_sink_t sink, void *user_ctx);
+
+/**
+ * @brief Feed the next piece of the response body, any split is fine
+ * @return INLINE_DATA_OK, or the (sticky) error code
+ */
+int inline_data_parser_feed(inline_data_parser_t *p, const char *data, size_t len);
+
+/**
+ * @brief Check that the whole "data" string was seen once the body has ended
+ * @return INLINE_DATA_OK or an error code
+ */
+int inline_data_parser_finish(inline_data_parser_t *p);
+
+/**
+ * @brief True once the closing quote of the "data" string was consumed
+ */
+bool inline_data_parser_done(const inline_data_parser_t *p);
+
+/**
+ * @brief Human-readable text for an error code
+ */
+const char *inline_data_error_text(int error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INLINE_DATA_PARSER_H
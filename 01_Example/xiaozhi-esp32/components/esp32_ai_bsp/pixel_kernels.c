@@ -0,0 +1,196 @@
+/**
+ * @file pixel_kernels.c
+ * @brief Per-pixel kernels shared by the dither, resize and BMP paths
+ *
+ * The ESP32-S3 vector unit has no byte shuffle and the redmean distance needs
+ * 32-bit products, so the fast paths work on whole 32-bit words instead: four
+ * RGB888 pixels are exactly three words, which turns twelve byte loads/stores
+ * into three. Word paths only run on 4-byte aligned rows (every 800/480 wide
+ * frame buffer), anything else takes the reference loop.
+ */
+
+#include "pixel_kernels.h"
+
+#include <limits.h>
+
+#if defined(PIXEL_KERNELS_SCALAR) || !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#define PIXEL_WORDS 0
+#else
+#define PIXEL_WORDS 1
+#endif
+
+#define IS_ALIGNED4(p) ((((uintptr_t)(p)) & 3) == 0)
+
+// ============================================================================
+// Reference Kernels
+// ============================================================================
+
+void pixel_swap_rb_row_ref(const uint8_t *src, uint8_t *dst, int n) {
+    for (int x = 0; x < n; x++) {
+        uint8_t r = src[x * 3 + 0];
+        uint8_t g = src[x * 3 + 1];
+        uint8_t b = src[x * 3 + 2];
+        dst[x * 3 + 0] = b;
+        dst[x * 3 + 1] = g;
+        dst[x * 3 + 2] = r;
+    }
+}
+
+void pixel_expand_indices_ref(const uint8_t *index_row, const uint8_t (*palette)[3], int count, uint8_t *dst, int n) {
+    (void)count;
+    for (int x = 0; x < n; x++) {
+        const uint8_t *c = palette[index_row[x]];
+        dst[x * 3 + 0] = c[0];
+        dst[x * 3 + 1] = c[1];
+        dst[x * 3 + 2] = c[2];
+    }
+}
+
+void pixel_resample_row_ref(const uint8_t *src_row, const uint16_t *x_index, uint8_t *dst, int n) {
+    for (int x = 0; x < n; x++) {
+        const uint8_t *s = src_row + x_index[x] * 3;
+        dst[x * 3 + 0] = s[0];
+        dst[x * 3 + 1] = s[1];
+        dst[x * 3 + 2] = s[2];
+    }
+}
+
+void pixel_nearest_palette16_ref(const uint8_t *rgb, int n, const uint8_t (*palette)[3], int count, uint8_t *out_index) {
+    for (int i = 0; i < n; i++) {
+        const uint8_t *p = rgb + i * 3;
+        int best = 0;
+        int best_dist = INT_MAX;
+        for (int c = 0; c < count; c++) {
+            int dist = pixel_redmean_distance(p[0], p[1], p[2], palette[c][0], palette[c][1], palette[c][2]);
+            if (dist < best_dist) {
+                best_dist = dist;
+                best = c;
+            }
+        }
+        out_index[i] = (uint8_t)best;
+    }
+}
+
+// ============================================================================
+// Word Kernels
+// ============================================================================
+
+#if PIXEL_WORDS
+
+// Store four packed 0x00BBGGRR pixels as three little-endian words
+static inline void store4(uint32_t *d, uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3) {
+    d[0] = c0 | (c1 << 24);
+    d[1] = (c1 >> 8) | (c2 << 16);
+    d[2] = (c2 >> 16) | (c3 << 8);
+}
+
+void pixel_swap_rb_row(const uint8_t *src, uint8_t *dst, int n) {
+    int x = 0;
+    if (IS_ALIGNED4(src) && IS_ALIGNED4(dst)) {
+        const uint32_t *s = (const uint32_t *)src;
+        uint32_t *d = (uint32_t *)dst;
+        for (; x + 4 <= n; x += 4, s += 3, d += 3) {
+            // w0 = R0 G0 B0 R1, w1 = G1 B1 R2 G2, w2 = B2 R3 G3 B3 (byte 0 first)
+            uint32_t w0 = s[0], w1 = s[1], w2 = s[2];
+            d[0] = ((w0 >> 16) & 0xFF) | (w0 & 0xFF00) | ((w0 & 0xFF) << 16) | ((w1 & 0xFF00) << 16);
+            d[1] = (w1 & 0xFF) | ((w0 >> 24) << 8) | ((w2 & 0xFF) << 16) | (w1 & 0xFF000000);
+            d[2] = ((w1 >> 16) & 0xFF) | ((w2 >> 24) << 8) | (w2 & 0xFF0000) | ((w2 & 0xFF00) << 16);
+        }
+    }
+    pixel_swap_rb_row_ref(src + x * 3, dst + x * 3, n - x);
+}
+
+void pixel_expand_indices(const uint8_t *index_row, const uint8_t (*palette)[3], int count, uint8_t *dst, int n) {
+    int x = 0;
+    if (IS_ALIGNED4(dst) && count > 0 && count <= PIXEL_PALETTE_MAX) {
+        uint32_t packed[PIXEL_PALETTE_MAX];
+        for (int c = 0; c < count; c++) {
+            packed[c] = palette[c][0] | (palette[c][1] << 8) | ((uint32_t)palette[c][2] << 16);
+        }
+        uint32_t *d = (uint32_t *)dst;
+        for (; x + 4 <= n; x += 4, d += 3) {
+            store4(d, packed[index_row[x]], packed[index_row[x + 1]],
+                   packed[index_row[x + 2]], packed[index_row[x + 3]]);
+        }
+    }
+    pixel_expand_indices_ref(index_row + x, palette, count, dst + x * 3, n - x);
+}
+
+static inline uint32_t load_rgb(const uint8_t *s) {
+    return s[0] | (s[1] << 8) | ((uint32_t)s[2] << 16);
+}
+
+void pixel_resample_row(const uint8_t *src_row, const uint16_t *x_index, uint8_t *dst, int n) {
+    int x = 0;
+    if (IS_ALIGNED4(dst)) {
+        uint32_t *d = (uint32_t *)dst;
+        for (; x + 4 <= n; x += 4, d += 3) {
+            store4(d, load_rgb(src_row + x_index[x] * 3), load_rgb(src_row + x_index[x + 1] * 3),
+                   load_rgb(src_row + x_index[x + 2] * 3), load_rgb(src_row + x_index[x + 3] * 3));
+        }
+    }
+    pixel_resample_row_ref(src_row, x_index + x, dst + x * 3, n - x);
+}
+
+#else
+
+void pixel_swap_rb_row(const uint8_t *src, uint8_t *dst, int n) {
+    pixel_swap_rb_row_ref(src, dst, n);
+}
+
+void pixel_expand_indices(const uint8_t *index_row, const uint8_t (*palette)[3], int count, uint8_t *dst, int n) {
+    pixel_expand_indices_ref(index_row, palette, count, dst, n);
+}
+
+void pixel_resample_row(const uint8_t *src_row, const uint16_t *x_index, uint8_t *dst, int n) {
+    pixel_resample_row_ref(src_row, x_index, dst, n);
+}
+
+#endif
+
+// ============================================================================
+// Block Palette Search
+// ============================================================================
+
+#if defined(PIXEL_KERNELS_SCALAR)
+
+void pixel_nearest_palette16(const uint8_t *rgb, int n, const uint8_t (*palette)[3], int count, uint8_t *out_index) {
+    pixel_nearest_palette16_ref(rgb, n, palette, count, out_index);
+}
+
+#else
+
+void pixel_nearest_palette16(const uint8_t *rgb, int n, const uint8_t (*palette)[3], int count, uint8_t *out_index) {
+    // Palette-outer, pixel-inner: each palette colour stays in registers for the whole block
+    // and the inner loop has no data-dependent branches, only a compare/select per pixel
+    uint8_t r[PIXEL_BLOCK], g[PIXEL_BLOCK], b[PIXEL_BLOCK];
+    int best_dist[PIXEL_BLOCK];
+    uint8_t best[PIXEL_BLOCK];
+
+    if (n > PIXEL_BLOCK) {
+        n = PIXEL_BLOCK;
+    }
+    for (int i = 0; i < n; i++) {
+        r[i] = rgb[i * 3 + 0];
+        g[i] = rgb[i * 3 + 1];
+        b[i] = rgb[i * 3 + 2];
+        best_dist[i] = INT_MAX;
+        best[i] = 0;
+    }
+
+    for (int c = 0; c < count; c++) {
+        const uint8_t pr = palette[c][0], pg = palette[c][1], pb = palette[c][2];
+        for (int i = 0; i < n; i++) {
+            int dist = pixel_redmean_distance(r[i], g[i], b[i], pr, pg, pb);
+            int closer = dist < best_dist[i];
+            best_dist[i] = closer ? dist : best_dist[i];
+            best[i] = closer ? (uint8_t)c : best[i];
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        out_index[i] = best[i];
+    }
+}
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ * @file pixel_kernels.h
+ * @brief Per-pixel kernels shared by the dither, resize and BMP paths
+ *
+ * Every kernel has a plain scalar *_ref twin with identical output, so the
+ * optimized versions can be checked against it on any host. Define
+ * PIXEL_KERNELS_SCALAR to route the public entry points to the references.
+ */
+
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pixels evaluated per call of pixel_nearest_palette16()
+#define PIXEL_BLOCK 16
+
+// Largest palette pixel_nearest_palette16() accepts
+#define PIXEL_PALETTE_MAX 8
+
+/**
+ * @brief Perceptual colour distance (redmean), weighs green highest and
+ *        shifts the red/blue weights with the mean red level
+ */
+static inline int pixel_redmean_distance(uint8_t r1, uint8_t g1, uint8_t b1,
+                                         uint8_t r2, uint8_t g2, uint8_t b2) {
+    int dr = (int)r1 - r2;
+    int dg = (int)g1 - g2;
+    int db = (int)b1 - b2;
+    int rmean = ((int)r1 + r2) / 2;
+    return ((512 + rmean) * dr * dr >> 8) + 4 * dg * dg + ((767 - rmean) * db * db >> 8);
+}
+
+/**
+ * @brief Swap R and B of n RGB888 pixels (RGB <-> BGR), src and dst may be the same buffer
+ */
+void pixel_swap_rb_row(const uint8_t *src, uint8_t *dst, int n);
+void pixel_swap_rb_row_ref(const uint8_t *src, uint8_t *dst, int n);
+
+/**
+ * @brief Expand n palette indices into RGB888 pixels
+ * @param palette count RGB triplets (count 1..PIXEL_PALETTE_MAX), indexed by index_row
+ */
+void pixel_expand_indices(const uint8_t *index_row, const uint8_t (*palette)[3], int count, uint8_t *dst, int n);
+void pixel_expand_indices_ref(const uint8_t *index_row, const uint8_t (*palette)[3], int count, uint8_t *dst, int n);
+
+/**
+ * @brief Gather n RGB888 pixels from a source row through a column table
+ * @param x_index Source column for each destination pixel
+ */
+void pixel_resample_row(const uint8_t *src_row, const uint16_t *x_index, uint8_t *dst, int n);
+void pixel_resample_row_ref(const uint8_t *src_row, const uint16_t *x_index, uint8_t *dst, int n);
+
+/**
+ * @brief Nearest palette entry by redmean distance for up to PIXEL_BLOCK pixels
+ *
+ * Ties go to the lowest palette index, the same as a first-best linear search.
+ *
+ * @param rgb n RGB888 pixels
+ * @param n Pixel count, 1..PIXEL_BLOCK
+ * @param palette count RGB triplets, count 1..PIXEL_PALETTE_MAX
+ * @param out_index Receives n palette indices
+ */
+void pixel_nearest_palette16(const uint8_t *rgb, int n, const uint8_t (*palette)[3], int count, uint8_t *out_index);
+void pixel_nearest_palette16_ref(const uint8_t *rgb, int n, const uint8_t (*palette)[3], int count, uint8_t *out_index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PIXEL_KERNELS_H
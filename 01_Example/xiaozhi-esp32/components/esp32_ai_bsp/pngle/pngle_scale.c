@@ -8,11 +8,25 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "esp_heap_caps.h"
 #include "esp_log.h"
 
 static const char *TAG = "PNGLE_SCALE";
 
+// Resampling filter, chosen once the PNG dimensions are known
+typedef enum {
+    SCALE_FILTER_AREA,      // Downscale: box filter, every source pixel averaged into its output pixel
+    SCALE_FILTER_BILINEAR,  // Vertical upscale: interpolate between two buffered source rows
+    SCALE_FILTER_NEAREST    // Interlaced PNG (passes arrive out of order): last pixel wins
+} scale_filter_t;
+
+// Fixed-point fraction bits of the bilinear weights
+#define BILINEAR_BITS 8
+
+// Bytes handed to pngle_feed() at a time
+#define PNGLE_SCALE_FEED_CHUNK 4096
+
 // Context for decoding with scaling
 typedef struct {
     uint8_t *rgb_buffer;        // Output buffer
@@ -29,8 +43,420 @@ typedef struct {
     pngle_scale_mode_t scale_mode;
     int error_code;
     const char *error_msg;
+
+    // Precomputed mapping, the draw callbacks do no float maths
+    scale_filter_t filter;
+    int16_t *col_index;         // Source column -> output column, -1 when cropped away
+    int16_t *row_index;         // Source row -> output row, -1 when cropped away
+    int cur_y;                  // Source row of the last pixel drawn, -1 before the first
+
+    // SCALE_FILTER_AREA: running sums of one output row
+    uint32_t *acc;              // RGB sums, output_width * 3
+    uint16_t *col_count;        // Source columns summed into each output column
+    int acc_row;                // Output row being accumulated, -1 if none
+    int acc_rows;               // Source rows summed into acc_row so far
+
+    // SCALE_FILTER_BILINEAR: two source rows and per-output sample positions
+    uint8_t *src_rows[2];       // Source rows y & 1, original_width * 3 each
+    uint16_t *bx0;              // Left source column of each output column
+    uint8_t *bfx;               // Weight of bx0 + 1, 0..(1 << BILINEAR_BITS) - 1
+    uint16_t *by0;              // Upper source row of each output row
+    uint8_t *bfy;               // Weight of by0 + 1
+    int out_x0, out_x1;         // Output columns covered by the image
+    int out_y0, out_y1;         // Output rows covered by the image
+    int next_out_row;           // Next output row to emit
+    int finished;               // Final rows flushed
+
+    // Row output (pngle_scale_decode_rows): finished rows go to row_cb instead of rgb_buffer
+    pngle_scale_row_cb_t row_cb;
+    void *row_ctx;
+    uint8_t *out_row;           // The single output row, letterbox columns hold the background
+    int next_emit;              // Next output row handed to row_cb
+    uint8_t background;         // Letterbox grey level
 } pngle_scale_ctx_t;
 
+static void *scale_alloc(size_t size) {
+    // Mapping tables and accumulators are touched for every pixel, keep them in internal RAM if possible
+    void *p = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!p) {
+        p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    return p;
+}
+
+static void scale_free_tables(pngle_scale_ctx_t *ctx) {
+    heap_caps_free(ctx->col_index);
+    heap_caps_free(ctx->row_index);
+    heap_caps_free(ctx->acc);
+    heap_caps_free(ctx->col_count);
+    heap_caps_free(ctx->src_rows[0]);
+    heap_caps_free(ctx->src_rows[1]);
+    heap_caps_free(ctx->bx0);
+    heap_caps_free(ctx->bfx);
+    heap_caps_free(ctx->by0);
+    heap_caps_free(ctx->bfy);
+    heap_caps_free(ctx->out_row);
+    ctx->out_row = NULL;
+    ctx->col_index = ctx->row_index = NULL;
+    ctx->acc = NULL;
+    ctx->col_count = NULL;
+    ctx->src_rows[0] = ctx->src_rows[1] = NULL;
+    ctx->bx0 = ctx->by0 = NULL;
+    ctx->bfx = ctx->bfy = NULL;
+}
+
+/**
+ * @brief Build the source -> output index table of one axis
+ *
+ * Source pixel centres map to (i + 0.5) * scale + shift, which is the crop
+ * (FILL) or letterbox offset (FIT). Pixels landing outside [lo, hi) get -1.
+ */
+static void scale_build_index(int16_t *index, int count, float scale, float shift, int lo, int hi) {
+    for (int i = 0; i < count; i++) {
+        int o = (int)floorf((i + 0.5f) * scale + shift);
+        index[i] = (o >= lo && o < hi) ? (int16_t)o : -1;
+    }
+}
+
+/**
+ * @brief Build the output -> source sample table of one axis for bilinear filtering
+ */
+static void scale_build_bilinear(uint16_t *pos, uint8_t *frac, int lo, int hi, int src_count,
+                                 float scale, float shift) {
+    for (int o = lo; o < hi; o++) {
+        float s = (o + 0.5f - shift) / scale - 0.5f;
+        if (s < 0.0f) {
+            s = 0.0f;
+        }
+        int i = (int)s;
+        int f = (int)((s - i) * (1 << BILINEAR_BITS) + 0.5f);
+        if (f >= (1 << BILINEAR_BITS)) {
+            i++;
+            f = 0;
+        }
+        if (i >= src_count - 1) {
+            i = src_count - 1;
+            f = 0;
+        }
+        pos[o] = (uint16_t)i;
+        frac[o] = (uint8_t)f;
+    }
+}
+
+static void scale_fail(pngle_scale_ctx_t *ctx, int code, const char *msg) {
+    ESP_LOGE(TAG, "%s", msg);
+    ctx->error_code = code;
+    ctx->error_msg = msg;
+}
+
+// ============================================================================
+// Output rows
+// ============================================================================
+
+/**
+ * @brief Get the buffer output row `row` is written to
+ *
+ * In row mode every row before `row` is handed out first: letterbox rows as
+ * plain background, rows inside the image no source row landed on as a copy
+ * of the previous row.
+ */
+static uint8_t *scale_begin_row(pngle_scale_ctx_t *ctx, int row) {
+    if (!ctx->row_cb) {
+        return ctx->rgb_buffer + (size_t)row * ctx->output_width * 3;
+    }
+    for (; ctx->next_emit < row && ctx->error_code == PNGLE_SCALE_OK; ctx->next_emit++) {
+        if (ctx->next_emit < ctx->out_y0 || ctx->next_emit >= ctx->out_y1) {
+            memset(ctx->out_row, ctx->background, ctx->output_width * 3);
+        }
+        if (ctx->row_cb(ctx->row_ctx, ctx->next_emit, ctx->out_row) != 0) {
+            scale_fail(ctx, PNGLE_SCALE_ERR_ABORTED, "Row consumer aborted");
+        }
+    }
+    return ctx->out_row;
+}
+
+/**
+ * @brief Hand a finished output row to the row consumer (row mode only)
+ */
+static void scale_end_row(pngle_scale_ctx_t *ctx, int row) {
+    if (!ctx->row_cb || ctx->error_code != PNGLE_SCALE_OK || row < ctx->next_emit) {
+        return;
+    }
+    if (ctx->row_cb(ctx->row_ctx, row, ctx->out_row) != 0) {
+        scale_fail(ctx, PNGLE_SCALE_ERR_ABORTED, "Row consumer aborted");
+    }
+    ctx->next_emit = row + 1;
+}
+
+// ============================================================================
+// Area average (downscaling)
+// ============================================================================
+
+/**
+ * @brief Write the accumulated output row and clear the sums
+ */
+static void area_flush_row(pngle_scale_ctx_t *ctx) {
+    if (ctx->acc_row < 0 || ctx->acc_rows == 0) {
+        return;
+    }
+    uint8_t *dst = scale_begin_row(ctx, ctx->acc_row);
+    uint32_t *acc = ctx->acc;
+    for (int x = ctx->out_x0; x < ctx->out_x1; x++) {
+        uint32_t cnt = (uint32_t)ctx->col_count[x] * ctx->acc_rows;
+        if (cnt == 0) {
+            continue;
+        }
+        // One reciprocal per pixel instead of three divisions, exact to within rounding
+        uint32_t inv = ((1u << 16) + cnt / 2) / cnt;
+        uint32_t *a = acc + x * 3;
+        uint8_t *d = dst + x * 3;
+        uint32_t r = (a[0] * inv + 0x8000) >> 16;
+        uint32_t g = (a[1] * inv + 0x8000) >> 16;
+        uint32_t b = (a[2] * inv + 0x8000) >> 16;
+        d[0] = r > 255 ? 255 : r;
+        d[1] = g > 255 ? 255 : g;
+        d[2] = b > 255 ? 255 : b;
+    }
+    memset(acc + ctx->out_x0 * 3, 0, (ctx->out_x1 - ctx->out_x0) * 3 * sizeof(uint32_t));
+    ctx->acc_rows = 0;
+    scale_end_row(ctx, ctx->acc_row);
+}
+
+static void area_draw_callback(pngle_t *pngle, uint32_t x, uint32_t y,
+                               uint32_t w, uint32_t h, const uint8_t rgba[4]) {
+    pngle_scale_ctx_t *ctx = (pngle_scale_ctx_t *)pngle_get_user_data(pngle);
+    (void)w;
+    (void)h;
+
+    if ((int)y != ctx->cur_y) {
+        // First pixel of a new source row: close the output row once the source moves past it
+        ctx->cur_y = y;
+        int row = ctx->row_index[y];
+        if (row != ctx->acc_row) {
+            area_flush_row(ctx);
+            ctx->acc_row = row;
+        }
+        if (row >= 0) {
+            ctx->acc_rows++;
+        }
+    }
+    if (ctx->acc_row < 0) {
+        return;
+    }
+
+    int col = ctx->col_index[x];
+    if (col < 0) {
+        return;
+    }
+    uint32_t *a = ctx->acc + col * 3;
+    a[0] += rgba[0];
+    a[1] += rgba[1];
+    a[2] += rgba[2];
+}
+
+// ============================================================================
+// Bilinear (upscaling)
+// ============================================================================
+
+/**
+ * @brief Emit every output row whose lower source row is available
+ * @param last_src Last complete source row
+ */
+static void bilinear_emit_rows(pngle_scale_ctx_t *ctx, int last_src) {
+    const int one = 1 << BILINEAR_BITS;
+    const int src_h = ctx->original_height;
+    for (; ctx->next_out_row < ctx->out_y1; ctx->next_out_row++) {
+        int oy = ctx->next_out_row;
+        int y0 = ctx->by0[oy];
+        int y1 = y0 + 1 < src_h ? y0 + 1 : y0;
+        if (y1 > last_src) {
+            break;
+        }
+        const uint8_t *r0 = ctx->src_rows[y0 & 1];
+        const uint8_t *r1 = ctx->src_rows[y1 & 1];
+        int fy = ctx->bfy[oy];
+        uint8_t *dst = scale_begin_row(ctx, oy);
+        for (int ox = ctx->out_x0; ox < ctx->out_x1; ox++) {
+            int x0 = ctx->bx0[ox];
+            int x1 = x0 + 1 < ctx->original_width ? x0 + 1 : x0;
+            int fx = ctx->bfx[ox];
+            const uint8_t *a = r0 + x0 * 3, *b = r0 + x1 * 3;
+            const uint8_t *c = r1 + x0 * 3, *e = r1 + x1 * 3;
+            for (int ch = 0; ch < 3; ch++) {
+                int top = a[ch] * (one - fx) + b[ch] * fx;
+                int bottom = c[ch] * (one - fx) + e[ch] * fx;
+                dst[ox * 3 + ch] = (uint8_t)((top * (one - fy) + bottom * fy + (1 << (2 * BILINEAR_BITS - 1)))
+                                             >> (2 * BILINEAR_BITS));
+            }
+        }
+        scale_end_row(ctx, oy);
+    }
+}
+
+static void bilinear_draw_callback(pngle_t *pngle, uint32_t x, uint32_t y,
+                                   uint32_t w, uint32_t h, const uint8_t rgba[4]) {
+    pngle_scale_ctx_t *ctx = (pngle_scale_ctx_t *)pngle_get_user_data(pngle);
+    (void)w;
+    (void)h;
+
+    if ((int)y != ctx->cur_y) {
+        // Row y - 1 is complete, and row y is about to reuse the buffer of row y - 2
+        if (ctx->cur_y >= 0) {
+            bilinear_emit_rows(ctx, ctx->cur_y);
+        }
+        ctx->cur_y = y;
+    }
+    uint8_t *p = ctx->src_rows[y & 1] + x * 3;
+    p[0] = rgba[0];
+    p[1] = rgba[1];
+    p[2] = rgba[2];
+}
+
+// ============================================================================
+// Nearest (interlaced fallback)
+// ============================================================================
+
+static void nearest_draw_callback(pngle_t *pngle, uint32_t x, uint32_t y,
+                                  uint32_t w, uint32_t h, const uint8_t rgba[4]) {
+    pngle_scale_ctx_t *ctx = (pngle_scale_ctx_t *)pngle_get_user_data(pngle);
+    (void)w;
+    (void)h;
+
+    int out_x = ctx->col_index[x];
+    int out_y = ctx->row_index[y];
+    if (out_x < 0 || out_y < 0) {
+        return;
+    }
+
+    // Write RGB (ignore alpha for now)
+    size_t offset = ((size_t)out_y * ctx->output_width + out_x) * 3;
+    ctx->rgb_buffer[offset + 0] = rgba[0];  // R
+    ctx->rgb_buffer[offset + 1] = rgba[1];  // G
+    ctx->rgb_buffer[offset + 2] = rgba[2];  // B
+}
+
+/**
+ * @brief Set up the filter tables and select the matching draw callback
+ */
+static void scale_setup_filter(pngle_t *pngle, pngle_scale_ctx_t *ctx) {
+    const int w = ctx->original_width;
+    const int h = ctx->original_height;
+
+    // Placement of the scaled image on the output: crop for FILL, letterbox for FIT
+    float shift_x = 0.0f, shift_y = 0.0f;
+    ctx->out_x0 = 0;
+    ctx->out_y0 = 0;
+    ctx->out_x1 = ctx->output_width;
+    ctx->out_y1 = ctx->output_height;
+    if (ctx->scale_mode == PNGLE_SCALE_FILL) {
+        shift_x = -(w * ctx->scale_x - ctx->output_width) / 2.0f;
+        shift_y = -(h * ctx->scale_y - ctx->output_height) / 2.0f;
+    } else if (ctx->scale_mode == PNGLE_SCALE_FIT) {
+        int scaled_w = (int)(w * ctx->scale_x);
+        int scaled_h = (int)(h * ctx->scale_y);
+        ctx->out_x0 = ctx->offset_x;
+        ctx->out_y0 = ctx->offset_y;
+        ctx->out_x1 = ctx->offset_x + scaled_w;
+        ctx->out_y1 = ctx->offset_y + scaled_h;
+        shift_x = ctx->offset_x;
+        shift_y = ctx->offset_y;
+    }
+
+    pngle_ihdr_t *ihdr = pngle_get_ihdr(pngle);
+    if (ihdr && ihdr->interlace) {
+        ctx->filter = SCALE_FILTER_NEAREST;
+    } else if (ctx->scale_x <= 1.0f && ctx->scale_y <= 1.0f) {
+        ctx->filter = SCALE_FILTER_AREA;
+    } else if (ctx->scale_y >= 1.0f) {
+        ctx->filter = SCALE_FILTER_BILINEAR;
+    } else {
+        // Vertical downscale with horizontal upscale (STRETCH only)
+        ctx->filter = SCALE_FILTER_NEAREST;
+    }
+
+    if (ctx->filter == SCALE_FILTER_BILINEAR) {
+        ctx->src_rows[0] = (uint8_t *)scale_alloc(w * 3);
+        ctx->src_rows[1] = (uint8_t *)scale_alloc(w * 3);
+        ctx->bx0 = (uint16_t *)scale_alloc(ctx->output_width * sizeof(uint16_t));
+        ctx->bfx = (uint8_t *)scale_alloc(ctx->output_width);
+        ctx->by0 = (uint16_t *)scale_alloc(ctx->output_height * sizeof(uint16_t));
+        ctx->bfy = (uint8_t *)scale_alloc(ctx->output_height);
+        if (!ctx->src_rows[0] || !ctx->src_rows[1] || !ctx->bx0 || !ctx->bfx || !ctx->by0 || !ctx->bfy) {
+            scale_fail(ctx, PNGLE_SCALE_ERR_MEMORY, "Failed to allocate bilinear tables");
+            return;
+        }
+        scale_build_bilinear(ctx->bx0, ctx->bfx, ctx->out_x0, ctx->out_x1, w, ctx->scale_x, shift_x);
+        scale_build_bilinear(ctx->by0, ctx->bfy, ctx->out_y0, ctx->out_y1, h, ctx->scale_y, shift_y);
+        ctx->next_out_row = ctx->out_y0;
+        pngle_set_draw_callback(pngle, bilinear_draw_callback);
+    } else {
+        ctx->col_index = (int16_t *)scale_alloc(w * sizeof(int16_t));
+        ctx->row_index = (int16_t *)scale_alloc(h * sizeof(int16_t));
+        if (!ctx->col_index || !ctx->row_index) {
+            scale_fail(ctx, PNGLE_SCALE_ERR_MEMORY, "Failed to allocate scale index tables");
+            return;
+        }
+        scale_build_index(ctx->col_index, w, ctx->scale_x, shift_x, ctx->out_x0, ctx->out_x1);
+        scale_build_index(ctx->row_index, h, ctx->scale_y, shift_y, ctx->out_y0, ctx->out_y1);
+
+        if (ctx->filter == SCALE_FILTER_AREA) {
+            ctx->acc = (uint32_t *)heap_caps_calloc(ctx->output_width * 3, sizeof(uint32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (!ctx->acc) {
+                ctx->acc = (uint32_t *)heap_caps_calloc(ctx->output_width * 3, sizeof(uint32_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            }
+            ctx->col_count = (uint16_t *)heap_caps_calloc(ctx->output_width, sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (!ctx->acc || !ctx->col_count) {
+                scale_fail(ctx, PNGLE_SCALE_ERR_MEMORY, "Failed to allocate area accumulators");
+                return;
+            }
+            for (int x = 0; x < w; x++) {
+                if (ctx->col_index[x] >= 0) {
+                    ctx->col_count[ctx->col_index[x]]++;
+                }
+            }
+            ctx->acc_row = -1;
+            ctx->acc_rows = 0;
+            pngle_set_draw_callback(pngle, area_draw_callback);
+        } else {
+            pngle_set_draw_callback(pngle, nearest_draw_callback);
+        }
+    }
+
+    static const char *filter_names[] = {"area average", "bilinear", "nearest"};
+    ESP_LOGI(TAG, "Resampling filter: %s", filter_names[ctx->filter]);
+}
+
+/**
+ * @brief Flush whatever the filter still holds once all pixels were drawn
+ */
+static void scale_finish(pngle_scale_ctx_t *ctx) {
+    if (ctx->finished || (!ctx->rgb_buffer && !ctx->out_row) || ctx->error_code != 0) {
+        return;
+    }
+    ctx->finished = 1;
+    if (ctx->filter == SCALE_FILTER_AREA) {
+        area_flush_row(ctx);
+    } else if (ctx->filter == SCALE_FILTER_BILINEAR && ctx->cur_y >= 0) {
+        bilinear_emit_rows(ctx, ctx->original_height - 1);
+    }
+
+    if (!ctx->row_cb) {
+        return;
+    }
+    if (ctx->rgb_buffer) {
+        // Nearest filter decoded into a full frame, hand it out row by row now
+        for (int y = 0; y < ctx->output_height && ctx->error_code == PNGLE_SCALE_OK; y++) {
+            if (ctx->row_cb(ctx->row_ctx, y, ctx->rgb_buffer + (size_t)y * ctx->output_width * 3) != 0) {
+                scale_fail(ctx, PNGLE_SCALE_ERR_ABORTED, "Row consumer aborted");
+            }
+        }
+        ctx->next_emit = ctx->output_height;
+    } else {
+        // Bottom letterbox and any rows the image never reached
+        scale_begin_row(ctx, ctx->output_height);
+    }
+}
+
 /**
  * @brief Init callback - called when PNG dimensions are known
  */
@@ -99,6 +525,23 @@ static void scale_init_callback(pngle_t *pngle, uint32_t w, uint32_t h) {
              ctx->scale_x, ctx->scale_y,
              ctx->offset_x, ctx->offset_y);
 
+    scale_setup_filter(pngle, ctx);
+    if (ctx->error_code != PNGLE_SCALE_OK) {
+        return;
+    }
+
+    if (ctx->row_cb && ctx->filter != SCALE_FILTER_NEAREST) {
+        // Streaming filters only ever need the output row being produced
+        ctx->out_row = (uint8_t *)scale_alloc(ctx->output_width * 3);
+        if (!ctx->out_row) {
+            scale_fail(ctx, PNGLE_SCALE_ERR_MEMORY, "Failed to allocate output row");
+            return;
+        }
+        memset(ctx->out_row, ctx->background, ctx->output_width * 3);
+        ctx->next_emit = 0;
+        return;
+    }
+
     // Allocate RGB buffer from SPIRAM
     size_t buffer_size = ctx->output_width * ctx->output_height * 3;
 
@@ -115,165 +558,268 @@ static void scale_init_callback(pngle_t *pngle, uint32_t w, uint32_t h) {
         return;
     }
 
-    // Initialize to black (for letterboxing in FIT mode)
-    memset(ctx->rgb_buffer, 0, buffer_size);
+    // Initialize to the background (black unless a row consumer asked otherwise) for letterboxing in FIT mode
+    memset(ctx->rgb_buffer, ctx->background, buffer_size);
 
     ESP_LOGI(TAG, "Output buffer allocated at %p", ctx->rgb_buffer);
 }
 
 /**
- * @brief Draw callback - called for each pixel
- *
- * For downscaling, we use area sampling by accumulating pixel values.
- * For simplicity, this implementation uses nearest-neighbor sampling
- * which is fast and works well for significant downscaling.
+ * @brief Done callback - called when decoding is complete
  */
-static void scale_draw_callback(pngle_t *pngle, uint32_t x, uint32_t y,
-                                 uint32_t w, uint32_t h, const uint8_t rgba[4]) {
+static void scale_done_callback(pngle_t *pngle) {
     pngle_scale_ctx_t *ctx = (pngle_scale_ctx_t *)pngle_get_user_data(pngle);
+    scale_finish(ctx);
+    ESP_LOGI(TAG, "PNG decoding complete");
+}
 
-    if (!ctx->rgb_buffer || ctx->error_code != 0) {
-        return;
+// ============================================================================
+// Incremental decoding
+// ============================================================================
+
+// Longest input pngle_feed() can leave unconsumed while waiting for more (the 13-byte IHDR)
+#define PNGLE_SCALE_CARRY_MAX 32
+
+struct pngle_scale_stream {
+    pngle_t *pngle;
+    pngle_scale_ctx_t ctx;
+    uint8_t carry[PNGLE_SCALE_CARRY_MAX];   // Input bytes pngle could not use yet
+    size_t carry_len;
+    size_t fed;                             // Total input bytes
+    int status;                             // First error, sticky
+};
+
+static int stream_fail(pngle_scale_stream_t *s, int code) {
+    if (s->status == PNGLE_SCALE_OK) {
+        s->status = code;
     }
+    return s->status;
+}
 
-    // Calculate output position
-    int out_x, out_y;
+pngle_scale_stream_t *pngle_scale_stream_new(int target_width, int target_height,
+                                             pngle_scale_mode_t scale_mode, uint8_t background,
+                                             pngle_scale_row_cb_t row_cb, void *user_ctx) {
+    pngle_scale_stream_t *s = (pngle_scale_stream_t *)heap_caps_calloc(1, sizeof(pngle_scale_stream_t),
+                                                                       MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s) {
+        ESP_LOGE(TAG, "Failed to allocate stream context");
+        return NULL;
+    }
 
-    if (ctx->scale_mode == PNGLE_SCALE_FILL) {
-        // For FILL mode, calculate position considering crop
-        float scaled_w = ctx->original_width * ctx->scale_x;
-        float scaled_h = ctx->original_height * ctx->scale_y;
-        float crop_x = (scaled_w - ctx->output_width) / 2.0f;
-        float crop_y = (scaled_h - ctx->output_height) / 2.0f;
-
-        out_x = (int)(x * ctx->scale_x - crop_x);
-        out_y = (int)(y * ctx->scale_y - crop_y);
-    } else if (ctx->scale_mode == PNGLE_SCALE_FIT) {
-        // For FIT mode, calculate position with offset
-        float scale = ctx->scale_x;  // scale_x == scale_y in FIT mode
-        int scaled_w = (int)(ctx->original_width * scale);
-        int scaled_h = (int)(ctx->original_height * scale);
-        int off_x = (ctx->output_width - scaled_w) / 2;
-        int off_y = (ctx->output_height - scaled_h) / 2;
-
-        out_x = (int)(x * scale) + off_x;
-        out_y = (int)(y * scale) + off_y;
-    } else {
-        // STRETCH mode
-        out_x = (int)(x * ctx->scale_x);
-        out_y = (int)(y * ctx->scale_y);
+    s->pngle = pngle_new();
+    if (!s->pngle) {
+        ESP_LOGE(TAG, "Failed to create pngle instance");
+        heap_caps_free(s);
+        return NULL;
     }
 
-    // Bounds check
-    if (out_x < 0 || out_x >= ctx->output_width ||
-        out_y < 0 || out_y >= ctx->output_height) {
-        return;
+    // Setup context
+    s->ctx.target_width = target_width;
+    s->ctx.target_height = target_height;
+    s->ctx.scale_x = 1.0f;
+    s->ctx.scale_y = 1.0f;
+    s->ctx.scale_mode = scale_mode;
+    s->ctx.error_code = PNGLE_SCALE_OK;
+    s->ctx.cur_y = -1;
+    s->ctx.acc_row = -1;
+    s->ctx.row_cb = row_cb;
+    s->ctx.row_ctx = user_ctx;
+    s->ctx.background = background;
+    s->status = PNGLE_SCALE_OK;
+
+    pngle_set_user_data(s->pngle, &s->ctx);
+    pngle_set_init_callback(s->pngle, scale_init_callback);
+    // The draw callback is picked by scale_init_callback once the filter is known
+    pngle_set_done_callback(s->pngle, scale_done_callback);
+    return s;
+}
+
+int pngle_scale_stream_feed(pngle_scale_stream_t *s, const uint8_t *data, size_t len) {
+    if (!s) {
+        return PNGLE_SCALE_ERR_PARAM;
+    }
+    if (s->status != PNGLE_SCALE_OK) {
+        return s->status;
+    }
+    s->fed += len;
+
+    // Bytes left over from the previous call come first: complete them from the new data
+    while (s->carry_len > 0 && len > 0) {
+        size_t take = PNGLE_SCALE_CARRY_MAX - s->carry_len;
+        if (take == 0) {
+            ESP_LOGE(TAG, "PNG decoder stalled on %zu buffered bytes", s->carry_len);
+            return stream_fail(s, PNGLE_SCALE_ERR_PNG_DECODE);
+        }
+        if (take > len) {
+            take = len;
+        }
+        memcpy(s->carry + s->carry_len, data, take);
+        size_t total = s->carry_len + take;
+        int used = pngle_feed(s->pngle, s->carry, total);
+        if (used < 0) {
+            ESP_LOGE(TAG, "PNG decode error: %s", pngle_error(s->pngle));
+            return stream_fail(s, PNGLE_SCALE_ERR_PNG_DECODE);
+        }
+        if ((size_t)used >= s->carry_len) {
+            // Everything carried was used, continue from the first unused byte of data
+            data += used - s->carry_len;
+            len -= used - s->carry_len;
+            s->carry_len = 0;
+        } else {
+            memmove(s->carry, s->carry + used, total - used);
+            s->carry_len = total - used;
+            data += take;
+            len -= take;
+        }
     }
 
-    // Write RGB (ignore alpha for now)
-    size_t offset = (out_y * ctx->output_width + out_x) * 3;
-    ctx->rgb_buffer[offset + 0] = rgba[0];  // R
-    ctx->rgb_buffer[offset + 1] = rgba[1];  // G
-    ctx->rgb_buffer[offset + 2] = rgba[2];  // B
+    // Feed in slices so a failed allocation or an aborting row consumer stops the inflate early
+    while (len > 0 && s->ctx.error_code == PNGLE_SCALE_OK) {
+        size_t slice = len < PNGLE_SCALE_FEED_CHUNK ? len : PNGLE_SCALE_FEED_CHUNK;
+        int used = pngle_feed(s->pngle, data, slice);
+        if (used < 0) {
+            ESP_LOGE(TAG, "PNG decode error: %s", pngle_error(s->pngle));
+            return stream_fail(s, PNGLE_SCALE_ERR_PNG_DECODE);
+        }
+        int last = (slice == len);
+        data += used;
+        len -= used;
+        if ((size_t)used < slice && last) {
+            // pngle wants more than is left: keep the tail for the next call
+            if (len > PNGLE_SCALE_CARRY_MAX) {
+                ESP_LOGE(TAG, "PNG decoder left %zu bytes unconsumed", len);
+                return stream_fail(s, PNGLE_SCALE_ERR_PNG_DECODE);
+            }
+            break;
+        }
+        if (used == 0) {
+            ESP_LOGE(TAG, "PNG decoder made no progress");
+            return stream_fail(s, PNGLE_SCALE_ERR_PNG_DECODE);
+        }
+    }
+    if (s->ctx.error_code != PNGLE_SCALE_OK) {
+        return stream_fail(s, s->ctx.error_code);
+    }
+    if (len > 0) {
+        memcpy(s->carry, data, len);
+        s->carry_len = len;
+    }
+    return PNGLE_SCALE_OK;
 }
 
-/**
- * @brief Done callback - called when decoding is complete
- */
-static void scale_done_callback(pngle_t *pngle) {
-    pngle_scale_ctx_t *ctx = (pngle_scale_ctx_t *)pngle_get_user_data(pngle);
-    ESP_LOGI(TAG, "PNG decoding complete");
-    (void)ctx;
+void pngle_scale_stream_free(pngle_scale_stream_t *s) {
+    if (!s) {
+        return;
+    }
+    scale_free_tables(&s->ctx);
+    heap_caps_free(s->ctx.rgb_buffer);
+    pngle_destroy(s->pngle);
+    heap_caps_free(s);
 }
 
-int pngle_scale_decode(const uint8_t *png_data, size_t png_len,
-                       int target_width, int target_height,
-                       pngle_scale_mode_t scale_mode,
-                       pngle_scale_result_t *result) {
-    if (!png_data || png_len == 0 || !result) {
+int pngle_scale_stream_finish(pngle_scale_stream_t *s, pngle_scale_result_t *result) {
+    if (!s || !result) {
+        pngle_scale_stream_free(s);
         return PNGLE_SCALE_ERR_PARAM;
     }
 
     // Initialize result
     memset(result, 0, sizeof(pngle_scale_result_t));
+    pngle_scale_ctx_t *ctx = &s->ctx;
 
-    // Create pngle instance
-    pngle_t *pngle = pngle_new();
-    if (!pngle) {
-        ESP_LOGE(TAG, "Failed to create pngle instance");
-        return PNGLE_SCALE_ERR_PNG_INIT;
+    if (s->status == PNGLE_SCALE_ERR_PNG_DECODE) {
+        pngle_scale_stream_free(s);
+        return PNGLE_SCALE_ERR_PNG_DECODE;
     }
 
-    // Setup context
-    pngle_scale_ctx_t ctx = {
-        .rgb_buffer = NULL,
-        .target_width = target_width,
-        .target_height = target_height,
-        .original_width = 0,
-        .original_height = 0,
-        .output_width = 0,
-        .output_height = 0,
-        .offset_x = 0,
-        .offset_y = 0,
-        .scale_x = 1.0f,
-        .scale_y = 1.0f,
-        .scale_mode = scale_mode,
-        .error_code = PNGLE_SCALE_OK,
-        .error_msg = NULL
-    };
-
-    pngle_set_user_data(pngle, &ctx);
-    pngle_set_init_callback(pngle, scale_init_callback);
-    pngle_set_draw_callback(pngle, scale_draw_callback);
-    pngle_set_done_callback(pngle, scale_done_callback);
-
-    ESP_LOGI(TAG, "Starting PNG decode: %zu bytes input", png_len);
-
-    // Feed all PNG data
-    int fed = pngle_feed(pngle, png_data, png_len);
-
-    if (fed < 0) {
-        ESP_LOGE(TAG, "PNG decode error: %s", pngle_error(pngle));
-        if (ctx.rgb_buffer) {
-            heap_caps_free(ctx.rgb_buffer);
-        }
-        pngle_destroy(pngle);
-        return PNGLE_SCALE_ERR_PNG_DECODE;
+    // Flush the last rows in case the stream ended without IEND
+    if (s->status == PNGLE_SCALE_OK) {
+        scale_finish(ctx);
+    }
+    int streamed = ctx->out_row != NULL;
+    scale_free_tables(ctx);
+
+    // Row mode hands out the frame itself, no buffer is returned
+    if (ctx->row_cb && ctx->rgb_buffer) {
+        heap_caps_free(ctx->rgb_buffer);
+        ctx->rgb_buffer = NULL;
+        streamed = 1;
     }
 
     // Check for errors during decoding
-    if (ctx.error_code != PNGLE_SCALE_OK) {
-        ESP_LOGE(TAG, "Decode error: %s", ctx.error_msg ? ctx.error_msg : "unknown");
-        if (ctx.rgb_buffer) {
-            heap_caps_free(ctx.rgb_buffer);
-        }
-        pngle_destroy(pngle);
-        return ctx.error_code;
+    if (ctx->error_code != PNGLE_SCALE_OK) {
+        ESP_LOGE(TAG, "Decode error: %s", ctx->error_msg ? ctx->error_msg : "unknown");
+        int err = ctx->error_code;
+        pngle_scale_stream_free(s);
+        return err;
     }
 
-    // Verify we got a buffer
-    if (!ctx.rgb_buffer) {
+    // Verify we got a buffer (or rows)
+    if (!ctx->rgb_buffer && !streamed) {
         ESP_LOGE(TAG, "No output buffer - decode may have failed");
-        pngle_destroy(pngle);
+        pngle_scale_stream_free(s);
         return PNGLE_SCALE_ERR_PNG_DECODE;
     }
 
-    // Fill result
-    result->rgb_buffer = ctx.rgb_buffer;
-    result->width = ctx.output_width;
-    result->height = ctx.output_height;
-    result->original_width = ctx.original_width;
-    result->original_height = ctx.original_height;
-    result->buffer_size = ctx.output_width * ctx.output_height * 3;
+    // Fill result, the buffer now belongs to the caller
+    result->rgb_buffer = ctx->rgb_buffer;
+    result->width = ctx->output_width;
+    result->height = ctx->output_height;
+    result->original_width = ctx->original_width;
+    result->original_height = ctx->original_height;
+    result->buffer_size = ctx->rgb_buffer ? ctx->output_width * ctx->output_height * 3 : 0;
+    ctx->rgb_buffer = NULL;
 
-    ESP_LOGI(TAG, "PNG decode complete: %dx%d -> %dx%d",
+    ESP_LOGI(TAG, "PNG decode complete: %dx%d -> %dx%d (%zu bytes input)",
              result->original_width, result->original_height,
-             result->width, result->height);
+             result->width, result->height, s->fed);
 
-    pngle_destroy(pngle);
+    pngle_scale_stream_free(s);
     return PNGLE_SCALE_OK;
 }
 
+// ============================================================================
+// One-shot decoding
+// ============================================================================
+
+static int scale_decode(const uint8_t *png_data, size_t png_len,
+                        int target_width, int target_height,
+                        pngle_scale_mode_t scale_mode, uint8_t background,
+                        pngle_scale_row_cb_t row_cb, void *row_ctx,
+                        pngle_scale_result_t *result) {
+    if (!png_data || png_len == 0 || !result) {
+        return PNGLE_SCALE_ERR_PARAM;
+    }
+
+    pngle_scale_stream_t *s = pngle_scale_stream_new(target_width, target_height, scale_mode,
+                                                     background, row_cb, row_ctx);
+    if (!s) {
+        return PNGLE_SCALE_ERR_PNG_INIT;
+    }
+
+    ESP_LOGI(TAG, "Starting PNG decode: %zu bytes input", png_len);
+    pngle_scale_stream_feed(s, png_data, png_len);
+    return pngle_scale_stream_finish(s, result);
+}
+
+int pngle_scale_decode(const uint8_t *png_data, size_t png_len,
+                       int target_width, int target_height,
+                       pngle_scale_mode_t scale_mode,
+                       pngle_scale_result_t *result) {
+    return scale_decode(png_data, png_len, target_width, target_height, scale_mode, 0, NULL, NULL, result);
+}
+
+int pngle_scale_decode_rows(const uint8_t *png_data, size_t png_len,
+                            int target_width, int target_height,
+                            pngle_scale_mode_t scale_mode, uint8_t background,
+                            pngle_scale_row_cb_t row_cb, void *user_ctx,
+                            pngle_scale_result_t *result) {
+    if (!row_cb) {
+        return PNGLE_SCALE_ERR_PARAM;
+    }
+    return scale_decode(png_data, png_len, target_width, target_height, scale_mode, background, row_cb, user_ctx, result);
+}
+
 const char *pngle_scale_error_text(int error_code) {
     switch (error_code) {
         case PNGLE_SCALE_OK:
@@ -286,6 +832,8 @@ const char *pngle_scale_error_text(int error_code) {
             return "Failed to initialize PNG decoder";
         case PNGLE_SCALE_ERR_PNG_DECODE:
             return "PNG decode error";
+        case PNGLE_SCALE_ERR_ABORTED:
+            return "Aborted by row consumer";
         default:
             return "Unknown error";
     }
@@ -4,6 +4,14 @@
  *
  * This wrapper provides PNG decoding with automatic downscaling to target
  * dimensions, using minimal memory by processing pixels as they are decoded.
+ * Downscaling averages every source pixel into its output pixel (box filter),
+ * upscaling interpolates bilinearly from two buffered source rows, and
+ * interlaced PNGs fall back to nearest neighbour.
+ *
+ * pngle_scale_decode_rows() hands each output row to a callback as soon as it
+ * is complete, so a consumer (e.g. the ditherer) can run without any full
+ * frame buffer. Only the interlaced fallback still decodes a whole frame
+ * first, since its passes arrive out of order.
  */
 
 #ifndef PNGLE_SCALE_H
@@ -56,6 +64,66 @@ int pngle_scale_decode(const uint8_t *png_data, size_t png_len,
                        pngle_scale_mode_t scale_mode,
                        pngle_scale_result_t *result);
 
+/**
+ * @brief Output row consumer for pngle_scale_decode_rows()
+ *
+ * @param user_ctx Pointer passed to pngle_scale_decode_rows()
+ * @param y Output row, called exactly once per row in order 0..height-1
+ * @param rgb_row width RGB888 pixels, only valid during the call
+ * @return 0 to continue, non-zero to abort the decode
+ */
+typedef int (*pngle_scale_row_cb_t)(void *user_ctx, int y, const uint8_t *rgb_row);
+
+/**
+ * @brief Decode PNG with scaling, streaming output rows to a callback
+ *
+ * Same scaling as pngle_scale_decode(), but no output buffer is kept:
+ * result->rgb_buffer is NULL and only the dimensions are filled in.
+ *
+ * @param background Grey level of the letterbox bars in FIT mode
+ * @param row_cb Receives every output row in order
+ * @param user_ctx Passed through to row_cb
+ * @return 0 on success, PNGLE_SCALE_ERR_ABORTED if row_cb stopped the decode
+ */
+int pngle_scale_decode_rows(const uint8_t *png_data, size_t png_len,
+                            int target_width, int target_height,
+                            pngle_scale_mode_t scale_mode, uint8_t background,
+                            pngle_scale_row_cb_t row_cb, void *user_ctx,
+                            pngle_scale_result_t *result);
+
+/**
+ * @brief Incremental decoder for PNG data that arrives in pieces (e.g. over HTTP)
+ */
+typedef struct pngle_scale_stream pngle_scale_stream_t;
+
+/**
+ * @brief Start an incremental decode, same parameters as pngle_scale_decode_rows()
+ *
+ * row_cb may be NULL to decode into a buffer returned by pngle_scale_stream_finish().
+ *
+ * @return Stream handle, NULL if out of memory
+ */
+pngle_scale_stream_t *pngle_scale_stream_new(int target_width, int target_height,
+                                             pngle_scale_mode_t scale_mode, uint8_t background,
+                                             pngle_scale_row_cb_t row_cb, void *user_ctx);
+
+/**
+ * @brief Feed the next piece of PNG data, any split is fine
+ * @return 0 on success, negative error code once decoding failed (sticky)
+ */
+int pngle_scale_stream_feed(pngle_scale_stream_t *stream, const uint8_t *data, size_t len);
+
+/**
+ * @brief Flush the remaining rows, fill result and release the stream
+ * @return 0 on success, negative error code on failure
+ */
+int pngle_scale_stream_finish(pngle_scale_stream_t *stream, pngle_scale_result_t *result);
+
+/**
+ * @brief Release a stream without finishing it (abort), NULL is ignored
+ */
+void pngle_scale_stream_free(pngle_scale_stream_t *stream);
+
 /**
  * @brief Get error message for error code
  *
@@ -70,6 +138,7 @@ const char *pngle_scale_error_text(int error_code);
 #define PNGLE_SCALE_ERR_MEMORY     -2
 #define PNGLE_SCALE_ERR_PNG_INIT   -3
 #define PNGLE_SCALE_ERR_PNG_DECODE -4
+#define PNGLE_SCALE_ERR_ABORTED    -5
 
 #ifdef __cplusplus
 }
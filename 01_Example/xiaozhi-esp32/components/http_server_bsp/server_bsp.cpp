@@ -4,14 +4,18 @@
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
 #include "sdcard_bsp.h"
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
 
 static const char *TAG = "server_bsp";
 
 #define MIN(x, y) ((x < y) ? (x) : (y))
 #define READ_LEN_MAX (10 * 1024) // Buffer area for receiving data
-#define SEND_LEN_MAX (5 * 1024)  // Data for sending response
+#define UPLOAD_FILE_BUF_LEN (32 * 1024) // stdio buffer when uploads are saved to the card
 
 #define EXAMPLE_ESP_WIFI_SSID "esp_network"
 #define EXAMPLE_ESP_WIFI_PASS "1234567890"
@@ -20,10 +24,14 @@ static const char *TAG = "server_bsp";
 
 EventGroupHandle_t server_groups;
 
+static const server_upload_sink_t *upload_sink = NULL;   // NULL: uploads are saved to SERVER_UPLOAD_PATH
+
+void http_server_set_upload_sink(const server_upload_sink_t *sink) {
+    upload_sink = sink;
+}
+
 /*Callback function*/
-esp_err_t get_html_callback(httpd_req_t *req);
-esp_err_t get_css_callback(httpd_req_t *req);
-esp_err_t get_js_callback(httpd_req_t *req);
+esp_err_t get_static_callback(httpd_req_t *req);
 esp_err_t post_dataup_callback(httpd_req_t *req);
 esp_err_t get_404_callback(httpd_req_t *req);
 
@@ -39,24 +47,14 @@ void http_server_init(void) {
     httpd_uri_t uri_get = {};
     uri_get.method      = HTTP_GET;
     uri_get.user_ctx    = NULL;
-    uri_get.uri         = "/index.html";
-    uri_get.handler     = get_html_callback;
-    httpd_register_uri_handler(server, &uri_get);
-
-    uri_get.uri     = "/assets/bootstrap/css/bootstrap.min.css";
-    uri_get.handler = get_css_callback;
-    httpd_register_uri_handler(server, &uri_get);
-
-    uri_get.uri     = "/assets/css/styles.min.css";
-    uri_get.handler = get_css_callback;
+    uri_get.uri         = "/";
+    uri_get.handler     = get_static_callback;
     httpd_register_uri_handler(server, &uri_get);
 
-    uri_get.uri     = "/assets/js/script.min.js";
-    uri_get.handler = get_js_callback;
+    uri_get.uri = "/index.html";
     httpd_register_uri_handler(server, &uri_get);
 
-    uri_get.uri     = "/assets/bootstrap/js/bootstrap.min.js";
-    uri_get.handler = get_js_callback;
+    uri_get.uri = "/assets/*";
     httpd_register_uri_handler(server, &uri_get);
 
     httpd_uri_t uri_post = {};
@@ -74,128 +72,229 @@ void http_server_init(void) {
     httpd_register_uri_handler(server, &uri_404);
 }
 
-/*The callback function for handling GET requests*/
-esp_err_t get_html_callback(httpd_req_t *req) {
-    char       *buf;
-    size_t      buf_len;
-    const char *uri = req->uri;                                     // The desired URI
-    buf_len         = httpd_req_get_hdr_value_len(req, "Host") + 1; // Obtain the length of the host address
-
-    if (buf_len > 1) {
-        buf = (char *) malloc(buf_len);
-        if (httpd_req_get_hdr_value_str(req, "Host", buf, buf_len) == ESP_OK) {
-            ESP_LOGI(TAG, "Found header => Host: %s", buf);
+/*
+Static files of the AP web UI, served from STATIC_ROOT.
+
+A pre-gzipped "<file>.gz" next to a file is sent instead with
+Content-Encoding: gzip when the client accepts it and the .gz is not older
+than the file (scripts/gzip_web_assets.py makes them), so an edited file on
+the card is never hidden by a stale .gz. Responses carry an ETag built from
+the size and mtime of the file sent, so a revalidating browser gets a 304
+without any file read, and cache slots are keyed on the same file.
+Files up to STATIC_CACHE_FILE_MAX are kept in a small PSRAM LRU cache; the
+httpd task runs one handler at a time, so the cache needs no lock.
+*/
+#define STATIC_ROOT           "/sdcard/03_sys_ap_html"
+#define STATIC_CHUNK_LEN      (32 * 1024)    // File read / send chunk
+#define STATIC_CACHE_SLOTS    8
+#define STATIC_CACHE_BYTES    (512 * 1024)   // 0 disables the cache
+#define STATIC_CACHE_FILE_MAX (256 * 1024)
+
+typedef struct {
+    char     path[128];   // Served file, including a ".gz" suffix
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t used;        // static_cache_clock at the last hit
+    uint8_t *data;        // PSRAM, NULL for a free slot
+} static_cache_t;
+
+static static_cache_t static_cache[STATIC_CACHE_SLOTS];
+static size_t         static_cache_bytes = 0;
+static uint32_t       static_cache_clock = 0;
+
+static const char *static_mime_type(const char *path) {
+    static const struct {
+        const char *ext;
+        const char *type;
+    } types[] = {
+        {".html", "text/html"},
+        {".css", "text/css"},
+        {".js", "application/javascript"},
+        {".json", "application/json"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".bmp", "image/bmp"},
+        {".svg", "image/svg+xml"},
+        {".ico", "image/x-icon"},
+        {".woff2", "font/woff2"},
+    };
+    const char *ext = strrchr(path, '.');
+    if (ext != NULL) {
+        for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+            if (strcasecmp(ext, types[i].ext) == 0) {
+                return types[i].type;
+            }
         }
-        free(buf);
-        buf = NULL;
     }
+    return "application/octet-stream";
+}
 
-    /*Send response*/
-    char  *resp_str      = (char *) heap_caps_malloc(SEND_LEN_MAX + 1, MALLOC_CAP_SPIRAM);
-    size_t str_respLen   = 0;
-    size_t str_len       = 0;
-    char   Name_str[125] = {""};
-    snprintf(Name_str, sizeof(Name_str), "/sdcard/03_sys_ap_html%.100s", uri);
-    httpd_resp_set_type(req, "text/html");
-    while (1) {
-        str_len = sdcard_read_offset(Name_str,resp_str,SEND_LEN_MAX,str_respLen);
-        if (str_len) {
-            httpd_resp_send_chunk(req, resp_str, str_len); //Send data
-            str_respLen += str_len;
-        } else {
-            break;
-        }
-    }
-    httpd_resp_send_chunk(req, NULL, 0);               // Send empty data to indicate completion of transmission
-    if (httpd_req_get_hdr_value_len(req, "Host") == 0) // After sending the response, check if there are any remaining request headers. The ESP32 will send again after this.
-    {
-        ESP_LOGI(TAG, "Request headers lost");
+static bool static_header_has(httpd_req_t *req, const char *field, const char *value) {
+    char   buf[128];
+    size_t len = httpd_req_get_hdr_value_len(req, field);
+    if (len == 0 || len >= sizeof(buf) || httpd_req_get_hdr_value_str(req, field, buf, sizeof(buf)) != ESP_OK) {
+        return false;
     }
-    heap_caps_free(resp_str);
-    resp_str = NULL;
-    return ESP_OK;
+    return strstr(buf, value) != NULL;
 }
 
-esp_err_t get_css_callback(httpd_req_t *req) {
-    char       *buf;
-    size_t      buf_len;
-    const char *uri = req->uri;                                     // The desired URI
-    buf_len         = httpd_req_get_hdr_value_len(req, "Host") + 1; // Obtain the length of the host address
+static void static_cache_drop(static_cache_t *slot) {
+    heap_caps_free(slot->data);
+    slot->data = NULL;
+    static_cache_bytes -= slot->size;
+}
 
-    if (buf_len > 1) {
-        buf = (char *) malloc(buf_len);
-        if (httpd_req_get_hdr_value_str(req, "Host", buf, buf_len) == ESP_OK) {
-            ESP_LOGI(TAG, "Found header => Host: %s", buf);
+static static_cache_t *static_cache_find(const char *path, const struct stat *st) {
+    for (int i = 0; i < STATIC_CACHE_SLOTS; i++) {
+        static_cache_t *slot = &static_cache[i];
+        if (slot->data != NULL && strcmp(slot->path, path) == 0) {
+            if (slot->size == (uint32_t) st->st_size && slot->mtime == (uint32_t) st->st_mtime) {
+                slot->used = ++static_cache_clock;
+                return slot;
+            }
+            static_cache_drop(slot);   // Stale copy, the file was replaced on the card
+            return NULL;
         }
-        free(buf);
-        buf = NULL;
     }
+    return NULL;
+}
 
-    char  *resp_str      = (char *) heap_caps_malloc(SEND_LEN_MAX + 1, MALLOC_CAP_SPIRAM);
-    size_t str_respLen   = 0;
-    size_t str_len       = 0;
-    char   Name_str[125] = {""};
-    snprintf(Name_str, sizeof(Name_str), "/sdcard/03_sys_ap_html%.100s", uri);
-    httpd_resp_set_type(req, "text/css");
-    while (1) {
-        str_len = sdcard_read_offset(Name_str, resp_str, SEND_LEN_MAX, str_respLen);
-        if (str_len) {
-            httpd_resp_send_chunk(req, resp_str, str_len);
-            str_respLen += str_len;
-        } else {
-            break;
+/*Take a slot for size bytes, evicting least recently used files as needed*/
+static static_cache_t *static_cache_alloc(const char *path, const struct stat *st) {
+    size_t size = st->st_size;
+    if (size == 0 || size > STATIC_CACHE_FILE_MAX || size > STATIC_CACHE_BYTES || strlen(path) >= sizeof(static_cache[0].path)) {
+        return NULL;
+    }
+    for (;;) {
+        static_cache_t *free_slot = NULL;
+        static_cache_t *lru       = NULL;
+        for (int i = 0; i < STATIC_CACHE_SLOTS; i++) {
+            static_cache_t *slot = &static_cache[i];
+            if (slot->data == NULL) {
+                free_slot = free_slot ? free_slot : slot;
+            } else if (lru == NULL || slot->used < lru->used) {
+                lru = slot;
+            }
         }
+        if (free_slot != NULL && static_cache_bytes + size <= STATIC_CACHE_BYTES) {
+            free_slot->data = (uint8_t *) heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+            if (free_slot->data == NULL) {
+                return NULL;
+            }
+            snprintf(free_slot->path, sizeof(free_slot->path), "%s", path);
+            free_slot->size  = size;
+            free_slot->mtime = st->st_mtime;
+            free_slot->used  = ++static_cache_clock;
+            static_cache_bytes += size;
+            return free_slot;
+        }
+        if (lru == NULL) {
+            return NULL;
+        }
+        static_cache_drop(lru);
     }
+}
 
-    httpd_resp_send_chunk(req, NULL, 0);               // Send empty data to indicate completion of transmission
-    if (httpd_req_get_hdr_value_len(req, "Host") == 0) // After sending the response, check if there are any previous request headers left. The ESP32 will clear them after sending.
-    {
-        ESP_LOGI(TAG, "Request headers lost");
+esp_err_t get_static_callback(httpd_req_t *req) {
+    // Strip the query string and refuse to leave STATIC_ROOT
+    char   uri[100];
+    size_t uri_len = strcspn(req->uri, "?#");
+    if (uri_len >= sizeof(uri) || strstr(req->uri, "..") != NULL) {
+        return get_404_callback(req);
+    }
+    memcpy(uri, req->uri, uri_len);
+    uri[uri_len] = '\0';
+
+    char path[140];
+    snprintf(path, sizeof(path), STATIC_ROOT "%s%s", uri, uri[uri_len - 1] == '/' ? "index.html" : "");
+    const char *mime = static_mime_type(path);
+
+    // The .gz is only used while it is at least as new as the file it was made from
+    struct stat st;
+    bool        found    = stat(path, &st) == 0;
+    bool        gzip     = false;
+    size_t      path_len = strlen(path);
+    if (path_len + 3 < sizeof(path) && static_header_has(req, "Accept-Encoding", "gzip")) {
+        struct stat gz_st;
+        strcpy(path + path_len, ".gz");
+        if (stat(path, &gz_st) == 0) {
+            if (!found || gz_st.st_mtime >= st.st_mtime) {
+                gzip = true;
+                st   = gz_st;
+            } else {
+                ESP_LOGW(TAG, "%s is older than its source, sending the source", path);
+            }
+        }
+        if (!gzip) {
+            path[path_len] = '\0';
+        }
+    }
+    if (!gzip && !found) {
+        return get_404_callback(req);
     }
-    heap_caps_free(resp_str);
-    resp_str = NULL;
-    return ESP_OK;
-}
 
-esp_err_t get_js_callback(httpd_req_t *req) {
-    char       *buf;
-    size_t      buf_len;
-    const char *uri = req->uri;                                     // The desired URI
-    buf_len         = httpd_req_get_hdr_value_len(req, "Host") + 1; // Obtain the length of the host address
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"%lx-%lx%s\"", (unsigned long) st.st_size, (unsigned long) st.st_mtime, gzip ? "-gz" : "");
+    httpd_resp_set_type(req, mime);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    // Pages revalidate on every load, assets are reused for a day
+    httpd_resp_set_hdr(req, "Cache-Control", strcmp(mime, "text/html") == 0 ? "no-cache" : "max-age=86400");
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    if (gzip) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+    if (static_header_has(req, "If-None-Match", etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
 
-    if (buf_len > 1) {
-        buf = (char *) malloc(buf_len);
-        if (httpd_req_get_hdr_value_str(req, "Host", buf, buf_len) == ESP_OK) {
-            ESP_LOGI(TAG, "Found header => Host: %s", buf);
-        }
-        free(buf);
-        buf = NULL;
+    int64_t         start = esp_timer_get_time();
+    static_cache_t *slot  = STATIC_CACHE_BYTES > 0 ? static_cache_find(path, &st) : NULL;
+    if (slot != NULL) {
+        esp_err_t err = httpd_resp_send(req, (const char *) slot->data, slot->size);
+        ESP_LOGI(TAG, "%s: %lu bytes from cache in %lld ms", path, (unsigned long) slot->size, (esp_timer_get_time() - start) / 1000);
+        return err;
     }
 
-    char  *resp_str      = (char *) heap_caps_malloc(SEND_LEN_MAX + 1, MALLOC_CAP_SPIRAM);
-    size_t str_respLen   = 0;
-    size_t str_len       = 0;
-    char   Name_str[125] = {""};
-    snprintf(Name_str, sizeof(Name_str), "/sdcard/03_sys_ap_html%.100s", uri);
-    httpd_resp_set_type(req, "application/javascript");
-    while (1) {
-        str_len = sdcard_read_offset(Name_str, resp_str, SEND_LEN_MAX, str_respLen);
-        if (str_len) {
-            httpd_resp_send_chunk(req, resp_str, str_len);
-            str_respLen += str_len;
-        } else {
-            break;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return get_404_callback(req);
+    }
+    setvbuf(f, NULL, _IONBF, 0);   // Chunks are large, skip the stdio copy
+
+    // A cacheable file is read whole and sent from its cache slot
+    slot = STATIC_CACHE_BYTES > 0 ? static_cache_alloc(path, &st) : NULL;
+    if (slot != NULL) {
+        bool ok = fread(slot->data, 1, slot->size, f) == slot->size;
+        fclose(f);
+        if (!ok) {
+            static_cache_drop(slot);
+            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Read failed");
         }
+        esp_err_t err = httpd_resp_send(req, (const char *) slot->data, slot->size);
+        ESP_LOGI(TAG, "%s: %lu bytes in %lld ms (cached)", path, (unsigned long) slot->size, (esp_timer_get_time() - start) / 1000);
+        return err;
     }
 
-    httpd_resp_send_chunk(req, NULL, 0);               // Send empty data to indicate completion of transmission
-    if (httpd_req_get_hdr_value_len(req, "Host") == 0) // After sending the response, check if there are any previous request headers left. The ESP32 will clear them after sending.
-    {
-        ESP_LOGI(TAG, "Request headers lost");
+    char *chunk = (char *) heap_caps_malloc(STATIC_CHUNK_LEN, MALLOC_CAP_SPIRAM);
+    if (chunk == NULL) {
+        fclose(f);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
     }
-    heap_caps_free(resp_str);
-    resp_str = NULL;
-    return ESP_OK;
+    esp_err_t err  = ESP_OK;
+    size_t    sent = 0;
+    size_t    len;
+    while (err == ESP_OK && (len = fread(chunk, 1, STATIC_CHUNK_LEN, f)) > 0) {
+        err = httpd_resp_send_chunk(req, chunk, len);
+        sent += len;
+    }
+    fclose(f);
+    heap_caps_free(chunk);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);   // Send empty data to indicate completion of transmission
+    }
+    ESP_LOGI(TAG, "%s: %u bytes in %lld ms", path, (unsigned) sent, (esp_timer_get_time() - start) / 1000);
+    return err;
 }
 
 esp_err_t get_404_callback(httpd_req_t *req) {
@@ -206,29 +305,55 @@ esp_err_t get_404_callback(httpd_req_t *req) {
 }
 
 esp_err_t post_dataup_callback(httpd_req_t *req) {
-    char       *buf        = (char *) heap_caps_malloc(READ_LEN_MAX + 1, MALLOC_CAP_SPIRAM);
-    size_t      sdcard_len = 0;
-    size_t      remaining  = req->content_len;
-    const char *uri        = req->uri;
-    size_t      ret;
+    char         *buf       = (char *) heap_caps_malloc(READ_LEN_MAX, MALLOC_CAP_SPIRAM);
+    size_t        remaining = req->content_len;
+    const char   *uri       = req->uri;
+    sdcard_file_t file      = {};
+    bool          ok;
     ESP_LOGI("TAG", "用户POST的URI是:%s,字节:%d", uri, remaining);
+    if (buf == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
     xEventGroupSetBits(server_groups, set_bit_button(0)); 
-    sdcard_write_offset("/sdcard/02_sys_ap_img/user_send.bmp", NULL, 0, 0);
+    int64_t start = esp_timer_get_time();
+    if (upload_sink != NULL) {
+        ok = upload_sink->begin(req->content_len);
+    } else {
+        // One open for the whole body, the DMA buffer turns the receive chunks into long sector writes
+        ok = sdcard_file_open(&file, SERVER_UPLOAD_PATH, "wb", UPLOAD_FILE_BUF_LEN, SDCARD_BUF_DMA) == ESP_OK;
+    }
     while (remaining > 0) {
         /* Read the data for the request */
-        if ((ret = httpd_req_recv(req, buf, MIN(remaining, READ_LEN_MAX))) <= 0) {
+        int ret = httpd_req_recv(req, buf, MIN(remaining, READ_LEN_MAX));
+        if (ret <= 0) {
             if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
                 /* Retry receiving if timeout occurred */
                 continue;
             }
-            return ESP_FAIL;
+            break;
+        }
+        // After a failure the rest of the body is still read, so the client gets the answer
+        if (ok) {
+            ok = upload_sink ? upload_sink->write((const uint8_t *) buf, ret) : sdcard_file_write(&file, buf, ret) == ret;
         }
-        size_t req_len = sdcard_write_offset("/sdcard/02_sys_ap_img/user_send.bmp", buf, ret, 1);
-        sdcard_len += req_len; // Final comparison result
         remaining -= ret;      // Subtract the data that has already been received
     }
+    if (upload_sink != NULL) {
+        ok = upload_sink->end(ok && remaining == 0);
+    } else if (file.f != NULL) {
+        ok = sdcard_file_close(&file) == ESP_OK && ok;
+        sdcard_log_stats("SD card");
+    }
+    heap_caps_free(buf);
+    buf = NULL;
     xEventGroupSetBits(server_groups, set_bit_button(1)); 
-    if (sdcard_len == req->content_len) {
+    ESP_LOGI(TAG, "[TIMING] Upload of %d bytes %s in %lld ms", req->content_len, ok && remaining == 0 ? "done" : "failed",
+             (esp_timer_get_time() - start) / 1000);
+    if (remaining > 0) {
+        xEventGroupSetBits(server_groups, set_bit_button(3));
+        return ESP_FAIL;
+    }
+    if (ok) {
         httpd_resp_send_chunk(req, "上传成功", strlen("上传成功"));
         xEventGroupSetBits(server_groups, set_bit_button(2));
     } 
@@ -237,9 +362,6 @@ esp_err_t post_dataup_callback(httpd_req_t *req) {
         xEventGroupSetBits(server_groups, set_bit_button(3));
     } 
     httpd_resp_send_chunk(req, NULL, 0);
-
-    heap_caps_free(buf);
-    buf = NULL;
     return ESP_OK;
 }
 
@@ -2,6 +2,23 @@
 #define SERVER_BSP_H
 
 #include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*Where POST /dataUP is saved when no upload sink is set*/
+#define SERVER_UPLOAD_PATH "/sdcard/02_sys_ap_img/user_send.bmp"
+
+/*
+Consumer of the POST /dataUP body, fed as it is received. write() is not
+called again once it returned false; end() gets complete = false if the
+body was cut short or a call failed, and returns the final result.
+*/
+typedef struct {
+    bool (*begin)(size_t content_len);
+    bool (*write)(const uint8_t *data, size_t len);
+    bool (*end)(bool complete);
+} server_upload_sink_t;
 
 extern EventGroupHandle_t server_groups;
 
@@ -13,6 +30,9 @@ void http_server_init(void);
 void Network_wifi_ap_init(void);
 void set_espWifi_sleep(void);
 
+/*Route uploads to sink instead of the SD card, NULL restores saving*/
+void http_server_set_upload_sink(const server_upload_sink_t *sink);
+
 
 #ifdef __cplusplus
 }
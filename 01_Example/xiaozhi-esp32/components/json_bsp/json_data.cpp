@@ -317,6 +317,12 @@ ai_model_t *json_sdcard_txt_aimodel(void) {
         data->dither.kernel = DITHER_STUCKI;
     } else if (strcmp(kernel_str, "sierra") == 0) {
         data->dither.kernel = DITHER_SIERRA_2_4A;
+    } else if (strcmp(kernel_str, "floyd_steinberg_wavefront") == 0) {
+        data->dither.kernel = DITHER_FLOYD_STEINBERG_WAVEFRONT;
+    } else if (strcmp(kernel_str, "bayer") == 0) {
+        data->dither.kernel = DITHER_ORDERED_BAYER;
+    } else if (strcmp(kernel_str, "blue_noise") == 0) {
+        data->dither.kernel = DITHER_BLUE_NOISE;
     } else {
         data->dither.kernel = DITHER_JARVIS;  // Default: best quality
     }
@@ -351,7 +357,8 @@ ai_model_t *json_sdcard_txt_aimodel(void) {
         ESP_LOGI("sdcardjson", "Dither color calibration loaded from config");
     }
 
-    const char *kernel_names[] = {"Floyd-Steinberg", "Jarvis", "Stucki", "Sierra-2-4A"};
+    const char *kernel_names[] = {"Floyd-Steinberg", "Jarvis", "Stucki", "Sierra-2-4A",
+                                  "Floyd-Steinberg (wavefront)", "Bayer 8x8", "Blue noise 32x32"};
     ESP_LOGI("sdcardjson", "Dither config: kernel=%s, serpentine=%s",
              kernel_names[data->dither.kernel], data->dither.serpentine ? "true" : "false");
 
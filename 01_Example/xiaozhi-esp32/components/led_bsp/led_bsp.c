@@ -1,12 +1,141 @@
 #include "led_bsp.h"
-#include "button_bsp.h"
 #include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
 #include <stdio.h>
 
-static EventGroupHandle_t led_groups;
+static const char *TAG = "led";
+
+#define LED_QUEUE_LEN 8
+
+/*
+One period is on_ms lit then off_ms dark, repeated count times (0 = until
+replaced or stopped), then the LED is left at end. A pattern without
+periods only sets end.
+*/
+typedef struct {
+    uint16_t on_ms;
+    uint16_t off_ms;
+    uint8_t  count;
+    uint8_t  end;
+} led_pattern_t;
+
+static const led_pattern_t led_patterns[LED_PATTERN_COUNT] = {
+    [LED_PATTERN_OFF]            = {0, 0, 0, LED_OFF},
+    [LED_PATTERN_ON]             = {0, 0, 0, LED_ON},
+    [LED_PATTERN_BUSY]           = {100, 100, 0, LED_OFF},
+    [LED_PATTERN_BUSY_LIT]       = {100, 100, 0, LED_ON},
+};
+
+typedef struct {
+    uint8_t          led;
+    led_pattern_id_t pattern;   // LED_PATTERN_COUNT stops the current one
+} led_request_t;
+
+typedef struct {
+    uint8_t              pin;
+    const led_pattern_t *pattern;   // NULL when idle
+    bool                 lit;       // In the on_ms half of the period
+    uint8_t              done;      // Periods completed
+    int64_t              next_us;   // Next edge
+} led_channel_t;
+
+static led_channel_t      led_channels[] = {{LED_PIN_Red}, {LED_PIN_Green}};
+static QueueHandle_t      led_queue      = NULL;
+static esp_timer_handle_t led_timer      = NULL;
+
+#define LED_CHANNEL_NUM (sizeof(led_channels) / sizeof(led_channels[0]))
+
+static led_channel_t *led_find_channel(uint8_t led) {
+    for (int i = 0; i < LED_CHANNEL_NUM; i++) {
+        if (led_channels[i].pin == led) {
+            return &led_channels[i];
+        }
+    }
+    return NULL;
+}
+
+static void led_channel_start(led_channel_t *ch, led_request_t *req, int64_t now) {
+    if (req->pattern >= LED_PATTERN_COUNT) {
+        if (ch->pattern) {
+            led_set(ch->pin, ch->pattern->end);
+        }
+        ch->pattern = NULL;
+        return;
+    }
+    const led_pattern_t *pattern = &led_patterns[req->pattern];
+    if (!pattern->on_ms && !pattern->off_ms) {
+        led_set(ch->pin, pattern->end);
+        ch->pattern = NULL;
+        return;
+    }
+    ch->pattern = pattern;
+    ch->lit     = true;
+    ch->done    = 0;
+    ch->next_us = now + pattern->on_ms * 1000;
+    led_set(ch->pin, LED_ON);
+}
+
+/*Move the channel past every edge due by now*/
+static void led_channel_advance(led_channel_t *ch, int64_t now) {
+    while (ch->pattern && ch->next_us <= now) {
+        const led_pattern_t *pattern = ch->pattern;
+        if (ch->lit) {
+            ch->lit      = false;
+            ch->next_us += pattern->off_ms * 1000;
+            led_set(ch->pin, LED_OFF);
+        } else if (pattern->count && ++ch->done >= pattern->count) {
+            led_set(ch->pin, pattern->end);
+            ch->pattern = NULL;
+        } else {
+            ch->lit      = true;
+            ch->next_us += pattern->on_ms * 1000;
+            led_set(ch->pin, LED_ON);
+        }
+    }
+}
+
+/*Takes the queued requests, drives the edges that are due and re-arms itself for the next one*/
+static void led_timer_callback(void *arg) {
+    int64_t       now = esp_timer_get_time();
+    led_request_t req;
+    while (xQueueReceive(led_queue, &req, 0) == pdTRUE) {
+        led_channel_t *ch = led_find_channel(req.led);
+        if (ch) {
+            led_channel_start(ch, &req, now);
+        }
+    }
+    int64_t next_us = 0;
+    for (int i = 0; i < LED_CHANNEL_NUM; i++) {
+        led_channel_advance(&led_channels[i], now);
+        if (led_channels[i].pattern && (!next_us || led_channels[i].next_us < next_us)) {
+            next_us = led_channels[i].next_us;
+        }
+    }
+    if (next_us) {
+        // Already armed only if led_request() kicked it meanwhile, that run re-arms instead
+        esp_timer_start_once(led_timer, next_us > now ? next_us - now : 0);
+    }
+}
+
+static void led_request(uint8_t led, led_pattern_id_t pattern) {
+    if (!led_queue) {
+        return;
+    }
+    led_request_t req = {led, pattern};
+    if (xQueueSend(led_queue, &req, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Request queue full, LED %d pattern %d dropped", led, pattern);
+        return;
+    }
+    /*Run the callback now, it picks the request up and re-arms for the running patterns*/
+    if (esp_timer_start_once(led_timer, 0) != ESP_OK) {
+        esp_timer_stop(led_timer);
+        esp_timer_start_once(led_timer, 0);
+    }
+}
 
 void led_init(void) {
-    led_groups              = xEventGroupCreate();
     gpio_config_t gpio_conf = {};
     gpio_conf.intr_type     = GPIO_INTR_DISABLE;
     gpio_conf.mode          = GPIO_MODE_OUTPUT;
@@ -18,103 +147,22 @@ void led_init(void) {
     led_set(LED_PIN_Red, LED_OFF);
     led_set(LED_PIN_Green, LED_OFF);
 
-    //xTaskCreate(led_Reg_loop_task, "led_Reg_loop_task", 2 * 1024, NULL, 3,NULL);
-    //xTaskCreate(led_Green_loop_task, "led_Green_loop_task", 2 * 1024, NULL, 3,NULL);
+    led_queue = xQueueCreate(LED_QUEUE_LEN, sizeof(led_request_t));
+    const esp_timer_create_args_t timer_args = {
+        .callback = led_timer_callback,
+        .name     = "led_pattern",
+    };
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_timer_create(&timer_args, &led_timer));
 }
 
 void led_set(uint8_t led, uint8_t mode) {
     gpio_set_level(led, mode);
 }
 
-void led_Reg_loop_task(void *arg) {
-    for (;;) {
-        EventBits_t even = xEventGroupWaitBits(led_groups, set_bit_button(0) | set_bit_button(1) | set_bit_button(2), pdFALSE, pdFALSE, 1000);
-        if (get_bit_data(even, 0)) //慢闪
-        {
-            led_set(LED_PIN_Red, 0);
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            led_set(LED_PIN_Red, 1);
-            vTaskDelay(pdMS_TO_TICKS(1000));
-        } else if (get_bit_data(even, 1)) //中闪
-        {
-            led_set(LED_PIN_Red, 0);
-            vTaskDelay(pdMS_TO_TICKS(500));
-            led_set(LED_PIN_Red, 1);
-            vTaskDelay(pdMS_TO_TICKS(500));
-        } else if (get_bit_data(even, 2)) //快闪
-        {
-            led_set(LED_PIN_Red, 0);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            led_set(LED_PIN_Red, 1);
-            vTaskDelay(pdMS_TO_TICKS(100));
-        } else {
-            led_set(LED_PIN_Red, 0);
-        }
-    }
-}
-
-void led_Green_loop_task(void *arg) {
-    for (;;) {
-        EventBits_t even = xEventGroupWaitBits(led_groups, set_bit_button(3) | set_bit_button(4) | set_bit_button(5), pdFALSE, pdFALSE, 1000);
-        if (get_bit_data(even, 3)) //慢闪
-        {
-            led_set(LED_PIN_Green, 0);
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            led_set(LED_PIN_Green, 1);
-            vTaskDelay(pdMS_TO_TICKS(1000));
-        } else if (get_bit_data(even, 4)) //中闪
-        {
-            led_set(LED_PIN_Green, 0);
-            vTaskDelay(pdMS_TO_TICKS(500));
-            led_set(LED_PIN_Green, 1);
-            vTaskDelay(pdMS_TO_TICKS(500));
-        } else if (get_bit_data(even, 5)) //快闪
-        {
-            led_set(LED_PIN_Green, 0);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            led_set(LED_PIN_Green, 1);
-            vTaskDelay(pdMS_TO_TICKS(100));
-        } else {
-            led_set(LED_PIN_Green, 1);
-        }
-    }
+void led_play(uint8_t led, led_pattern_id_t pattern) {
+    led_request(led, pattern);
 }
 
-/*
-  LED：LED序号 mode:闪烁速度
-*/
-void led_set_Flicker(uint8_t led, uint8_t mode) {
-    if (led == LED_PIN_Green) {
-        xEventGroupClearBits(led_groups, set_bit_button(3) | set_bit_button(4) | set_bit_button(5));
-        switch (mode) {
-        case 1:
-            xEventGroupSetBits(led_groups, set_bit_button(5));
-            break;
-        case 2:
-            xEventGroupSetBits(led_groups, set_bit_button(4));
-            break;
-        case 3:
-            xEventGroupSetBits(led_groups, set_bit_button(3));
-            break;
-        default:
-            break;
-        }
-    } else if (led == LED_PIN_Red) {
-        xEventGroupClearBits(led_groups, set_bit_button(0) | set_bit_button(1) | set_bit_button(2));
-        switch (mode) {
-        case 1:
-            xEventGroupSetBits(led_groups, set_bit_button(2)); //快
-            break;
-        case 2:
-            xEventGroupSetBits(led_groups, set_bit_button(1));
-            break;
-        case 3:
-            xEventGroupSetBits(led_groups, set_bit_button(0));
-            break;
-        default:
-            break;
-        }
-    } else {
-        xEventGroupClearBits(led_groups, set_bit_button(0) | set_bit_button(1) | set_bit_button(2) | set_bit_button(3) | set_bit_button(4) | set_bit_button(5));
-    }
+void led_stop(uint8_t led) {
+    led_request(led, LED_PATTERN_COUNT);
 }
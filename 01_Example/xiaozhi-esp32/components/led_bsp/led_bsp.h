@@ -5,25 +5,34 @@
 
 #define LED_PIN_Red   45
 #define LED_PIN_Green 42
-#define LED_ALL_OFF_PIN 255  
 
 #define LED_ON  0
 #define LED_OFF 1
 
+/*
+Patterns are played by one esp_timer, requests go through a queue, so a
+blink costs a timer callback per edge and no task is left waiting on it.
+*/
+typedef enum {
+    LED_PATTERN_OFF = 0,
+    LED_PATTERN_ON,
+    LED_PATTERN_BUSY,          // 100 ms blink until led_stop(), e.g. during a refresh
+    LED_PATTERN_BUSY_LIT,      // Same, left lit once stopped
+    LED_PATTERN_COUNT,
+} led_pattern_id_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void led_init(void);
 void led_set(uint8_t led,uint8_t mode);
-void led_Reg_loop_task(void *arg);
-void led_Green_loop_task(void *arg);
-void led_set_Flicker(uint8_t led,uint8_t mode);
+void led_play(uint8_t led, led_pattern_id_t pattern);
+void led_stop(uint8_t led);   // Ends the pattern in its final state
 
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif 
-
+#endif
@@ -0,0 +1,333 @@
+#include "power_bsp.h"
+#include "axp_prot.h"
+#include "driver/rtc_io.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdcard_bsp.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+static const char *TAG = "power";
+
+/*
+Rough current draw used for the per-cycle estimate in the log, measure the
+board and adjust. The battery voltage in the same line is the real figure.
+*/
+#define POWER_AWAKE_MA  45     // Awake, SD card and panel powered
+#define POWER_SLEEP_UA  150    // Deep sleep, including the AXP2101
+
+#define POWER_MIN_SLEEP_US (1000 * 1000) // Timer wake-up for an event already due
+#define POWER_SETTLE_MS    20            // Lets the last log lines leave the UART
+#define POWER_MAX_HOOKS    4
+
+#define POWER_BIT_CHANGED 0x01 // Sleep request, hold released or timeout changed
+
+/*
+Kept in RTC memory: due times use the system clock, which keeps running
+through deep sleep, so an event is not pushed back by unrelated wake-ups.
+Reset on a cold boot or esp_restart().
+*/
+typedef struct {
+    int64_t  due_us[POWER_EVENT_COUNT]; // 0 = not scheduled
+    int64_t  sleep_start_us;            // When the last deep sleep started
+    uint64_t awake_ms_total;
+    uint64_t sleep_ms_total;
+    uint32_t cycle;
+    int32_t  sleep_event;               // Event the wake-up timer was set for, -1 none
+} power_rtc_state_t;
+
+typedef struct {
+    EventGroupHandle_t group;
+    EventBits_t        bits;
+} power_target_t;
+
+static RTC_DATA_ATTR power_rtc_state_t power_state;
+
+static power_target_t     power_targets[POWER_EVENT_COUNT] = {};
+static void             (*power_hooks[POWER_MAX_HOOKS])(void) = {};
+static uint64_t           wake_pins       = 0;
+static int64_t            idle_timeout_us = 0;
+static int64_t            last_activity_us;
+static int                holds           = 0;
+static bool               sleep_requested = false;
+static int                wake_event      = -1;
+static int64_t            slept_ms        = 0;   // Length of the deep sleep this boot woke from
+static esp_timer_handle_t event_timer     = NULL;
+static EventGroupHandle_t power_groups    = NULL;
+static SemaphoreHandle_t  timer_mutex     = NULL;  // Serialises power_update_timer() callers
+static portMUX_TYPE       power_lock      = portMUX_INITIALIZER_UNLOCKED;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t hold_lock = NULL;
+#endif
+
+static int64_t power_now_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*Earliest scheduled event, -1 if none*/
+static int power_next_event(void) {
+    int next = -1;
+    for (int i = 0; i < POWER_EVENT_COUNT; i++) {
+        if (power_state.due_us[i] && (next < 0 || power_state.due_us[i] < power_state.due_us[next])) {
+            next = i;
+        }
+    }
+    return next;
+}
+
+/*Fire the due events that have a target and re-arm the timer for the next one with a target*/
+static void power_update_timer(void) {
+    int64_t     now = power_now_us();
+    int64_t     next_us = 0;
+    EventBits_t fire[POWER_EVENT_COUNT] = {};
+    xSemaphoreTake(timer_mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&power_lock);
+    for (int i = 0; i < POWER_EVENT_COUNT; i++) {
+        if (!power_state.due_us[i] || !power_targets[i].group) {
+            continue;
+        }
+        if (power_state.due_us[i] <= now) {
+            power_state.due_us[i] = 0;
+            fire[i]               = power_targets[i].bits;
+        } else if (!next_us || power_state.due_us[i] < next_us) {
+            next_us = power_state.due_us[i];
+        }
+    }
+    portEXIT_CRITICAL(&power_lock);
+    esp_timer_stop(event_timer);
+    if (next_us) {
+        esp_timer_start_once(event_timer, next_us - now);
+    }
+    xSemaphoreGive(timer_mutex);
+    for (int i = 0; i < POWER_EVENT_COUNT; i++) {
+        if (fire[i]) {
+            ESP_LOGI(TAG, "Event %d due", i);
+            xEventGroupSetBits(power_targets[i].group, fire[i]);
+        }
+    }
+}
+
+static void power_timer_callback(void *arg) {
+    power_update_timer();
+}
+
+/*One CSV line per wake cycle, appended to POWER_LOG_PATH*/
+static void power_log_cycle(int64_t awake_ms, int64_t sleep_us) {
+    int      mv       = axp_get_batt_voltage();
+    int      percent  = axp_get_batt_percent();
+    uint32_t est_uah  = (uint32_t) (awake_ms * POWER_AWAKE_MA / 3600 + sleep_us / 1000000 * POWER_SLEEP_UA / 3600);
+    power_state.awake_ms_total += awake_ms;
+    ESP_LOGI(TAG, "[TIMING] Cycle %lu: woke by %d/%d after %lld ms asleep, awake %lld ms, sleeping %lld s, battery %d mV %d%%, ~%lu uAh",
+             (unsigned long) power_state.cycle, (int) esp_sleep_get_wakeup_cause(), wake_event, slept_ms, awake_ms,
+             sleep_us / 1000000, mv, percent, (unsigned long) est_uah);
+    ESP_LOGI(TAG, "[TIMING] Totals: awake %llu s, asleep %llu s", power_state.awake_ms_total / 1000,
+             power_state.sleep_ms_total / 1000);
+#if POWER_LOG_TO_SDCARD
+    char line[128];
+    int  len = 0;
+    struct stat st;
+    if (stat(POWER_LOG_PATH, &st) != 0 || st.st_size == 0) {
+        // The cycle counter restarts on every cold boot, the file does not
+        len = snprintf(line, sizeof(line), "cycle,wake_cause,wake_event,slept_ms,awake_ms,sleep_s,batt_mv,batt_pct,est_uah\n");
+    }
+    len += snprintf(line + len, sizeof(line) - len, "%lu,%d,%d,%lld,%lld,%lld,%d,%d,%lu\n", (unsigned long) power_state.cycle,
+                    (int) esp_sleep_get_wakeup_cause(), wake_event, slept_ms, awake_ms, sleep_us / 1000000, mv, percent,
+                    (unsigned long) est_uah);
+    sdcard_write_offset(POWER_LOG_PATH, line, len, true);
+#endif
+}
+
+static void power_deep_sleep(void) {
+    for (int i = 0; i < POWER_MAX_HOOKS && power_hooks[i]; i++) {
+        power_hooks[i]();
+    }
+    esp_timer_stop(event_timer);
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+    if (wake_pins) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(esp_sleep_enable_ext1_wakeup_io(wake_pins, ESP_EXT1_WAKEUP_ANY_LOW));
+        for (int pin = 0; pin < 64; pin++) {
+            if ((wake_pins >> pin) & 0x01) {
+                ESP_ERROR_CHECK_WITHOUT_ABORT(rtc_gpio_pulldown_dis(pin));
+                ESP_ERROR_CHECK_WITHOUT_ABORT(rtc_gpio_pullup_en(pin));
+            }
+        }
+    }
+    int64_t now      = power_now_us();
+    int64_t sleep_us = 0;
+    int     next     = power_next_event();
+    if (next >= 0) {
+        sleep_us = power_state.due_us[next] - now;
+        if (sleep_us < POWER_MIN_SLEEP_US) {
+            sleep_us = POWER_MIN_SLEEP_US;
+        }
+        esp_sleep_enable_timer_wakeup(sleep_us);
+    }
+    power_state.sleep_event = next;
+    power_log_cycle(esp_timer_get_time() / 1000, sleep_us);
+    power_state.sleep_start_us = power_now_us();
+    fflush(stdout);
+    vTaskDelay(pdMS_TO_TICKS(POWER_SETTLE_MS));
+    esp_deep_sleep_start();
+}
+
+static void power_task(void *arg) {
+    for (;;) {
+        TickType_t wait = portMAX_DELAY;
+        portENTER_CRITICAL(&power_lock);
+        if (idle_timeout_us) {
+            int64_t left_us = last_activity_us + idle_timeout_us - esp_timer_get_time();
+            if (left_us <= 0) {
+                sleep_requested = true;
+            } else {
+                wait = pdMS_TO_TICKS(left_us / 1000) + 1;
+            }
+        }
+        bool sleep = sleep_requested && holds == 0;
+        portEXIT_CRITICAL(&power_lock);
+        if (sleep) {
+            power_deep_sleep();
+        }
+        xEventGroupWaitBits(power_groups, POWER_BIT_CHANGED, pdTRUE, pdFALSE, wait);
+    }
+}
+
+void power_init(void) {
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    if (cause == ESP_SLEEP_WAKEUP_UNDEFINED) {
+        memset(&power_state, 0, sizeof(power_state));
+        power_state.sleep_event = -1;
+    } else {
+        slept_ms = (power_now_us() - power_state.sleep_start_us) / 1000;
+        power_state.sleep_ms_total += slept_ms;
+    }
+    if (cause == ESP_SLEEP_WAKEUP_TIMER) {
+        wake_event = power_state.sleep_event;
+    }
+    power_state.cycle++;
+    last_activity_us = esp_timer_get_time();
+    power_groups     = xEventGroupCreate();
+    timer_mutex      = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t timer_args = {
+        .callback = power_timer_callback,
+        .name     = "power_event",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &event_timer));
+#if CONFIG_PM_ENABLE
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "power_hold", &hold_lock));
+#endif
+    xTaskCreate(power_task, "power_task", 4 * 1024, NULL, 2, NULL);
+    ESP_LOGI(TAG, "Cycle %lu, wake-up cause %d, event %d", (unsigned long) power_state.cycle, (int) cause, wake_event);
+}
+
+void power_set_light_sleep(bool enable) {
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz       = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz       = enable ? 40 : CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .light_sleep_enable = enable,
+    };
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_pm_configure(&pm_config));
+#else
+    if (enable) {
+        ESP_LOGW(TAG, "Light sleep needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE");
+    }
+#endif
+}
+
+void power_set_wake_pins(uint64_t mask) {
+    wake_pins = mask;
+}
+
+void power_on_event(power_event_t event, EventGroupHandle_t group, EventBits_t bits) {
+    portENTER_CRITICAL(&power_lock);
+    power_targets[event].group = group;
+    power_targets[event].bits  = bits;
+    portEXIT_CRITICAL(&power_lock);
+    power_update_timer();
+}
+
+void power_schedule(power_event_t event, uint32_t seconds) {
+    portENTER_CRITICAL(&power_lock);
+    power_state.due_us[event] = seconds ? power_now_us() + (int64_t) seconds * 1000000 : 0;
+    portEXIT_CRITICAL(&power_lock);
+    power_update_timer();
+}
+
+bool power_pending(power_event_t event) {
+    portENTER_CRITICAL(&power_lock);
+    bool pending = power_state.due_us[event] != 0;
+    portEXIT_CRITICAL(&power_lock);
+    return pending;
+}
+
+int power_wake_event(void) {
+    return wake_event;
+}
+
+void power_set_idle_timeout(uint32_t seconds) {
+    portENTER_CRITICAL(&power_lock);
+    idle_timeout_us  = (int64_t) seconds * 1000000;
+    last_activity_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&power_lock);
+    xEventGroupSetBits(power_groups, POWER_BIT_CHANGED);
+}
+
+void power_activity(void) {
+    portENTER_CRITICAL(&power_lock);
+    last_activity_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&power_lock);
+}
+
+void power_hold(void) {
+    portENTER_CRITICAL(&power_lock);
+    holds++;
+    portEXIT_CRITICAL(&power_lock);
+#if CONFIG_PM_ENABLE
+    if (hold_lock) {
+        esp_pm_lock_acquire(hold_lock);
+    }
+#endif
+}
+
+void power_release(void) {
+#if CONFIG_PM_ENABLE
+    if (hold_lock) {
+        esp_pm_lock_release(hold_lock);
+    }
+#endif
+    portENTER_CRITICAL(&power_lock);
+    if (holds > 0) {
+        holds--;
+    }
+    portEXIT_CRITICAL(&power_lock);
+    xEventGroupSetBits(power_groups, POWER_BIT_CHANGED);
+}
+
+void power_add_sleep_hook(void (*hook)(void)) {
+    for (int i = 0; i < POWER_MAX_HOOKS; i++) {
+        if (!power_hooks[i]) {
+            power_hooks[i] = hook;
+            return;
+        }
+    }
+    ESP_LOGE(TAG, "No room for another sleep hook");
+}
+
+void power_request_sleep(void) {
+    portENTER_CRITICAL(&power_lock);
+    sleep_requested = true;
+    portEXIT_CRITICAL(&power_lock);
+    xEventGroupSetBits(power_groups, POWER_BIT_CHANGED);
+}
@@ -0,0 +1,77 @@
+#ifndef POWER_BSP_H
+#define POWER_BSP_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Low-power service shared by the modes. It owns the deep sleep wake-up
+sources, the timers and the decision to sleep:
+
+- Scheduled events have a due time that survives deep sleep. An event due
+  while awake sets its bits in the owner's event group; while asleep the
+  earliest due event sets the wake-up timer.
+- The chip goes to deep sleep when a mode asks for it or after the idle
+  timeout, but only once every power_hold() has been released.
+- A hold also keeps a PM lock, so with automatic light sleep enabled
+  (CONFIG_PM_ENABLE) the chip only light sleeps between refreshes.
+
+Every wake cycle is logged with its awake time, the planned sleep and the
+battery voltage, and appended to POWER_LOG_PATH, so slideshow battery
+life can be measured from the card.
+*/
+
+#define POWER_LOG_PATH "/sdcard/power_log.csv"   // One CSV line per cycle, see power_bsp.c
+#define POWER_LOG_TO_SDCARD 1
+
+typedef enum {
+    POWER_EVENT_SLIDESHOW = 0,   // Basic mode: next picture
+    POWER_EVENT_SCORE,           // xiaozhi mode: next high-score picture
+    POWER_EVENT_AP_WAKE,         // Network mode: periodic AP wake-up
+    POWER_EVENT_COUNT,
+} power_event_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Call once at boot, before the modes start*/
+void power_init(void);
+
+/*Automatic light sleep while no hold is active (needs CONFIG_PM_ENABLE)*/
+void power_set_light_sleep(bool enable);
+
+/*Deep sleep wake-up keys, woken by any of them going low (ext1, pulled up)*/
+void power_set_wake_pins(uint64_t mask);
+
+/*Bits set in group when event comes due while awake, fires at once if it already is*/
+void power_on_event(power_event_t event, EventGroupHandle_t group, EventBits_t bits);
+
+/*Event due in seconds from now, 0 cancels it*/
+void power_schedule(power_event_t event, uint32_t seconds);
+bool power_pending(power_event_t event);
+
+/*Event the wake-up timer was set for, -1 if this boot was not a timer wake-up*/
+int power_wake_event(void);
+
+/*Deep sleep after seconds without power_activity(), 0 disables the timeout*/
+void power_set_idle_timeout(uint32_t seconds);
+void power_activity(void);
+
+/*Keep the chip awake (no light or deep sleep) for the duration of a refresh, upload ...*/
+void power_hold(void);
+void power_release(void);
+
+/*Called right before deep sleep, e.g. to stop Wi-Fi*/
+void power_add_sleep_hook(void (*hook)(void));
+
+/*Deep sleep as soon as no hold is active*/
+void power_request_sleep(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,7 +1,12 @@
 #include "sdcard_bsp.h"
 #include "esp_err.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_vfs_fat.h"
+#include "diskio_sdmmc.h"   // After esp_vfs_fat.h, uses the FATFS types
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "sdmmc_cmd.h"
 #include <dirent.h>
 #include <stdio.h>
@@ -20,19 +25,42 @@ static const char *TAG = "_sdcard";
 
 #define SDlist "/sdcard" 
 
+/*
+Mount tuning. The allocation unit is the FAT cluster size used if the card
+is ever formatted from here; FATFS only takes powers of two, and 32 KB
+clusters keep large images in few FAT lookups. max_files covers the open
+handles of the web server, the index and the mode tasks.
+*/
+#define SDCARD_MAX_FILES       8
+#define SDCARD_ALLOCATION_UNIT (32 * 1024)
+
 sdmmc_card_t *card_host = NULL;
 
-list_t *sdcard_scan_listhandle = NULL;
+static sdcard_stats_t sdcard_stats = {};
+static portMUX_TYPE   stats_lock   = portMUX_INITIALIZER_UNLOCKED;
 
-static list_node_t *Currently_node = NULL; 
+/*Cluster size and free space of the mounted card*/
+static void sdcard_log_fs_info(void) {
+    char    drv[3] = {(char) ('0' + ff_diskio_get_pdrv_card(card_host)), ':', 0};
+    FATFS  *fs;
+    DWORD   free_clusters;
+    if (f_getfree(drv, &free_clusters, &fs) != FR_OK) {
+        return;
+    }
+    uint32_t cluster = fs->csize * card_host->csd.sector_size;
+    ESP_LOGI(TAG, "FAT cluster %lu bytes, %llu MB free", (unsigned long) cluster,
+             (unsigned long long) free_clusters * cluster / (1024 * 1024));
+    if (cluster < 16 * 1024) {
+        ESP_LOGW(TAG, "Small clusters slow down large reads, format the card with %d KB units", SDCARD_ALLOCATION_UNIT / 1024);
+    }
+}
 
 uint8_t _sdcard_init(void) {
-    sdcard_scan_listhandle = list_new();
     esp_vfs_fat_sdmmc_mount_config_t mount_config =
         {
             .format_if_mount_failed = false,         
-            .max_files              = 5,             
-            .allocation_unit_size   = 16 * 1024 * 3, 
+            .max_files              = SDCARD_MAX_FILES,             
+            .allocation_unit_size   = SDCARD_ALLOCATION_UNIT, 
         };
 
     sdmmc_host_t host = SDMMC_HOST_DEFAULT();
@@ -51,6 +79,7 @@ uint8_t _sdcard_init(void) {
 
     if (card_host != NULL) {
         sdmmc_card_print_info(stdout, card_host);
+        sdcard_log_fs_info();
         return 1;
     }
     return 0;
@@ -139,27 +168,18 @@ int sdcard_read_file(const char *path, uint8_t *buffer, size_t *outLen) {
 * @param len    Length to read
 * @param offset Offset position
 * @param outLen Actual read length (can be NULL) 
+* @note  Opens the file on every call, loops should keep a sdcard_file_t open instead
 */
 int sdcard_read_offset(const char *path, void *buffer, size_t len, size_t offset) {
-    if (card_host == NULL) {
-        ESP_LOGE(TAG, "SD card not initialized");
-        return ESP_ERR_INVALID_STATE;
+    sdcard_file_t file;
+    esp_err_t     err = sdcard_file_open(&file, path, "rb", 0, 0);
+    if (err != ESP_OK) {
+        return err;
     }
 
-    if (sdmmc_get_status(card_host) != ESP_OK) {
-        ESP_LOGE(TAG, "SD card not ready");
-        return ESP_FAIL;
-    }
-
-    FILE *f = fopen(path, "rb");
-    if (f == NULL) {
-        ESP_LOGE(TAG, "Failed to open file: %s", path);
-        return ESP_ERR_NOT_FOUND;
-    }
-
-    fseek(f, offset, SEEK_SET);
-    size_t bytes_read = fread(buffer, 1, len, f);
-    fclose(f);
+    sdcard_file_seek(&file, offset);
+    int bytes_read = sdcard_file_read(&file, buffer, len);
+    sdcard_file_close(&file);
 
     //ESP_LOGI(TAG, "Read %zu bytes from %s (offset=%zu)", bytes_read, path, offset);
 
@@ -172,8 +192,47 @@ int sdcard_read_offset(const char *path, void *buffer, size_t len, size_t offset
 * @param data  Data pointer
 * @param len   Data length
 * @param append Whether it is an append mode (true = append, false = clear and rewrite)
+* @note  Opens the file on every call, loops should keep a sdcard_file_t open instead
 */
 int sdcard_write_offset(const char *path, const void *data, size_t len, bool append) {
+    sdcard_file_t file;
+    esp_err_t     err = sdcard_file_open(&file, path, append ? "ab" : "wb", 0, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int bytes_written = len ? sdcard_file_write(&file, data, len) : 0;
+    sdcard_file_close(&file);
+
+    if (!append && len == 0) {
+        ESP_LOGI(TAG, "File cleared: %s", path);
+        return ESP_OK;
+    }
+
+    //ESP_LOGI(TAG, "Wrote %zu bytes to %s (append=%d)", bytes_written, path, append);
+    return bytes_written;
+}
+
+static void sdcard_stats_add(uint64_t *bytes, uint64_t *us, size_t len, int64_t start) {
+    int64_t elapsed = esp_timer_get_time() - start;
+    taskENTER_CRITICAL(&stats_lock);
+    if (bytes != NULL) {
+        *bytes += len;
+    }
+    *us += elapsed;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+* @brief Open a file once for sequential access
+* @param file     Handle to fill in
+* @param path     File path
+* @param mode     fopen mode ("rb", "wb", "ab", "r+b" ...)
+* @param buf_size stdio buffer size, 0 for unbuffered access (callers passing large chunks)
+* @param buf_caps heap_caps of the buffer, e.g. SDCARD_BUF_DMA or SDCARD_BUF_PSRAM
+*/
+esp_err_t sdcard_file_open(sdcard_file_t *file, const char *path, const char *mode, size_t buf_size, uint32_t buf_caps) {
+    memset(file, 0, sizeof(*file));
     if (card_host == NULL) {
         ESP_LOGE(TAG, "SD card not initialized");
         return ESP_ERR_INVALID_STATE;
@@ -184,75 +243,110 @@ int sdcard_write_offset(const char *path, const void *data, size_t len, bool app
         return ESP_FAIL;
     }
 
-    const char *mode = append ? "ab" : "wb";
-    FILE *f = fopen(path, mode);
-    if (f == NULL) {
+    if (buf_size > 0) {
+        file->buf = (uint8_t *) heap_caps_malloc(buf_size, buf_caps);
+        if (file->buf == NULL) {
+            ESP_LOGW(TAG, "No %u byte file buffer (caps 0x%lx), using the default", (unsigned) buf_size, (unsigned long) buf_caps);
+        }
+    }
+
+    file->f = fopen(path, mode);
+    if (file->f == NULL) {
         ESP_LOGE(TAG, "Failed to open file: %s", path);
+        heap_caps_free(file->buf);
+        file->buf = NULL;
         return ESP_ERR_NOT_FOUND;
     }
+    if (buf_size == 0) {
+        setvbuf(file->f, NULL, _IONBF, 0);
+    } else if (file->buf != NULL) {
+        setvbuf(file->f, (char *) file->buf, _IOFBF, buf_size);
+    }
 
-    size_t bytes_written = fwrite(data, 1, len, f);
-    fclose(f);
+    taskENTER_CRITICAL(&stats_lock);
+    sdcard_stats.opens++;
+    taskEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
 
-    if (!append && len == 0) {
-        ESP_LOGI(TAG, "File cleared: %s", path);
-        return ESP_OK;
-    }
+/**
+* @brief Read the next len bytes, returns the number of bytes read
+*/
+int sdcard_file_read(sdcard_file_t *file, void *buffer, size_t len) {
+    int64_t start = esp_timer_get_time();
+    size_t  bytes_read = fread(buffer, 1, len, file->f);
+    sdcard_stats_add(&sdcard_stats.bytes_read, &sdcard_stats.read_us, bytes_read, start);
+    return bytes_read;
+}
 
-    //ESP_LOGI(TAG, "Wrote %zu bytes to %s (append=%d)", bytes_written, path, append);
+/**
+* @brief Write len bytes at the current position, returns the number of bytes written
+*/
+int sdcard_file_write(sdcard_file_t *file, const void *data, size_t len) {
+    int64_t start = esp_timer_get_time();
+    size_t  bytes_written = fwrite(data, 1, len, file->f);
+    sdcard_stats_add(&sdcard_stats.bytes_written, &sdcard_stats.write_us, bytes_written, start);
+    if (bytes_written != len) {
+        file->error = true;
+    }
     return bytes_written;
 }
 
-void list_scan_dir(const char *path) {
-    struct dirent *entry;
-    DIR           *dir = opendir(path);
+/**
+* @brief Move to offset bytes from the start of the file
+*/
+esp_err_t sdcard_file_seek(sdcard_file_t *file, size_t offset) {
+    return fseek(file->f, offset, SEEK_SET) == 0 ? ESP_OK : ESP_FAIL;
+}
 
-    if (dir == NULL) {
-        ESP_LOGE("sdscan", "Failed to open directory: %s", path);
-        return;
+/**
+* @brief Push buffered data and the FAT entries to the card, so it survives a power loss
+*/
+esp_err_t sdcard_file_sync(sdcard_file_t *file) {
+    int64_t start = esp_timer_get_time();
+    bool    ok    = fflush(file->f) == 0 && fsync(fileno(file->f)) == 0;
+    sdcard_stats_add(NULL, &sdcard_stats.sync_us, 0, start);
+    taskENTER_CRITICAL(&stats_lock);
+    sdcard_stats.syncs++;
+    taskEXIT_CRITICAL(&stats_lock);
+    if (!ok) {
+        file->error = true;
     }
+    return ok ? ESP_OK : ESP_FAIL;
+}
 
-    while ((entry = readdir(dir)) != NULL) {
-        if (entry->d_type == DT_DIR) { 
-            ESP_LOGI("sdscan", "Directory: %s", entry->d_name);
-        } else {
-            if (strstr(entry->d_name, ".bmp") == NULL) {
-                continue;
-            }
-            uint16_t       _strlen   = strlen(path) + strlen(entry->d_name) + 1 + 1; 
-            sdcard_node_t *node_data = (sdcard_node_t *) LIST_MALLOC(sizeof(sdcard_node_t));
-            assert(node_data);
-            if (_strlen > 96) {
-                ESP_LOGE("sdcard", "scan file fill _strlen:%d", _strlen);
-                continue;
-            }
-            node_data->name_score = 0;
-            snprintf(node_data->sdcard_name, sizeof(node_data->sdcard_name) - 2, "%s/%s", path, entry->d_name); 
-            list_rpush(sdcard_scan_listhandle, list_node_new(node_data));                                       
-        }
+/**
+* @brief Close the file and free its buffer, ESP_FAIL if any write or the final flush failed
+*/
+esp_err_t sdcard_file_close(sdcard_file_t *file) {
+    if (file->f == NULL) {
+        return ESP_ERR_INVALID_STATE;
     }
-    closedir(dir);
+    int64_t start = esp_timer_get_time();
+    bool    ok    = fclose(file->f) == 0 && !file->error;
+    sdcard_stats_add(NULL, &sdcard_stats.write_us, 0, start);   // Flushing the buffer is write time
+    heap_caps_free(file->buf);
+    memset(file, 0, sizeof(*file));
+    return ok ? ESP_OK : ESP_FAIL;
 }
 
-int list_iterator(void) 
-{
-    int              Quantity = 0;
-    list_iterator_t *it       = list_iterator_new(sdcard_scan_listhandle, LIST_HEAD); 
-    list_node_t     *node     = list_iterator_next(it);
-    while (node != NULL) {
-        sdcard_node_t *sdcard_node = (sdcard_node_t *) node->val;
-        ESP_LOGI("sdscan", "File: %s", sdcard_node->sdcard_name);
-        node = list_iterator_next(it);
-        Quantity++;
-    }
-    list_iterator_destroy(it); 
-    return Quantity;
+void sdcard_get_stats(sdcard_stats_t *stats) {
+    taskENTER_CRITICAL(&stats_lock);
+    *stats = sdcard_stats;
+    taskEXIT_CRITICAL(&stats_lock);
 }
 
-void set_Currently_node(list_node_t *node) {
-    Currently_node = node;
+void sdcard_reset_stats(void) {
+    taskENTER_CRITICAL(&stats_lock);
+    memset(&sdcard_stats, 0, sizeof(sdcard_stats));
+    taskEXIT_CRITICAL(&stats_lock);
 }
 
-list_node_t *get_Currently_node(void) {
-    return Currently_node;
+void sdcard_log_stats(const char *label) {
+    sdcard_stats_t st;
+    sdcard_get_stats(&st);
+    ESP_LOGI(TAG, "[TIMING] %s: read %llu KB in %llu ms (%.2f MB/s), wrote %llu KB in %llu ms (%.2f MB/s), %lu opens, %lu syncs in %llu ms",
+             label, st.bytes_read / 1024, st.read_us / 1000, st.read_us ? (double) st.bytes_read / st.read_us : 0.0,
+             st.bytes_written / 1024, st.write_us / 1000, st.write_us ? (double) st.bytes_written / st.write_us : 0.0,
+             (unsigned long) st.opens, (unsigned long) st.syncs, st.sync_us / 1000);
 }
@@ -2,18 +2,37 @@
 #define SDCARD_BSP_H
 
 #include "driver/sdmmc_host.h"
-#include "list.h"
+#include "esp_heap_caps.h"
+#include "sdcard_index.h"
+#include <stdio.h>
 
-typedef struct
-{
-    char sdcard_name[100];
-	int name_score;       
-}sdcard_node_t; 
+extern sdmmc_card_t *card_host;
 
+/*
+Open-once file handle for sequential reads and writes. The card status is
+checked at open only, and the stdio buffer size and memory are chosen by
+the caller: a DMA-capable internal buffer lets FATFS move whole sectors
+without a bounce copy, PSRAM suits large buffers that are only memcpy'd.
+*/
+#define SDCARD_BUF_DMA   (MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL)
+#define SDCARD_BUF_PSRAM (MALLOC_CAP_SPIRAM)
 
+typedef struct {
+    FILE    *f;
+    uint8_t *buf;      // stdio buffer, NULL for unbuffered or default buffering
+    bool     error;    // A write or sync failed, reported by sdcard_file_close()
+} sdcard_file_t;
 
-extern sdmmc_card_t *card_host;
-extern list_t *sdcard_scan_listhandle;
+/*Totals over all handles since boot or the last sdcard_reset_stats()*/
+typedef struct {
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t read_us;
+    uint64_t write_us;     // Includes the buffer flush at close
+    uint64_t sync_us;
+    uint32_t opens;
+    uint32_t syncs;
+} sdcard_stats_t;
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,17 +40,23 @@ extern "C" {
 
 
 uint8_t _sdcard_init(void);
-void list_scan_dir(const char *path);
-int list_iterator(void); 
-
-void set_Currently_node(list_node_t *node);
-list_node_t *get_Currently_node(void);
 
 int sdcard_write_file(const char *path, const void *data, size_t data_len);
 int sdcard_read_file(const char *path, uint8_t *buffer, size_t *outLen);
 int sdcard_read_offset(const char *path, void *buffer, size_t len, size_t offset);
 int sdcard_write_offset(const char *path, const void *data, size_t len, bool append);
 
+esp_err_t sdcard_file_open(sdcard_file_t *file, const char *path, const char *mode, size_t buf_size, uint32_t buf_caps);
+int       sdcard_file_read(sdcard_file_t *file, void *buffer, size_t len);
+int       sdcard_file_write(sdcard_file_t *file, const void *data, size_t len);
+esp_err_t sdcard_file_seek(sdcard_file_t *file, size_t offset);
+esp_err_t sdcard_file_sync(sdcard_file_t *file);
+esp_err_t sdcard_file_close(sdcard_file_t *file);
+
+void sdcard_get_stats(sdcard_stats_t *stats);
+void sdcard_reset_stats(void);
+void sdcard_log_stats(const char *label);
+
 
 #ifdef __cplusplus
 }
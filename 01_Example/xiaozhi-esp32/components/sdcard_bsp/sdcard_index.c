@@ -0,0 +1,543 @@
+#include "sdcard_index.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#define SDCARD_INDEX_MAGIC   "IDX1"
+#define SDCARD_INDEX_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    char     magic[4];      // SDCARD_INDEX_MAGIC
+    uint16_t version;       // SDCARD_INDEX_VERSION
+    uint16_t entry_size;    // sizeof(sdcard_index_entry_t)
+    uint32_t count;         // Entries following the header
+} sdcard_index_header_t;
+
+static const char *TAG = "sdcard_index";
+
+static SemaphoreHandle_t     index_lock     = NULL;
+static char                  index_dir[48];
+static sdcard_index_entry_t *index_entries  = NULL;   // PSRAM, index_capacity entries
+static int                   index_count    = 0;
+static int                   index_capacity = 0;
+static int                   index_current  = -1;
+
+/*
+High-score playlist: entry indexes of weight > 0, heaviest bucket first
+and by entry index inside a bucket. Updated in place as scores change.
+*/
+static int *playlist       = NULL;   // PSRAM, index_capacity slots
+static int  playlist_len   = 0;
+static int  playlist_count[SDCARD_PLAYLIST_WEIGHTS + 1];   // Entries per weight, [0] unused
+static int  playlist_pos   = 0;
+static int  playlist_pass  = 0;
+
+static bool index_reserve(int count) {
+    if (count <= index_capacity) {
+        return true;
+    }
+    int capacity = index_capacity ? index_capacity : 32;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    sdcard_index_entry_t *entries = (sdcard_index_entry_t *) heap_caps_realloc(
+        index_entries, capacity * sizeof(sdcard_index_entry_t), MALLOC_CAP_SPIRAM);
+    if (entries == NULL) {
+        ESP_LOGE(TAG, "Failed to grow index to %d entries", capacity);
+        return false;
+    }
+    index_entries = entries;
+    int *slots    = (int *) heap_caps_realloc(playlist, capacity * sizeof(int), MALLOC_CAP_SPIRAM);
+    if (slots == NULL) {
+        ESP_LOGE(TAG, "Failed to grow playlist to %d entries", capacity);
+        return false;
+    }
+    playlist       = slots;
+    index_capacity = capacity;
+    return true;
+}
+
+static int playlist_weight(int score) {
+    if (score < SDCARD_PLAYLIST_MIN_SCORE) {
+        return 0;
+    }
+    int weight = score - SDCARD_PLAYLIST_MIN_SCORE + 1;
+    return weight > SDCARD_PLAYLIST_WEIGHTS ? SDCARD_PLAYLIST_WEIGHTS : weight;
+}
+
+/*First slot of the bucket of weight, i.e. the number of heavier entries*/
+static int playlist_bucket(int weight) {
+    int start = 0;
+    for (int w = SDCARD_PLAYLIST_WEIGHTS; w > weight; w--) {
+        start += playlist_count[w];
+    }
+    return start;
+}
+
+/*Slot of entry index in the bucket of weight, or where it belongs*/
+static int playlist_find(int weight, int index) {
+    int lo = playlist_bucket(weight);
+    int hi = lo + playlist_count[weight];
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (playlist[mid] < index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void playlist_remove(int index, int weight) {
+    if (weight == 0) {
+        return;
+    }
+    int slot = playlist_find(weight, index);
+    memmove(&playlist[slot], &playlist[slot + 1], (playlist_len - slot - 1) * sizeof(int));
+    playlist_len--;
+    playlist_count[weight]--;
+    if (slot < playlist_pos) {
+        playlist_pos--;
+    }
+}
+
+static void playlist_insert(int index, int weight) {
+    if (weight == 0) {
+        return;
+    }
+    int slot = playlist_find(weight, index);
+    memmove(&playlist[slot + 1], &playlist[slot], (playlist_len - slot) * sizeof(int));
+    playlist[slot] = index;
+    playlist_len++;
+    playlist_count[weight]++;
+    if (slot < playlist_pos) {
+        playlist_pos++;
+    }
+}
+
+/*Counting sort of all entries into their buckets, after entries moved*/
+static void playlist_rebuild(void) {
+    int fill[SDCARD_PLAYLIST_WEIGHTS + 1];
+    memset(playlist_count, 0, sizeof(playlist_count));
+    for (int i = 0; i < index_count; i++) {
+        playlist_count[playlist_weight(index_entries[i].score)]++;
+    }
+    for (int w = 1; w <= SDCARD_PLAYLIST_WEIGHTS; w++) {
+        fill[w] = playlist_bucket(w);
+    }
+    for (int i = 0; i < index_count; i++) {
+        int weight = playlist_weight(index_entries[i].score);
+        if (weight > 0) {
+            playlist[fill[weight]++] = i;
+        }
+    }
+    playlist_len  = index_count - playlist_count[0];
+    playlist_pos  = 0;
+    playlist_pass = 0;
+}
+
+/*Negative indexes count from the end, -1 if out of range*/
+static int index_resolve(int index) {
+    if (index < 0) {
+        index += index_count;
+    }
+    return (index >= 0 && index < index_count) ? index : -1;
+}
+
+static void index_file_path(char *path, size_t len) {
+    snprintf(path, len, "%s/%s", index_dir, SDCARD_INDEX_FILE);
+}
+
+static bool index_is_image(const char *name, sdcard_img_format_t *format) {
+    size_t len = strlen(name);
+    if (len < 5 || len >= SDCARD_INDEX_NAME_LEN) {
+        return false;
+    }
+    if (strcasecmp(name + len - 4, ".bmp") == 0) {
+        *format = SDCARD_IMG_BMP;
+        return true;
+    }
+    if (strcasecmp(name + len - 4, ".epf") == 0) {
+        *format = SDCARD_IMG_EPF;
+        return true;
+    }
+    return false;
+}
+
+/*True if dir/name.bmp has a converted dir/name.epf next to it*/
+static bool index_has_epf_twin(const char *bmp_name) {
+    char        epf_path[100];
+    struct stat st;
+    int         len = snprintf(epf_path, sizeof(epf_path), "%s/%s", index_dir, bmp_name);
+    if (len < 4 || len >= (int) sizeof(epf_path)) {
+        return false;
+    }
+    memcpy(epf_path + len - 4, ".epf", 4);
+    return stat(epf_path, &st) == 0;
+}
+
+/*Image size from the BMP or EPF header, left at 0 if unreadable*/
+static void index_read_size(const char *path, sdcard_index_entry_t *entry) {
+    uint8_t head[26];
+    FILE   *f = fopen(path, "rb");
+    if (f == NULL) {
+        return;
+    }
+    size_t got = fread(head, 1, sizeof(head), f);
+    fclose(f);
+
+    if (entry->format == SDCARD_IMG_BMP && got >= 26 && head[0] == 'B' && head[1] == 'M') {
+        int32_t width  = head[18] | (head[19] << 8) | (head[20] << 16) | ((uint32_t) head[21] << 24);
+        int32_t height = head[22] | (head[23] << 8) | (head[24] << 16) | ((uint32_t) head[25] << 24);
+        entry->width   = width;
+        entry->height  = height < 0 ? -height : height;
+    } else if (entry->format == SDCARD_IMG_EPF && got >= 8 && memcmp(head, "EPF1", 4) == 0) {
+        entry->width  = head[4] | (head[5] << 8);
+        entry->height = head[6] | (head[7] << 8);
+    }
+}
+
+static bool index_fill_entry(const char *name, sdcard_img_format_t format, sdcard_index_entry_t *entry) {
+    char        path[100];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", index_dir, name);
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->name, name, SDCARD_INDEX_NAME_LEN - 1);
+    entry->size   = st.st_size;
+    entry->mtime  = st.st_mtime;
+    entry->format = format;
+    index_read_size(path, entry);
+    return true;
+}
+
+static bool index_write_all(void) {
+    char path[64];
+    index_file_path(path, sizeof(path));
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "Failed to create %s", path);
+        return false;
+    }
+    sdcard_index_header_t header;
+    memcpy(header.magic, SDCARD_INDEX_MAGIC, 4);
+    header.version    = SDCARD_INDEX_VERSION;
+    header.entry_size = sizeof(sdcard_index_entry_t);
+    header.count      = index_count;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(index_entries, sizeof(sdcard_index_entry_t), index_count, f) == (size_t) index_count;
+    if (fclose(f) != 0 || !ok) {
+        ESP_LOGE(TAG, "Failed to write %s", path);
+        remove(path);
+        return false;
+    }
+    return true;
+}
+
+/*Rewrite the header and entry index in place, the file already holds the entries before it*/
+static bool index_write_entry(int index) {
+    char path[64];
+    index_file_path(path, sizeof(path));
+    FILE *f = fopen(path, "r+b");
+    if (f == NULL) {
+        return index_write_all();
+    }
+    sdcard_index_header_t header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, SDCARD_INDEX_MAGIC, 4) == 0;
+    if (ok && header.count != (uint32_t) index_count) {
+        header.count = index_count;
+        ok = fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, f) == 1;
+    }
+    ok = ok && fseek(f, sizeof(header) + (long) index * sizeof(sdcard_index_entry_t), SEEK_SET) == 0 &&
+         fwrite(&index_entries[index], sizeof(sdcard_index_entry_t), 1, f) == 1;
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+    return ok ? true : index_write_all();
+}
+
+static bool index_load(void) {
+    char path[64];
+    index_file_path(path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    sdcard_index_header_t header;
+    struct stat           st;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, SDCARD_INDEX_MAGIC, 4) == 0 &&
+              header.version == SDCARD_INDEX_VERSION && header.entry_size == sizeof(sdcard_index_entry_t) &&
+              fstat(fileno(f), &st) == 0 &&
+              st.st_size == (off_t) (sizeof(header) + header.count * sizeof(sdcard_index_entry_t)) &&
+              index_reserve(header.count) &&
+              fread(index_entries, sizeof(sdcard_index_entry_t), header.count, f) == header.count;
+    fclose(f);
+    index_count = ok ? (int) header.count : 0;
+    if (!ok) {
+        ESP_LOGW(TAG, "%s is damaged or outdated, rebuilding", path);
+    }
+    return ok;
+}
+
+/*
+Scan the directory and rebuild the entries in readdir order. Files whose
+size and mtime did not change keep their entry (and score) without being
+opened. Returns false if the directory cannot be read.
+*/
+static bool index_scan(void) {
+    DIR *dir = opendir(index_dir);
+    if (dir == NULL) {
+        ESP_LOGE(TAG, "Failed to open directory: %s", index_dir);
+        return false;
+    }
+
+    // Scanned entries are collected behind the old ones and moved down at the end
+    int            old_count = index_count;
+    int            count     = 0;
+    int            hint      = 0;
+    bool           changed   = false;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        sdcard_img_format_t format;
+        if (ent->d_type == DT_DIR || !index_is_image(ent->d_name, &format)) {
+            continue;
+        }
+        if (format == SDCARD_IMG_BMP && index_has_epf_twin(ent->d_name)) {
+            continue;   // Already migrated, the EPF frame is listed instead
+        }
+        if (!index_reserve(old_count + count + 1)) {
+            break;
+        }
+        sdcard_index_entry_t *entry = &index_entries[old_count + count];
+        if (!index_fill_entry(ent->d_name, format, entry)) {
+            continue;
+        }
+
+        // readdir order is stable, so the match is usually at the hint
+        int match = -1;
+        for (int n = 0; n < old_count; n++) {
+            int i = (hint + n) % old_count;
+            if (strcmp(index_entries[i].name, entry->name) == 0) {
+                match = i;
+                break;
+            }
+        }
+        if (match >= 0 && index_entries[match].size == entry->size && index_entries[match].mtime == entry->mtime) {
+            *entry = index_entries[match];
+        } else {
+            if (match >= 0) {
+                entry->score = index_entries[match].score;  // Same image name, rewritten file
+            }
+            changed = true;
+        }
+        if (match != count) {
+            changed = true;
+        }
+        if (match >= 0) {
+            hint = (match + 1) % old_count;
+        }
+        count++;
+    }
+    closedir(dir);
+
+    if (count != old_count) {
+        changed = true;
+    }
+    memmove(index_entries, index_entries + old_count, count * sizeof(sdcard_index_entry_t));
+    index_count = count;
+    if (changed) {
+        index_write_all();
+    }
+    return true;
+}
+
+int sdcard_index_open(const char *dir, bool verify) {
+    if (index_lock == NULL) {
+        index_lock = xSemaphoreCreateMutex();
+        assert(index_lock);
+    }
+    xSemaphoreTake(index_lock, portMAX_DELAY);
+    int64_t start = esp_timer_get_time();
+
+    strncpy(index_dir, dir, sizeof(index_dir) - 1);
+    index_dir[sizeof(index_dir) - 1] = '\0';
+    index_count   = 0;
+    index_current = -1;
+    playlist_len  = 0;
+    memset(playlist_count, 0, sizeof(playlist_count));
+
+    bool        loaded = index_load();
+    const char *how    = "loaded";
+    if (!loaded || verify) {
+        if (!index_scan()) {
+            index_count = 0;
+            xSemaphoreGive(index_lock);
+            return -1;
+        }
+        how = loaded ? "verified" : "rebuilt";
+    }
+    if (index_count > 0) {
+        playlist_rebuild();
+    }
+    int count  = index_count;
+    int scored = playlist_len;
+    xSemaphoreGive(index_lock);
+
+    ESP_LOGI(TAG, "%s: %d images (%d in playlist), index %s in %lld ms", dir, count, scored, how,
+             (esp_timer_get_time() - start) / 1000);
+    return count;
+}
+
+int sdcard_index_count(void) {
+    return index_count;
+}
+
+bool sdcard_index_get(int index, sdcard_index_entry_t *entry) {
+    if (index_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(index_lock, portMAX_DELAY);
+    index = index_resolve(index);
+    if (index >= 0) {
+        *entry = index_entries[index];
+    }
+    xSemaphoreGive(index_lock);
+    return index >= 0;
+}
+
+bool sdcard_index_path(int index, char *path, size_t len) {
+    if (index_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(index_lock, portMAX_DELAY);
+    index = index_resolve(index);
+    if (index >= 0) {
+        snprintf(path, len, "%s/%s", index_dir, index_entries[index].name);
+    }
+    xSemaphoreGive(index_lock);
+    return index >= 0;
+}
+
+int sdcard_index_add(const char *path, int score) {
+    size_t dir_len = strlen(index_dir);
+    if (index_lock == NULL || strncmp(path, index_dir, dir_len) != 0 || path[dir_len] != '/') {
+        ESP_LOGE(TAG, "%s is not in the indexed directory", path);
+        return -1;
+    }
+    const char         *name = path + dir_len + 1;
+    sdcard_img_format_t format;
+    if (strchr(name, '/') != NULL || !index_is_image(name, &format)) {
+        ESP_LOGE(TAG, "%s is not an image", path);
+        return -1;
+    }
+
+    xSemaphoreTake(index_lock, portMAX_DELAY);
+    int index = -1;
+    if (index_reserve(index_count + 1)) {
+        sdcard_index_entry_t entry;
+        if (index_fill_entry(name, format, &entry)) {
+            entry.score = score;
+            // A regenerated file name moves to the end, which takes a full rewrite
+            int old = -1;
+            for (int i = 0; i < index_count; i++) {
+                if (strcmp(index_entries[i].name, name) == 0) {
+                    old = i;
+                    break;
+                }
+            }
+            if (old >= 0) {
+                memmove(&index_entries[old], &index_entries[old + 1],
+                        (index_count - old - 1) * sizeof(sdcard_index_entry_t));
+                index_count--;
+                if (index_current == old) {
+                    index_current = -1;
+                } else if (index_current > old) {
+                    index_current--;
+                }
+            }
+            index = index_count++;
+            index_entries[index] = entry;
+            if (old >= 0) {
+                index_write_all();
+                playlist_rebuild();
+            } else {
+                index_write_entry(index);
+                playlist_insert(index, playlist_weight(score));
+            }
+        } else {
+            ESP_LOGE(TAG, "Failed to stat %s", path);
+        }
+    }
+    xSemaphoreGive(index_lock);
+    return index;
+}
+
+bool sdcard_index_set_score(int index, int score) {
+    if (index_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(index_lock, portMAX_DELAY);
+    index = index_resolve(index);
+    if (index >= 0 && index_entries[index].score != score) {
+        int old_weight = playlist_weight(index_entries[index].score);
+        int new_weight = playlist_weight(score);
+        if (old_weight != new_weight) {
+            playlist_remove(index, old_weight);
+            playlist_insert(index, new_weight);
+        }
+        index_entries[index].score = score;
+        index_write_entry(index);
+    }
+    xSemaphoreGive(index_lock);
+    return index >= 0;
+}
+
+void sdcard_index_set_current(int index) {
+    index_current = index_resolve(index);
+}
+
+int sdcard_index_get_current(void) {
+    return index_current;
+}
+
+int sdcard_index_playlist_count(void) {
+    return playlist_len;
+}
+
+int sdcard_index_playlist_next(void) {
+    if (index_lock == NULL) {
+        return -1;
+    }
+    xSemaphoreTake(index_lock, portMAX_DELAY);
+    int index = -1;
+    if (playlist_len > 0) {
+        // Pass p walks the entries heavier than p; pass 0 is the whole playlist, so this ends
+        while (playlist_pos >= playlist_bucket(playlist_pass)) {
+            playlist_pos  = 0;
+            playlist_pass = (playlist_pass + 1) % SDCARD_PLAYLIST_WEIGHTS;
+        }
+        index = playlist[playlist_pos++];
+    }
+    xSemaphoreGive(index_lock);
+    return index;
+}
+
+void sdcard_index_playlist_rewind(void) {
+    if (index_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(index_lock, portMAX_DELAY);
+    playlist_pos  = 0;
+    playlist_pass = 0;
+    xSemaphoreGive(index_lock);
+}
@@ -0,0 +1,90 @@
+#ifndef SDCARD_INDEX_H
+#define SDCARD_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+Image index of one SD card directory, kept on the card as <dir>/.index:
+a small header followed by a flat array of fixed-size records, loaded
+with one read at boot. Lookups by position are O(1) and new images are
+appended to the file without touching the rest of it.
+
+The directory itself is only scanned when the index is missing or
+damaged, or when sdcard_index_open() is asked to verify it (e.g. on a
+cold boot, after the card may have been edited on a PC). Unchanged files
+keep their metadata and score during a verify.
+
+Scores are stored in the entry records, so they survive reboots and deep
+sleep. Entries scored SDCARD_PLAYLIST_MIN_SCORE or more also sit in a
+playlist ordered by weight (score - SDCARD_PLAYLIST_MIN_SCORE + 1, capped
+at SDCARD_PLAYLIST_WEIGHTS), kept sorted as scores change. Playback runs
+in passes, pass p only playing entries heavier than p, so an image of
+weight w comes up in w of every SDCARD_PLAYLIST_WEIGHTS passes.
+*/
+
+#define SDCARD_INDEX_FILE     ".index"
+#define SDCARD_INDEX_NAME_LEN 64
+
+#define SDCARD_PLAYLIST_MIN_SCORE 3
+#define SDCARD_PLAYLIST_WEIGHTS   3
+
+typedef enum {
+    SDCARD_IMG_BMP = 0,
+    SDCARD_IMG_EPF = 1,
+} sdcard_img_format_t;
+
+typedef struct __attribute__((packed)) {
+    char     name[SDCARD_INDEX_NAME_LEN];   // File name inside the indexed directory
+    uint32_t size;                          // File size in bytes
+    uint32_t mtime;                         // Modification time (st_mtime)
+    uint16_t width;                         // Image size, 0 if the header could not be read
+    uint16_t height;
+    int16_t  score;                         // User rating
+    uint8_t  format;                        // sdcard_img_format_t
+    uint8_t  reserved;
+} sdcard_index_entry_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Load (or build) the index of dir, returns the number of images or -1*/
+int sdcard_index_open(const char *dir, bool verify);
+
+int sdcard_index_count(void);
+
+/*Copy of entry index; negative indexes count from the end (-1 is the newest)*/
+bool sdcard_index_get(int index, sdcard_index_entry_t *entry);
+
+/*Full path of entry index, same indexing as sdcard_index_get()*/
+bool sdcard_index_path(int index, char *path, size_t len);
+
+/*
+Add (or refresh) the image at path, which must lie in the open directory.
+The entry ends up last; returns its index or -1.
+*/
+int sdcard_index_add(const char *path, int score);
+
+/*Change the score of an entry and store it in the index file*/
+bool sdcard_index_set_score(int index, int score);
+
+/*Entry shown last, for actions that refer to "the current image"*/
+void sdcard_index_set_current(int index);
+int  sdcard_index_get_current(void);
+
+/*Number of entries in the high-score playlist*/
+int sdcard_index_playlist_count(void);
+
+/*Entry index of the next high-score image, -1 if none is scored high enough*/
+int sdcard_index_playlist_next(void);
+
+/*Restart playback at the top of the playlist*/
+void sdcard_index_playlist_rewind(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,17 +1,20 @@
 #include "axp_prot.h"
 #include "button_bsp.h"
-#include "driver/rtc_io.h"
 #include "esp_log.h"
 #include "esp_sleep.h"
+#include "esp_timer.h"
 #include "json_data.h"
 #include "led_bsp.h"
+#include "power_bsp.h"
 #include "sdcard_bsp.h"
 #include "user_app.h"
 #include <stdio.h>
+#include <string.h>
 
 #include "GUI_BMPfile.h"
 #include "GUI_Paint.h"
 #include "epaper_port.h"
+#include "epf_file.h"
 
 #define ext_wakeup_pin_1 GPIO_NUM_0 
 #define ext_wakeup_pin_2 GPIO_NUM_5 
@@ -23,12 +26,28 @@ static uint32_t Imagesize;             // Size of image buffer
 static uint32_t               sdcard_Basic_bmp   = 0; 
 static RTC_DATA_ATTR uint32_t sdcard_Basic_count = 0; 
 
+/*
+The next slideshow image is rendered while the panel refreshes and saved
+as a raw EPF frame, so a timer wake only streams it to the panel. Kept out of
+the image directory so the index never lists it.
+*/
+#define BASIC_NEXT_FRAME_PATH "/sdcard/.basic_next.epf"
+
+typedef struct {
+    uint32_t index;     // Index entry the frame was rendered from
+    uint32_t size;      // Its name, size and mtime, a changed file invalidates the frame
+    uint32_t mtime;
+    uint8_t  valid;
+    char     name[SDCARD_INDEX_NAME_LEN]; // Same-sized BMPs within the 2 s FAT mtime are told apart by name
+} basic_next_frame_t;
+
+static RTC_DATA_ATTR basic_next_frame_t basic_next_frame = {};
+static SemaphoreHandle_t                prefetch_Semp;      // Start rendering the next frame
+static SemaphoreHandle_t                prefetch_done_Semp; // Next frame saved (or skipped)
+
 
 static RTC_DATA_ATTR int basic_rtc_set_time = 13 * 60;// User sets the wake-up time in seconds. // The default is 60 seconds. It is awakened by a timer.
 
-static uint8_t           Basic_sleep_arg = 0; // Parameters for low-power tasks
-static SemaphoreHandle_t sleep_Semp;          // Binary call low-power task
- 
 static uint8_t           wakeup_basic_flag = 0;
 
 static void pwr_button_user_Task(void *arg) {
@@ -37,17 +56,74 @@ static void pwr_button_user_Task(void *arg) {
                                                pdFALSE, pdMS_TO_TICKS(2000));
         if (get_bit_button(even, 0)) // Immediately enter low-power mode
         {
-            esp_sleep_pd_config(ESP_PD_DOMAIN_MAX, ESP_PD_OPTION_AUTO);
-            esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);     
-            const uint64_t ext_wakeup_pin_1_mask = 1ULL << ext_wakeup_pin_1;
-            const uint64_t ext_wakeup_pin_3_mask = 1ULL << ext_wakeup_pin_3;
-            ESP_ERROR_CHECK(esp_sleep_enable_ext1_wakeup_io(ext_wakeup_pin_1_mask | ext_wakeup_pin_3_mask, ESP_EXT1_WAKEUP_ANY_LOW)); 
-            ESP_ERROR_CHECK(rtc_gpio_pulldown_dis(ext_wakeup_pin_3));
-            ESP_ERROR_CHECK(rtc_gpio_pullup_en(ext_wakeup_pin_3));
-            esp_sleep_enable_timer_wakeup(basic_rtc_set_time * 1000 * 1000);
-            //axp_basic_sleep_start();
-            vTaskDelay(pdMS_TO_TICKS(500));
-            esp_deep_sleep_start(); 
+            if (!power_pending(POWER_EVENT_SLIDESHOW)) {
+                power_schedule(POWER_EVENT_SLIDESHOW, basic_rtc_set_time);
+            }
+            power_request_sleep();
+        }
+    }
+}
+
+/*
+Stream frame index from the card to the panel RAM without the framebuffer:
+the pre-rendered frame if it was made from the unchanged entry, or the
+image itself when it is an EPF. Returns how, or NULL to decode it instead.
+*/
+static const char *basic_stream_frame(uint32_t index, const char *img_path) {
+    sdcard_index_entry_t entry;
+    const char          *path;
+    const char          *how;
+    if (!sdcard_index_get(index, &entry)) {
+        return NULL;
+    }
+    if (basic_next_frame.valid && basic_next_frame.index == index && entry.size == basic_next_frame.size &&
+        entry.mtime == basic_next_frame.mtime && strncmp(entry.name, basic_next_frame.name, sizeof(entry.name)) == 0) {
+        path = BASIC_NEXT_FRAME_PATH;
+        how  = "streamed from cache";
+    } else if (entry.format == SDCARD_IMG_EPF) {
+        path = img_path;
+        how  = "streamed";
+    } else {
+        return NULL;
+    }
+    return epf_upload(path, EXAMPLE_LCD_WIDTH, EXAMPLE_LCD_HEIGHT, EPF_LAYOUT(Paint.Rotate, Paint.Mirror)) == ESP_OK ? how : NULL;
+}
+
+/*Render the image shown on the next wake and save it as BASIC_NEXT_FRAME_PATH*/
+static void basic_prefetch_next(uint32_t index) {
+    sdcard_index_entry_t entry;
+    char                 img_path[100];
+    basic_next_frame.valid = 0;
+    if (!sdcard_index_get(index, &entry) || !sdcard_index_path(index, img_path, sizeof(img_path))) {
+        return;
+    }
+    if (entry.format == SDCARD_IMG_EPF) {
+        return; // Already a packed frame, nothing to save
+    }
+    int64_t start = esp_timer_get_time();
+    Paint_Clear(EPD_7IN3E_WHITE);
+    if (GUI_ReadImage_6Color(img_path, 0, 0) != 0) {
+        return;
+    }
+    if (epf_write(BASIC_NEXT_FRAME_PATH, epd_blackImage, EXAMPLE_LCD_WIDTH, EXAMPLE_LCD_HEIGHT,
+                  EPF_LAYOUT(Paint.Rotate, Paint.Mirror), EPF_COMPRESSION_NONE) != ESP_OK) {
+        return;
+    }
+    basic_next_frame.index = index;
+    basic_next_frame.size  = entry.size;
+    basic_next_frame.mtime = entry.mtime;
+    memcpy(basic_next_frame.name, entry.name, sizeof(basic_next_frame.name));
+    basic_next_frame.valid = 1;
+    ESP_LOGI("Basic", "[TIMING] Next frame %ld pre-rendered in %lld ms", index, (esp_timer_get_time() - start) / 1000);
+}
+
+static void next_frame_user_Task(void *arg) {
+    for (;;) {
+        if (pdTRUE == xSemaphoreTake(prefetch_Semp, portMAX_DELAY)) {
+            power_hold();
+            basic_prefetch_next(sdcard_Basic_count);
+            power_release();
+            xSemaphoreGive(prefetch_done_Semp);
         }
     }
 }
@@ -68,26 +144,57 @@ static void boot_button_user_Task(void *arg) {
         if (get_bit_button(even, 0)) {
             if (*wakeup_arg == 0) {
                 if (pdTRUE == xSemaphoreTake(epaper_gui_semapHandle, 2000)) {                       
-                    list_node_t *sdcard_node = list_at(sdcard_scan_listhandle, sdcard_Basic_count); 
-                    if (sdcard_node == NULL) {
+                    char img_path[100];
+                    bool found = sdcard_index_path(sdcard_Basic_count, img_path, sizeof(img_path)); 
+                    if (!found) {
                         sdcard_Basic_count = 0;
-                        sdcard_node        = list_at(sdcard_scan_listhandle, sdcard_Basic_count);
+                        found              = sdcard_index_path(sdcard_Basic_count, img_path, sizeof(img_path));
                     }
                     ESP_LOGE("node", "%ld", sdcard_Basic_count);
+                    uint32_t shown = sdcard_Basic_count;
                     sdcard_Basic_count++;
-                    if (sdcard_node != NULL) 
+                    if (sdcard_Basic_count >= sdcard_Basic_bmp) {
+                        sdcard_Basic_count = 0;
+                    }
+                    if (found) 
                     {
-                        
-                        xEventGroupSetBits(Green_led_Mode_queue,
-                                           set_bit_button(6));
-                        Green_led_arg                   = 1;
-                        sdcard_node_t *sdcard_Name_node = (sdcard_node_t *) sdcard_node->val;
-                        GUI_ReadBmp_RGB_6Color(sdcard_Name_node->sdcard_name, 0, 0);
-                        epaper_port_display(epd_blackImage);    
+                        led_play(LED_PIN_Green, LED_PATTERN_BUSY);
+                        power_hold();
+                        int64_t start = esp_timer_get_time();
+                        // EPF frames go card to panel in stripes, the rest is decoded into the framebuffer
+                        const char *how    = basic_stream_frame(shown, img_path);
+                        bool        loaded = how != NULL;
+                        if (!loaded) {
+                            loaded = GUI_ReadImage_6Color(img_path, 0, 0) == 0;
+                            how    = loaded ? "decoded" : "failed, refresh skipped";
+                            // The panel keeps the frame, the buffer is free for the next one during the refresh
+                            if (loaded) {
+                                epaper_port_upload_frame(epd_blackImage);
+                            }
+                        }
+                        ESP_LOGI("Basic", "[TIMING] Frame %ld %s and uploaded in %lld ms", shown, how,
+                                 (esp_timer_get_time() - start) / 1000);
+                        if (loaded) {
+                            User_boot_mark("slideshow frame on the panel");
+                        }
+                        xSemaphoreGive(prefetch_Semp);
+                        // Only the prefetch keeps the CPU busy now, the BUSY wait can light sleep
+                        power_release();
+                        if (loaded) {
+                            epaper_port_refresh();
+                        }
+                        // Never sleep with the next frame half written, the card would be cut off mid-write
+                        if (pdTRUE != xSemaphoreTake(prefetch_done_Semp, pdMS_TO_TICKS(30 * 1000))) {
+                            ESP_LOGW("Basic", "Next frame still rendering, sleep waits for it");
+                            xSemaphoreTake(prefetch_done_Semp, portMAX_DELAY);
+                        }
                         xSemaphoreGive(epaper_gui_semapHandle); 
-                        Green_led_arg = 0;
-                        xSemaphoreGive(sleep_Semp); 
-                        Basic_sleep_arg = 1;
+                        led_stop(LED_PIN_Green);
+                        // A fired timer is no longer pending, a key-triggered frame keeps the running interval
+                        if (!power_pending(POWER_EVENT_SLIDESHOW)) {
+                            power_schedule(POWER_EVENT_SLIDESHOW, basic_rtc_set_time);
+                        }
+                        power_request_sleep();
                     }
                 }
             }
@@ -95,32 +202,6 @@ static void boot_button_user_Task(void *arg) {
     }
 }
 
-static void default_sleep_user_Task(void *arg) {
-    uint8_t *sleep_arg = (uint8_t *) arg;
-    for (;;) {
-        if (pdTRUE == xSemaphoreTake(sleep_Semp, portMAX_DELAY)) {
-            if (*sleep_arg == 1) {
-                esp_sleep_pd_config(
-                    ESP_PD_DOMAIN_MAX,
-                    ESP_PD_OPTION_AUTO);   
-                esp_sleep_disable_wakeup_source(
-                    ESP_SLEEP_WAKEUP_ALL); 
-                const uint64_t ext_wakeup_pin_1_mask = 1ULL << ext_wakeup_pin_1;
-                const uint64_t ext_wakeup_pin_3_mask = 1ULL << ext_wakeup_pin_3;
-                ESP_ERROR_CHECK(esp_sleep_enable_ext1_wakeup_io(
-                    ext_wakeup_pin_1_mask | ext_wakeup_pin_3_mask,
-                    ESP_EXT1_WAKEUP_ANY_LOW)); 
-                ESP_ERROR_CHECK(rtc_gpio_pulldown_dis(ext_wakeup_pin_3));
-                ESP_ERROR_CHECK(rtc_gpio_pullup_en(ext_wakeup_pin_3));
-                esp_sleep_enable_timer_wakeup(basic_rtc_set_time * 1000 * 1000);
-                //axp_basic_sleep_start(); 
-                vTaskDelay(pdMS_TO_TICKS(500));
-                esp_deep_sleep_start();  
-            }
-        }
-    }
-}
-
 static void get_wakeup_gpio(void) {
     esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
     if (ESP_SLEEP_WAKEUP_EXT1 == wakeup_reason) {
@@ -136,14 +217,13 @@ static void get_wakeup_gpio(void) {
         } else if (wakeup_pins & (1ULL << ext_wakeup_pin_3)) {
             return;
         }
-    } else if (ESP_SLEEP_WAKEUP_TIMER == wakeup_reason) {
-        xEventGroupSetBits(boot_groups, set_bit_button(0)); 
     }
 }
 
 void User_Basic_mode_app_init(void) {
-    sleep_Semp  = xSemaphoreCreateBinary();
-    xEventGroupSetBits(Red_led_Mode_queue, set_bit_button(0));  
+    prefetch_Semp      = xSemaphoreCreateBinary();
+    prefetch_done_Semp = xSemaphoreCreateBinary();
+    led_play(LED_PIN_Red, LED_PATTERN_ON);
     ai_model_t *ai_model_data = NULL;
     if ((13 * 60) == basic_rtc_set_time) {
         ai_model_data = json_sdcard_txt_aimodel();
@@ -153,11 +233,19 @@ void User_Basic_mode_app_init(void) {
         }
     }
     if(ai_model_data != NULL) {free(ai_model_data);ai_model_data = NULL;}
-    list_scan_dir("/sdcard/06_user_foundation_img");        
-    sdcard_Basic_bmp = list_iterator();
+    // Timer wake-ups trust the stored index, only a cold boot rescans the directory
+    int img_count    = sdcard_index_open("/sdcard/06_user_foundation_img", esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED);
+    sdcard_Basic_bmp = img_count > 0 ? img_count : 0;
     xTaskCreate(boot_button_user_Task, "boot_button_user_Task", 6 * 1024, &wakeup_basic_flag, 3, NULL);
     xTaskCreate(pwr_button_user_Task, "pwr_button_user_Task", 4 * 1024, NULL, 3, NULL);
-    xTaskCreate(default_sleep_user_Task, "default_sleep_user_Task", 4 * 1024, &Basic_sleep_arg, 3, NULL); 
+    xTaskCreate(next_frame_user_Task, "next_frame_user_Task", 6 * 1024, NULL, 2, NULL);
+    /*The slideshow timer keeps its due time across key wake-ups, a timer wake-up finds it due*/
+    power_set_wake_pins((1ULL << ext_wakeup_pin_1) | (1ULL << ext_wakeup_pin_3));
+    power_set_light_sleep(true);
+    if (!power_pending(POWER_EVENT_SLIDESHOW)) {
+        power_schedule(POWER_EVENT_SLIDESHOW, basic_rtc_set_time);
+    }
+    power_on_event(POWER_EVENT_SLIDESHOW, boot_groups, set_bit_button(0));
     get_wakeup_gpio();
 }
 
@@ -81,6 +81,11 @@ static void key1_button_user_Task(void *arg) {
     }
 }
 
+/*Prompts stop as soon as the boot key is pressed*/
+static bool audio_key_released(void) {
+    return gpio_get_level(GPIO_NUM_4);
+}
+
 static void audio_user_Task(void *arg) {
     dev_audio->Play_InfoAudio();
     int value = 0;
@@ -95,14 +100,7 @@ static void audio_user_Task(void *arg) {
         } else if (get_bit_button(even, 3)) {
             value = 3;
         }
-        int      bytes_write = 0;
-        int      bytes_sizt  = dev_audio->Get_MusicSizt(value);
-        uint8_t *Music_ptr   = dev_audio->Get_MusicData(value);
-        do {
-            dev_audio->Play_BackWrite(Music_ptr, 256);
-            Music_ptr += 256;
-            bytes_write += 256;
-        } while ((bytes_write < bytes_sizt) && (gpio_get_level(GPIO_NUM_4)));
+        dev_audio->Play_Prompt(value, audio_key_released);
     }
 }
 
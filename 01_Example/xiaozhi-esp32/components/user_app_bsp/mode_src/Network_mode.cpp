@@ -4,6 +4,7 @@
 #include "esp_log.h"
 #include "esp_sleep.h"
 #include "led_bsp.h"
+#include "power_bsp.h"
 #include "server_bsp.h"
 #include "user_app.h"
 #include <stdio.h>
@@ -11,12 +12,17 @@
 #include "GUI_BMPfile.h"
 #include "GUI_Paint.h"
 #include "epaper_port.h"
-
-#include "driver/rtc_io.h"
+#include "epf_file.h"
+#include "image_upload.h"
 
 #define ext_wakeup_pin_3 GPIO_NUM_4
 
-static EventGroupHandle_t sleep_group;
+#define NETWORK_IDLE_TIMEOUT_S  30 // Deep sleep when no station joins the AP in time
+#define NETWORK_WAKE_INTERVAL_S 30 // Then bring the AP up again after this long
+
+/*Keep a copy of each uploaded picture as an EPF frame (IMAGE_UPLOAD_EPF_PATH), 0 to skip*/
+#define NETWORK_SAVE_UPLOAD 1
+
 static uint8_t           *epd_blackImage = NULL; // Image buffer
 static uint32_t           Imagesize;             // Size of image buffer
 
@@ -30,77 +36,39 @@ static void Network_user_Task(void *arg) {
     Paint_SetScale(6);
     Paint_SelectImage(epd_blackImage);
     Paint_SetRotate(180);
+    // Uploads are decoded into epd_blackImage while they are received
+    image_upload_init(epd_blackImage);
+    http_server_set_upload_sink(&image_upload_sink);
     for (;;) {
         EventBits_t even =
             xEventGroupWaitBits(server_groups, set_bit_all, pdTRUE, pdFALSE, pdMS_TO_TICKS(2000));
         if (get_bit_button(even, 0)) 
         {
-            Red_led_arg = 1;                                           
-            xEventGroupSetBits(Red_led_Mode_queue, set_bit_button(6)); 
+            led_play(LED_PIN_Red, LED_PATTERN_BUSY_LIT);
         } else if (get_bit_button(even, 1)) {
-            Red_led_arg = 0;                
+            led_stop(LED_PIN_Red);
         } else if (get_bit_button(even, 2)) 
         {
             if (pdTRUE == xSemaphoreTake(epaper_gui_semapHandle,
                                          2000)) 
             {
-                
-                xEventGroupSetBits(Green_led_Mode_queue, set_bit_button(6));
-                Green_led_arg = 1;
-                GUI_ReadBmp_RGB_6Color("/sdcard/02_sys_ap_img/user_send.bmp", 0, 0);
+                led_play(LED_PIN_Green, LED_PATTERN_BUSY);
+                power_hold();
                 epaper_port_display(epd_blackImage);    
+#if NETWORK_SAVE_UPLOAD
+                epf_write(IMAGE_UPLOAD_EPF_PATH, epd_blackImage, EXAMPLE_LCD_WIDTH, EXAMPLE_LCD_HEIGHT,
+                          EPF_LAYOUT(Paint.Rotate, Paint.Mirror), EPF_COMPRESSION_RLE);
+#endif
+                power_release();
                 xSemaphoreGive(epaper_gui_semapHandle); 
-                Green_led_arg = 0;                      
+                led_stop(LED_PIN_Green);
             }
         } else if (get_bit_button(even, 5)) 
         {
-            esp_sleep_pd_config(ESP_PD_DOMAIN_MAX, ESP_PD_OPTION_AUTO); 
-            esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);      
-            const uint64_t ext_wakeup_pin_3_mask = 1ULL << ext_wakeup_pin_3;
-            ESP_ERROR_CHECK(esp_sleep_enable_ext1_wakeup_io(
-                ext_wakeup_pin_3_mask, ESP_EXT1_WAKEUP_ANY_LOW)); 
-            ESP_ERROR_CHECK(rtc_gpio_pulldown_dis(ext_wakeup_pin_3));
-            ESP_ERROR_CHECK(rtc_gpio_pullup_en(ext_wakeup_pin_3));
-            esp_sleep_enable_timer_wakeup(30 * 1000 * 1000); 
-            set_espWifi_sleep();                             
-            //axp_basic_sleep_start();
-            vTaskDelay(pdMS_TO_TICKS(500));                        
-            esp_deep_sleep_start();                          
+            power_request_sleep();
         } else if (get_bit_button(even, 4))                  
         {
-            xEventGroupClearBits(sleep_group, rset_bit_data(0)); 
-            xEventGroupSetBits(sleep_group, set_bit_button(1));  
-        }
-    }
-}
-
-static void Network_sleep_Task(void *arg) {
-    size_t time = 0;
-    for (;;) {
-        EventBits_t even =
-            xEventGroupWaitBits(sleep_group, set_bit_all, pdFALSE, pdFALSE, pdMS_TO_TICKS(1000));
-        if (get_bit_button(even, 0)) 
-        {
-            vTaskDelay(pdMS_TO_TICKS(500));
-            time++;
-            if (time == 60) {
-                esp_sleep_pd_config(ESP_PD_DOMAIN_MAX, ESP_PD_OPTION_AUTO); 
-                esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);      
-                const uint64_t ext_wakeup_pin_3_mask = 1ULL << ext_wakeup_pin_3;
-                ESP_ERROR_CHECK(esp_sleep_enable_ext1_wakeup_io(
-                    ext_wakeup_pin_3_mask, ESP_EXT1_WAKEUP_ANY_LOW)); 
-                ESP_ERROR_CHECK(rtc_gpio_pulldown_dis(ext_wakeup_pin_3));
-                ESP_ERROR_CHECK(rtc_gpio_pullup_en(ext_wakeup_pin_3));
-                esp_sleep_enable_timer_wakeup(30 * 1000 * 1000); // 15s
-                set_espWifi_sleep();                             
-                //axp_basic_sleep_start(); 
-                vTaskDelay(pdMS_TO_TICKS(500));                        
-                esp_deep_sleep_start();                          
-            }
-        } else if (get_bit_button(even, 1)) 
-        {
-            time = 0;
-            xEventGroupClearBits(sleep_group, rset_bit_data(1)); 
+            power_set_idle_timeout(0); // A station joined, stay up until it leaves
         }
     }
 }
@@ -112,43 +80,37 @@ static void get_wakeup_gpio(void) {
         if (wakeup_pins == 0)
             return;
         if (wakeup_pins & (1ULL << ext_wakeup_pin_3)) {
-            xEventGroupClearBits(sleep_group, rset_bit_data(0)); 
+            power_set_idle_timeout(0); // Woken by hand, keep the AP up
         }
     } else if (ESP_SLEEP_WAKEUP_TIMER == wakeup_reason) {
     }
 }
 
+/*Every deep sleep wakes the AP again after NETWORK_WAKE_INTERVAL_S*/
+static void Network_sleep_hook(void) {
+    power_schedule(POWER_EVENT_AP_WAKE, NETWORK_WAKE_INTERVAL_S);
+    set_espWifi_sleep();
+}
+
 static void pwr_button_user_Task(void *arg) {
     for (;;) {
         EventBits_t even =
             xEventGroupWaitBits(pwr_groups, set_bit_all, pdTRUE, pdFALSE, pdMS_TO_TICKS(2000));
         if (get_bit_button(even, 0)) 
         {
-            esp_sleep_pd_config(ESP_PD_DOMAIN_MAX, ESP_PD_OPTION_AUTO); 
-            esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);      
-            const uint64_t ext_wakeup_pin_3_mask = 1ULL << ext_wakeup_pin_3;
-            ESP_ERROR_CHECK(esp_sleep_enable_ext1_wakeup_io(
-                ext_wakeup_pin_3_mask, ESP_EXT1_WAKEUP_ANY_LOW)); 
-            ESP_ERROR_CHECK(rtc_gpio_pulldown_dis(ext_wakeup_pin_3));
-            ESP_ERROR_CHECK(rtc_gpio_pullup_en(ext_wakeup_pin_3));
-            esp_sleep_enable_timer_wakeup(30 * 1000 * 1000);
-            set_espWifi_sleep();     
-            //axp_basic_sleep_start();
-            vTaskDelay(pdMS_TO_TICKS(500)); 
-            esp_deep_sleep_start();  
+            power_request_sleep();
         }
     }
 }
 
 void User_Network_mode_app_init(void) {
-    sleep_group = xEventGroupCreate();
-    xEventGroupSetBits(sleep_group, set_bit_button(0)); 
+    power_set_wake_pins(1ULL << ext_wakeup_pin_3);
+    power_add_sleep_hook(Network_sleep_hook);
+    power_set_idle_timeout(NETWORK_IDLE_TIMEOUT_S);
     Network_wifi_ap_init();                             
     http_server_init();                                 
-    xEventGroupSetBits(Red_led_Mode_queue,
-                       set_bit_button(0)); 
+    led_play(LED_PIN_Red, LED_PATTERN_ON);
     xTaskCreate(Network_user_Task, "Network_user_Task", 6 * 1024, NULL, 2, NULL);
-    xTaskCreate(Network_sleep_Task, "Network_sleep_Task", 5 * 1024, NULL, 2, NULL);
     xTaskCreate(pwr_button_user_Task, "pwr_button_user_Task", 5 * 1024, NULL, 2, NULL);
     get_wakeup_gpio(); 
 }
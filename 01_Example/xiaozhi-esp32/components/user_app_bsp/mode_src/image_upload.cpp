@@ -0,0 +1,337 @@
+#include "image_upload.h"
+#include "GUI_BMPfile.h"
+#include "GUI_Paint.h"
+#include "dither_engine.h"
+#include "epaper_port.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "pngle_scale.h"
+#include "user_app.h"
+#include <string.h>
+
+#define UPLOAD_HEAD_LEN  54                  // BMP file + info header, also covers the PNG IHDR size
+#define UPLOAD_JPEG_MAX  (4 * 1024 * 1024)   // Largest JPEG body kept in PSRAM
+#define UPLOAD_BMP_ROW_MAX (4096 * 3)
+
+typedef enum {
+    UPLOAD_HEAD,    // Collecting the first UPLOAD_HEAD_LEN bytes
+    UPLOAD_BMP,
+    UPLOAD_PNG,
+    UPLOAD_JPEG,
+} upload_format_t;
+
+typedef struct {
+    upload_format_t format;
+    uint8_t         head[UPLOAD_HEAD_LEN];
+    size_t          head_len;
+    size_t          content_len;
+    bool            locked;        // epaper_gui_semapHandle held
+    int64_t         start;
+
+    // BMP: pixel rows are drawn one by one as they complete
+    int      width;
+    int      height;
+    bool     bottom_up;
+    uint32_t skip;                 // Bytes left before the pixel data
+    uint32_t row_size;
+    uint32_t row_fill;
+    int      rows;                 // Rows drawn so far
+    uint8_t *row;
+
+    // PNG
+    pngle_scale_stream_t *png;
+    bool                  push_started;
+
+    // JPEG
+    uint8_t *jpeg;
+    size_t   jpeg_len;
+} upload_state_t;
+
+// Centre crop of a decoded JPEG, sampled nearest-neighbour into the panel size
+typedef struct {
+    const uint8_t *rgb;
+    int            width;
+    int            x0, y0, crop_w, crop_h;
+    int            target_w, target_h;
+} upload_jpeg_ctx_t;
+
+static const char *TAG = "image_upload";
+
+static dither_engine       *upload_engine = NULL;
+static dither_epd_target_t  upload_target = {};
+static upload_state_t       up;
+
+void image_upload_init(uint8_t *image) {
+    if (upload_engine == NULL) {
+        upload_engine = new dither_engine();
+    }
+    upload_target.image         = image;
+    upload_target.width_memory  = Paint.WidthMemory;
+    upload_target.height_memory = Paint.HeightMemory;
+    upload_target.rotate        = Paint.Rotate;
+    upload_target.mirror        = Paint.Mirror;
+    upload_target.lock          = NULL;    // epaper_gui_semapHandle is held for the whole upload instead
+}
+
+/*Panel-sized target for a w x h image, portrait images stay portrait*/
+static void upload_target_size(int w, int h, int *target_w, int *target_h) {
+    *target_w = (h > w) ? EXAMPLE_LCD_HEIGHT : EXAMPLE_LCD_WIDTH;
+    *target_h = (h > w) ? EXAMPLE_LCD_WIDTH : EXAMPLE_LCD_HEIGHT;
+}
+
+static uint32_t upload_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint32_t upload_be32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static int upload_png_row(void *user_ctx, int y, const uint8_t *rgb_row) {
+    (void) y;
+    return ((dither_engine *) user_ctx)->dither_push_row(rgb_row) ? 0 : 1;
+}
+
+static bool upload_jpeg_row(void *user_ctx, int y, uint8_t *rgb_row) {
+    const upload_jpeg_ctx_t *ctx = (const upload_jpeg_ctx_t *) user_ctx;
+    const uint8_t           *src = ctx->rgb + (size_t) (ctx->y0 + y * ctx->crop_h / ctx->target_h) * ctx->width * 3;
+    for (int x = 0; x < ctx->target_w; x++) {
+        const uint8_t *p = src + (ctx->x0 + x * ctx->crop_w / ctx->target_w) * 3;
+        rgb_row[x * 3]     = p[0];
+        rgb_row[x * 3 + 1] = p[1];
+        rgb_row[x * 3 + 2] = p[2];
+    }
+    return true;
+}
+
+/*Pick the decoder from the collected head, false if the format is not supported*/
+static bool upload_start(void) {
+    const uint8_t *h = up.head;
+    if (up.head_len >= 54 && h[0] == 'B' && h[1] == 'M') {
+        int32_t width  = (int32_t) upload_le32(h + 18);
+        int32_t height = (int32_t) upload_le32(h + 22);
+        if ((h[28] | (h[29] << 8)) != 24 || upload_le32(h + 30) != 0) {
+            ESP_LOGE(TAG, "BMP is not an uncompressed 24-bit bitmap");
+            return false;
+        }
+        up.width     = width;
+        up.bottom_up = height > 0;
+        up.height    = height < 0 ? -height : height;
+        up.row_size  = ((uint32_t) width * 3 + 3) & ~3u;
+        uint32_t off = upload_le32(h + 10);
+        if (width <= 0 || up.height == 0 || up.row_size > UPLOAD_BMP_ROW_MAX || off < 54) {
+            ESP_LOGE(TAG, "Unsupported BMP %ld x %ld", (long) width, (long) height);
+            return false;
+        }
+        up.row = (uint8_t *) heap_caps_malloc(up.row_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (up.row == NULL) {
+            return false;
+        }
+        up.skip = off;     // Counted from the start of the file, the head is fed through again
+        Paint_Clear(EPD_7IN3E_WHITE);
+        up.format = UPLOAD_BMP;
+        ESP_LOGI(TAG, "BMP %dx%d, drawing rows as they arrive", up.width, up.height);
+        return true;
+    }
+
+    if (up.head_len >= 24 && h[0] == 0x89 && h[1] == 'P' && h[2] == 'N' && h[3] == 'G') {
+        int target_w, target_h;
+        upload_target_size(upload_be32(h + 16), upload_be32(h + 20), &target_w, &target_h);
+        if (!upload_engine->dither_push_begin_epd(target_w, target_h, &upload_target)) {
+            return false;
+        }
+        up.push_started = true;
+        up.png = pngle_scale_stream_new(target_w, target_h, PNGLE_SCALE_FILL, 255, upload_png_row, upload_engine);
+        if (up.png == NULL) {
+            ESP_LOGE(TAG, "Failed to create PNG decode stream");
+            return false;
+        }
+        up.format = UPLOAD_PNG;
+        ESP_LOGI(TAG, "PNG %lux%lu, decode + dither while receiving (target %dx%d)",
+                 (unsigned long) upload_be32(h + 16), (unsigned long) upload_be32(h + 20), target_w, target_h);
+        return true;
+    }
+
+    if (up.head_len >= 2 && h[0] == 0xFF && h[1] == 0xD8) {
+        if (up.content_len > UPLOAD_JPEG_MAX) {
+            ESP_LOGE(TAG, "JPEG of %u bytes is too large", (unsigned) up.content_len);
+            return false;
+        }
+        up.jpeg = (uint8_t *) heap_caps_malloc(up.content_len, MALLOC_CAP_SPIRAM);
+        if (up.jpeg == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate JPEG buffer (%u bytes)", (unsigned) up.content_len);
+            return false;
+        }
+        up.format = UPLOAD_JPEG;
+        return true;
+    }
+    ESP_LOGE(TAG, "Unknown image format %02x %02x", h[0], h[1]);
+    return false;
+}
+
+static bool upload_feed(const uint8_t *data, size_t len) {
+    if (up.format == UPLOAD_PNG) {
+        int err = pngle_scale_stream_feed(up.png, data, len);
+        if (err != PNGLE_SCALE_OK) {
+            ESP_LOGE(TAG, "pngle decode failed: %s", pngle_scale_error_text(err));
+            return false;
+        }
+        return true;
+    }
+    if (up.format == UPLOAD_JPEG) {
+        if (up.jpeg_len + len > up.content_len) {
+            return false;
+        }
+        memcpy(up.jpeg + up.jpeg_len, data, len);
+        up.jpeg_len += len;
+        return true;
+    }
+
+    // BMP
+    while (len > 0) {
+        if (up.skip > 0) {
+            size_t n = (len < up.skip) ? len : up.skip;
+            up.skip -= n;
+            data += n;
+            len -= n;
+            continue;
+        }
+        if (up.rows >= up.height) {
+            return true;    // Trailing bytes after the pixel data
+        }
+        size_t n = up.row_size - up.row_fill;
+        n        = (len < n) ? len : n;
+        memcpy(up.row + up.row_fill, data, n);
+        up.row_fill += n;
+        data += n;
+        len -= n;
+        if (up.row_fill == up.row_size) {
+            int y = up.bottom_up ? up.height - 1 - up.rows : up.rows;
+            GUI_DrawBmpRow_6Color(up.row, up.width, up.height, y, 0, 0);
+            up.row_fill = 0;
+            up.rows++;
+        }
+    }
+    return true;
+}
+
+static bool upload_begin(size_t content_len) {
+    memset(&up, 0, sizeof(up));
+    up.start       = esp_timer_get_time();
+    up.content_len = content_len;
+    if (upload_engine == NULL || upload_target.image == NULL) {
+        ESP_LOGE(TAG, "Not initialized");
+        return false;
+    }
+    up.locked = xSemaphoreTake(epaper_gui_semapHandle, pdMS_TO_TICKS(2000)) == pdTRUE;
+    if (!up.locked) {
+        ESP_LOGE(TAG, "Framebuffer busy");
+    }
+    return up.locked;
+}
+
+static bool upload_write(const uint8_t *data, size_t len) {
+    if (up.format == UPLOAD_HEAD) {
+        size_t n = UPLOAD_HEAD_LEN - up.head_len;
+        n        = (len < n) ? len : n;
+        memcpy(up.head + up.head_len, data, n);
+        up.head_len += n;
+        if (up.head_len < UPLOAD_HEAD_LEN) {
+            return true;
+        }
+        if (!upload_start() || !upload_feed(up.head, up.head_len)) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return len == 0 || upload_feed(data, len);
+}
+
+static bool upload_finish_jpeg(void) {
+    uint8_t *rgb = NULL;
+    int      rgb_len, w = 0, h = 0;
+    int64_t  t0 = esp_timer_get_time();
+    int      decoded = upload_engine->Jpeg_decode(up.jpeg, up.jpeg_len, &rgb, &rgb_len, &w, &h);
+    heap_caps_free(up.jpeg);
+    up.jpeg = NULL;
+    if (!decoded || w <= 0 || h <= 0) {
+        ESP_LOGE(TAG, "JPEG decode failed");
+        upload_engine->Jpeg_dec_buffer_free(rgb);
+        return false;
+    }
+    int64_t t1 = esp_timer_get_time();
+
+    upload_jpeg_ctx_t ctx = {};
+    ctx.rgb   = rgb;
+    ctx.width = w;
+    upload_target_size(w, h, &ctx.target_w, &ctx.target_h);
+    // Fill: crop the longer side so the image covers the whole panel
+    if ((int64_t) w * ctx.target_h > (int64_t) h * ctx.target_w) {
+        ctx.crop_h = h;
+        ctx.crop_w = (int) ((int64_t) h * ctx.target_w / ctx.target_h);
+        ctx.x0     = (w - ctx.crop_w) / 2;
+    } else {
+        ctx.crop_w = w;
+        ctx.crop_h = (int) ((int64_t) w * ctx.target_h / ctx.target_w);
+        ctx.y0     = (h - ctx.crop_h) / 2;
+    }
+    bool ok = upload_engine->dither_stream_to_epd(ctx.target_w, ctx.target_h, upload_jpeg_row, &ctx, &upload_target);
+    upload_engine->Jpeg_dec_buffer_free(rgb);
+    ESP_LOGI(TAG, "[TIMING] JPEG %dx%d: decode %lld ms, scale + dither %lld ms", w, h, (t1 - t0) / 1000,
+             (esp_timer_get_time() - t1) / 1000);
+    return ok;
+}
+
+static bool upload_end(bool complete) {
+    bool ok = false;
+    if (up.format == UPLOAD_HEAD && complete && up.head_len > 0) {
+        // Body shorter than the head buffer
+        complete = upload_start() && upload_feed(up.head, up.head_len);
+    }
+    switch (up.format) {
+        case UPLOAD_BMP:
+            ok = complete && up.rows == up.height;
+            break;
+        case UPLOAD_PNG: {
+            pngle_scale_result_t result;
+            int                  err = pngle_scale_stream_finish(up.png, &result);
+            up.png                   = NULL;
+            ok                       = complete && err == PNGLE_SCALE_OK;
+            break;
+        }
+        case UPLOAD_JPEG:
+            ok = complete && up.jpeg_len == up.content_len && upload_finish_jpeg();
+            break;
+        default:
+            break;
+    }
+
+    // Whatever is still open after a failure
+    if (up.png != NULL) {
+        pngle_scale_stream_free(up.png);
+        up.png = NULL;
+    }
+    if (up.push_started) {
+        ok              = upload_engine->dither_push_end() && ok;
+        up.push_started = false;
+    }
+    heap_caps_free(up.jpeg);
+    heap_caps_free(up.row);
+    up.jpeg = NULL;
+    up.row  = NULL;
+    if (up.locked) {
+        xSemaphoreGive(epaper_gui_semapHandle);
+        up.locked = false;
+    }
+    ESP_LOGI(TAG, "[TIMING] Upload %s: %u bytes received and drawn in %lld ms", ok ? "ok" : "failed",
+             (unsigned) up.content_len, (esp_timer_get_time() - up.start) / 1000);
+    return ok;
+}
+
+const server_upload_sink_t image_upload_sink = {
+    upload_begin,
+    upload_write,
+    upload_end,
+};
@@ -0,0 +1,38 @@
+#ifndef IMAGE_UPLOAD_H
+#define IMAGE_UPLOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "server_bsp.h"
+
+/*
+Upload sink for the AP web UI: the POST body is decoded straight into the
+e-paper framebuffer while it is received, nothing goes through the SD card.
+
+    BMP   24-bit 6-color, rows drawn as they arrive (off-palette pixels
+          become white, like GUI_ReadBmp_RGB_6Color)
+    PNG   decoded incrementally, scaled to fill the panel and dithered row
+          by row
+    JPEG  the decoder needs the whole file, so it is kept in PSRAM and
+          dithered once the body is complete
+
+The format is taken from the first bytes, not the Content-Type. Portrait
+PNG/JPEG images are shown rotated, like the AI images.
+*/
+
+#define IMAGE_UPLOAD_EPF_PATH "/sdcard/02_sys_ap_img/user_send.epf"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Framebuffer the uploads are drawn into, set up with the Paint settings in use*/
+void image_upload_init(uint8_t *image);
+
+extern const server_upload_sink_t image_upload_sink;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
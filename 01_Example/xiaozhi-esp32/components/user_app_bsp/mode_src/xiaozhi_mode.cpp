@@ -2,10 +2,12 @@
 #include "button_bsp.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_sleep.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "i2c_bsp.h"
 #include "led_bsp.h"
+#include "power_bsp.h"
 #include "sdcard_bsp.h"
 #include "user_app.h"
 #include <cmath>
@@ -44,6 +46,10 @@ int                sdcard_doc_count    = 0; // The index of the image  // Used i
 int                is_ai_img           = 1; // If the current process is refreshing, then the AI-generated images cannot be generated
 EventGroupHandle_t ai_IMG_Group;            // Task group for ai_IMG
 EventGroupHandle_t ai_IMG_Score_Group;      // Task group for polling and playing high-score images by AI in ai_IMG
+
+#define AI_SCORE_INTERVAL_S (30 * 60) // Next high-score image every half hour
+#define AI_SCORE_DUE_BIT    0x04      // Set in ai_IMG_Score_Group by the power service
+
 static bool        g_ai_direct_display = true; // AI image direct display mode (skip SD card I/O)
 
 char   *str_ai_chat_buff = NULL; // This is a text-to-image conversion. The default text length is 1024.
@@ -51,7 +57,7 @@ char   *str_ai_chat_buff = NULL; // This is a text-to-image conversion. The defa
 int     IMG_Score        = 0;    // Score the image
 gemini_aspect_ratio_t ai_img_aspect_ratio = ASPECT_RATIO_16_9;  // Default to landscape (16:9)
 scale_mode_t ai_img_scale_mode = SCALE_MODE_FILL;  // Default to fill (crop excess)
-list_t *sdcard_score     = NULL; // The high-score list requires memory allocation and deallocation
+int     score_index      = -1;   // Index entry of the high-score image to show
 char    score_name[100];         // Poll the current image
 
 char sleep_buff[64]; 
@@ -70,7 +76,7 @@ void xiaozhi_init_received(const char *arg1)
         // json_data = json_read_data(str);
         json_data = NULL;
         ESP_LOGI("xiaozhi", "Weather query disabled, skipping weather display");
-        xEventGroupSetBits(Red_led_Mode_queue, set_bit_button(0));
+        led_play(LED_PIN_Red, LED_PATTERN_ON);
         // Skip weather display on EPD - don't set epaper_groups bit 0
         // xEventGroupSetBits(epaper_groups, set_bit_button(0));
     }
@@ -83,12 +89,12 @@ void xiaozhi_application_received(const char *str) {
     sleep_buff[sizeof(sleep_buff) - 1] = '\0';
     if (is_led_flag) {
         if (strstr(sleep_buff, "idle") != NULL) {
-            gpio_set_level((gpio_num_t) 45, 1);
+            led_play(LED_PIN_Red, LED_PATTERN_OFF);
             is_led_flag = false;
         }
     } else {
         if ((strstr(sleep_buff, "listening") != NULL) || (strstr(sleep_buff, "speaking") != NULL)) {
-            gpio_set_level((gpio_num_t) 45, 0);
+            led_play(LED_PIN_Red, LED_PATTERN_ON);
             is_led_flag = true;
         }
     }
@@ -114,13 +120,17 @@ static void gui_user_Task(void *arg) {
     Paint_SelectImage(epd_blackImage); 
     Paint_Clear(EPD_7IN3E_WHITE);      
     /**/
+    if (dev_ai_gemini != NULL) {
+        // Let direct display dither straight into the framebuffer under the GUI lock
+        dither_epd_target_t epd_target = {epd_blackImage, Paint.WidthMemory, Paint.HeightMemory,
+                                          Paint.Rotate, Paint.Mirror, epaper_gui_semapHandle};
+        dev_ai_gemini->set_EpdTarget(&epd_target);
+    }
     for (;;) {
         EventBits_t even = xEventGroupWaitBits(epaper_groups, set_bit_all, pdTRUE, pdFALSE, portMAX_DELAY); 
         if (pdTRUE == xSemaphoreTake(epaper_gui_semapHandle, 2000))                                         
         {
-            
-            xEventGroupSetBits(Green_led_Mode_queue, set_bit_button(6));
-            Green_led_arg = 1;
+            led_play(LED_PIN_Green, LED_PATTERN_BUSY);
             is_ai_img     = 0;           
             if (get_bit_button(even, 0)) 
             {
@@ -190,56 +200,70 @@ static void gui_user_Task(void *arg) {
                 heap_caps_free(json_data);
             } else if (get_bit_button(even, 1)) { 
                 *sdcard_doc -= 1;
-                list_node_t *sdcard_node = list_at(sdcard_scan_listhandle, *sdcard_doc); 
-                if (sdcard_node != NULL)                                                 
+                char img_path[100];
+                if (sdcard_index_path(*sdcard_doc, img_path, sizeof(img_path)))
                 {
-                    sdcard_node_t *sdcard_Name_node = (sdcard_node_t *) sdcard_node->val;
-                    set_Currently_node(sdcard_node);
-                    GUI_ReadBmp_RGB_6Color(sdcard_Name_node->sdcard_name, 0, 0);
-                    epaper_port_display(epd_blackImage); 
+                    sdcard_index_set_current(*sdcard_doc);
+                    if (GUI_ReadImage_6Color(img_path, 0, 0) == 0) {
+                        epaper_port_display(epd_blackImage); 
+                    }
                 }
             } else if (get_bit_button(even, 2)) {
                 ESP_LOGI("epaper_showTask", "Received AI image display event");
-                list_node_t *node = list_at(sdcard_scan_listhandle, -1);
-                if (node != NULL) {
-                    sdcard_node_t *sdcard_Name_node_ai = (sdcard_node_t *) node->val;
-                    set_Currently_node(node);
+                char img_path[100];
+                if (sdcard_index_path(-1, img_path, sizeof(img_path))) {
+                    sdcard_index_set_current(-1);
 
-                    // Step 4: Read BMP from SD card - timing
+                    // Step 4: Read image (EPF or BMP) from SD card - timing
                     int64_t bmp_read_start = esp_timer_get_time();
-                    ESP_LOGI("epaper_showTask", "Loading BMP: %s", sdcard_Name_node_ai->sdcard_name);
-                    GUI_ReadBmp_RGB_6Color(sdcard_Name_node_ai->sdcard_name, 0, 0);
+                    ESP_LOGI("epaper_showTask", "Loading image: %s", img_path);
+                    UBYTE   read_err     = GUI_ReadImage_6Color(img_path, 0, 0);
                     int64_t bmp_read_end = esp_timer_get_time();
                     int64_t bmp_read_ms = (bmp_read_end - bmp_read_start) / 1000;
-                    ESP_LOGI("epaper_showTask", "[TIMING] BMP read from SD card: %lld ms", bmp_read_ms);
+                    ESP_LOGI("epaper_showTask", "[TIMING] Image read from SD card: %lld ms", bmp_read_ms);
+                    if (read_err) {
+                        ESP_LOGE("epaper_showTask", "%s could not be loaded, refresh skipped", img_path);
+                    } else {
+                        // Step 5: E-paper display refresh - timing
+                        int64_t epaper_start = esp_timer_get_time();
+                        ESP_LOGI("epaper_showTask", "Starting e-paper refresh...");
+                        epaper_port_display(epd_blackImage);
+                        int64_t epaper_end = esp_timer_get_time();
+                        int64_t epaper_ms = (epaper_end - epaper_start) / 1000;
+                        ESP_LOGI("epaper_showTask", "[TIMING] E-paper refresh: %lld ms (%.1f seconds)", epaper_ms, epaper_ms / 1000.0f);
 
-                    // Step 5: E-paper display refresh - timing
-                    int64_t epaper_start = esp_timer_get_time();
-                    ESP_LOGI("epaper_showTask", "Starting e-paper refresh...");
-                    epaper_port_display(epd_blackImage);
-                    int64_t epaper_end = esp_timer_get_time();
-                    int64_t epaper_ms = (epaper_end - epaper_start) / 1000;
-                    ESP_LOGI("epaper_showTask", "[TIMING] E-paper refresh: %lld ms (%.1f seconds)", epaper_ms, epaper_ms / 1000.0f);
-
-                    // Summary
-                    ESP_LOGI("epaper_showTask", "╔════════════════════════════════════════╗");
-                    ESP_LOGI("epaper_showTask", "║     DISPLAY TIMING SUMMARY             ║");
-                    ESP_LOGI("epaper_showTask", "╠════════════════════════════════════════╣");
-                    ESP_LOGI("epaper_showTask", "║ BMP Read:      %6lld ms              ║", bmp_read_ms);
-                    ESP_LOGI("epaper_showTask", "║ E-Paper:       %6lld ms (%5.1f s)    ║", epaper_ms, epaper_ms / 1000.0f);
-                    ESP_LOGI("epaper_showTask", "║ Total:         %6lld ms (%5.1f s)    ║", bmp_read_ms + epaper_ms, (bmp_read_ms + epaper_ms) / 1000.0f);
-                    ESP_LOGI("epaper_showTask", "╚════════════════════════════════════════╝");
+                        // Summary
+                        ESP_LOGI("epaper_showTask", "╔════════════════════════════════════════╗");
+                        ESP_LOGI("epaper_showTask", "║     DISPLAY TIMING SUMMARY             ║");
+                        ESP_LOGI("epaper_showTask", "╠════════════════════════════════════════╣");
+                        ESP_LOGI("epaper_showTask", "║ Image Read:    %6lld ms              ║", bmp_read_ms);
+                        ESP_LOGI("epaper_showTask", "║ E-Paper:       %6lld ms (%5.1f s)    ║", epaper_ms, epaper_ms / 1000.0f);
+                        ESP_LOGI("epaper_showTask", "║ Total:         %6lld ms (%5.1f s)    ║", bmp_read_ms + epaper_ms, (bmp_read_ms + epaper_ms) / 1000.0f);
+                        ESP_LOGI("epaper_showTask", "╚════════════════════════════════════════╝");
+                    }
                 } else {
-                    ESP_LOGE("epaper_showTask", "No node found in list");
+                    ESP_LOGE("epaper_showTask", "No image in the index");
                 }
             } else if (get_bit_button(even, 3)) {
-                GUI_ReadBmp_RGB_6Color(score_name, 0, 0);
-                epaper_port_display(epd_blackImage);
+                if (score_index >= 0 && sdcard_index_path(score_index, score_name, sizeof(score_name))) {
+                    sdcard_index_set_current(score_index);
+                    if (GUI_ReadImage_6Color(score_name, 0, 0) == 0) {
+                        epaper_port_display(epd_blackImage);
+                    }
+                }
             } else if (get_bit_button(even, 4)) {
                 // Direct display from buffer (skip SD card I/O)
                 ESP_LOGI("epaper_showTask", "Received direct buffer display event");
 
-                if (dev_ai_gemini != NULL) {
+                if (dev_ai_gemini != NULL && dev_ai_gemini->is_EpdWritten()) {
+                    // Framebuffer was filled by the dither engine, only the refresh is left
+                    int64_t epaper_start = esp_timer_get_time();
+                    ESP_LOGI("epaper_showTask", "Framebuffer already dithered (%dx%d), starting e-paper refresh...",
+                             dev_ai_gemini->get_TargetWidth(), dev_ai_gemini->get_TargetHeight());
+                    epaper_port_display(epd_blackImage);
+                    int64_t epaper_ms = (esp_timer_get_time() - epaper_start) / 1000;
+                    ESP_LOGI("epaper_showTask", "[TIMING] E-paper refresh: %lld ms", epaper_ms);
+                } else if (dev_ai_gemini != NULL) {
                     uint8_t *buffer = dev_ai_gemini->get_DitheredBuffer();
                     int img_w = dev_ai_gemini->get_TargetWidth();
                     int img_h = dev_ai_gemini->get_TargetHeight();
@@ -275,7 +299,7 @@ static void gui_user_Task(void *arg) {
                 }
             }
             xSemaphoreGive(epaper_gui_semapHandle);
-            Green_led_arg = 0;
+            led_stop(LED_PIN_Green);
             is_ai_img     = 1;
             ESP_LOGI("epaper_showTask", "Display complete, is_ai_img reset to 1, ready for next request");
         }
@@ -315,11 +339,7 @@ static void ai_IMG_Task(void *arg) {
                     xEventGroupSetBits(epaper_groups, set_bit_button(4));
                 } else {
                     // SD card mode - existing flow
-                    sdcard_node_t *sdcard_node_data = (sdcard_node_t *) malloc(sizeof(sdcard_node_t));
-                    assert(sdcard_node_data);
-                    strcpy(sdcard_node_data->sdcard_name, str);
-                    sdcard_node_data->name_score = 1;
-                    list_rpush(sdcard_scan_listhandle, list_node_new(sdcard_node_data));
+                    sdcard_index_add(str, 1);
                     ESP_LOGI("ai_IMG_Task", "Triggering epaper display (from SD card)...");
                     xEventGroupSetBits(epaper_groups, set_bit_button(2));
                 }
@@ -328,12 +348,10 @@ static void ai_IMG_Task(void *arg) {
             }
             ESP_LOGI("ai_IMG_Task", "Image task complete, waiting for next event");
         } else if (get_bit_button(even, 1)) {
-            sdcard_bmp_Quantity = list_iterator(); 
+            sdcard_bmp_Quantity = sdcard_index_count(); 
             xSemaphoreGive(ai_img_while_semap);    
         } else if (get_bit_button(even, 2)) {
-            list_node_t   *node               = get_Currently_node();
-            sdcard_node_t *sdcard_curren_node = (sdcard_node_t *) node->val;
-            sdcard_curren_node->name_score    = IMG_Score; 
+            sdcard_index_set_score(sdcard_index_get_current(), IMG_Score); 
             xSemaphoreGive(ai_img_while_semap);            
         } else if (get_bit_button(even, 3)) {              
             auto &app = Application::GetInstance();
@@ -353,60 +371,26 @@ static void ai_IMG_Task(void *arg) {
     vTaskDelete(NULL);
 }
 
-static int list_score_iterator(list_t *list_data, list_t *list_out_score) 
-{
-    if (list_out_score == NULL || list_data == NULL) {
-        ESP_LOGE("list", "list out fill");
-        return -1;
-    }
-    int              value = 0;
-    list_iterator_t *it    = list_iterator_new(list_data, LIST_HEAD); 
-    list_node_t     *node  = list_iterator_next(it);
-    while (node != NULL) {
-        sdcard_node_t *sdcard_node = (sdcard_node_t *) node->val;
-        if (sdcard_node->name_score >= 3) {
-            char *score = (char *) malloc(100);
-            strcpy(score, sdcard_node->sdcard_name);
-            list_rpush(list_out_score, list_node_new(score)); 
-            value++;
-        }
-        node = list_iterator_next(it);
-    }
-    return value;
-}
-
 void ai_Score_Task(void *arg) 
 {
-    int name_value = 0;
-    int _ats       = 0;
+    power_on_event(POWER_EVENT_SCORE, ai_IMG_Score_Group, AI_SCORE_DUE_BIT);
     for (;;) {
         EventBits_t even = xEventGroupWaitBits(ai_IMG_Score_Group, (0x01) | (0x02), pdFALSE, pdFALSE, pdMS_TO_TICKS(2000));
-        if (get_bit_button(even, 0)) {
-            if (sdcard_score == NULL) {
-                sdcard_score = list_new();                                                
-                name_value   = list_score_iterator(sdcard_scan_listhandle, sdcard_score); 
-                //ESP_LOGE("OK", "OK1");
-            }
-            if (sdcard_score != NULL) {
-                if (name_value > 0) {
-                    list_node_t *sdcard_node = list_at(sdcard_score, _ats); 
-                    strcpy(score_name, (char *) sdcard_node->val);          
-                    xEventGroupSetBits(epaper_groups, set_bit_button(3));   
-                    //ESP_LOGE("OK", "OK2");
-                    _ats++;
-                    if (_ats == name_value) {
-                        _ats = 0;
-                    }
-                }
-            }
-        } else if (get_bit_button(even, 1)) { 
-            
-            list_destroy(sdcard_score);
-            sdcard_score = NULL;
+        if (get_bit_button(even, 1)) { 
+            sdcard_index_playlist_rewind();
             xEventGroupClearBits(ai_IMG_Score_Group, 0x02);
-            //ESP_LOGE("OK", "OK2");
+        } else if (get_bit_button(even, 0)) {
+            int index = sdcard_index_playlist_next(); // Kept sorted by the index as scores change
+            if (index >= 0) {
+                score_index = index;
+                xEventGroupSetBits(epaper_groups, set_bit_button(3));   
+            }
+            // The power service wakes the task for the next image, a score reset cuts the wait short
+            power_schedule(POWER_EVENT_SCORE, AI_SCORE_INTERVAL_S);
+            xEventGroupWaitBits(ai_IMG_Score_Group, AI_SCORE_DUE_BIT | 0x02, pdFALSE, pdFALSE, portMAX_DELAY);
+            xEventGroupClearBits(ai_IMG_Score_Group, AI_SCORE_DUE_BIT);
+            power_schedule(POWER_EVENT_SCORE, 0);
         }
-        vTaskDelay(pdMS_TO_TICKS(1000 * 60 * 30)); 
     }
 }
 
@@ -414,7 +398,7 @@ void key_wakeUp_user_Task(void *arg) {
     for (;;) {
         EventBits_t even = xEventGroupWaitBits(key_groups, (0x01), pdTRUE, pdFALSE, pdMS_TO_TICKS(2000));
         if (even & 0x01) {
-            gpio_set_level((gpio_num_t) 45, 0);
+            led_play(LED_PIN_Red, LED_PATTERN_ON);
             std::string wake_word = "你好小智";
             Application::GetInstance().WakeWordInvoke(wake_word);
         }
@@ -426,7 +410,7 @@ void pwr_sleep_user_Task(void *arg) {
         EventBits_t even = xEventGroupWaitBits(pwr_groups, (0x01), pdTRUE, pdFALSE, pdMS_TO_TICKS(2000));
         if (even & 0x01) {
             xEventGroupSetBits(ai_IMG_Group, 0x08);
-            gpio_set_level((gpio_num_t) 45, 1); 
+            led_play(LED_PIN_Red, LED_PATTERN_OFF);
         }
     }
 }
@@ -441,7 +425,7 @@ char* Get_TemperatureHumidity(void) {
 
 void User_xiaozhi_app_init(void)                     // Initialization in the Xiaozhi mode
 {
-    gpio_set_level((gpio_num_t) 45, 0);
+    led_play(LED_PIN_Red, LED_PATTERN_ON);
     dev_shtc3 = new i2c_equipment_shtc3();
     ai_img_while_semap = xSemaphoreCreateBinary();
     str_ai_chat_buff   = (char *) heap_caps_malloc(STR_AI_CHAT_BUFF_SIZE, MALLOC_CAP_SPIRAM);
@@ -480,8 +464,11 @@ void User_xiaozhi_app_init(void)                     // Initialization in the Xi
     dev_ai_base->set_config(&ai_model_data->dither);
 
     //if(ai_model_data != NULL) {free(ai_model_data);ai_model_data = NULL;}
-    list_scan_dir("/sdcard/05_user_ai_img"); // Place the image data under the linked list
-    sdcard_bmp_Quantity = list_iterator();   // Traverse the linked list to count the number of images
+    // Load the image index; the directory is only rescanned on a cold boot (the card may have been edited)
+    sdcard_bmp_Quantity = sdcard_index_open("/sdcard/05_user_ai_img", esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED);
+    if (sdcard_bmp_Quantity < 0) {
+        sdcard_bmp_Quantity = 0;
+    }
     xTaskCreate(gui_user_Task, "gui_user_Task", 6 * 1024, &sdcard_doc_count, 2, NULL);
     xTaskCreate(ai_IMG_Task, "ai_IMG_Task", 6 * 1024, str_ai_chat_buff, 2, NULL);
     xTaskCreate(ai_Score_Task, "ai_Score_Task", 4 * 1024, NULL, 2, NULL);
@@ -3,8 +3,10 @@
 #include "button_bsp.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "i2c_bsp.h"
 #include "led_bsp.h"
+#include "power_bsp.h"
 #include "sdcard_bsp.h"
 #include <stdio.h>
 #include <string.h>
@@ -26,106 +28,29 @@
 
 SemaphoreHandle_t  epaper_gui_semapHandle = NULL; // Mutual exclusion lock to prevent repeated refreshing
 EventGroupHandle_t epaper_groups;                 // Event group for map refreshing
-EventGroupHandle_t Green_led_Mode_queue = 0;      // Queue for LED blinking, mainly for storing mode parameters
-EventGroupHandle_t Red_led_Mode_queue   = 0;      // Queue for LED blinking, mainly for storing mode parameters
-uint8_t            Green_led_arg        = 0;      // Parameters for LED task
-uint8_t            Red_led_arg          = 0;      // Parameters for LED task
 
-static void Green_led_user_Task(void *arg) {
-    uint8_t *led_arg = (uint8_t *) arg;
-    for (;;) {
-        EventBits_t even =
-            xEventGroupWaitBits(Green_led_Mode_queue, set_bit_all, pdFALSE, pdFALSE, portMAX_DELAY);
-        if (get_bit_data(even, 1)) {
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            xEventGroupClearBits(Green_led_Mode_queue, rset_bit_data(1));
-        }
-        if (get_bit_data(even, 2)) {
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            xEventGroupClearBits(Green_led_Mode_queue, rset_bit_data(2));
-        }
-        if (get_bit_data(even, 3)) {
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            xEventGroupClearBits(Green_led_Mode_queue, rset_bit_data(3));
-        }
-        if (get_bit_data(even, 4)) {
-            led_set(LED_PIN_Green, LED_ON);
-            xEventGroupClearBits(Green_led_Mode_queue, rset_bit_data(4));
-        }
-        if (get_bit_data(even, 5)) {
-            led_set(LED_PIN_Green, LED_OFF);
-            xEventGroupClearBits(Green_led_Mode_queue, rset_bit_data(5));
-        }
-        if (get_bit_data(even, 6)) {
-            while (*led_arg) {
-                led_set(LED_PIN_Green, LED_ON);
-                vTaskDelay(pdMS_TO_TICKS(100));
-                led_set(LED_PIN_Green, LED_OFF);
-                vTaskDelay(pdMS_TO_TICKS(100));
-            }
-            xEventGroupClearBits(Green_led_Mode_queue, rset_bit_data(6));
-        }
-        if (get_bit_data(even, 7)) 
-        {
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_ON);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            led_set(LED_PIN_Green, LED_OFF);
-            xEventGroupClearBits(Green_led_Mode_queue, rset_bit_data(7));
-        }
-    }
-}
+/*
+What each mode needs at boot besides I2C, the AXP2101, the LEDs, the power
+service and the buttons. The SD card mount and the e-paper init touch
+different peripherals (SDMMC and SPI) and run side by side.
+*/
+#define BOOT_EPAPER   (1 << 0)
+#define BOOT_SDCARD   (1 << 1)
+#define BOOT_MODE_KEY (1 << 2) // Long press of key1 into the mode selection
 
-static void Red_led_user_Task(void *arg) {
-    uint8_t *led_arg = (uint8_t *) arg;
-    for (;;) {
-        EventBits_t even =
-            xEventGroupWaitBits(Red_led_Mode_queue, set_bit_all, pdFALSE, pdFALSE, portMAX_DELAY);
-        if (get_bit_data(even, 0)) {
-            led_set(LED_PIN_Red, LED_ON);
-            xEventGroupClearBits(Red_led_Mode_queue, rset_bit_data(0));
-        }
-        if (get_bit_data(even, 6)) {
-            while (*led_arg) {
-                vTaskDelay(pdMS_TO_TICKS(100));
-                led_set(LED_PIN_Red, LED_OFF);
-                vTaskDelay(pdMS_TO_TICKS(100));
-                led_set(LED_PIN_Red, LED_ON);
-            }
-            xEventGroupClearBits(Red_led_Mode_queue, rset_bit_data(6));
-        }
-    }
-}
+typedef struct {
+    uint8_t mode;
+    uint8_t needs;
+} boot_profile_t;
+
+static const boot_profile_t boot_profiles[] = {
+    {PHOTOPAINTER_MODE_BASIC, BOOT_EPAPER | BOOT_SDCARD | BOOT_MODE_KEY},
+    {PHOTOPAINTER_MODE_NETWORK, BOOT_EPAPER | BOOT_SDCARD | BOOT_MODE_KEY},
+    {PHOTOPAINTER_MODE_XIAOZHI, BOOT_EPAPER | BOOT_SDCARD | BOOT_MODE_KEY},
+    {PHOTOPAINTER_MODE_SELECTION, 0}, // Only plays the prompts and writes NVS
+};
 
+static SemaphoreHandle_t epaper_init_Semp = NULL;
 
 static void key1_button_user_Task(void *arg) {
     esp_err_t ret;
@@ -152,6 +77,26 @@ static void key1_button_user_Task(void *arg) {
     }
 }
 
+static uint8_t boot_needs(uint8_t mode) {
+    for (int i = 0; i < sizeof(boot_profiles) / sizeof(boot_profiles[0]); i++) {
+        if (boot_profiles[i].mode == mode) {
+            return boot_profiles[i].needs;
+        }
+    }
+    return BOOT_EPAPER | BOOT_SDCARD | BOOT_MODE_KEY;
+}
+
+static void epaper_init_Task(void *arg) {
+    epaper_port_init(); /* Ink Display Initialization */
+    User_boot_mark("e-paper ready");
+    xSemaphoreGive(epaper_init_Semp);
+    vTaskDelete(NULL);
+}
+
+void User_boot_mark(const char *name) {
+    ESP_LOGI("boot", "[TIMING] %s at %lld ms", name, esp_timer_get_time() / 1000);
+}
+
 void axp2101_irq_init(void) {
     gpio_config_t gpio_conf = {};
     gpio_conf.intr_type     = GPIO_INTR_DISABLE;
@@ -167,21 +112,33 @@ void axp2101_irq_init(void) {
     vTaskDelay(pdMS_TO_TICKS(200));
 }
 
-uint8_t User_Mode_init(void) 
-{
+uint8_t User_Mode_init(uint8_t mode) {
+    uint8_t needs          = boot_needs(mode);
     epaper_gui_semapHandle = xSemaphoreCreateMutex(); /* Acquire the mutual exclusion lock to prevent re-flashing */
+    epaper_groups          = xEventGroupCreate();
     i2c_master_Init();                                /* Must be initialized */
     //axp2101_irq_init();                             /* AXP2101 Wakeup Settings */
     axp_i2c_prot_init();                              /* AXP2101 Initialization */
-    axp_cmd_init();                                   /* Enable the corresponding channel */
+    axp_cmd_init();                                   /* Enable the corresponding channel, before the panel and the card */
+    User_boot_mark("pmu ready");
     led_init();                                       /* LED Blink Initialization */
-    epaper_port_init();                               /* Ink Display Initialization */
-    uint8_t sdcard_win = _sdcard_init();              /* SD Card Initialization */
+    power_init();                                     /* Wake-up sources and sleep scheduling */
+    if (needs & BOOT_EPAPER) {
+        epaper_init_Semp = xSemaphoreCreateBinary();
+        xTaskCreate(epaper_init_Task, "epaper_init_Task", 4 * 1024, NULL, 4, NULL);
+    }
+    uint8_t sdcard_win = 1;
+    if (needs & BOOT_SDCARD) {
+        sdcard_win = _sdcard_init();                  /* SD Card Initialization, while the panel resets */
+        User_boot_mark("sd card mounted");
+    }
+    if (needs & BOOT_EPAPER) {
+        xSemaphoreTake(epaper_init_Semp, portMAX_DELAY);
+        vSemaphoreDelete(epaper_init_Semp);
+        epaper_init_Semp = NULL;
+    }
     if (sdcard_win == 0)
         return 0;
-    Green_led_Mode_queue = xEventGroupCreate();
-    Red_led_Mode_queue   = xEventGroupCreate();
-    epaper_groups        = xEventGroupCreate();
     /*GPIO */
     gpio_config_t gpio_conf = {};
     gpio_conf.intr_type     = GPIO_INTR_DISABLE;
@@ -190,14 +147,15 @@ uint8_t User_Mode_init(void)
     gpio_conf.pull_down_en  = GPIO_PULLDOWN_DISABLE;
     gpio_conf.pull_up_en    = GPIO_PULLUP_ENABLE;
     ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_config(&gpio_conf));
-    do {
-        vTaskDelay(pdMS_TO_TICKS(50)); 
-    } while (!gpio_get_level(GPIO_NUM_4));
+    while (!gpio_get_level(GPIO_NUM_4)) {             /* Wait for the key to be released, no delay when it already is */
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
     ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_reset_pin(GPIO_NUM_4));
     button_Init();
-    xTaskCreate(key1_button_user_Task, "key1_button_user_Task", 4 * 1024, NULL, 3, NULL);
-    xTaskCreate(Green_led_user_Task, "Green_led_user_Task", 3 * 1024, &Green_led_arg, 2, NULL);
-    xTaskCreate(Red_led_user_Task, "Red_led_user_Task", 3 * 1024, &Red_led_arg, 2, NULL);
+    if (needs & BOOT_MODE_KEY) {
+        xTaskCreate(key1_button_user_Task, "key1_button_user_Task", 4 * 1024, NULL, 3, NULL);
+    }
     xTaskCreate(axp2101_isCharging_task, "axp2101_isCharging_task", 3 * 1024, NULL, 2, NULL);   //AXP2101 Charging
+    User_boot_mark("peripherals ready");
     return 1;
 }
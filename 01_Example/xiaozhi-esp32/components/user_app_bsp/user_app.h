@@ -4,15 +4,16 @@
 #include "gemini_image_bsp.h"
 
 
-uint8_t User_Mode_init(void);       // main.cc
+/*PhotPainterMode values kept in NVS*/
+#define PHOTOPAINTER_MODE_BASIC     0x01
+#define PHOTOPAINTER_MODE_NETWORK   0x02
+#define PHOTOPAINTER_MODE_XIAOZHI   0x03
+#define PHOTOPAINTER_MODE_SELECTION 0x04
+
+uint8_t User_Mode_init(uint8_t mode);     // main.cc, brings up only what mode needs
+void    User_boot_mark(const char *name); // Boot timeline checkpoint, logged with the time since reset
 
-extern EventGroupHandle_t
-    Green_led_Mode_queue; 
-extern EventGroupHandle_t
-    Red_led_Mode_queue; 
 extern SemaphoreHandle_t epaper_gui_semapHandle;
-extern uint8_t Green_led_arg;           
-extern uint8_t Red_led_arg;             
 extern EventGroupHandle_t epaper_groups;
 
 
@@ -0,0 +1,234 @@
+/*
+Base64 decode of a sample PNG with the old per-character table decoder and
+with base64_stream, plus the full inlineData parser on a Gemini-style JSON
+body fed in random pieces. Fails if any decoded image differs from the PNG
+or if base64_stream is not faster than the old decoder.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "base64_stream.h"
+#include "inline_data_parser.h"
+
+#define RUNS 20
+
+static const char B64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*The decoder gemini_image_bsp used before base64_stream, for reference*/
+static int8_t old_table[256];
+
+static void old_table_init(void) {
+    memset(old_table, -1, sizeof(old_table));
+    for (int i = 0; i < 64; i++) {
+        old_table[(uint8_t)B64_CHARS[i]] = (int8_t)i;
+    }
+}
+
+static int old_base64_decode(const char *input, size_t input_len, uint8_t *output, size_t *output_len) {
+    size_t out_idx = 0;
+    uint32_t accum = 0;
+    int bits = 0;
+
+    for (size_t i = 0; i < input_len; i++) {
+        char c = input[i];
+        if (c == '=' || c == '\n' || c == '\r' || c == ' ') continue;
+
+        int8_t val = old_table[(uint8_t)c];
+        if (val < 0) {
+            return -1;
+        }
+
+        accum = (accum << 6) | val;
+        bits += 6;
+
+        if (bits >= 8) {
+            bits -= 8;
+            output[out_idx++] = (accum >> bits) & 0xFF;
+        }
+    }
+
+    *output_len = out_idx;
+    return 0;
+}
+
+/*Base64 of data into out, "\r\n" every wrap characters when wrap > 0; returns the length*/
+static size_t encode(const uint8_t *data, size_t len, char *out, int wrap) {
+    size_t o = 0;
+    int col = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        v |= i + 1 < len ? (uint32_t)data[i + 1] << 8 : 0;
+        v |= i + 2 < len ? data[i + 2] : 0;
+        char quad[4] = {B64_CHARS[v >> 18], B64_CHARS[(v >> 12) & 63],
+                        i + 1 < len ? B64_CHARS[(v >> 6) & 63] : '=', i + 2 < len ? B64_CHARS[v & 63] : '='};
+        for (int k = 0; k < 4; k++) {
+            out[o++] = quad[k];
+            if (wrap > 0 && ++col == wrap) {
+                out[o++] = '\r';
+                out[o++] = '\n';
+                col = 0;
+            }
+        }
+    }
+    return o;
+}
+
+static uint32_t seed = 4242;
+
+static size_t rand_piece(size_t max) {
+    seed = seed * 1103515245 + 12345;
+    return 1 + (seed >> 8) % max;
+}
+
+/*base64_stream over text split into random pieces*/
+static int stream_decode_split(const char *text, size_t len, uint8_t *out, size_t out_cap, size_t *out_len) {
+    base64_stream_t s;
+    base64_stream_init(&s);
+    size_t pos = 0, o = 0;
+    while (pos < len) {
+        size_t n = rand_piece(4096);
+        n = n < len - pos ? n : len - pos;
+        size_t end = pos + n;
+        while (pos < end && s.error == BASE64_STREAM_OK) {
+            size_t produced;
+            size_t used = base64_stream_decode(&s, text + pos, end - pos, out + o, out_cap - o, &produced);
+            o += produced;
+            if (used == 0) {
+                return -1;
+            }
+            pos += used;
+        }
+    }
+    size_t produced;
+    if (base64_stream_finish(&s, out + o, &produced) != BASE64_STREAM_OK) {
+        return -1;
+    }
+    *out_len = o + produced;
+    return 0;
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+} sink_ctx_t;
+
+static int collect(void *user_ctx, const uint8_t *data, size_t len) {
+    sink_ctx_t *ctx = (sink_ctx_t *)user_ctx;
+    memcpy(ctx->buf + ctx->len, data, len);
+    ctx->len += len;
+    return 0;
+}
+
+static int same(const char *what, const uint8_t *a, size_t a_len, const uint8_t *png, size_t png_len) {
+    int ok = a_len == png_len && memcmp(a, png, png_len) == 0;
+    printf("  %-44s %s\n", what, ok ? "identical" : "DIFFERENT");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s sample.png\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 2;
+    }
+    fseek(f, 0, SEEK_END);
+    size_t png_len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *png = (uint8_t *)malloc(png_len);
+    if (png == NULL || fread(png, 1, png_len, f) != png_len) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 2;
+    }
+    fclose(f);
+
+    size_t text_cap = png_len / 3 * 4 * 2 + 256;
+    char *text = (char *)malloc(text_cap);
+    uint8_t *out = (uint8_t *)malloc(png_len + 16);
+    if (text == NULL || out == NULL) {
+        return 2;
+    }
+    old_table_init();
+    printf("base64 of %s (%u bytes), best of %d\n", argv[1], (unsigned)png_len, RUNS);
+    int ok = 1;
+    size_t out_len;
+
+    // Timing on the plain base64 string, as Gemini sends it
+    size_t text_len = encode(png, png_len, text, 0);
+    int64_t old_us = INT64_MAX, new_us = INT64_MAX;
+    for (int i = 0; i < RUNS; i++) {
+        int64_t start = esp_timer_get_time();
+        old_base64_decode(text, text_len, out, &out_len);
+        int64_t us = esp_timer_get_time() - start;
+        old_us = us < old_us ? us : old_us;
+    }
+    ok &= same("old decoder", out, out_len, png, png_len);
+
+    base64_stream_t s;
+    for (int i = 0; i < RUNS; i++) {
+        size_t tail;
+        int64_t start = esp_timer_get_time();
+        base64_stream_init(&s);
+        base64_stream_decode(&s, text, text_len, out, png_len + 16, &out_len);
+        base64_stream_finish(&s, out + out_len, &tail);
+        int64_t us = esp_timer_get_time() - start;
+        out_len += tail;
+        new_us = us < new_us ? us : new_us;
+    }
+    ok &= same("base64_stream", out, out_len, png, png_len);
+
+    // Line-wrapped input, split anywhere
+    text_len = encode(png, png_len, text, 76);
+    ok &= stream_decode_split(text, text_len, out, png_len + 16, &out_len) == 0 &&
+          same("base64_stream, CRLF wrapped, random splits", out, out_len, png, png_len);
+
+    // Whole JSON body through the parser, with escaped slashes, random splits
+    size_t body_len = 0;
+    char *body = (char *)malloc(text_cap + png_len);
+    if (body == NULL) {
+        return 2;
+    }
+    body_len += sprintf(body, "{\"candidates\": [{\"content\": {\"parts\": [{\"inlineData\": "
+                              "{\"mimeType\": \"image/png\", \"data\": \"");
+    text_len = encode(png, png_len, text, 0);
+    for (size_t i = 0; i < text_len; i++) {
+        if (text[i] == '/') {
+            body[body_len++] = '\\';
+        }
+        body[body_len++] = text[i];
+    }
+    body_len += sprintf(body + body_len, "\"}}]}}]}");
+
+    uint8_t block[4096];
+    sink_ctx_t ctx = {out, 0};
+    inline_data_parser_t parser;
+    inline_data_parser_init(&parser, block, sizeof(block), collect, &ctx);
+    for (size_t pos = 0; pos < body_len;) {
+        size_t n = rand_piece(4096);
+        n = n < body_len - pos ? n : body_len - pos;
+        inline_data_parser_feed(&parser, body + pos, n);
+        pos += n;
+    }
+    ok &= inline_data_parser_finish(&parser) == INLINE_DATA_OK &&
+          same("inlineData parser, JSON body, random splits", ctx.buf, ctx.len, png, png_len);
+
+    double mb = (double)encode(png, png_len, text, 0) / (1024 * 1024);
+    printf("  old table decoder: %7.3f ms (%.0f MB/s)\n", old_us / 1000.0, mb / (old_us / 1e6));
+    printf("  base64_stream:     %7.3f ms (%.0f MB/s, %.2fx)\n", new_us / 1000.0, mb / (new_us / 1e6),
+           (double)old_us / new_us);
+
+    free(body);
+    free(text);
+    free(out);
+    free(png);
+    if (new_us >= old_us) {
+        printf("base64_stream is not faster\n");
+        ok = 0;
+    }
+    return ok ? 0 : 1;
+}
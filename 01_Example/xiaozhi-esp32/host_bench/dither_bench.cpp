@@ -0,0 +1,115 @@
+/*
+Per-frame dither time with the palette lookup table against the exact
+nearest-colour search, on a fixed 800x480 test image, and how many output
+pixels differ between the two. Error diffusion carries any single different
+decision on to its neighbours, so the frame difference is large even when
+the images look the same; the 8x8 block luma difference and the decisions
+on single pixels (a 1x1 image has no diffused error) show the real change.
+Fails if more than 2% of single-pixel decisions differ.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+
+void bench_dither_lut(uint8_t *in, uint8_t *out, int w, int h);
+void bench_dither_exact(uint8_t *in, uint8_t *out, int w, int h);
+
+#define W    800
+#define H    480
+#define RUNS 5
+
+/*Gradients, hard-edged colour blocks and a little noise, the same every run*/
+static void make_image(uint8_t *img) {
+    uint32_t seed = 12345;
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            uint8_t *p = img + (y * W + x) * 3;
+            seed = seed * 1103515245 + 12345;
+            int noise = (int)((seed >> 16) & 15) - 8;
+            int r = x * 255 / (W - 1), g = y * 255 / (H - 1), b = 255 - (x + y) * 255 / (W + H - 2);
+            if (((x / 100) + (y / 80)) % 5 == 0) {
+                r = 200, g = 60, b = 40;
+            }
+            p[0] = (uint8_t)(r + noise < 0 ? 0 : r + noise > 255 ? 255 : r + noise);
+            p[1] = (uint8_t)(g + noise < 0 ? 0 : g + noise > 255 ? 255 : g + noise);
+            p[2] = (uint8_t)(b + noise < 0 ? 0 : b + noise > 255 ? 255 : b + noise);
+        }
+    }
+}
+
+/*Best of RUNS, the input is restored each time since it may be dithered in place*/
+static int64_t time_dither(void (*fn)(uint8_t *, uint8_t *, int, int), const uint8_t *src, uint8_t *in, uint8_t *out) {
+    int64_t best = INT64_MAX;
+    for (int i = 0; i < RUNS; i++) {
+        memcpy(in, src, W * H * 3);
+        int64_t start = esp_timer_get_time();
+        fn(in, out, W, H);
+        int64_t us = esp_timer_get_time() - start;
+        best = us < best ? us : best;
+    }
+    return best;
+}
+
+int main(void) {
+    uint8_t *src = (uint8_t *)malloc(W * H * 3);
+    uint8_t *in = (uint8_t *)malloc(W * H * 3);
+    uint8_t *lut = (uint8_t *)malloc(W * H * 3);
+    uint8_t *exact = (uint8_t *)malloc(W * H * 3);
+    if (!src || !in || !lut || !exact) {
+        return 1;
+    }
+    make_image(src);
+
+    int64_t exact_us = time_dither(bench_dither_exact, src, in, exact);
+    int64_t lut_us = time_dither(bench_dither_lut, src, in, lut);
+
+    int diff = 0;
+    long block_err = 0;     // Sum of |mean luma| differences over 8x8 blocks
+    for (int i = 0; i < W * H; i++) {
+        diff += memcmp(lut + i * 3, exact + i * 3, 3) != 0;
+    }
+    for (int by = 0; by < H; by += 8) {
+        for (int bx = 0; bx < W; bx += 8) {
+            long a = 0, b = 0;
+            for (int y = by; y < by + 8; y++) {
+                for (int x = bx; x < bx + 8; x++) {
+                    const uint8_t *p = lut + (y * W + x) * 3, *q = exact + (y * W + x) * 3;
+                    a += p[0] * 3 + p[1] * 6 + p[2];
+                    b += q[0] * 3 + q[1] * 6 + q[2];
+                }
+            }
+            block_err += labs(a - b) / 640;  // 64 pixels, weights sum to 10
+        }
+    }
+
+    // Single-pixel decisions over random colours
+    const int samples = 100000;
+    int decision_diff = 0;
+    uint32_t seed = 777;
+    for (int i = 0; i < samples; i++) {
+        uint8_t px[3], a[3], b[3];
+        seed = seed * 1103515245 + 12345;
+        px[0] = seed >> 24, px[1] = seed >> 16, px[2] = seed >> 8;
+        memcpy(a, px, 3);
+        memcpy(b, px, 3);
+        bench_dither_exact(a, a, 1, 1);
+        bench_dither_lut(b, b, 1, 1);
+        decision_diff += memcmp(a, b, 3) != 0;
+    }
+
+    printf("dither %dx%d, best of %d\n", W, H, RUNS);
+    printf("  exact search: %8.2f ms\n", exact_us / 1000.0);
+    printf("  palette LUT:  %8.2f ms (%.2fx)\n", lut_us / 1000.0, (double)exact_us / lut_us);
+    printf("  pixels differing: %d of %d (%.2f%%), mean 8x8 block luma difference %.2f\n", diff, W * H,
+           100.0 * diff / (W * H), (double)block_err / ((W / 8) * (H / 8)));
+    printf("  single-pixel decisions differing: %d of %d (%.3f%%)\n", decision_diff, samples,
+           100.0 * decision_diff / samples);
+
+    free(src);
+    free(in);
+    free(lut);
+    free(exact);
+    return decision_diff * 50 > samples;
+}
@@ -0,0 +1,9 @@
+// dither_engine with the exact six-entry search for every pixel, renamed so both fit in one binary
+#define DITHER_PALETTE_LUT_BITS 0
+#define dither_engine dither_engine_exact
+#include "../components/esp32_ai_bsp/dither_engine.cpp"
+
+void bench_dither_exact(uint8_t *in, uint8_t *out, int w, int h) {
+    static dither_engine engine;
+    engine.dither_rgb888(in, out, w, h);
+}
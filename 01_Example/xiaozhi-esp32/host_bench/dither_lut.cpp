@@ -0,0 +1,7 @@
+// dither_engine as built for the firmware, with the palette lookup table
+#include "../components/esp32_ai_bsp/dither_engine.cpp"
+
+void bench_dither_lut(uint8_t *in, uint8_t *out, int w, int h) {
+    static dither_engine engine;
+    engine.dither_rgb888(in, out, w, h);
+}
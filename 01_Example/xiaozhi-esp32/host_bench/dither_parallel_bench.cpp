@@ -0,0 +1,116 @@
+/*
+Two-core dithering against the single-core pass, with the FreeRTOS workers
+on POSIX threads. The Bayer and blue-noise band split and the wavefront
+Floyd-Steinberg (against plain Floyd-Steinberg, serpentine off) must give
+bit-identical output, both as RGB888 and packed into the 4bpp framebuffer
+at rotate 180 (row-mapped) and 90 (column-mapped). The speedup is only
+meaningful when the host gives the process two or more cores; the test
+fails on differing output, not on time.
+*/
+#include <unistd.h>
+#include "../components/esp32_ai_bsp/dither_engine.cpp"
+
+#define W    800
+#define H    480
+#define RUNS 5
+
+/*Gradients, hard-edged colour blocks and a little noise, the same every run*/
+static void make_image(uint8_t *img) {
+    uint32_t seed = 12345;
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            uint8_t *p = img + (y * W + x) * 3;
+            seed = seed * 1103515245 + 12345;
+            int noise = (int)((seed >> 16) & 15) - 8;
+            int r = x * 255 / (W - 1), g = y * 255 / (H - 1), b = 255 - (x + y) * 255 / (W + H - 2);
+            if (((x / 100) + (y / 80)) % 5 == 0) {
+                r = 200, g = 60, b = 40;
+            }
+            p[0] = (uint8_t)CLAMP(r + noise, 0, 255);
+            p[1] = (uint8_t)CLAMP(g + noise, 0, 255);
+            p[2] = (uint8_t)CLAMP(b + noise, 0, 255);
+        }
+    }
+}
+
+static void configure(dither_engine *engine, dither_kernel_t kernel) {
+    dither_config_t config;
+    config.kernel = kernel;
+    config.serpentine = false;
+    memcpy(config.palette, DEFAULT_PALETTE, sizeof(DEFAULT_PALETTE));
+    engine->set_config(&config);
+}
+
+/*Single core: dither_stream always runs on the calling thread*/
+static void single_rgb(dither_engine *engine, const uint8_t *in, uint8_t *out) {
+    dither_buffer_ctx_t ctx = {in, out, W};
+    engine->dither_stream(W, H, buffer_row_source, buffer_row_sink, &ctx);
+}
+
+/*Single core into the framebuffer: the push session is the same pass row by row*/
+static void single_epd(dither_engine *engine, const uint8_t *in, const dither_epd_target_t *target) {
+    engine->dither_push_begin_epd(W, H, target);
+    for (int y = 0; y < H; y++) {
+        engine->dither_push_row(in + (size_t)y * W * 3);
+    }
+    engine->dither_push_end();
+}
+
+typedef struct {
+    const char *name;
+    dither_kernel_t parallel;
+    dither_kernel_t single;
+} bench_case_t;
+
+int main(void) {
+    static uint8_t in[W * H * 3], a[W * H * 3], b[W * H * 3];
+    static uint8_t fb_a[W / 2 * H], fb_b[W / 2 * H];
+    make_image(in);
+
+    static const bench_case_t cases[] = {
+        {"bayer", DITHER_ORDERED_BAYER, DITHER_ORDERED_BAYER},
+        {"blue_noise", DITHER_BLUE_NOISE, DITHER_BLUE_NOISE},
+        {"floyd_steinberg_wavefront", DITHER_FLOYD_STEINBERG_WAVEFRONT, DITHER_FLOYD_STEINBERG},
+    };
+
+    dither_engine engine;
+    int failed = 0;
+    printf("dither %dx%d, best of %d, %ld host core(s)\n", W, H, RUNS, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  %-27s %9s %9s %8s  output\n", "kernel", "1 core", "2 cores", "speedup");
+    for (const bench_case_t &c : cases) {
+        int64_t single_us = INT64_MAX, parallel_us = INT64_MAX;
+        for (int i = 0; i < RUNS; i++) {
+            configure(&engine, c.single);
+            int64_t start = esp_timer_get_time();
+            single_rgb(&engine, in, a);
+            int64_t us = esp_timer_get_time() - start;
+            single_us = us < single_us ? us : single_us;
+
+            configure(&engine, c.parallel);
+            start = esp_timer_get_time();
+            engine.dither_rgb888(in, b, W, H);
+            us = esp_timer_get_time() - start;
+            parallel_us = us < parallel_us ? us : parallel_us;
+        }
+        bool same = memcmp(a, b, sizeof(a)) == 0;
+
+        // The framebuffer path, row-mapped and column-mapped
+        for (int rotate = 90; rotate <= 180; rotate += 90) {
+            dither_epd_target_t target = {fb_a, W, H, rotate, 0, NULL};
+            memset(fb_a, 0x11, sizeof(fb_a));
+            memset(fb_b, 0x11, sizeof(fb_b));
+            configure(&engine, c.single);
+            single_epd(&engine, in, &target);
+            configure(&engine, c.parallel);
+            target.image = fb_b;
+            engine.dither_rgb888_to_epd(in, W, H, &target);
+            same = same && memcmp(fb_a, fb_b, sizeof(fb_a)) == 0;
+        }
+
+        double speedup = (double)single_us / parallel_us;
+        printf("  %-27s %6.2f ms %6.2f ms %7.2fx  %s%s\n", c.name, single_us / 1000.0, parallel_us / 1000.0, speedup,
+               same ? "identical" : "DIFFERENT", speedup < 1.8 ? ", below the 1.8x target" : "");
+        failed += !same;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,446 @@
+/*
+GUI_Paint span core against the per-pixel Paint_SetPixel code it replaced.
+Random clears, windows, lines, rectangles, spans and bitmaps are drawn with
+both into two image caches, in every scale, rotation and mirror, and must
+give the same bytes; lines and rectangles often start at the top or left
+edge, where wide dots hang off the picture and must be clipped the same way. Then a full 800x480 frame in
+Scale 6 (4bpp, the PhotoPainter mode) is cleared, filled and blitted with
+both and timed. Coordinates stay clear of x == Width and y == Height, which
+the old Paint_SetPixel let through into the next memory row.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "GUI_Paint.h"
+
+#define RUNS 20
+
+static const char *TAG = "paint_bench";
+
+/*The generated CN font index is not built here, Paint_DrawString_CN is not used*/
+const cFONT_INDEX *Font_CN_GetIndex(const cFONT *font) {
+    return NULL;
+}
+
+/*
+The drawing code before the span core, for reference, trimmed to the
+functions the span core replaced
+*/
+static void old_SetPixel(UWORD Xpoint, UWORD Ypoint, UWORD Color)
+{
+    if(Xpoint > Paint.Width || Ypoint > Paint.Height){
+        ESP_LOGI(TAG,"Exceeding display boundaries");
+        return;
+    }
+    UWORD X, Y;
+    switch(Paint.Rotate) {
+    case 0:
+        X = Xpoint;
+        Y = Ypoint;
+        break;
+    case 90:
+        X = Paint.WidthMemory - Ypoint - 1;
+        Y = Xpoint;
+        break;
+    case 180:
+        X = Paint.WidthMemory - Xpoint - 1;
+        Y = Paint.HeightMemory - Ypoint - 1;
+        break;
+    case 270:
+        X = Ypoint;
+        Y = Paint.HeightMemory - Xpoint - 1;
+        break;
+    default:
+        return;
+    }
+
+    switch(Paint.Mirror) {
+    case MIRROR_NONE:
+        break;
+    case MIRROR_HORIZONTAL:
+        X = Paint.WidthMemory - X - 1;
+        break;
+    case MIRROR_VERTICAL:
+        Y = Paint.HeightMemory - Y - 1;
+        break;
+    case MIRROR_ORIGIN:
+        X = Paint.WidthMemory - X - 1;
+        Y = Paint.HeightMemory - Y - 1;
+        break;
+    default:
+        return;
+    }
+
+    if(X > Paint.WidthMemory || Y > Paint.HeightMemory){
+        ESP_LOGI(TAG,"Exceeding display boundaries");
+        return;
+    }
+
+    if(Paint.Scale == 2){
+        UDOUBLE Addr = X / 8 + Y * Paint.WidthByte;
+        UBYTE Rdata = Paint.Image[Addr];
+        if(Color == BLACK)
+            Paint.Image[Addr] = Rdata & ~(0x80 >> (X % 8));
+        else
+            Paint.Image[Addr] = Rdata | (0x80 >> (X % 8));
+    }else if(Paint.Scale == 4){
+        UDOUBLE Addr = X / 4 + Y * Paint.WidthByte;
+        Color = Color % 4;//Guaranteed color scale is 4  --- 0~3
+        UBYTE Rdata = Paint.Image[Addr];
+        Rdata = Rdata & (~(0xC0 >> ((X % 4)*2)));//Clear first, then set value
+        Paint.Image[Addr] = Rdata | ((Color << 6) >> ((X % 4)*2));
+    }else if(Paint.Scale == 6 || Paint.Scale == 7 || Paint.Scale == 16){
+        UDOUBLE Addr = X / 2  + Y * Paint.WidthByte;
+        UBYTE Rdata = Paint.Image[Addr];
+        Rdata = Rdata & (~(0xF0 >> ((X % 2)*4)));//Clear first, then set value
+        Paint.Image[Addr] = Rdata | ((Color << 4) >> ((X % 2)*4));
+    }
+}
+
+static void old_Clear(UWORD Color)
+{
+    if(Paint.Scale == 2) {
+        for (UWORD Y = 0; Y < Paint.HeightByte; Y++) {
+            for (UWORD X = 0; X < Paint.WidthByte; X++ ) {//8 pixel =  1 byte
+                UDOUBLE Addr = X + Y*Paint.WidthByte;
+                Paint.Image[Addr] = Color;
+            }
+        }
+    }else if(Paint.Scale == 4) {
+        for (UWORD Y = 0; Y < Paint.HeightByte; Y++) {
+            for (UWORD X = 0; X < Paint.WidthByte; X++ ) {
+                UDOUBLE Addr = X + Y*Paint.WidthByte;
+                Paint.Image[Addr] = (Color<<6)|(Color<<4)|(Color<<2)|Color;
+            }
+        }
+    }else if(Paint.Scale == 6 || Paint.Scale == 7 || Paint.Scale == 16) {
+        for (UWORD Y = 0; Y < Paint.HeightByte; Y++) {
+            for (UWORD X = 0; X < Paint.WidthByte; X++ ) {
+                UDOUBLE Addr = X + Y*Paint.WidthByte;
+                Paint.Image[Addr] = (Color<<4)|Color;
+            }
+        }
+    }
+}
+
+static void old_ClearWindows(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend, UWORD Color)
+{
+    UWORD X, Y;
+    for (Y = Ystart; Y < Yend; Y++) {
+        for (X = Xstart; X < Xend; X++) {//8 pixel =  1 byte
+            old_SetPixel(X, Y, Color);
+        }
+    }
+}
+
+static void old_DrawPoint(UWORD Xpoint, UWORD Ypoint, UWORD Color,
+                          DOT_PIXEL Dot_Pixel, DOT_STYLE Dot_Style)
+{
+    if (Xpoint > Paint.Width || Ypoint > Paint.Height) {
+        ESP_LOGI(TAG,"Paint_DrawPoint Input exceeds the normal display range");
+        return;
+    }
+
+    int16_t XDir_Num , YDir_Num;
+    if (Dot_Style == DOT_FILL_AROUND) {
+        for (XDir_Num = 0; XDir_Num < 2 * Dot_Pixel - 1; XDir_Num++) {
+            for (YDir_Num = 0; YDir_Num < 2 * Dot_Pixel - 1; YDir_Num++) {
+                if(Xpoint + XDir_Num - Dot_Pixel < 0 || Ypoint + YDir_Num - Dot_Pixel < 0)
+                    break;
+                old_SetPixel(Xpoint + XDir_Num - Dot_Pixel, Ypoint + YDir_Num - Dot_Pixel, Color);
+            }
+        }
+    } else {
+        for (XDir_Num = 0; XDir_Num <  Dot_Pixel; XDir_Num++) {
+            for (YDir_Num = 0; YDir_Num <  Dot_Pixel; YDir_Num++) {
+                old_SetPixel(Xpoint + XDir_Num - 1, Ypoint + YDir_Num - 1, Color);
+            }
+        }
+    }
+}
+
+static void old_DrawLine(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend,
+                         UWORD Color, DOT_PIXEL Line_width, LINE_STYLE Line_Style)
+{
+    if (Xstart > Paint.Width || Ystart > Paint.Height ||
+        Xend > Paint.Width || Yend > Paint.Height) {
+        ESP_LOGI(TAG,"Paint_DrawLine Input exceeds the normal display range");
+        return;
+    }
+
+    UWORD Xpoint = Xstart;
+    UWORD Ypoint = Ystart;
+    int dx = (int)Xend - (int)Xstart >= 0 ? Xend - Xstart : Xstart - Xend;
+    int dy = (int)Yend - (int)Ystart <= 0 ? Yend - Ystart : Ystart - Yend;
+
+    // Increment direction, 1 is positive, -1 is counter;
+    int XAddway = Xstart < Xend ? 1 : -1;
+    int YAddway = Ystart < Yend ? 1 : -1;
+
+    //Cumulative error
+    int Esp = dx + dy;
+    char Dotted_Len = 0;
+
+    for (;;) {
+        Dotted_Len++;
+        //Painted dotted line, 2 point is really virtual
+        if (Line_Style == LINE_STYLE_DOTTED && Dotted_Len % 3 == 0) {
+            old_DrawPoint(Xpoint, Ypoint, IMAGE_BACKGROUND, Line_width, DOT_STYLE_DFT);
+            Dotted_Len = 0;
+        } else {
+            old_DrawPoint(Xpoint, Ypoint, Color, Line_width, DOT_STYLE_DFT);
+        }
+        if (2 * Esp >= dy) {
+            if (Xpoint == Xend)
+                break;
+            Esp += dy;
+            Xpoint += XAddway;
+        }
+        if (2 * Esp <= dx) {
+            if (Ypoint == Yend)
+                break;
+            Esp += dx;
+            Ypoint += YAddway;
+        }
+    }
+}
+
+static void old_DrawRectangle(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend,
+                              UWORD Color, DOT_PIXEL Line_width, DRAW_FILL Draw_Fill)
+{
+    if (Xstart > Paint.Width || Ystart > Paint.Height ||
+        Xend > Paint.Width || Yend > Paint.Height) {
+        ESP_LOGI(TAG,"Input exceeds the normal display range");
+        return;
+    }
+
+    if (Draw_Fill) {
+        UWORD Ypoint;
+        for(Ypoint = Ystart; Ypoint < Yend; Ypoint++) {
+            old_DrawLine(Xstart, Ypoint, Xend, Ypoint, Color , Line_width, LINE_STYLE_SOLID);
+        }
+    } else {
+        old_DrawLine(Xstart, Ystart, Xend, Ystart, Color, Line_width, LINE_STYLE_SOLID);
+        old_DrawLine(Xstart, Ystart, Xstart, Yend, Color, Line_width, LINE_STYLE_SOLID);
+        old_DrawLine(Xend, Yend, Xend, Ystart, Color, Line_width, LINE_STYLE_SOLID);
+        old_DrawLine(Xend, Yend, Xstart, Yend, Color, Line_width, LINE_STYLE_SOLID);
+    }
+}
+
+static void old_DrawBitMap(const unsigned char* image_buffer)
+{
+    UWORD x, y;
+    UDOUBLE Addr = 0;
+
+    for (y = 0; y < Paint.HeightByte; y++) {
+        for (x = 0; x < Paint.WidthByte; x++) {//8 pixel =  1 byte
+            Addr = x + y * Paint.WidthByte;
+            Paint.Image[Addr] = (unsigned char)image_buffer[Addr];
+        }
+    }
+}
+
+/*How the BMP readers blitted a row or column before Paint_DrawSpan*/
+static void old_DrawSpan(UWORD Xstart, UWORD Ystart, const UBYTE *Colors, UWORD Len, SPAN_DIR Dir)
+{
+    for (UWORD i = 0; i < Len; i++) {
+        if (Dir == SPAN_HORIZONTAL)
+            old_SetPixel(Xstart + i, Ystart, Colors[i]);
+        else
+            old_SetPixel(Xstart, Ystart + i, Colors[i]);
+    }
+}
+
+static uint32_t seed = 1;
+
+static uint32_t rnd(uint32_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+/*Mostly anywhere, often right at the top or left edge; never past limit*/
+static UWORD coord(UWORD limit) {
+    return rnd(4) == 0 ? rnd(6) : rnd(limit);
+}
+
+static UWORD color(void) {
+    if (Paint.Scale == 2) {
+        return rnd(2) ? WHITE : BLACK;
+    }
+    return rnd(Paint.Scale == 4 ? 4 : 7);
+}
+
+/*One random operation, drawn with the old code when old is set*/
+static void random_op(int op, int old, const UBYTE *bitmap, const UBYTE *colors) {
+    // Keep wide dots short of x == Width and y == Height
+    UWORD W = Paint.Width - 8, H = Paint.Height - 8;
+    UWORD x0 = coord(W), y0 = coord(H), x1 = coord(W), y1 = coord(H);
+    UWORD c = color();
+    DOT_PIXEL dot = (DOT_PIXEL)(1 + rnd(4));
+    switch (op) {
+    case 0:
+        old ? old_Clear(c) : Paint_Clear(c);
+        break;
+    case 1:
+        old ? old_ClearWindows(x0, y0, x1, y1, c) : Paint_ClearWindows(x0, y0, x1, y1, c);
+        break;
+    case 2:     // Horizontal
+        old ? old_DrawLine(x0, y0, x1, y0, c, dot, LINE_STYLE_SOLID) : Paint_DrawLine(x0, y0, x1, y0, c, dot, LINE_STYLE_SOLID);
+        break;
+    case 3:     // Vertical
+        old ? old_DrawLine(x0, y0, x0, y1, c, dot, LINE_STYLE_SOLID) : Paint_DrawLine(x0, y0, x0, y1, c, dot, LINE_STYLE_SOLID);
+        break;
+    case 4:     // Any slope, dotted
+        old ? old_DrawLine(x0, y0, x1, y1, c, dot, LINE_STYLE_DOTTED) : Paint_DrawLine(x0, y0, x1, y1, c, dot, LINE_STYLE_DOTTED);
+        break;
+    case 5:
+        old ? old_DrawRectangle(x0, y0, x1, y1, c, dot, DRAW_FILL_FULL) : Paint_DrawRectangle(x0, y0, x1, y1, c, dot, DRAW_FILL_FULL);
+        break;
+    case 6:
+        old ? old_DrawRectangle(x0, y0, x1, y1, c, dot, DRAW_FILL_EMPTY) : Paint_DrawRectangle(x0, y0, x1, y1, c, dot, DRAW_FILL_EMPTY);
+        break;
+    case 7: {
+        SPAN_DIR dir = (SPAN_DIR)rnd(2);
+        UWORD len = rnd(dir == SPAN_HORIZONTAL ? Paint.Width - x0 : Paint.Height - y0) + 1;
+        old ? old_DrawSpan(x0, y0, colors, len, dir) : Paint_DrawSpan(x0, y0, colors, len, dir);
+        break;
+    }
+    default:
+        old ? old_DrawBitMap(bitmap) : Paint_DrawBitMap(bitmap);
+        break;
+    }
+}
+
+/*Every op in every scale, rotation and mirror; returns the number of mismatching cases*/
+static int check(UWORD width, UWORD height, UBYTE *a, UBYTE *b, const UBYTE *bitmap, UBYTE *colors) {
+    static const UBYTE scales[] = {2, 4, 6, 7};
+    int cases = 0, failed = 0;
+    for (int s = 0; s < 4; s++) {
+        for (int r = 0; r < 4; r++) {
+            for (int m = 0; m < 4; m++) {
+                Paint_NewImage(a, width, height, r * 90, WHITE);
+                Paint_SetScale(scales[s]);
+                Paint.Mirror = m;
+                UDOUBLE size = (UDOUBLE)Paint.WidthByte * Paint.HeightByte;
+                for (int op = 0; op < 9; op++) {
+                    for (int n = 0; n < 50; n++) {
+                        memset(a, 0x5a, size);
+                        memset(b, 0x5a, size);
+                        for (UWORD i = 0; i < 800; i++) {
+                            colors[i] = color();
+                        }
+                        uint32_t start = seed;
+                        Paint.Image = a;
+                        random_op(op, 1, bitmap, colors);
+                        seed = start;
+                        Paint.Image = b;
+                        random_op(op, 0, bitmap, colors);
+                        cases++;
+                        if (memcmp(a, b, size) != 0) {
+                            if (failed++ < 5) {
+                                printf("  differs: %ux%u scale %u rotate %d mirror %d op %d\n",
+                                       width, height, scales[s], r * 90, m, op);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    printf("  %ux%u: %d cases, %d differ\n", width, height, cases, failed);
+    return failed;
+}
+
+typedef void (*frame_fn)(int old, const UBYTE *bitmap, const UBYTE *colors);
+
+static void frame_clear(int old, const UBYTE *bitmap, const UBYTE *colors) {
+    old ? old_Clear(1) : Paint_Clear(1);
+}
+
+static void frame_window(int old, const UBYTE *bitmap, const UBYTE *colors) {
+    old ? old_ClearWindows(0, 0, Paint.Width, Paint.Height, 3) : Paint_ClearWindows(0, 0, Paint.Width, Paint.Height, 3);
+}
+
+static void frame_rectangle(int old, const UBYTE *bitmap, const UBYTE *colors) {
+    UWORD x1 = Paint.Width - 1, y1 = Paint.Height - 1;
+    old ? old_DrawRectangle(1, 1, x1, y1, 5, DOT_PIXEL_1X1, DRAW_FILL_FULL)
+        : Paint_DrawRectangle(1, 1, x1, y1, 5, DOT_PIXEL_1X1, DRAW_FILL_FULL);
+}
+
+static void frame_rows(int old, const UBYTE *bitmap, const UBYTE *colors) {
+    for (UWORD y = 0; y < Paint.Height; y++) {
+        old ? old_DrawSpan(0, y, colors, Paint.Width, SPAN_HORIZONTAL) : Paint_DrawSpan(0, y, colors, Paint.Width, SPAN_HORIZONTAL);
+    }
+}
+
+static void frame_columns(int old, const UBYTE *bitmap, const UBYTE *colors) {
+    for (UWORD x = 0; x < Paint.Width; x++) {
+        old ? old_DrawSpan(x, 0, colors, Paint.Height, SPAN_VERTICAL) : Paint_DrawSpan(x, 0, colors, Paint.Height, SPAN_VERTICAL);
+    }
+}
+
+static void frame_bitmap(int old, const UBYTE *bitmap, const UBYTE *colors) {
+    old ? old_DrawBitMap(bitmap) : Paint_DrawBitMap(bitmap);
+}
+
+/*Best of RUNS, in ms*/
+static double time_frame(frame_fn fn, int old, const UBYTE *bitmap, const UBYTE *colors) {
+    int64_t best = INT64_MAX;
+    for (int i = 0; i < RUNS; i++) {
+        int64_t start = esp_timer_get_time();
+        fn(old, bitmap, colors);
+        int64_t us = esp_timer_get_time() - start;
+        best = us < best ? us : best;
+    }
+    return best / 1000.0;
+}
+
+int main(void) {
+    UBYTE *a = (UBYTE *)malloc(800 * 480);
+    UBYTE *b = (UBYTE *)malloc(800 * 480);
+    UBYTE *bitmap = (UBYTE *)malloc(800 * 480);
+    UBYTE colors[800];
+    if (!a || !b || !bitmap) {
+        return 2;
+    }
+    for (int i = 0; i < 800 * 480; i++) {
+        bitmap[i] = rnd(256);
+    }
+
+    printf("old vs new drawing, identical output\n");
+    int failed = check(800, 480, a, b, bitmap, colors);
+    failed += check(122, 250, a, b, bitmap, colors);
+
+    static const struct {
+        const char *name;
+        frame_fn fn;
+    } frames[] = {
+        {"clear", frame_clear},
+        {"window fill", frame_window},
+        {"filled rectangle", frame_rectangle},
+        {"row blit", frame_rows},
+        {"column blit", frame_columns},
+        {"bitmap", frame_bitmap},
+    };
+    for (int r = 0; r < 2; r++) {
+        Paint_NewImage(a, 800, 480, r ? ROTATE_180 : ROTATE_90, WHITE);
+        Paint_SetScale(6);
+        for (UWORD i = 0; i < 800; i++) {
+            colors[i] = (i / 7) % 7;
+        }
+        printf("full frame 800x480, Scale 6, rotate %d, best of %d (ms, old -> new)\n", Paint.Rotate, RUNS);
+        for (int i = 0; i < 6; i++) {
+            double old_ms = time_frame(frames[i].fn, 1, bitmap, colors);
+            double new_ms = time_frame(frames[i].fn, 0, bitmap, colors);
+            printf("  %-17s %7.3f -> %7.3f (%.1fx)\n", frames[i].name, old_ms, new_ms, old_ms / new_ms);
+        }
+    }
+
+    free(a);
+    free(b);
+    free(bitmap);
+    return failed ? 1 : 0;
+}
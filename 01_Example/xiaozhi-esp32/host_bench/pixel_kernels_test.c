@@ -0,0 +1,132 @@
+/*
+pixel_kernels against their *_ref twins: random rows of random, often odd
+lengths, with source and destination at every offset 0..3 from a word
+boundary (so both the word paths and the fallbacks run), in place for the
+R/B swap, and palettes with duplicate entries to check the tie rule.
+Fails on the first mismatch.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "pixel_kernels.h"
+
+#define MAX_N  803
+#define ROUNDS 400
+
+static uint32_t seed = 99;
+
+static uint32_t rnd(uint32_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static void fill(uint8_t *p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        p[i] = rnd(256);
+    }
+}
+
+/*Buffers with room for an offset of up to 3 and guard bytes after the row*/
+static uint32_t src_words[(MAX_N * 3 + 16) / 4];
+static uint32_t out_words[(MAX_N * 3 + 16) / 4];
+static uint32_t ref_words[(MAX_N * 3 + 16) / 4];
+
+static int failures = 0;
+
+static void check(const char *kernel, int n, int src_off, int dst_off, const uint8_t *out, const uint8_t *ref, size_t len) {
+    if (memcmp(out, ref, len) != 0 && failures++ < 10) {
+        printf("  %s differs: n %d, src offset %d, dst offset %d\n", kernel, n, src_off, dst_off);
+    }
+}
+
+static void test_swap_rb(int n, int src_off, int dst_off) {
+    uint8_t *src = (uint8_t *)src_words + src_off;
+    uint8_t *out = (uint8_t *)out_words + dst_off;
+    uint8_t *ref = (uint8_t *)ref_words + dst_off;
+    fill((uint8_t *)src_words, sizeof(src_words));
+    fill((uint8_t *)out_words, sizeof(out_words));
+    memcpy(ref_words, out_words, sizeof(out_words));
+    pixel_swap_rb_row(src, out, n);
+    pixel_swap_rb_row_ref(src, ref, n);
+    check("pixel_swap_rb_row", n, src_off, dst_off, (uint8_t *)out_words, (uint8_t *)ref_words, sizeof(out_words));
+
+    // In place
+    memcpy(ref_words, out_words, sizeof(out_words));
+    pixel_swap_rb_row(out, out, n);
+    pixel_swap_rb_row_ref(ref, ref, n);
+    check("pixel_swap_rb_row (in place)", n, dst_off, dst_off, (uint8_t *)out_words, (uint8_t *)ref_words, sizeof(out_words));
+}
+
+static void test_expand(int n, int src_off, int dst_off, const uint8_t (*palette)[3], int count) {
+    uint8_t *index = (uint8_t *)src_words + src_off;
+    uint8_t *out = (uint8_t *)out_words + dst_off;
+    uint8_t *ref = (uint8_t *)ref_words + dst_off;
+    for (int i = 0; i < n; i++) {
+        index[i] = rnd(count);
+    }
+    fill((uint8_t *)out_words, sizeof(out_words));
+    memcpy(ref_words, out_words, sizeof(out_words));
+    pixel_expand_indices(index, palette, count, out, n);
+    pixel_expand_indices_ref(index, palette, count, ref, n);
+    check("pixel_expand_indices", n, src_off, dst_off, (uint8_t *)out_words, (uint8_t *)ref_words, sizeof(out_words));
+}
+
+static void test_resample(int n, int src_off, int dst_off) {
+    static uint16_t x_index[MAX_N];
+    uint8_t *src = (uint8_t *)src_words + src_off;
+    uint8_t *out = (uint8_t *)out_words + dst_off;
+    uint8_t *ref = (uint8_t *)ref_words + dst_off;
+    int src_n = 1 + rnd(MAX_N);
+    for (int i = 0; i < n; i++) {
+        x_index[i] = rnd(src_n);
+    }
+    fill((uint8_t *)src_words, sizeof(src_words));
+    fill((uint8_t *)out_words, sizeof(out_words));
+    memcpy(ref_words, out_words, sizeof(out_words));
+    pixel_resample_row(src, x_index, out, n);
+    pixel_resample_row_ref(src, x_index, ref, n);
+    check("pixel_resample_row", n, src_off, dst_off, (uint8_t *)out_words, (uint8_t *)ref_words, sizeof(out_words));
+}
+
+static void test_nearest(int n, int src_off, const uint8_t (*palette)[3], int count) {
+    uint8_t *rgb = (uint8_t *)src_words + src_off;
+    uint8_t out[PIXEL_BLOCK + 4], ref[PIXEL_BLOCK + 4];
+    fill((uint8_t *)src_words, sizeof(src_words));
+    // Some pixels exactly on a palette colour, which ties with its duplicates
+    for (int i = 0; i < n; i++) {
+        if (rnd(4) == 0) {
+            memcpy(rgb + i * 3, palette[rnd(count)], 3);
+        }
+    }
+    memset(out, 0xee, sizeof(out));
+    memset(ref, 0xee, sizeof(ref));
+    pixel_nearest_palette16(rgb, n, palette, count, out);
+    pixel_nearest_palette16_ref(rgb, n, palette, count, ref);
+    check("pixel_nearest_palette16", n, src_off, 0, out, ref, sizeof(out));
+}
+
+int main(void) {
+    uint8_t palette[PIXEL_PALETTE_MAX][3];
+    int cases = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        int count = 1 + rnd(PIXEL_PALETTE_MAX);
+        fill(&palette[0][0], sizeof(palette));
+        if (count > 1) {
+            memcpy(palette[count - 1], palette[rnd(count - 1)], 3);    // A duplicate entry
+        }
+        // Lengths around the 4-pixel word groups, and whole rows
+        int n = (round % 4 == 0) ? MAX_N - rnd(8) : (int)rnd(64);
+        for (int src_off = 0; src_off < 4; src_off++) {
+            for (int dst_off = 0; dst_off < 4; dst_off++) {
+                test_swap_rb(n, src_off, dst_off);
+                test_expand(n, src_off, dst_off, (const uint8_t (*)[3])palette, count);
+                test_resample(n, src_off, dst_off);
+                cases += 3;
+            }
+            test_nearest(1 + rnd(PIXEL_BLOCK), src_off, (const uint8_t (*)[3])palette, count);
+            cases++;
+        }
+    }
+    printf("pixel kernels vs *_ref: %d cases, %d differ\n", cases, failures);
+    return failures ? 1 : 0;
+}
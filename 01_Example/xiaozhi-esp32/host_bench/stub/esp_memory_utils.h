@@ -0,0 +1,3 @@
+#pragma once
+#include <stdbool.h>
+static inline bool esp_ptr_external_ram(const void *p) { (void)p; return false; }
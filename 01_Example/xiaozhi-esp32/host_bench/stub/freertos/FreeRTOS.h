@@ -0,0 +1,16 @@
+// Host stand-in for the few FreeRTOS calls the benchmarked code makes.
+// dither_bench sets CONFIG_FREERTOS_UNICORE, so no task is created; the threaded
+// task and semaphore calls of dither_parallel_bench are under stub_threads/
+#pragma once
+#include <stdint.h>
+
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef unsigned UBaseType_t;
+typedef int BaseType_t;
+
+#define pdTRUE        1
+#define pdFALSE       0
+#define pdPASS        1
+#define portMAX_DELAY 0xffffffffu
@@ -0,0 +1,11 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+static inline BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *arg,
+                                                 UBaseType_t prio, TaskHandle_t *handle, int core) {
+    (void)fn; (void)name; (void)stack; (void)arg; (void)prio; (void)handle; (void)core;
+    return pdFALSE;
+}
+static inline UBaseType_t uxTaskPriorityGet(TaskHandle_t t) { (void)t; return 0; }
+static inline void vTaskDelete(TaskHandle_t t) { (void)t; }
+static inline int xPortGetCoreID(void) { return 0; }
+#define taskYIELD() do { } while (0)
@@ -0,0 +1,5 @@
+#pragma once
+#include <stdlib.h>
+typedef int jpeg_error_t;
+#define JPEG_ERR_OK 0
+static inline void jpeg_free_align(void *p) { free(p); }
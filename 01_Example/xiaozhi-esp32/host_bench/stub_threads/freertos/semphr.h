@@ -0,0 +1,20 @@
+// Host stand-in for FreeRTOS counting semaphores on POSIX semaphores
+#pragma once
+#include <semaphore.h>
+#include "freertos/FreeRTOS.h"
+
+static inline SemaphoreHandle_t xSemaphoreCreateCounting(unsigned max, unsigned init) {
+    (void)max;
+    sem_t *s = new sem_t;
+    sem_init(s, 0, init);
+    return (SemaphoreHandle_t)s;
+}
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t t) {
+    (void)t;
+    return sem_wait((sem_t *)s) == 0 ? pdTRUE : pdFALSE;
+}
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { return sem_post((sem_t *)s) == 0 ? pdTRUE : pdFALSE; }
+static inline void vSemaphoreDelete(SemaphoreHandle_t s) {
+    sem_destroy((sem_t *)s);
+    delete (sem_t *)s;
+}
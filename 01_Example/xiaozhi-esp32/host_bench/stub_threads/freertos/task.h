@@ -0,0 +1,40 @@
+// Host stand-in for FreeRTOS tasks on POSIX threads, for the two-core dither paths.
+// "Pinned to core" only sets what xPortGetCoreID() returns in that thread.
+#pragma once
+#include <pthread.h>
+#include <sched.h>
+#include "freertos/FreeRTOS.h"
+
+inline thread_local int host_core_id = 0;
+
+struct host_task_start_t {
+    void (*fn)(void *);
+    void *arg;
+    int core;
+};
+
+static inline void *host_task_entry(void *p) {
+    host_task_start_t start = *(host_task_start_t *)p;
+    delete (host_task_start_t *)p;
+    host_core_id = start.core;
+    start.fn(start.arg);
+    return NULL;
+}
+
+static inline BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *arg,
+                                                 UBaseType_t prio, TaskHandle_t *handle, int core) {
+    (void)name; (void)stack; (void)prio; (void)handle;
+    pthread_t thread;
+    host_task_start_t *start = new host_task_start_t{fn, arg, core};
+    if (pthread_create(&thread, NULL, host_task_entry, start) != 0) {
+        delete start;
+        return pdFALSE;
+    }
+    pthread_detach(thread);
+    return pdPASS;
+}
+static inline UBaseType_t uxTaskPriorityGet(TaskHandle_t t) { (void)t; return 0; }
+// The task function returns right after, which ends the thread
+static inline void vTaskDelete(TaskHandle_t t) { (void)t; }
+static inline int xPortGetCoreID(void) { return host_core_id; }
+#define taskYIELD() sched_yield()
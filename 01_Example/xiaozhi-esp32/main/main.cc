@@ -15,6 +15,7 @@
 #define TAG "main"
 
 extern "C" void app_main(void) {
+    User_boot_mark("app_main");
     // Initialize the default event loop
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
@@ -26,46 +27,49 @@ extern "C" void app_main(void) {
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    /*Both keys in one pass, the defaults are written back with a single commit*/
     nvs_handle_t my_handle;
     ret = nvs_open("PhotoPainter", NVS_READWRITE, &my_handle);
     ESP_ERROR_CHECK(ret);
+    bool    dirty      = false;
     uint8_t read_value = 0;
-    ret                = nvs_get_u8(my_handle, "PhotPainterMode", &read_value);
-    if (ret != ESP_OK) {
-        ret = nvs_set_u8(my_handle, "PhotPainterMode", 0x03);
-        ESP_ERROR_CHECK(ret);
-        nvs_commit(my_handle); //Submit the revisions
-        ret = nvs_get_u8(my_handle, "PhotPainterMode", &read_value);
+    if (nvs_get_u8(my_handle, "PhotPainterMode", &read_value) != ESP_OK) {
+        read_value = PHOTOPAINTER_MODE_XIAOZHI;
+        ESP_ERROR_CHECK(nvs_set_u8(my_handle, "PhotPainterMode", read_value));
+        dirty = true;
+    }
+    uint8_t Mode_value = 0;
+    if (nvs_get_u8(my_handle, "Mode_Flag", &Mode_value) != ESP_OK) {
+        Mode_value = 0x01;
+        ESP_ERROR_CHECK(nvs_set_u8(my_handle, "Mode_Flag", Mode_value));
+        dirty = true;
     }
-    uint8_t Mode_value;
-    ret = nvs_get_u8(my_handle, "Mode_Flag", &Mode_value);
-    if (ret != ESP_OK) {
-        ret = nvs_set_u8(my_handle, "Mode_Flag", 0x01);
-        ESP_ERROR_CHECK(ret);
+    if (dirty) {
         nvs_commit(my_handle); //Submit the revisions
-        ret = nvs_get_u8(my_handle, "Mode_Flag", &Mode_value);
     }
     nvs_close(my_handle); //Close handle
     ESP_LOGI("Mode_value", "%d", Mode_value);
-    /*Button Press Task Creation*/
-    if (User_Mode_init() == 0) {
+    User_boot_mark("nvs read");
+    /*Only what this mode uses is brought up*/
+    if (User_Mode_init(read_value) == 0) {
         ESP_LOGE("init", "init Failure");
         return;
     }
 
-    if (read_value == 0x03) {
+    if (read_value == PHOTOPAINTER_MODE_XIAOZHI) {
         printf("Enter xiaozhi mode\n");
         //Launch the application
         auto &app = Application::GetInstance();
         app.Start();
-    } else if (read_value == 0x01) {
+    } else if (read_value == PHOTOPAINTER_MODE_BASIC) {
         printf("Enter Basic mode\n");
         User_Basic_mode_app_init();
-    } else if (read_value == 0x02) {
+    } else if (read_value == PHOTOPAINTER_MODE_NETWORK) {
         printf("Enter Network mode\n");
         User_Network_mode_app_init();
-    } else if (read_value == 0x04) {
+    } else if (read_value == PHOTOPAINTER_MODE_SELECTION) {
         printf("Enter Mode Selection\n");
         Mode_Selection_Init();
     }
+    User_boot_mark("mode started");
 }
@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+"""One-shot migration of 6-colour SD card BMPs to EPF frames.
+
+Converts every full-screen 24-bit BMP in the given directories (e.g. a
+mounted SD card's 05_user_ai_img and 06_user_Foundation_img) into an .epf
+file next to it, laid out exactly as GUI_ReadBmp_RGB_6Color(path, 0, 0)
+draws it into the framebuffer. See components/epaper_port/epf_file.h for the format.
+
+    python scripts/bmp_to_epf.py /media/sd/05_user_ai_img /media/sd/06_user_Foundation_img
+"""
+import argparse
+import os
+import struct
+import sys
+
+PANEL_WIDTH = 800
+PANEL_HEIGHT = 480
+
+HEADER = struct.Struct('<4sHHBBBBII')
+COMPRESSION_NONE = 0
+COMPRESSION_RLE = 1
+
+# EPD_7IN3E_* codes of the panel palette, keyed by BMP (B, G, R)
+PALETTE = {
+    (0, 0, 0): 0x0,         # Black
+    (255, 255, 255): 0x1,   # White
+    (0, 255, 255): 0x2,     # Yellow
+    (0, 0, 255): 0x3,       # Red
+    (255, 0, 0): 0x5,       # Blue
+    (0, 255, 0): 0x6,       # Green
+}
+
+
+def read_bmp(path):
+    """Rows of panel codes, top row first"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:2] != b'BM':
+        raise ValueError("not a BMP file")
+    offset = struct.unpack_from('<I', data, 10)[0]
+    width, height, _, bit_count, compression = struct.unpack_from('<iiHHI', data, 18)
+    if bit_count != 24 or compression != 0:
+        raise ValueError(f"{bit_count}-bit BMP, only uncompressed 24-bit is supported")
+
+    stride = (width * 3 + 3) & ~3
+    bottom_up = height > 0
+    height = abs(height)
+    rows = []
+    for y in range(height):
+        file_row = height - 1 - y if bottom_up else y
+        start = offset + file_row * stride
+        row = []
+        for x in range(width):
+            # Off-palette colours fall back to white, like the firmware reader
+            row.append(PALETTE.get(tuple(data[start + x * 3:start + x * 3 + 3]), 0x1))
+        rows.append(row)
+    return width, height, rows
+
+
+def map_point(x, y, rotate, mirror):
+    """Paint_SetPixel's logical -> memory transform"""
+    if rotate == 0:
+        X, Y = x, y
+    elif rotate == 90:
+        X, Y = PANEL_WIDTH - y - 1, x
+    elif rotate == 180:
+        X, Y = PANEL_WIDTH - x - 1, PANEL_HEIGHT - y - 1
+    else:
+        X, Y = y, PANEL_HEIGHT - x - 1
+    if mirror & 0x01:
+        X = PANEL_WIDTH - X - 1
+    if mirror & 0x02:
+        Y = PANEL_HEIGHT - Y - 1
+    return X, Y
+
+
+def logical_size(rotate):
+    """Paint.Width x Paint.Height for a rotation"""
+    return (PANEL_WIDTH, PANEL_HEIGHT) if rotate in (0, 180) else (PANEL_HEIGHT, PANEL_WIDTH)
+
+
+def build_frame(rows, rotate, mirror):
+    """Packed 4bpp frame, as GUI_ReadBmp_RGB_6Color(path, 0, 0) leaves epd_blackImage"""
+    width_byte = (PANEL_WIDTH + 1) // 2
+    frame = bytearray([0x11] * (width_byte * PANEL_HEIGHT))
+    for y, row in enumerate(rows):
+        for x, code in enumerate(row):
+            X, Y = map_point(x, y, rotate, mirror)
+            addr = Y * width_byte + X // 2
+            if X % 2:
+                frame[addr] = (frame[addr] & 0xF0) | code
+            else:
+                frame[addr] = (frame[addr] & 0x0F) | (code << 4)
+    return bytes(frame)
+
+
+def rle_encode(data):
+    """PackBits, the same tokens as epf_rle_token()"""
+    out = bytearray()
+    n = len(data)
+    p = 0
+    while p < n:
+        run = 1
+        while p + run < n and run < 128 and data[p + run] == data[p]:
+            run += 1
+        if run >= 3:
+            out += bytes((257 - run, data[p]))
+            p += run
+            continue
+        length = 0
+        while p + length < n and length < 128:
+            if p + length + 2 < n and data[p + length] == data[p + length + 1] == data[p + length + 2]:
+                break
+            length += 1
+        out.append(length - 1)
+        out += data[p:p + length]
+        p += length
+    return bytes(out)
+
+
+def write_epf(path, frame, rotate, mirror, use_rle):
+    compression = COMPRESSION_NONE
+    payload = frame
+    if use_rle:
+        packed = rle_encode(frame)
+        if len(packed) < len(frame):
+            compression = COMPRESSION_RLE
+            payload = packed
+    layout = ((rotate // 90) & 0x03) | ((mirror & 0x03) << 2)
+    header = HEADER.pack(b'EPF1', PANEL_WIDTH, PANEL_HEIGHT, 4, compression, layout, 0, len(payload), len(frame))
+    with open(path, 'wb') as f:
+        f.write(header)
+        f.write(payload)
+    return compression, HEADER.size + len(payload)
+
+
+def convert_dir(directory, args):
+    converted = 0
+    for name in sorted(os.listdir(directory)):
+        if not name.lower().endswith('.bmp'):
+            continue
+        src = os.path.join(directory, name)
+        dst = os.path.splitext(src)[0] + '.epf'
+        if os.path.exists(dst) and not args.force:
+            print(f"skip {src}: {os.path.basename(dst)} exists")
+            continue
+        try:
+            width, height, rows = read_bmp(src)
+        except (ValueError, struct.error) as e:
+            print(f"skip {src}: {e}")
+            continue
+        if (width, height) != logical_size(args.rotate):
+            print(f"skip {src}: {width}x{height} does not fill the screen")
+            continue
+
+        frame = build_frame(rows, args.rotate, args.mirror)
+        compression, size = write_epf(dst, frame, args.rotate, args.mirror, not args.raw)
+        print(f"{src} -> {os.path.basename(dst)} ({'RLE' if compression else 'raw'}, {size} bytes)")
+        if args.remove:
+            os.remove(src)
+        converted += 1
+    return converted
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Convert full-screen 6-colour BMPs to EPF frames")
+    parser.add_argument("dirs", nargs='+', help="Directories holding the BMPs")
+    parser.add_argument("--rotate", type=int, default=180, choices=(0, 90, 180, 270),
+                        help="Paint rotation of the firmware (default 180)")
+    parser.add_argument("--mirror", type=int, default=0, choices=(0, 1, 2, 3),
+                        help="Paint mirror bits of the firmware (default 0)")
+    parser.add_argument("--raw", action='store_true', help="Never RLE-compress")
+    parser.add_argument("--force", action='store_true', help="Overwrite existing .epf files")
+    parser.add_argument("--remove", action='store_true', help="Delete each BMP once converted")
+    args = parser.parse_args()
+
+    total = 0
+    for directory in args.dirs:
+        if not os.path.isdir(directory):
+            print(f"Error: {directory} is not a directory")
+            sys.exit(1)
+        total += convert_dir(directory, args)
+    print(f"Converted {total} image(s)")
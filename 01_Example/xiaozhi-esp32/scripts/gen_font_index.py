@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Generate the sorted codepoint index of the CH_CN font tables.
+
+Paint_DrawString_CN looks glyphs up by binary search in these indexes
+instead of scanning the whole table for every character.
+"""
+import argparse
+import os
+import re
+
+SOURCE_TEMPLATE = """// Auto-generated by scripts/gen_font_index.py from {sources}, do not edit
+#include "fonts.h"
+#include <stddef.h>
+
+{tables}
+const cFONT_INDEX *Font_CN_GetIndex(const cFONT *font)
+{{
+{lookups}
+    return NULL;
+}}
+"""
+
+TABLE_RE = re.compile(r'const\s+CH_CN\s+(\w+)_Table\s*\[\s*\]')
+ENTRY_RE = re.compile(r'\{\s*\{\s*"((?:[^"\\]|\\.)*)"\s*\}')
+
+
+def first_codepoint(index):
+    """Codepoint of the first character of an index string, after C escapes"""
+    text = re.sub(r'\\(.)', r'\1', index)
+    return ord(text[0]) if text else None
+
+
+def parse_font(path):
+    with open(path, 'r', encoding='utf-8') as f:
+        source = f.read()
+    match = TABLE_RE.search(source)
+    if match is None:
+        raise ValueError(f"No CH_CN table in {path}")
+    name = match.group(1)
+
+    # Entries in table order; a codepoint keeps its first slot, like the old linear scan
+    slots = {}
+    for slot, entry in enumerate(ENTRY_RE.finditer(source, match.end())):
+        codepoint = first_codepoint(entry.group(1))
+        if codepoint is not None and codepoint not in slots:
+            slots[codepoint] = slot
+    return name, sorted(slots.items())
+
+
+def format_array(values, per_line=8):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('    ' + ', '.join(values[i:i + per_line]) + ',')
+    return '\n'.join(lines)
+
+
+def generate_source(font_paths, output_path):
+    tables = []
+    lookups = []
+    for path in font_paths:
+        name, entries = parse_font(path)
+        tables.append(f'''extern const CH_CN {name}_Table[];
+
+static const uint32_t {name}_Codepoints[] = {{
+{format_array([f"0x{cp:04X}" for cp, _ in entries])}
+}};
+
+static const uint16_t {name}_Slots[] = {{
+{format_array([str(slot) for _, slot in entries])}
+}};
+
+static const cFONT_INDEX {name}_Index = {{ {name}_Codepoints, {name}_Slots, {len(entries)} }};
+''')
+        lookups.append(f'''    if (font->table == {name}_Table) {{
+        return &{name}_Index;
+    }}''')
+        print(f"{name}: {len(entries)} glyphs")
+
+    content = SOURCE_TEMPLATE.format(
+        sources=', '.join(os.path.basename(p) for p in font_paths),
+        tables='\n'.join(tables),
+        lookups='\n'.join(lookups)
+    )
+
+    os.makedirs(os.path.dirname(os.path.abspath(output_path)), exist_ok=True)
+    with open(output_path, 'w', encoding='utf-8') as f:
+        f.write(content)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Generate the sorted codepoint index of CH_CN font tables")
+    parser.add_argument("--output", required=True, help="Output C source file path")
+    parser.add_argument("fonts", nargs='+', help="Font sources defining a CH_CN table")
+    args = parser.parse_args()
+
+    try:
+        generate_source(sorted(args.fonts), args.output)
+        print(f"Successfully generated font index: {args.output}")
+    except Exception as e:
+        print(f"Error: {e}")
+        exit(1)
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Pre-compress the AP-mode web UI for the SD card.
+
+Writes a "<file>.gz" next to every text asset under the given directories
+(default: the 03_sys_ap_html folder of the SD card image). The firmware's
+static file handler sends the .gz instead of the original, with
+Content-Encoding: gzip, to browsers that accept it. Re-run after editing
+an asset, a stale .gz is served as long as it exists.
+
+    python scripts/gzip_web_assets.py /media/sd/03_sys_ap_html
+"""
+import argparse
+import gzip
+import os
+import sys
+
+EXTENSIONS = ('.html', '.css', '.js', '.json', '.svg')
+
+
+def compress_file(path, force):
+    dst = path + '.gz'
+    if os.path.exists(dst) and not force and os.path.getmtime(dst) >= os.path.getmtime(path):
+        return None
+    with open(path, 'rb') as f:
+        data = f.read()
+    # mtime=0 keeps the output identical between runs
+    packed = gzip.compress(data, compresslevel=9, mtime=0)
+    if len(packed) >= len(data):
+        if os.path.exists(dst):
+            os.remove(dst)
+        return None
+    with open(dst, 'wb') as f:
+        f.write(packed)
+    return len(data), len(packed)
+
+
+def compress_dir(directory, force):
+    total = 0
+    for root, _, files in os.walk(directory):
+        for name in sorted(files):
+            if not name.lower().endswith(EXTENSIONS):
+                continue
+            path = os.path.join(root, name)
+            result = compress_file(path, force)
+            if result is None:
+                continue
+            size, packed = result
+            print(f"{os.path.relpath(path, directory)}: {size} -> {packed} bytes")
+            total += 1
+    return total
+
+
+if __name__ == "__main__":
+    default_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', '02_SDCARD', '03_sys_ap_html')
+    parser = argparse.ArgumentParser(description="Write .gz siblings of the web UI assets")
+    parser.add_argument("dirs", nargs='*', default=[os.path.normpath(default_dir)], help="Web UI directories")
+    parser.add_argument("--force", action='store_true', help="Rewrite up-to-date .gz files")
+    args = parser.parse_args()
+
+    count = 0
+    for directory in args.dirs:
+        if not os.path.isdir(directory):
+            print(f"Error: {directory} is not a directory")
+            sys.exit(1)
+        count += compress_dir(directory, args.force)
+    print(f"Compressed {count} file(s)")
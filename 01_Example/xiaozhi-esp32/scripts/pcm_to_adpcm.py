@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Convert raw 16-bit PCM prompt clips to the IMA-ADPCM clips audio_bsp embeds.
+
+Takes little-endian signed 16-bit PCM (stereo clips are mixed down to mono,
+playback duplicates the channel again) and writes a .adp file next to each
+input. See components/audio_bsp/audio_prompt.h for the format.
+
+    python scripts/pcm_to_adpcm.py clips/*.pcm --channels 2 --rate 16000
+    cp clips/*.adp components/audio_bsp/prompt_src/
+"""
+import argparse
+import os
+import struct
+import sys
+
+HEADER = struct.Struct('<4sIIHH')
+MAGIC = b'IMAA'
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+]
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def read_pcm(path, channels):
+    """Mono samples of a raw PCM file"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    count = len(data) // 2
+    samples = struct.unpack(f'<{count}h', data[:count * 2])
+    if channels == 1:
+        return list(samples)
+    return [sum(samples[i:i + channels]) // channels for i in range(0, count - channels + 1, channels)]
+
+
+def encode_block(samples, predictor, index):
+    """Nibbles of one block starting from (predictor, index), mirrors the firmware decoder"""
+    codes = []
+    for sample in samples:
+        step = STEP_TABLE[index]
+        diff = sample - predictor
+        code = 0
+        if diff < 0:
+            code = 8
+            diff = -diff
+        # Same shifts as the decoder so encoder and decoder stay in lock step
+        delta = step >> 3
+        if diff >= step:
+            code |= 4
+            diff -= step
+            delta += step
+        if diff >= step >> 1:
+            code |= 2
+            diff -= step >> 1
+            delta += step >> 1
+        if diff >= step >> 2:
+            code |= 1
+            delta += step >> 2
+        predictor += -delta if code & 8 else delta
+        predictor = max(-32768, min(32767, predictor))
+        index = max(0, min(88, index + INDEX_TABLE[code]))
+        codes.append(code)
+    if len(codes) & 1:
+        codes.append(0)
+    packed = bytes(codes[i] | (codes[i + 1] << 4) for i in range(0, len(codes), 2))
+    return packed, predictor, index
+
+
+def encode(samples, rate, block_samples):
+    out = bytearray(HEADER.pack(MAGIC, rate, len(samples), block_samples, 0))
+    predictor, index = 0, 0
+    for start in range(0, len(samples), block_samples):
+        block = samples[start:start + block_samples]
+        # The block header carries the state the previous block ended in
+        out += struct.pack('<hBB', predictor, index, 0)
+        packed, predictor, index = encode_block(block, predictor, index)
+        out += packed
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert raw PCM prompt clips to IMA-ADPCM")
+    parser.add_argument("files", nargs='+', help="Raw little-endian 16-bit PCM files")
+    parser.add_argument("--channels", type=int, default=2, help="Interleaved channels in the PCM")
+    parser.add_argument("--rate", type=int, default=16000, help="Sample rate of the PCM")
+    parser.add_argument("--block", type=int, default=1024, help="Samples per block, even")
+    args = parser.parse_args()
+    if args.block <= 0 or args.block & 1:
+        sys.exit("--block must be even")
+
+    for path in args.files:
+        samples = read_pcm(path, args.channels)
+        clip = encode(samples, args.rate, args.block)
+        out_path = os.path.splitext(path)[0] + '.adp'
+        with open(out_path, 'wb') as f:
+            f.write(clip)
+        print(f"{path}: {os.path.getsize(path)} -> {len(clip)} bytes ({out_path})")
+
+
+if __name__ == "__main__":
+    main()
@@ -33,50 +33,60 @@ function FileInput_Even(event) // change
     return;
   }
 
-  const fileName = file.name.toLowerCase();
-  if (!fileName.endsWith(".bmp")) {
-    alert("请选择 BMP 图片文件");
-    return;
-  }
-
   const reader = new FileReader();
   reader.onload = function (e) {
     const buffer = new Uint8Array(e.target.result);
-
-    // BMP 文件头检查
-    if (buffer[0] !== 0x42 || buffer[1] !== 0x4D) {
-      alert("无效的 BMP 文件");
+    const isBmp = buffer[0] === 0x42 && buffer[1] === 0x4D;
+    const isPng = buffer[0] === 0x89 && buffer[1] === 0x50 && buffer[2] === 0x4E && buffer[3] === 0x47;
+    const isJpeg = buffer[0] === 0xFF && buffer[1] === 0xD8;
+    if (!isBmp && !isPng && !isJpeg) {
+      alert("请选择 BMP / PNG / JPEG 图片文件");
       return;
     }
 
-    // 读取宽高（小端字节序）
-    const width = buffer[18] | (buffer[19] << 8) | (buffer[20] << 16) | (buffer[21] << 24);
-    const height = buffer[22] | (buffer[23] << 8) | (buffer[24] << 16) | (buffer[25] << 24);
-
-    // 位深
-    const bpp = buffer[28];
-    if (bpp !== 24) {
+    // BMP 直接按行绘制, 只接受 24 位无压缩
+    if (isBmp && (buffer[28] !== 24 || buffer[30] !== 0)) {
       alert("请选择 24 位 BMP 文件");
       return;
     }
 
-    // 分辨率判断
-    if (!((width === 800 && height === 480) || (width === 480 && height === 800))) {
-      alert(`BMP 图像分辨率必须为 800x480 或 480x800,当前为 ${width}x${height}`);
-      return;
-    }
-
-    // 所有验证通过，设置图像并标记成功
     const imageURL = URL.createObjectURL(file);
     ImageSys.src = imageURL;
     ImageSys.onload = () => {
       URL.revokeObjectURL(imageURL);
+      // 设备端 JPEG 需整张解码, 大图先在浏览器里缩放到屏幕尺寸
+      if (isJpeg && ImageSys.naturalWidth * ImageSys.naturalHeight > PanelW * PanelH) {
+        JpegShrink(ImageSys);
+      } else {
+        fileFlag = 1;
+      }
     };
-    fileFlag = 1;
   };
 
   reader.readAsArrayBuffer(file); // 读取数据 触发onload回调
 }
+const PanelW = 800;
+const PanelH = 480;
+function JpegShrink(img)      // 等比例裁剪填满屏幕, 重新编码为 JPEG
+{
+  const portrait = img.naturalHeight > img.naturalWidth;
+  const w = portrait ? PanelH : PanelW;
+  const h = portrait ? PanelW : PanelH;
+  const scale = Math.max(w / img.naturalWidth, h / img.naturalHeight);
+  const canvas = document.createElement("canvas");
+  canvas.width = w;
+  canvas.height = h;
+  canvas.getContext("2d").drawImage(img, (w - img.naturalWidth * scale) / 2, (h - img.naturalHeight * scale) / 2,
+                                    img.naturalWidth * scale, img.naturalHeight * scale);
+  canvas.toBlob(blob => {
+    if (!blob) {
+      alert("图片缩放失败");
+      return;
+    }
+    file = blob;
+    fileFlag = 1;
+  }, "image/jpeg", 0.92);
+}
 function SendButton_Even()
 {
   if(fileFlag)